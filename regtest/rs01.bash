@@ -10,6 +10,7 @@ MASTERECC=$ISODIR/rs01-master.ecc
 TMPISO=$TMPDIR/rs01-tmp.iso
 TMPECC=$TMPDIR/rs01-tmp.ecc
 SIMISO=$TMPDIR/rs01-sim.iso
+SIMISO2=$TMPDIR/rs01-sim2.iso
 
 CODEC_PREFIX=RS01
 
@@ -308,6 +309,49 @@ if try "image with uncorrectable dead sector markers (2), verbose output" uncorr
   run_regtest uncorrectable_dsm_in_image2_verbose "-t -v" $TMPISO $MASTERECC
 fi
 
+# Verify several images from a manifest with two workers
+
+if try "batch verify of good, defective and missing images" batch_verify; then
+
+  cp $MASTERISO $TMPISO
+  $NEWVER --debug -i$TMPISO --erase 1000-1099 >>$LOGFILE 2>&1
+  echo "# image and ecc file" >$TMPDIR/rs01-batch.txt
+  echo -e "$MASTERISO\t$MASTERECC" >>$TMPDIR/rs01-batch.txt
+  echo -e "$TMPISO\t$MASTERECC" >>$TMPDIR/rs01-batch.txt
+  echo "$TMPDIR/rs01-nonexisting.iso" >>$TMPDIR/rs01-batch.txt
+
+  extra_args="--debug --fixed-speed-values"
+  run_regtest batch_verify "--batch-verify=$TMPDIR/rs01-batch.txt --batch-jobs=2" $MASTERISO $MASTERECC
+  rm -f $TMPDIR/rs01-batch.txt
+fi
+
+# Read image and verify it in separate program calls.
+# The image is not scanned again; its checksums come from the CRC cache.
+
+if try "verify from crc cache of previous read" verify_from_crc_cache; then
+  cp $MASTERISO $SIMISO
+  rm -f $TMPISO $TMPDIR/crc.cache
+
+  $NEWVER --debug --sim-cd=$SIMISO --fixed-speed-values -i$TMPISO -r --spinup-delay=0 --crc-cache $TMPDIR/crc.cache >>$LOGFILE 2>&1
+
+  run_regtest verify_from_crc_cache "-t --crc-cache $TMPDIR/crc.cache" $TMPISO $MASTERECC
+  rm -f $TMPDIR/crc.cache
+fi
+
+# Same as above, but the medium contains a CRC error
+# which must be reported from the cached checksums.
+
+if try "verify crc errors from crc cache of previous read" verify_crc_errors_from_crc_cache; then
+  cp $MASTERISO $SIMISO
+  $NEWVER -i$SIMISO --debug --byteset 13444,0,154 >>$LOGFILE 2>&1
+  rm -f $TMPISO $TMPDIR/crc.cache
+
+  $NEWVER --debug --sim-cd=$SIMISO --fixed-speed-values -i$TMPISO -r --spinup-delay=0 --crc-cache $TMPDIR/crc.cache >>$LOGFILE 2>&1
+
+  run_regtest verify_crc_errors_from_crc_cache "-t --crc-cache $TMPDIR/crc.cache" $TMPISO $MASTERECC
+  rm -f $TMPDIR/crc.cache
+fi
+
 ### Creation tests
 
 REGTEST_SECTION="Creation tests"
@@ -387,6 +431,33 @@ if try "read image with ecc (RS01) and create new ecc" ecc_recreate_after_read_r
   run_regtest ecc_recreate_after_read_rs01 "-r -c $REDUNDANCY --spinup-delay=0 -v" $TMPISO $TMPECC
 fi
 
+# Read image and create ecc in separate program calls.
+# Tests whether the checksums are handed over through the CRC cache file.
+
+if try "create ecc from crc cache of previous read" ecc_create_from_crc_cache; then
+  cp $MASTERISO $SIMISO
+  rm -f $TMPISO $TMPDIR/crc.cache
+
+  $NEWVER --debug --sim-cd=$SIMISO --fixed-speed-values -i$TMPISO -r --spinup-delay=0 --crc-cache $TMPDIR/crc.cache >>$LOGFILE 2>&1
+
+  extra_args="--debug --set-version $SETVERSION --fixed-speed-values"
+  run_regtest ecc_create_from_crc_cache "-c $REDUNDANCY -v --crc-cache $TMPDIR/crc.cache" $TMPISO $TMPECC
+fi
+
+# Same as above, but the image has been modified after reading.
+# The CRC cache must not be used then.
+
+if try "create ecc from outdated crc cache" ecc_create_from_stale_crc_cache; then
+  cp $MASTERISO $SIMISO
+  rm -f $TMPISO $TMPDIR/crc.cache
+
+  $NEWVER --debug --sim-cd=$SIMISO --fixed-speed-values -i$TMPISO -r --spinup-delay=0 --crc-cache $TMPDIR/crc.cache >>$LOGFILE 2>&1
+  touch -t 200601010000 $TMPISO
+
+  extra_args="--debug --set-version $SETVERSION --fixed-speed-values"
+  run_regtest ecc_create_from_stale_crc_cache "-c $REDUNDANCY -v --crc-cache $TMPDIR/crc.cache" $TMPISO $TMPECC
+fi
+
 # Read image with ecc file and create new (other) ecc in the same program call.
 # Tests whether CRC and ECC information is handed over correctly.
 # Note: RS02 information will not be removed from the image. This ist intentional behaviour.
@@ -1019,6 +1090,72 @@ if try "reading image, defective media, large sector skip" read_defective_large_
   run_regtest read_defective_large_skip "--spinup-delay=0 -r -j 256" $TMPISO  $ISODIR/no.ecc
 fi
 
+# Read image with several read commands queued at the drive
+
+if try "reading image with read-ahead, no ecc data" read_ahead_no_ecc; then
+
+  extra_args="--debug --sim-cd=$MASTERISO --fixed-speed-values"
+  run_regtest read_ahead_no_ecc "--spinup-delay=0 --read-ahead=8 -r" $TMPISO  $ISODIR/no.ecc
+fi
+
+# Read image with read-ahead from defective media.
+# Read-ahead is given up at the first read error; the result must
+# be the same as in read_defective_no_ecc.
+
+if try "reading image with read-ahead, defective media, no ecc data" read_ahead_defective_no_ecc; then
+
+  cp $MASTERISO $SIMISO
+  $NEWVER --debug -i$SIMISO --erase 100-200 >>$LOGFILE 2>&1
+  $NEWVER --debug -i$SIMISO --erase 766 >>$LOGFILE 2>&1
+  $NEWVER --debug -i$SIMISO --erase 2410 >>$LOGFILE 2>&1
+  
+  extra_args="--debug --sim-cd=$SIMISO --fixed-speed-values"
+  run_regtest read_ahead_defective_no_ecc "--spinup-delay=0 --read-ahead=8 -r" $TMPISO  $ISODIR/no.ecc
+fi
+
+# Read image with two drives in parallel
+
+if try "reading image with two drives, no ecc data" read_striped_no_ecc; then
+
+  extra_args="--debug --sim-cd=$MASTERISO --sim-cd=$MASTERISO -d sim-cd,sim-cd2 --fixed-speed-values"
+  run_regtest read_striped_no_ecc "--spinup-delay=0 -r" $TMPISO  $ISODIR/no.ecc
+fi
+
+# Read image with two drives containing differently damaged media.
+# Each drive supplies the sectors the other one can not read,
+# so the image must be complete.
+
+if try "reading image with two drives, defective media, no ecc data" read_striped_defective_no_ecc; then
+
+  cp $MASTERISO $SIMISO
+  $NEWVER --debug -i$SIMISO --erase 100-200 >>$LOGFILE 2>&1
+  $NEWVER --debug -i$SIMISO --erase 766 >>$LOGFILE 2>&1
+  $NEWVER --debug -i$SIMISO --erase 2410 >>$LOGFILE 2>&1
+  cp $MASTERISO $SIMISO2
+  $NEWVER --debug -i$SIMISO2 --erase 3000-3050 >>$LOGFILE 2>&1
+  
+  extra_args="--debug --sim-cd=$SIMISO --sim-cd=$SIMISO2 -d sim-cd,sim-cd2 --fixed-speed-values"
+  run_regtest read_striped_defective_no_ecc "--spinup-delay=0 -r" $TMPISO  $ISODIR/no.ecc
+  rm -f $SIMISO2
+fi
+
+# Read image with two drives and ecc data. Sectors failing the
+# CRC test on one drive are taken from the other one.
+
+if try "reading image with two drives, defective media, ecc file" read_striped_defective_with_ecc; then
+
+  cp $MASTERISO $SIMISO
+  $NEWVER --debug -i$SIMISO --erase 100-200 >>$LOGFILE 2>&1
+  $NEWVER --debug -i$SIMISO --byteset 5000,100,1 >>$LOGFILE 2>&1
+  cp $MASTERISO $SIMISO2
+  $NEWVER --debug -i$SIMISO2 --erase 3000-3050 >>$LOGFILE 2>&1
+  $NEWVER --debug -i$SIMISO2 --byteset 7000,100,1 >>$LOGFILE 2>&1
+  
+  extra_args="--debug --sim-cd=$SIMISO --sim-cd=$SIMISO2 -d sim-cd,sim-cd2 --fixed-speed-values"
+  run_regtest read_striped_defective_with_ecc "--spinup-delay=0 -r" $TMPISO  $MASTERECC
+  rm -f $SIMISO2
+fi
+
 # Complete a truncated image
 
 if try "completing truncated image with no ecc data available" read_truncated_no_ecc; then
@@ -658,6 +658,21 @@ if try "ecc creating after reading image" ecc_create_after_read; then
    run_regtest ecc_create_after_read "-r --spinup-delay=0 -mRS02 -n$ECCSIZE -c -v" $TMPISO $NO_FILE
 fi
 
+# Read image and augment with RS02 in separate program calls.
+# The checksums are handed over through the CRC cache file.
+
+if try "ecc creating from crc cache of previous read" ecc_create_from_crc_cache; then
+   $NEWVER --debug -i$SIMISO --random-image $ISOSIZE >>$LOGFILE 2>&1
+   rm -f $TMPISO $TMPDIR/crc.cache
+
+   $NEWVER --debug --sim-cd=$SIMISO --fixed-speed-values -i$TMPISO -r --spinup-delay=0 --crc-cache $TMPDIR/crc.cache >>$LOGFILE 2>&1
+
+   replace_config method-name RS02
+   replace_config medium-size 35000
+   extra_args="--debug --set-version $SETVERSION --fixed-speed-values"
+   run_regtest ecc_create_from_crc_cache "-mRS02 -n$ECCSIZE -c -v --crc-cache $TMPDIR/crc.cache" $TMPISO $NO_FILE
+fi
+
 # Complete image and augment with RS02 in one pass.
 # In that case cached checksums can not be used.
 # Note: GUI mode will NOT automatically augment the image.
@@ -942,13 +957,38 @@ if try "image with bad crc byte" fix_crc_bad_byte; then
   run_regtest fix_crc_bad_byte "--debug --set-version $SETVERSION -f" $TMPISO $NO_FILE
 fi
 
-# Image contains bad byte in the ecc section
+# Image contains bad byte in the ecc section.
+# The ecc sectors have no CRC, so the ecc block is only decoded with --paranoid.
 
 if try "image with bad ecc byte" fix_ecc_bad_byte; then
    cp $MASTERISO $TMPISO 
    $NEWVER -i$TMPISO --debug --byteset 33100,50,10 >>$LOGFILE 2>&1
 
-  run_regtest fix_ecc_bad_byte "--debug --set-version $SETVERSION -f" $TMPISO $NO_FILE
+  run_regtest fix_ecc_bad_byte "--debug --set-version $SETVERSION --paranoid -f" $TMPISO $NO_FILE
+fi
+
+# Same without --paranoid: the ecc block with the bad ecc byte has intact
+# data sectors and is skipped, so only the erased data sector is repaired.
+
+if try "image with bad ecc byte, not paranoid" fix_ecc_bad_byte_skipped; then
+   cp $MASTERISO $TMPISO 
+   $NEWVER -i$TMPISO --debug --erase 1000 >>$LOGFILE 2>&1
+   $NEWVER -i$TMPISO --debug --byteset 33100,50,10 >>$LOGFILE 2>&1
+
+  run_regtest fix_ecc_bad_byte_skipped "--debug --set-version $SETVERSION -f" $TMPISO $NO_FILE
+fi
+
+# Repair only the ecc blocks listed in a damage map created by verifying the image
+
+if try "image with damage map" fix_damage_map; then
+   cp $MASTERISO $TMPISO 
+   $NEWVER -i$TMPISO --debug --erase 1000 >>$LOGFILE 2>&1
+   $NEWVER -i$TMPISO --debug --byteset 1235,50,10 >>$LOGFILE 2>&1
+   $NEWVER -i$TMPISO --debug --erase 33100 >>$LOGFILE 2>&1
+   rm -f $TMPDIR/damage.map
+   $NEWVER -i$TMPISO --debug --set-version $SETVERSION -t --damage-map $TMPDIR/damage.map >>$LOGFILE 2>&1
+
+  run_regtest fix_damage_map "--debug --set-version $SETVERSION --damage-map $TMPDIR/damage.map -f" $TMPISO $NO_FILE
 fi
 
 # Image is good with ECC header following directly after the user data
@@ -771,6 +771,20 @@ if try "fixing ecc file with missing ecc sectors" fix_missing_ecc_sectors; then
   run_regtest fix_missing_ecc_sectors "-f" $TMPISO $TMPECC
 fi
 
+# Fix image with a bad byte in the ecc file's ecc portion.
+# The ecc sectors have no CRC and the data sectors of that ecc block
+# are intact, so the block is skipped unless --paranoid is given.
+
+if try "fixing ecc file with bad byte in ecc sector, not paranoid" fix_ecc_bad_byte_skipped; then
+  cp $MASTERISO $TMPISO
+  cp $MASTERECC $TMPECC
+
+  $NEWVER --debug -i $TMPISO --erase 900 >>$LOGFILE 2>&1
+  $NEWVER --debug -i $TMPECC --byteset 115,100,17 >>$LOGFILE 2>&1
+
+  run_regtest fix_ecc_bad_byte_skipped "-f" $TMPISO $TMPECC
+fi
+
 # Fix image with missing sectors in several border locations
 
 if try "trying to fix image with missing sectors in border cases" fix_border_cases_erasures; then
@@ -823,6 +837,32 @@ if try "trying to fix image with crc errors in border cases" fix_border_cases_cr
   run_regtest fix_border_cases_crc_errors "-f" $TMPISO $TMPECC
 fi
 
+# Same as above, but with several decoder threads and smaller caches.
+
+if try "trying to fix image with crc errors in border cases, several threads" fix_border_cases_crc_errors_threads; then
+  cp $MASTERISO $TMPISO
+  cp $MASTERECC $TMPECC
+  $NEWVER --debug -i$TMPISO --byteset 0,0,1 >>$LOGFILE 2>&1       # first sector
+  $NEWVER --debug -i$TMPISO --byteset 90,0,0 >>$LOGFILE 2>&1      # first sector, second layer
+  $NEWVER --debug -i$TMPISO --byteset 180,0,0 >>$LOGFILE 2>&1     # first sector, third layer
+  $NEWVER --debug -i$TMPISO --byteset 20970,0,0 >>$LOGFILE 2>&1   # first sector, last data layer
+  $NEWVER --debug -i$TMPECC --byteset 2,0,0 >>$LOGFILE 2>&1       # first sector, crc layer
+  $NEWVER --debug -i$TMPECC --byteset 92,0,0 >>$LOGFILE 2>&1      # first sector, first ecc layer
+  $NEWVER --debug -i$TMPECC --byteset 182,0,0 >>$LOGFILE 2>&1     # first sector, second ecc layer
+  $NEWVER --debug -i$TMPECC --byteset 1802,0,0 >>$LOGFILE 2>&1    # first sector, last ecc layer
+
+  $NEWVER --debug -i$TMPISO --byteset 89,0,0 >>$LOGFILE 2>&1      # first sector
+  $NEWVER --debug -i$TMPISO --byteset 179,0,0 >>$LOGFILE 2>&1     # first sector, second layer
+  $NEWVER --debug -i$TMPISO --byteset 269,0,0 >>$LOGFILE 2>&1     # first sector, third layer
+  $NEWVER --debug -i$TMPISO --byteset 20999,0,0 >>$LOGFILE 2>&1   # first sector, last data layer
+  $NEWVER --debug -i$TMPECC --byteset 91,0,0 >>$LOGFILE 2>&1       # first sector, crc layer
+  $NEWVER --debug -i$TMPECC --byteset 181,0,0 >>$LOGFILE 2>&1      # first sector, first ecc layer
+  $NEWVER --debug -i$TMPECC --byteset 271,0,0 >>$LOGFILE 2>&1     # first sector, second ecc layer
+  $NEWVER --debug -i$TMPECC --byteset 1891,0,0 >>$LOGFILE 2>&1    # first sector, last ecc layer
+
+  run_regtest fix_border_cases_crc_errors_threads "-f -x 4 --cache-size 8" $TMPISO $TMPECC
+fi
+
 # Fix image without read permission on image
 
 if try "fixing image without read permission" fix_no_read_perm; then
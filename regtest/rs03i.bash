@@ -194,6 +194,86 @@ if try "bad byte in ecc sector" ecc_bad_byte; then
    run_regtest ecc_bad_byte "-t" $TMPISO  $NO_FILE
 fi
 
+# Same as above, but checking the ecc blocks with several threads
+
+if try "bad byte in ecc sector, several threads" ecc_bad_byte_threads; then
+   cp $MASTERISO $TMPISO
+   $NEWVER -i$TMPISO --debug --byteset 21878,100,17 >>$LOGFILE 2>&1
+
+   run_regtest ecc_bad_byte_threads "-t -x 4 --prefetch-sectors 32" $TMPISO  $NO_FILE
+fi
+
+# Same as above, but using the portable syndrome calculation
+
+if try "bad byte in ecc sector, portable codec" ecc_bad_byte_32bit; then
+   cp $MASTERISO $TMPISO
+   $NEWVER -i$TMPISO --debug --byteset 21878,100,17 >>$LOGFILE 2>&1
+
+   run_regtest ecc_bad_byte_32bit "-t --encoding-algorithm 32bit" $TMPISO  $NO_FILE
+fi
+
+# Incremental verify of an image which has not changed since the last verify
+
+if try "incremental verify, unchanged image" verify_incremental_unchanged; then
+   cp $MASTERISO $TMPISO
+   touch -t 200601010000 $TMPISO
+   rm -f $TMPDIR/verify.state
+   $NEWVER -i$TMPISO -t --verify-state $TMPDIR/verify.state >>$LOGFILE 2>&1
+
+   run_regtest verify_incremental_unchanged "-t --verify-state $TMPDIR/verify.state" $TMPISO  $NO_FILE
+fi
+
+# Incremental verify of an image which has been rewritten since the last verify
+
+if try "incremental verify, rewritten image" verify_incremental_modified; then
+   cp $MASTERISO $TMPISO
+   touch -t 200601010000 $TMPISO
+   rm -f $TMPDIR/verify.state
+   $NEWVER -i$TMPISO -t --verify-state $TMPDIR/verify.state >>$LOGFILE 2>&1
+   $NEWVER -i$TMPISO --debug --byteset 4096,100,17 >>$LOGFILE 2>&1
+   dd if=$TMPISO of=$TMPISO.new bs=2048 2>/dev/null
+   mv $TMPISO.new $TMPISO
+
+   run_regtest verify_incremental_modified "-t --verify-state $TMPDIR/verify.state" $TMPISO  $NO_FILE
+fi
+
+# Incremental verify of an image which has been modified in place.
+# The extents remain the same unless the file system copies on write,
+# so the damage must be found by a full verify.
+
+if try "incremental verify, image modified in place" verify_incremental_modified_in_place; then
+   cp $MASTERISO $TMPISO
+   touch -t 200601010000 $TMPISO
+   rm -f $TMPDIR/verify.state
+   $NEWVER -i$TMPISO -t --verify-state $TMPDIR/verify.state >>$LOGFILE 2>&1
+   $NEWVER -i$TMPISO --debug --byteset 4096,100,17 >>$LOGFILE 2>&1
+
+   run_regtest verify_incremental_modified_in_place "-t --verify-state $TMPDIR/verify.state" $TMPISO  $NO_FILE
+fi
+
+# Ecc blocks found defective by the last verify are checked again
+
+if try "incremental verify, known defect" verify_incremental_defect; then
+   cp $MASTERISO $TMPISO
+   $NEWVER -i$TMPISO --debug --byteset 4096,100,17 >>$LOGFILE 2>&1
+   touch -t 200601010000 $TMPISO
+   rm -f $TMPDIR/verify.state
+   $NEWVER -i$TMPISO -t --verify-state $TMPDIR/verify.state >>$LOGFILE 2>&1
+
+   run_regtest verify_incremental_defect "-t --verify-state $TMPDIR/verify.state" $TMPISO  $NO_FILE
+fi
+
+# Full verify is enforced by --full-verify-days
+
+if try "incremental verify, full verify due" verify_incremental_forced; then
+   cp $MASTERISO $TMPISO
+   touch -t 200601010000 $TMPISO
+   rm -f $TMPDIR/verify.state
+   $NEWVER -i$TMPISO -t --verify-state $TMPDIR/verify.state >>$LOGFILE 2>&1
+
+   run_regtest verify_incremental_forced "-t --verify-state $TMPDIR/verify.state --full-verify-days 0" $TMPISO  $NO_FILE
+fi
+
 # Image size is exact multiple of layer size,
 # resulting in a padding layer containing just the ecc sector behind the data area.
 
@@ -1018,6 +1098,40 @@ if try "trying to fix correctable image" fix_correctable; then
   run_regtest fix_correctable "-f" $TMPISO  $NO_FILE
 fi
 
+# Fix image with a bad byte in the ecc portion.
+# The ecc sectors have no CRC, so the ecc block is only decoded with --paranoid.
+
+if try "trying to fix bad byte in ecc sector" fix_ecc_bad_byte; then
+  cp $MASTERISO $TMPISO
+  $NEWVER --debug -i$TMPISO --byteset 21878,100,17 >>$LOGFILE 2>&1
+
+  run_regtest fix_ecc_bad_byte "--paranoid -f" $TMPISO  $NO_FILE
+fi
+
+# Same without --paranoid: the ecc block with the bad ecc byte has intact
+# data sectors and is skipped, so only the erased data sector is repaired.
+
+if try "trying to fix bad byte in ecc sector, not paranoid" fix_ecc_bad_byte_skipped; then
+  cp $MASTERISO $TMPISO
+  $NEWVER --debug -i$TMPISO --erase 1000 >>$LOGFILE 2>&1
+  $NEWVER --debug -i$TMPISO --byteset 21878,100,17 >>$LOGFILE 2>&1
+
+  run_regtest fix_ecc_bad_byte_skipped "-f" $TMPISO  $NO_FILE
+fi
+
+# Repair only the ecc blocks listed in a damage map created by verifying the image
+
+if try "trying to fix image using a damage map" fix_damage_map; then
+  cp $MASTERISO $TMPISO
+  $NEWVER --debug -i$TMPISO --erase 1000 >>$LOGFILE 2>&1
+  $NEWVER --debug -i$TMPISO --byteset 2000,0,111 >>$LOGFILE 2>&1
+  $NEWVER --debug -i$TMPISO --erase 21070 >>$LOGFILE 2>&1   # crc layer, first ecc block
+  rm -f $TMPDIR/damage.map
+  $NEWVER -i$TMPISO -t --damage-map $TMPDIR/damage.map >>$LOGFILE 2>&1
+
+  run_regtest fix_damage_map "--damage-map $TMPDIR/damage.map -f" $TMPISO  $NO_FILE
+fi
+
 # Fix image with missing sectors in several border locations
 
 if try "trying to fix image with missing sectors in border cases" fix_border_cases_erasures; then
@@ -1068,6 +1182,32 @@ if try "trying to fix image with crc errors in border cases" fix_border_cases_cr
   run_regtest fix_border_cases_crc_errors "-f" $TMPISO  $NO_FILE
 fi
 
+# Same as above, but with several decoder threads and smaller caches.
+# Results must not differ from the single threaded case.
+
+if try "trying to fix image with crc errors in border cases, several threads" fix_border_cases_crc_errors_threads; then
+  cp $MASTERISO $TMPISO
+  $NEWVER --debug -i$TMPISO --byteset 0,0,1 >>$LOGFILE 2>&1       # first sector
+  $NEWVER --debug -i$TMPISO --byteset 98,0,0 >>$LOGFILE 2>&1      # first sector, second layer
+  $NEWVER --debug -i$TMPISO --byteset 196,0,0 >>$LOGFILE 2>&1     # first sector, third layer
+  $NEWVER --debug -i$TMPISO --byteset 20972,0,0 >>$LOGFILE 2>&1   # first sector, last data layer
+  $NEWVER --debug -i$TMPISO --byteset 21070,0,0 >>$LOGFILE 2>&1   # first sector, crc layer
+  $NEWVER --debug -i$TMPISO --byteset 21168,0,0 >>$LOGFILE 2>&1   # first sector, first ecc layer
+  $NEWVER --debug -i$TMPISO --byteset 21266,0,0 >>$LOGFILE 2>&1   # first sector, second ecc layer
+  $NEWVER --debug -i$TMPISO --byteset 24892,0,0 >>$LOGFILE 2>&1   # first sector, last ecc layer
+
+  $NEWVER --debug -i$TMPISO --byteset 97,0,0 >>$LOGFILE 2>&1      # last sector, first layer
+  $NEWVER --debug -i$TMPISO --byteset 195,0,0 >>$LOGFILE 2>&1     # last sector, second layer
+  $NEWVER --debug -i$TMPISO --byteset 293,0,0 >>$LOGFILE 2>&1     # last sector, third layer
+  $NEWVER --debug -i$TMPISO --byteset 20999,0,0 >>$LOGFILE 2>&1   # last sector, last data layer
+  $NEWVER --debug -i$TMPISO --byteset 21167,0,0 >>$LOGFILE 2>&1   # last sector, crc layer
+  $NEWVER --debug -i$TMPISO --byteset 21265,0,0 >>$LOGFILE 2>&1   # last sector, first ecc layer
+  $NEWVER --debug -i$TMPISO --byteset 21363,0,0 >>$LOGFILE 2>&1   # last sector, second ecc layer
+  $NEWVER --debug -i$TMPISO --byteset 24989,0,0 >>$LOGFILE 2>&1   # last sector, last ecc layer
+
+  run_regtest fix_border_cases_crc_errors_threads "-f -x 4 --cache-size 8" $TMPISO  $NO_FILE
+fi
+
 # Fix ecc file where image size is exact multiple of layer size,
 # resulting in a padding layer containing just the ecc sector behind the data area.
 
@@ -0,0 +1,391 @@
+/*  dvdisaster: Additional error correction for optical media.
+ *  Copyright (C) 2004-2017 Carsten Gnoerlich.
+ *  Copyright (C) 2019-2021 The dvdisaster development team.
+ *
+ *  Email: support@dvdisaster.org
+ *
+ *  This file is part of dvdisaster.
+ *
+ *  dvdisaster is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  dvdisaster is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with dvdisaster. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*** src type: no GUI code ***/
+
+#include "dvdisaster.h"
+
+/***
+ *** Adapting the number of codec threads and the chunk size at runtime
+ ***/
+
+/*
+ * The RS03 codecs work in a pipeline: One thread reads a chunk of
+ * ecc blocks while the codec threads process the previous one.
+ * After each chunk the caller reports whether the codec threads
+ * were still busy when the next chunk had been read (CPU bound)
+ * or not (I/O bound), together with the amount of data processed.
+ *
+ * Every AUTOTUNE_SAMPLE seconds the throughput is compared with
+ * the previous sample. When CPU bound, the number of active threads
+ * is doubled; when I/O bound, the chunk size is doubled. A change
+ * which does not gain at least AUTOTUNE_GAIN is taken back and that
+ * parameter is left alone for the rest of the run.
+ * If no more threads are available while still being CPU bound,
+ * smaller chunks are tried since they may fit better into the
+ * processor caches.
+ */
+
+#define AUTOTUNE_SAMPLE 0.5
+#define AUTOTUNE_GAIN   1.05
+
+enum { AUTOTUNE_KEEP, AUTOTUNE_THREADS, AUTOTUNE_CHUNK };
+
+/*
+ * Number of threads to spawn for a codec.
+ * Only the first AutoTune->activeThreads of them take work.
+ */
+
+static int max_threads(void)
+{  int n = g_get_num_processors();
+
+   n = MAX(n, Closure->codecThreads);
+   n = MAX(n, Closure->tunedThreads);
+
+   return MIN(n, MAX_CODEC_THREADS);
+}
+
+AutoTune* CreateAutoTune(int chunk, int min_chunk, int max_chunk)
+{  AutoTune *at = g_malloc0(sizeof(AutoTune));
+
+   at->maxThreads    = max_threads();
+   at->activeThreads = Closure->tunedThreads ? Closure->tunedThreads : Closure->codecThreads;
+   at->activeThreads = MIN(at->activeThreads, at->maxThreads);
+   at->minChunk      = min_chunk;
+   at->maxChunk      = max_chunk;
+   at->chunk         = CLAMP(chunk, min_chunk, max_chunk);
+   at->timer         = g_timer_new();
+
+   Verbose("Auto-tuning: %d of %d threads, chunk size %d (%d..%d)\n",
+	   at->activeThreads, at->maxThreads, at->chunk, min_chunk, max_chunk);
+
+   return at;
+}
+
+void FreeAutoTune(AutoTune *at)
+{  g_timer_destroy(at->timer);
+   g_free(at);
+}
+
+/*
+ * Account for a finished chunk. Returns TRUE if activeThreads
+ * or the chunk size have been changed.
+ */
+
+int AutoTuneChunk(AutoTune *at, int cpu_bound, double bytes)
+{  double elapsed, rate;
+   int cpu;
+
+   at->bytes += bytes;
+   if(cpu_bound) at->cpuBound++;
+   else          at->ioBound++;
+
+   elapsed = g_timer_elapsed(at->timer, NULL);
+   if(elapsed < AUTOTUNE_SAMPLE)
+      return FALSE;
+
+   rate = at->bytes/elapsed;
+   cpu  = at->cpuBound > at->ioBound;
+   at->bytes = 0.0;
+   at->cpuBound = at->ioBound = 0;
+   at->samples++;
+   g_timer_start(at->timer);
+
+   /* The first sample includes buffer allocation and the
+      initial read; use it only for warming up. */
+
+   if(at->samples == 1)
+      return FALSE;
+
+   /* Take back the last change if it did not pay off */
+
+   if(at->move != AUTOTUNE_KEEP && rate < at->lastRate*AUTOTUNE_GAIN)
+   {  if(at->move == AUTOTUNE_THREADS)
+      {  at->activeThreads = at->undo;
+	 at->threadsSettled = TRUE;
+      }
+      else
+      {  at->chunk = at->undo;
+	 at->chunkSettled = TRUE;
+      }
+      Verbose("Auto-tuning: %.1f MB/s, reverting to %d threads, chunk size %d\n",
+	      rate/1000000.0, at->activeThreads, at->chunk);
+      at->move = AUTOTUNE_KEEP;
+      return TRUE;
+   }
+
+   at->lastRate = rate;
+   at->move = AUTOTUNE_KEEP;
+
+   /* Try the next step */
+
+   if(cpu && !at->threadsSettled && at->activeThreads < at->maxThreads)
+   {  at->move = AUTOTUNE_THREADS;
+      at->undo = at->activeThreads;
+      at->activeThreads = MIN(2*at->activeThreads, at->maxThreads);
+   }
+   else if(!at->chunkSettled && cpu && at->chunk > at->minChunk)
+   {  at->move = AUTOTUNE_CHUNK;
+      at->undo = at->chunk;
+      at->chunk = MAX(at->chunk/2, at->minChunk);
+   }
+   else if(!at->chunkSettled && !cpu && at->chunk < at->maxChunk)
+   {  at->move = AUTOTUNE_CHUNK;
+      at->undo = at->chunk;
+      at->chunk = MIN(2*at->chunk, at->maxChunk);
+   }
+
+   if(at->move == AUTOTUNE_KEEP)
+      return FALSE;
+
+   Verbose("Auto-tuning: %.1f MB/s, %s bound; trying %d threads, chunk size %d\n",
+	   rate/1000000.0, cpu ? "CPU" : "I/O", at->activeThreads, at->chunk);
+   return TRUE;
+}
+
+/*
+ * Remember the outcome of a run in the host profile.
+ * A change which could not be evaluated any more is not kept,
+ * and runs which were too short for a single comparison are ignored.
+ */
+
+void AutoTuneRemember(AutoTune *at, int *profile_chunk, int scale)
+{
+   if(at->move == AUTOTUNE_THREADS)
+      at->activeThreads = at->undo;
+   if(at->move == AUTOTUNE_CHUNK)
+      at->chunk = at->undo;
+   at->move = AUTOTUNE_KEEP;
+
+   if(at->samples < 3)
+      return;
+
+   Closure->tunedThreads = at->activeThreads;
+   *profile_chunk = at->chunk*scale;
+   Closure->tunedChanged = TRUE;
+}
+
+/***
+ *** Choosing the fastest encoder for this host
+ ***/
+
+#define ENCODER_TEST_SECONDS 0.05
+
+static int encoder_available(int algorithm)
+{  switch(algorithm)
+   {  case ENCODING_ALG_32BIT:
+      case ENCODING_ALG_64BIT:   return TRUE;
+      case ENCODING_ALG_SSE2:    return Closure->useSSE2;
+      case ENCODING_ALG_AVX2:    return Closure->useAVX2;
+      case ENCODING_ALG_AVX512:  return Closure->useAVX512;
+      case ENCODING_ALG_ALTIVEC: return Closure->useAltiVec;
+   }
+
+   return FALSE;
+}
+
+/* Encode ecc blocks of ndata 2K layers for a short while */
+
+static double encoder_rate(ReedSolomonTables *rt, unsigned char *data, unsigned char *parity)
+{  int nroots_aligned = (rt->nroots+15)&~15;
+   GTimer *timer = g_timer_new();
+   guint64 bytes = 0;
+   double elapsed;
+   int layer;
+
+   do
+   {  memset(parity, 0, 2048*nroots_aligned);
+      for(layer=0; layer<rt->ndata; layer++)
+	EncodeNextLayer(rt, data+2048*layer, parity, 2048,
+			(rt->shiftInit+layer) % rt->nroots);
+      bytes += 2048*rt->ndata;
+      elapsed = g_timer_elapsed(timer, NULL);
+   } while(elapsed < ENCODER_TEST_SECONDS);
+
+   g_timer_destroy(timer);
+   return bytes/elapsed;
+}
+
+/*
+ * Returns the encoder to use instead of ENCODING_ALG_DEFAULT.
+ * The choice is taken from the host profile, or measured
+ * for the given number of roots and stored in the profile.
+ */
+
+int AutoTuneEncoder(int nroots)
+{  GaloisTables *gt;
+   ReedSolomonTables *rt;
+   AlignedBuffer *data, *parity;
+   double best_rate = 0.0;
+   int best = ENCODING_ALG_64BIT;
+   int alg,i;
+
+   if(encoder_available(Closure->tunedEncoding))
+      return Closure->tunedEncoding;
+
+   gt = CreateGaloisTables(RS_GENERATOR_POLY);
+   rt = CreateReedSolomonTables(gt, RS_FIRST_ROOT, RS_PRIM_ELEM, nroots);
+   data   = CreateAlignedBuffer(2048*rt->ndata);
+   parity = CreateAlignedBuffer(2048*((nroots+15)&~15));
+
+   for(i=0; i<2048*rt->ndata; i++)  /* keep the random number sequence untouched */
+     data->buf[i] = (i*131 + (i>>11)) & 0xff;
+
+   for(alg=ENCODING_ALG_32BIT; alg<=ENCODING_ALG_AVX512; alg++)
+   {  int saved_algorithm = Closure->encodingAlgorithm;
+      double rate;
+
+      if(!encoder_available(alg))
+	continue;
+
+      Closure->encodingAlgorithm = alg;
+      rate = encoder_rate(rt, data->buf, parity->buf);
+      Closure->encodingAlgorithm = saved_algorithm;
+
+      Verbose("Auto-tuning: encoder %d: %.1f MB/s\n", alg, rate/1000000.0);
+      if(rate > best_rate)
+      {  best_rate = rate;
+	 best = alg;
+      }
+   }
+
+   FreeAlignedBuffer(data);
+   FreeAlignedBuffer(parity);
+   FreeReedSolomonTables(rt);
+   FreeGaloisTables(gt);
+
+   Closure->tunedEncoding = best;
+   Closure->tunedChanged = TRUE;
+
+   return best;
+}
+
+/***
+ *** The host profile in the preferences file
+ ***/
+
+/*
+ * In GUI mode the profile is read and written together with
+ * the other preferences. The command line version does not
+ * use the preferences file otherwise, so it only picks out
+ * and updates the tuned-* entries.
+ */
+
+#define MAX_LINE_LEN 512
+
+void ReadTuneProfile(void)
+{  FILE *dotfile;
+   char line[MAX_LINE_LEN];
+
+   dotfile = portable_fopen(Closure->dotFile, "rb");
+   if(!dotfile)
+      return;
+
+   while(fgets(line, MAX_LINE_LEN, dotfile))
+   {  char symbol[41];
+      int value;
+
+      if(sscanf(line, "%40[0-9a-zA-Z-]: %d", symbol, &value) != 2)
+	continue;
+
+      if(!strcmp(symbol, "tuned-cache-size"))         Closure->tunedCacheMiB = value;
+      if(!strcmp(symbol, "tuned-codec-threads"))      Closure->tunedThreads  = value;
+      if(!strcmp(symbol, "tuned-encoding-algorithm")) Closure->tunedEncoding = value;
+      if(!strcmp(symbol, "tuned-prefetch-sectors"))   Closure->tunedPrefetch = value;
+   }
+
+   fclose(dotfile);
+
+   /* Do not trust values from a damaged or foreign file */
+
+   if(Closure->tunedThreads < 0 || Closure->tunedThreads > MAX_CODEC_THREADS)
+      Closure->tunedThreads = 0;
+   if(Closure->tunedCacheMiB < 0 || Closure->tunedCacheMiB > MAX_OLD_CACHE_SIZE)
+      Closure->tunedCacheMiB = 0;
+   if(Closure->tunedPrefetch < 0 || Closure->tunedPrefetch > MAX_PREFETCH_CACHE_SIZE)
+      Closure->tunedPrefetch = 0;
+}
+
+void SaveTuneProfile(void)
+{  const char *no_dot_files;
+   char *contents = NULL;
+   GString *out;
+   FILE *dotfile;
+
+   if(!Closure->tunedChanged)
+      return;
+
+#ifdef WITH_GUI_YES
+   if(Closure->guiMode)  /* done by update_dotfile() */
+      return;
+#endif
+
+   no_dot_files = g_getenv("NO_DOT_FILES");
+   if(no_dot_files && atoi(no_dot_files))
+      return;
+
+   /*** Keep everything except for the old profile */
+
+   out = g_string_new(NULL);
+   if(g_file_get_contents(Closure->dotFile, &contents, NULL, NULL))
+   {  char **lines = g_strsplit(contents, "\n", -1);
+      int i;
+
+      for(i=0; lines[i]; i++)
+      {  if(!strncmp(lines[i], "tuned-", 6))
+	    continue;
+	 if(!lines[i+1] && !*lines[i])  /* after the last newline */
+	    break;
+	 g_string_append_printf(out, "%s\n", lines[i]);
+      }
+
+      g_strfreev(lines);
+      g_free(contents);
+   }
+   else
+     g_string_append_printf(out, _("# dvdisaster-%s configuration file\n"
+				   "# This is an automatically generated file\n"
+				   "# which will be overwritten each time dvdisaster is run.\n\n"),
+			    VERSION);
+
+   g_string_append_printf(out, "tuned-cache-size:  %d\n", Closure->tunedCacheMiB);
+   g_string_append_printf(out, "tuned-codec-threads: %d\n", Closure->tunedThreads);
+   g_string_append_printf(out, "tuned-encoding-algorithm: %d\n", Closure->tunedEncoding);
+   g_string_append_printf(out, "tuned-prefetch-sectors: %d\n", Closure->tunedPrefetch);
+
+   dotfile = portable_fopen(Closure->dotFile, "wb");
+   if(!dotfile)
+   {  PrintLog(_("Could not save the tuned profile to %s: %s\n"),
+	       Closure->dotFile, strerror(errno));
+   }
+   else
+   {  int written = fwrite(out->str, 1, out->len, dotfile) == out->len;
+
+      if(fclose(dotfile) || !written)
+	 PrintLog(_("Could not save the tuned profile to %s: %s\n"),
+		  Closure->dotFile, strerror(errno));
+      else Verbose("Tuned profile saved to %s\n", Closure->dotFile);
+   }
+
+   g_string_free(out, TRUE);
+   Closure->tunedChanged = FALSE;
+}
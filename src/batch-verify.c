@@ -0,0 +1,480 @@
+/*  dvdisaster: Additional error correction for optical media.
+ *  Copyright (C) 2004-2017 Carsten Gnoerlich.
+ *  Copyright (C) 2019-2021 The dvdisaster development team.
+ *
+ *  Email: support@dvdisaster.org
+ *
+ *  This file is part of dvdisaster.
+ *
+ *  dvdisaster is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  dvdisaster is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with dvdisaster. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*** src type: no GUI code ***/
+
+#include "dvdisaster.h"
+
+#ifndef SYS_MINGW
+  #include <poll.h>
+  #include <sys/wait.h>
+#endif
+
+/*
+ * Batch verify reads a manifest with one image per line,
+ * optionally followed by a tab and the name of its ecc file:
+ *
+ * # comment
+ * <image>[<tab><ecc file>]
+ *
+ * Each image is verified by a worker process forked from this one,
+ * so that the codecs keep working on their own copy of the global
+ * state and a failing image can not take down the whole batch.
+ * At most --batch-jobs workers run at a time, and at most
+ * --batch-device-jobs of them read from the same device.
+ * The reports are printed in manifest order, followed by a
+ * tab separated summary line for each image.
+ */
+
+#define MAX_LINE_LEN 4096
+
+enum { JOB_WAITING, JOB_RUNNING, JOB_DONE };
+
+typedef struct
+{  char *image;
+   char *ecc;
+   guint64 device;      /* device holding the image */
+   int missing;         /* image was not present when the batch started */
+   int state;
+   int pid;
+   int fd;              /* reading end of the output pipe */
+   GString *output;     /* report of the worker */
+   int exitStatus;      /* as returned by waitpid() */
+   gint64 startTime, endTime;
+} BatchJob;
+
+typedef struct
+{  GPtrArray *jobs;
+   int maxJobs;
+   int maxDeviceJobs;
+   int running;
+   int nextWaiting;     /* first job which may still be waiting */
+   int nextReport;      /* first job whose report has not been printed */
+} Batch;
+
+/***
+ *** Verify one image and its ecc file
+ ***/
+
+/*
+ * Verifies Closure->imageName with Closure->eccName.
+ * Called by main() for -t and by the batch workers.
+ */
+
+void VerifyImageFiles(void)
+{  Method *method;
+   Image *image;
+
+   image = OpenImageFromFile(Closure->imageName, O_RDONLY, IMG_PERMS);
+   image = OpenEccFileForImage(image, Closure->eccName, O_RDONLY, IMG_PERMS);
+
+   /* Determine method. Ecc files win over augmented ecc. */
+
+   if(image && image->eccFileMethod) method = image->eccFileMethod;
+   else if(image && image->eccMethod) method = image->eccMethod;
+   else if(!(method = FindMethod("RS01")))
+           Stop(_("RS01 method not available for comparing files."));
+
+   method->verify(image);
+}
+
+/***
+ *** Read the manifest
+ ***/
+
+static void free_batch(Batch *b)
+{  int i;
+
+   for(i=0; i<b->jobs->len; i++)
+   {  BatchJob *job = g_ptr_array_index(b->jobs, i);
+
+      g_free(job->image);
+      g_free(job->ecc);
+      if(job->output)
+	g_string_free(job->output, TRUE);
+#ifndef SYS_MINGW
+      if(job->state == JOB_RUNNING)
+	close(job->fd);
+#endif
+      g_free(job);
+   }
+
+   g_ptr_array_free(b->jobs, TRUE);
+   g_free(b);
+}
+
+/*
+ * Without an explicit ecc file, the image suffix is replaced by .ecc
+ */
+
+static char *default_ecc_name(char *image)
+{  char *slash = strrchr(image, '/');
+   char *dot = strrchr(image, '.');
+
+   if(dot && (!slash || dot > slash))
+     return g_strdup_printf("%.*s.ecc", (int)(dot-image), image);
+
+   return g_strdup_printf("%s.ecc", image);
+}
+
+static Batch *read_manifest(char *path)
+{  Batch *b = g_malloc0(sizeof(Batch));
+   FILE *file;
+   char line[MAX_LINE_LEN];
+
+   file = portable_fopen(path, "rb");
+   if(!file)
+     Stop(_("Could not open manifest %s: %s"), path, strerror(errno));
+
+   b->jobs = g_ptr_array_new();
+
+   while(fgets(line, MAX_LINE_LEN, file))
+   {  BatchJob *job;
+      char *tab;
+      struct stat mystat;
+
+      g_strchomp(line);
+      if(!*line || *line == '#')
+	continue;
+
+      job = g_malloc0(sizeof(BatchJob));
+      tab = strchr(line, '\t');
+      if(tab)
+      {  *tab = 0;
+	 job->ecc = g_strdup(g_strstrip(tab+1));
+      }
+      job->image = g_strdup(line);
+      if(!job->ecc || !*job->ecc)
+      {  g_free(job->ecc);
+	 job->ecc = default_ecc_name(job->image);
+      }
+
+      /* Missing images are still reported by the worker;
+	 they may share device 0 without harm. */
+
+      if(!stat(job->image, &mystat))
+	job->device = mystat.st_dev;
+      else job->missing = TRUE;
+
+      g_ptr_array_add(b->jobs, job);
+   }
+
+   fclose(file);
+   return b;
+}
+
+/***
+ *** Run the workers
+ ***/
+
+#ifndef SYS_MINGW
+
+/*
+ * The worker verifies its image and exits with the result in exitCode.
+ */
+
+static void run_worker(Batch *b, BatchJob *job, int fd)
+{
+   dup2(fd, STDOUT_FILENO);
+   dup2(fd, STDERR_FILENO);
+   close(fd);
+
+   /* The parent prints our report into the log file */
+
+   Closure->logFileEnabled = FALSE;
+   Closure->noProgress = TRUE;
+
+   g_free(Closure->imageName);
+   g_free(Closure->eccName);
+   Closure->imageName = g_strdup(job->image);
+   Closure->eccName   = g_strdup(job->ecc);
+   free_batch(b);
+
+   exitCode = EXIT_SUCCESS;
+   VerifyImageFiles();
+
+   FreeClosure();
+   exit(exitCode);
+}
+
+static void start_job(Batch *b, BatchJob *job)
+{  int fds[2];
+   int pid;
+
+   if(pipe(fds) == -1)
+     Stop(_("Could not create pipe for batch worker: %s"), strerror(errno));
+
+   fflush(stdout);
+   pid = fork();
+
+   if(pid == -1)
+   {  close(fds[0]);
+      close(fds[1]);
+      Stop(_("Could not fork batch worker: %s"), strerror(errno));
+   }
+
+   if(!pid)
+   {  close(fds[0]);
+      run_worker(b, job, fds[1]);
+   }
+
+   close(fds[1]);
+   job->pid = pid;
+   job->fd = fds[0];
+   job->output = g_string_new(NULL);
+   job->state = JOB_RUNNING;
+   job->startTime = g_get_monotonic_time();
+   b->running++;
+}
+
+/*
+ * Start waiting jobs in manifest order, skipping over those
+ * whose device is already busy with enough other jobs.
+ */
+
+static void start_jobs(Batch *b)
+{  int i,j;
+
+   while(b->nextWaiting < b->jobs->len
+	 && ((BatchJob*)g_ptr_array_index(b->jobs, b->nextWaiting))->state != JOB_WAITING)
+     b->nextWaiting++;
+
+   for(i=b->nextWaiting; i<b->jobs->len && b->running < b->maxJobs; i++)
+   {  BatchJob *job = g_ptr_array_index(b->jobs, i);
+      int same_device = 0;
+
+      if(job->state != JOB_WAITING)
+	continue;
+
+      if(b->maxDeviceJobs)
+      {  for(j=b->nextReport; j<b->jobs->len; j++)
+	 {  BatchJob *other = g_ptr_array_index(b->jobs, j);
+
+	    if(other->state == JOB_RUNNING && other->device == job->device)
+	      same_device++;
+	 }
+	 if(same_device >= b->maxDeviceJobs)
+	   continue;
+      }
+
+      start_job(b, job);
+   }
+}
+
+/*
+ * Collect the output of the running workers
+ * and reap those which have finished.
+ */
+
+static void collect_output(Batch *b)
+{  struct pollfd *pfd;
+   BatchJob **running;
+   int i,n = 0;
+
+   if(!b->running)
+     return;
+
+   pfd = g_malloc(b->running*sizeof(struct pollfd));
+   running = g_malloc(b->running*sizeof(BatchJob*));
+
+   for(i=b->nextReport; i<b->jobs->len && n<b->running; i++)
+   {  BatchJob *job = g_ptr_array_index(b->jobs, i);
+
+      if(job->state == JOB_RUNNING)
+      {  pfd[n].fd = job->fd;
+	 pfd[n].events = POLLIN;
+	 running[n++] = job;
+      }
+   }
+
+   if(poll(pfd, n, -1) < 0 && errno != EINTR)
+     Stop(_("Waiting for batch workers failed: %s"), strerror(errno));
+
+   for(i=0; i<n; i++)
+   {  BatchJob *job = running[i];
+      char buf[4096];
+      ssize_t len;
+
+      if(!pfd[i].revents)
+	continue;
+
+      len = read(job->fd, buf, sizeof(buf));
+      if(len > 0)
+      {  g_string_append_len(job->output, buf, len);
+	 continue;
+      }
+      if(len < 0 && errno == EINTR)
+	continue;
+
+      /* End of output; the worker has finished */
+
+      close(job->fd);
+      waitpid(job->pid, &job->exitStatus, 0);
+      job->endTime = g_get_monotonic_time();
+      job->state = JOB_DONE;
+      b->running--;
+   }
+
+   g_free(pfd);
+   g_free(running);
+}
+#endif /* SYS_MINGW */
+
+/***
+ *** Report the results
+ ***/
+
+static int exit_code(BatchJob *job)
+{
+#ifndef SYS_MINGW
+   if(WIFSIGNALED(job->exitStatus))
+     return 128 + WTERMSIG(job->exitStatus);
+
+   return WEXITSTATUS(job->exitStatus);
+#else
+   return job->exitStatus;
+#endif
+}
+
+static char *result_name(BatchJob *job)
+{
+   if(job->missing)
+     return "not-present";
+
+#ifndef SYS_MINGW
+   if(WIFSIGNALED(job->exitStatus))
+     return "crashed";
+#endif
+
+   switch(exit_code(job))
+   {  case EXIT_SUCCESS:               return "good";
+      case EXIT_CODE_SIZE_MISMATCH:    return "size-mismatch";
+      case EXIT_CODE_VERSION_MISMATCH: return "version-mismatch";
+      case EXIT_CODE_UNEXPECTED_EOF:   return "truncated";
+      case EXIT_CODE_MISSING_SECTOR:   return "missing-sectors";
+      case EXIT_CODE_CHECKSUM_ERROR:   return "checksum-errors";
+      case EXIT_CODE_SYNDROME_ERROR:   return "ecc-errors";
+      default:                         return "failed";
+   }
+}
+
+/*
+ * Print the reports of all finished jobs which
+ * are not preceded by unfinished ones.
+ */
+
+static void print_reports(Batch *b)
+{
+   while(b->nextReport < b->jobs->len)
+   {  BatchJob *job = g_ptr_array_index(b->jobs, b->nextReport);
+
+      if(job->state != JOB_DONE)
+	break;
+
+      PrintLog("%s", job->output->str);
+      b->nextReport++;
+   }
+}
+
+static void print_summary(Batch *b)
+{  FILE *file = stdout;
+   int i, good = 0;
+
+   if(Closure->batchSummaryFile)
+   {  file = portable_fopen(Closure->batchSummaryFile, "wb");
+      if(!file)
+	Stop(_("Could not create summary file %s: %s"), Closure->batchSummaryFile, strerror(errno));
+   }
+   else PrintLog("\n");
+
+   g_fprintf(file, "# image\tecc\tresult\texit code\tseconds\n");
+
+   for(i=0; i<b->jobs->len; i++)
+   {  BatchJob *job = g_ptr_array_index(b->jobs, i);
+      double seconds = (job->endTime - job->startTime)/1000000.0;
+
+      if(Closure->fixedSpeedValues)
+	seconds = 0.0;
+
+      g_fprintf(file, "%s\t%s\t%s\t%d\t%.1f\n",
+		job->image, job->ecc, result_name(job), exit_code(job), seconds);
+      if(!job->missing && !exit_code(job))
+	good++;
+   }
+
+   if(Closure->batchSummaryFile)
+   {  if(fclose(file))
+	PrintLog(_("Could not write summary file %s: %s\n"), Closure->batchSummaryFile, strerror(errno));
+   }
+   else fflush(stdout);
+
+   PrintLog(_("\nBatch verify: %d of %d images good.\n"), good, b->jobs->len);
+
+   if(good < b->jobs->len)
+     exitCode = EXIT_FAILURE;
+}
+
+/***
+ *** Verify all images from the manifest
+ ***/
+
+void BatchVerify(char *manifest)
+{  Batch *b = read_manifest(manifest);
+
+   b->maxJobs = Closure->batchJobs > 0 ? Closure->batchJobs : g_get_num_processors();
+   b->maxDeviceJobs = Closure->batchDeviceJobs;
+
+   PrintLog(_("\nVerifying %d images from %s.\n"), b->jobs->len, manifest);
+
+#ifndef SYS_MINGW
+   while(b->nextReport < b->jobs->len)
+   {  start_jobs(b);
+      collect_output(b);
+      print_reports(b);
+   }
+#else
+   /* No fork() here; verify one image after the other in this process */
+
+   {  int i;
+
+      for(i=0; i<b->jobs->len; i++)
+      {  BatchJob *job = g_ptr_array_index(b->jobs, i);
+
+	 g_free(Closure->imageName);
+	 g_free(Closure->eccName);
+	 Closure->imageName = g_strdup(job->image);
+	 Closure->eccName   = g_strdup(job->ecc);
+
+	 exitCode = EXIT_SUCCESS;
+	 job->startTime = g_get_monotonic_time();
+	 VerifyImageFiles();
+	 job->endTime = g_get_monotonic_time();
+	 job->exitStatus = exitCode;
+	 job->state = JOB_DONE;
+      }
+      exitCode = EXIT_SUCCESS;
+   }
+#endif
+
+   print_summary(b);
+   free_batch(b);
+}
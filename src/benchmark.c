@@ -0,0 +1,858 @@
+/*  dvdisaster: Additional error correction for optical media.
+ *  Copyright (C) 2004-2017 Carsten Gnoerlich.
+ *  Copyright (C) 2019-2021 The dvdisaster development team.
+ *
+ *  Email: support@dvdisaster.org
+ *
+ *  This file is part of dvdisaster.
+ *
+ *  dvdisaster is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  dvdisaster is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with dvdisaster. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*** src type: no GUI code ***/
+
+#include "dvdisaster.h"
+
+#include "md5.h"
+#include "rs03-includes.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+  #include <x86intrin.h>
+  #define HAVE_TSC
+#endif
+
+/***
+ *** Codec and I/O micro benchmarks
+ ***/
+
+/*
+ * Each test repeats its workload for BENCH_SECONDS and prints
+ * one line with the component, the variant, its parameters,
+ * the throughput in MB/s (10^6 bytes per second) and the
+ * time stamp counter cycles spent per byte.
+ * Lines starting with '#' are comments, so the output
+ * can be fed into awk, gnuplot or a spreadsheet as it is.
+ * The test data is derived from --random-seed and is therefore
+ * identical between runs and releases.
+ */
+
+#define BENCH_SECONDS 0.5
+
+/* Tests with a fixed amount of work per call */
+
+typedef guint64 (*bench_func)(void*);
+
+static guint64 read_tsc(void)
+{
+#ifdef HAVE_TSC
+   return __rdtsc();
+#else
+   return 0;
+#endif
+}
+
+static void print_result(char *component, char *variant, char *param,
+			 guint64 bytes, double elapsed, guint64 cycles)
+{  double mbs = elapsed > 0.0 ? (double)bytes/(1000000.0*elapsed) : 0.0;
+
+#ifdef HAVE_TSC
+   PrintCLI("%-10s %-18s %-24s %10.1f %8.2f\n",
+	    component, variant, param, mbs, bytes ? (double)cycles/(double)bytes : 0.0);
+#else
+   PrintCLI("%-10s %-18s %-24s %10.1f %8s\n",
+	    component, variant, param, mbs, "-");
+#endif
+}
+
+static void run_test(char *component, char *variant, char *param,
+		     bench_func func, void *data)
+{  GTimer *timer = g_timer_new();
+   guint64 bytes = 0;
+   guint64 tsc_start;
+   double elapsed;
+
+   func(data);  /* warm up caches */
+
+   g_timer_start(timer);
+   tsc_start = read_tsc();
+   do
+   {  bytes += func(data);
+      elapsed = g_timer_elapsed(timer, NULL);
+   } while(elapsed < BENCH_SECONDS);
+
+   print_result(component, variant, param, bytes, elapsed, read_tsc()-tsc_start);
+   g_timer_destroy(timer);
+}
+
+static void fill_random(unsigned char *buf, int size)
+{  int i;
+
+   for(i=0; i<size; i++)
+     buf[i] = Random32() & 0xff;
+}
+
+/***
+ *** Reed-Solomon encoder
+ ***/
+
+/*
+ * Encodes one ecc block of ndata 2K layers in the same way as
+ * the RS03 encoder threads do.
+ */
+
+typedef struct
+{  ReedSolomonTables *rt;
+   AlignedBuffer *data;
+   AlignedBuffer *parity;
+   int nrootsAligned;
+   gint *stop;
+   guint64 bytes;
+} encoder_bench;
+
+static guint64 encode_block(void *ptr)
+{  encoder_bench *eb = (encoder_bench*)ptr;
+   ReedSolomonTables *rt = eb->rt;
+   int layer;
+
+   memset(eb->parity->buf, 0, 2048*eb->nrootsAligned);
+
+   for(layer=0; layer<rt->ndata; layer++)
+     EncodeNextLayer(rt, eb->data->buf+2048*layer, eb->parity->buf, 2048,
+		     (rt->shiftInit+layer) % rt->nroots);
+
+   return 2048*rt->ndata;
+}
+
+static encoder_bench *create_encoder_bench(ReedSolomonTables *rt)
+{  encoder_bench *eb = g_malloc0(sizeof(encoder_bench));
+
+   eb->rt = rt;
+   eb->nrootsAligned = (rt->nroots+15)&~15;
+   eb->data   = CreateAlignedBuffer(2048*rt->ndata);
+   eb->parity = CreateAlignedBuffer(2048*eb->nrootsAligned);
+   fill_random(eb->data->buf, 2048*rt->ndata);
+
+   return eb;
+}
+
+static void free_encoder_bench(encoder_bench *eb)
+{  FreeAlignedBuffer(eb->data);
+   FreeAlignedBuffer(eb->parity);
+   g_free(eb);
+}
+
+static int bench_nroots[] = { 8, 16, 32, 64, 128, 0 };
+
+typedef struct
+{  int algorithm;
+   char *name;
+} encoder_variant;
+
+static int available_encoders(encoder_variant *ev)
+{  int n = 0;
+
+   ev[n].algorithm = ENCODING_ALG_32BIT;  ev[n++].name = "32bit";
+   ev[n].algorithm = ENCODING_ALG_64BIT;  ev[n++].name = "64bit";
+   if(Closure->useSSE2)
+   {  ev[n].algorithm = ENCODING_ALG_SSE2;   ev[n++].name = "SSE2";
+   }
+   if(Closure->useAVX2)
+   {  ev[n].algorithm = ENCODING_ALG_AVX2;   ev[n++].name = "AVX2";
+   }
+   if(Closure->useAVX512)
+   {  ev[n].algorithm = ENCODING_ALG_AVX512; ev[n++].name = "AVX512";
+   }
+   if(Closure->useAltiVec)
+   {  ev[n].algorithm = ENCODING_ALG_ALTIVEC; ev[n++].name = "AltiVec";
+   }
+
+   return n;
+}
+
+static void bench_encoder(GaloisTables *gt)
+{  encoder_variant ev[8];
+   int saved_algorithm = Closure->encodingAlgorithm;
+   int n_variants = available_encoders(ev);
+   int i,j;
+
+   for(i=0; bench_nroots[i]; i++)
+   {  ReedSolomonTables *rt = CreateReedSolomonTables(gt, RS_FIRST_ROOT, RS_PRIM_ELEM, bench_nroots[i]);
+      encoder_bench *eb = create_encoder_bench(rt);
+      char param[40];
+
+      g_snprintf(param, 40, "nroots=%d", rt->nroots);
+      for(j=0; j<n_variants; j++)
+      {  Closure->encodingAlgorithm = ev[j].algorithm;
+	 run_test("encoder", ev[j].name, param, encode_block, eb);
+      }
+
+      free_encoder_bench(eb);
+      FreeReedSolomonTables(rt);
+   }
+
+   Closure->encodingAlgorithm = saved_algorithm;
+}
+
+/*
+ * Scaling of the default encoder with the number of threads.
+ * Each thread works on its own ecc block, which is what
+ * the RS03 encoder does given enough I/O bandwidth.
+ */
+
+static gpointer encoder_thread(gpointer data)
+{  encoder_bench *eb = (encoder_bench*)data;
+
+   while(!g_atomic_int_get(eb->stop))
+     eb->bytes += encode_block(eb);
+
+   return NULL;
+}
+
+static void bench_threads(GaloisTables *gt)
+{  ReedSolomonTables *rt = CreateReedSolomonTables(gt, RS_FIRST_ROOT, RS_PRIM_ELEM, 32);
+   int max_threads = MAX(Closure->codecThreads, g_get_num_processors());
+   char *variant, *strategy;
+   int n_threads;
+
+   DescribeRSEncoder(&variant, &strategy);
+
+   for(n_threads=1; ; n_threads = MIN(2*n_threads, max_threads))
+   {  encoder_bench *eb[n_threads];
+      GThread *thread[n_threads];
+      gint stop = FALSE;
+      GTimer *timer = g_timer_new();
+      guint64 bytes = 0;
+      guint64 tsc_start;
+      char param[40];
+      int i;
+
+      for(i=0; i<n_threads; i++)
+      {  eb[i] = create_encoder_bench(rt);
+	 eb[i]->stop = &stop;
+      }
+
+      g_timer_start(timer);
+      tsc_start = read_tsc();
+      for(i=0; i<n_threads; i++)
+	thread[i] = g_thread_new("benchmark", encoder_thread, eb[i]);
+
+      g_usleep(BENCH_SECONDS*G_USEC_PER_SEC);
+      g_atomic_int_set(&stop, TRUE);
+
+      for(i=0; i<n_threads; i++)
+      {  g_thread_join(thread[i]);
+	 bytes += eb[i]->bytes;
+	 free_encoder_bench(eb[i]);
+      }
+
+      g_snprintf(param, 40, "nroots=32,threads=%d", n_threads);
+      print_result("threads", variant, param, bytes,
+		   g_timer_elapsed(timer, NULL), read_tsc()-tsc_start);
+      g_timer_destroy(timer);
+
+      if(n_threads == max_threads)
+	break;
+   }
+
+   FreeReedSolomonTables(rt);
+}
+
+/***
+ *** Error syndromes
+ ***/
+
+#define SYNDROME_CODEWORDS 64
+
+typedef struct
+{  ReedSolomonTables *rt;
+   unsigned char *codewords;
+   unsigned char *layer[GF_FIELDMAX];
+} syndrome_bench;
+
+static guint64 single_syndromes(void *ptr)
+{  syndrome_bench *sb = (syndrome_bench*)ptr;
+   int i;
+
+   for(i=0; i<SYNDROME_CODEWORDS; i++)
+     TestErrorSyndromes(sb->rt, sb->codewords+GF_FIELDMAX*i);
+
+   return GF_FIELDMAX*SYNDROME_CODEWORDS;
+}
+
+static guint64 column_syndromes(void *ptr)
+{  syndrome_bench *sb = (syndrome_bench*)ptr;
+
+   CountErrorSyndromes(sb->rt, sb->layer, 0, 2048);
+
+   return GF_FIELDMAX*2048;
+}
+
+static void bench_syndromes(GaloisTables *gt)
+{  syndrome_bench *sb = g_malloc0(sizeof(syndrome_bench));
+   encoder_variant ev[8];
+   int saved_algorithm = Closure->encodingAlgorithm;
+   int i,j;
+
+   sb->codewords = g_malloc(GF_FIELDMAX*2048);
+   fill_random(sb->codewords, GF_FIELDMAX*2048);
+   for(i=0; i<GF_FIELDMAX; i++)
+     sb->layer[i] = sb->codewords + 2048*i;
+
+   /* Only the portable, SSE2 and AVX2 syndrome code paths exist */
+
+   j = 0;
+   ev[j].algorithm = ENCODING_ALG_32BIT; ev[j++].name = "columns-portable";
+   if(Closure->useSSE2)
+   {  ev[j].algorithm = ENCODING_ALG_SSE2; ev[j++].name = "columns-SSE2";
+   }
+   if(Closure->useAVX2)
+   {  ev[j].algorithm = ENCODING_ALG_AVX2; ev[j++].name = "columns-AVX2";
+   }
+
+   for(i=0; bench_nroots[i]; i++)
+   {  char param[40];
+      int k;
+
+      sb->rt = CreateReedSolomonTables(gt, RS_FIRST_ROOT, RS_PRIM_ELEM, bench_nroots[i]);
+      g_snprintf(param, 40, "nroots=%d", sb->rt->nroots);
+
+      run_test("syndromes", "single", param, single_syndromes, sb);
+      for(k=0; k<j; k++)
+      {  Closure->encodingAlgorithm = ev[k].algorithm;
+	 run_test("syndromes", ev[k].name, param, column_syndromes, sb);
+      }
+
+      FreeReedSolomonTables(sb->rt);
+   }
+
+   Closure->encodingAlgorithm = saved_algorithm;
+   g_free(sb->codewords);
+   g_free(sb);
+}
+
+/***
+ *** Errors and erasures decoding
+ ***/
+
+/*
+ * Decodes one ecc block with a fixed damage pattern: random values
+ * in the erased sectors plus some bytes altered elsewhere.
+ * The ecc block is left untouched, so both variants include the
+ * syndrome calculation: "column" runs RSDecodeColumn() on each of
+ * the 2048 codewords, "block" decodes them together via RSDecodeBlock().
+ */
+
+typedef struct
+{  RSDecoder *dec;
+   unsigned char **layer;
+   guint8 *syn;
+   int erasureList[GF_FIELDMAX];
+   int erasureCount;
+} decoder_bench;
+
+static guint64 decode_columns(void *ptr)
+{  decoder_bench *db = (decoder_bench*)ptr;
+   int nroots = db->dec->rt->nroots;
+   int location[nroots], error[nroots];
+   guint32 nonzero = 0;
+   int c;
+
+   SetRSDecoderErasures(db->dec, db->erasureList, db->erasureCount);
+
+   for(c=0; c<2048; c++)
+   {  int column = c % SYNDROME_COLUMNS;
+
+      if(!column)
+	nonzero = ComputeSyndromeColumns(db->dec->rt, db->layer, c,
+					 SYNDROME_COLUMNS, db->syn);
+
+      if(nonzero & (1U<<column))
+	RSDecodeColumn(db->dec, db->syn+column, SYNDROME_COLUMNS, location, error);
+   }
+
+   return GF_FIELDMAX*2048;
+}
+
+static guint64 decode_block(void *ptr)
+{  decoder_bench *db = (decoder_bench*)ptr;
+   RSDecoder *dec = db->dec;
+   int nroots = dec->rt->nroots;
+   int location[nroots], error[nroots];
+   int c;
+
+   SetRSDecoderErasures(dec, db->erasureList, db->erasureCount);
+   RSDecodeBlock(dec, db->layer, 0);
+
+   for(c=0; c<2048; c++)
+     if(dec->nonzero[c/SYNDROME_COLUMNS] & (1U<<(c%SYNDROME_COLUMNS)))
+       RSDecodeBlockColumn(dec, c, location, error);
+
+   return GF_FIELDMAX*2048;
+}
+
+static void prepare_decoder_block(decoder_bench *db, int n_erasures, int n_errors)
+{  unsigned char **layer = db->layer;
+   int taken[GF_FIELDMAX];
+   int i,c;
+
+   memset(taken, 0, sizeof(taken));
+   for(i=0; i<GF_FIELDMAX; i++)
+     memset(layer[i], 0, 2048);
+
+   /* The all-zero ecc block is a valid codeword */
+
+   db->erasureCount = n_erasures;
+   for(i=0; i<n_erasures+n_errors; i++)
+   {  int pos;
+
+      do pos = Random() % GF_FIELDMAX; while(taken[pos]);
+      taken[pos] = TRUE;
+
+      if(i < n_erasures)
+      {  db->erasureList[i] = pos;
+	 fill_random(layer[pos], 2048);
+      }
+      else 
+      {  for(c=0; c<2048; c+=7)
+	   layer[pos][c] = 1 + Random() % 255;
+      }
+   }
+}
+
+static void bench_decoder(GaloisTables *gt)
+{  decoder_bench *db = g_malloc0(sizeof(decoder_bench));
+   unsigned char *codewords = g_malloc(GF_FIELDMAX*2048);
+   unsigned char *layer[GF_FIELDMAX];
+   int i;
+
+   for(i=0; i<GF_FIELDMAX; i++)
+     layer[i] = codewords + 2048*i;
+   db->layer = layer;
+
+   for(i=0; bench_nroots[i]; i++)
+   {  ReedSolomonTables *rt = CreateReedSolomonTables(gt, RS_FIRST_ROOT, RS_PRIM_ELEM, bench_nroots[i]);
+      int nroots = rt->nroots;
+      char param[40];
+
+      db->dec = CreateRSDecoder(rt);
+      db->syn = g_malloc(nroots*SYNDROME_COLUMNS);
+
+      prepare_decoder_block(db, nroots, 0);
+      g_snprintf(param, 40, "nroots=%d erasures=%d", nroots, nroots);
+      run_test("decoder", "column", param, decode_columns, db);
+      run_test("decoder", "block", param, decode_block, db);
+
+      prepare_decoder_block(db, nroots/2, 0);
+      g_snprintf(param, 40, "nroots=%d erasures=%d", nroots, nroots/2);
+      run_test("decoder", "column", param, decode_columns, db);
+      run_test("decoder", "block", param, decode_block, db);
+
+      prepare_decoder_block(db, nroots/2, nroots/4);
+      g_snprintf(param, 40, "nroots=%d errors+erasures=%d+%d", nroots, nroots/4, nroots/2);
+      run_test("decoder", "column", param, decode_columns, db);
+      run_test("decoder", "block", param, decode_block, db);
+
+      g_free(db->syn);
+      FreeRSDecoder(db->dec);
+      FreeReedSolomonTables(rt);
+   }
+
+   g_free(codewords);
+   g_free(db);
+}
+
+/***
+ *** Checksums
+ ***/
+
+#define CHECKSUM_BUFSIZE (1024*1024)
+
+typedef struct
+{  unsigned char *buf;
+#if !defined(SIMPLE_MD5SUM)
+   unsigned char const *lane[MD5_MAX_LANES];
+   struct MD5Context *laneCtxt[MD5_MAX_LANES];
+#endif
+   struct MD5Context ctxt;
+} checksum_bench;
+
+static guint64 crc32_sectors(void *ptr)
+{  checksum_bench *cb = (checksum_bench*)ptr;
+   int i;
+
+   for(i=0; i<CHECKSUM_BUFSIZE; i+=2048)
+     Crc32(cb->buf+i, 2048);
+
+   return CHECKSUM_BUFSIZE;
+}
+
+/* EDC covers bytes 0-2063 of a mode 1 raw sector */
+
+static guint64 edc_sectors(void *ptr)
+{  checksum_bench *cb = (checksum_bench*)ptr;
+   int i;
+
+   for(i=0; i+2064<=CHECKSUM_BUFSIZE; i+=2064)
+     EDCCrc32(cb->buf+i, 2064);
+
+   return (CHECKSUM_BUFSIZE/2064)*2064;
+}
+
+static guint64 md5_update(void *ptr)
+{  checksum_bench *cb = (checksum_bench*)ptr;
+
+   MD5Update(&cb->ctxt, cb->buf, CHECKSUM_BUFSIZE);
+
+   return CHECKSUM_BUFSIZE;
+}
+
+#if !defined(SIMPLE_MD5SUM)
+static guint64 md5_update_multi(void *ptr)
+{  checksum_bench *cb = (checksum_bench*)ptr;
+
+   MD5UpdateMulti(cb->laneCtxt, cb->lane, CHECKSUM_BUFSIZE/MD5_MAX_LANES, MD5_MAX_LANES);
+
+   return CHECKSUM_BUFSIZE;
+}
+#endif
+
+static void bench_checksums(void)
+{  checksum_bench *cb = g_malloc0(sizeof(checksum_bench));
+#if !defined(SIMPLE_MD5SUM)
+   int i;
+#endif
+
+   cb->buf = g_malloc(CHECKSUM_BUFSIZE);
+   fill_random(cb->buf, CHECKSUM_BUFSIZE);
+
+   run_test("checksums", "Crc32", "len=2048", crc32_sectors, cb);
+   run_test("checksums", "EDCCrc32", "len=2064", edc_sectors, cb);
+
+   MD5Init(&cb->ctxt);
+   run_test("checksums", "MD5Update", "len=1048576", md5_update, cb);
+
+#if !defined(SIMPLE_MD5SUM)
+   for(i=0; i<MD5_MAX_LANES; i++)
+   {  cb->laneCtxt[i] = g_malloc(sizeof(struct MD5Context));
+      cb->lane[i] = cb->buf + i*(CHECKSUM_BUFSIZE/MD5_MAX_LANES);
+      MD5Init(cb->laneCtxt[i]);
+   }
+   run_test("checksums", "MD5UpdateMulti", "lanes=8", md5_update_multi, cb);
+   for(i=0; i<MD5_MAX_LANES; i++)
+     g_free(cb->laneCtxt[i]);
+#endif
+
+   g_free(cb->buf);
+   g_free(cb);
+}
+
+/***
+ *** L-EC P/Q vector decoding
+ ***/
+
+/*
+ * All-zero vectors are valid codewords; the errors are injected
+ * at random positions. A run decodes all P or Q vectors of a sector,
+ * or checks all P and Q vectors of a frame with CheckPQVectors().
+ */
+
+#define MAX_PQ_VECTORS N_P_VECTORS
+
+typedef struct
+{  ReedSolomonTables *rt;
+   unsigned char vector[MAX_PQ_VECTORS][Q_VECTOR_SIZE];
+   unsigned char work[Q_VECTOR_SIZE];
+   int erasures[MAX_PQ_VECTORS][2];
+   int nVectors,vectorSize,padding;
+   int nErasures;
+   unsigned char frame[2352];
+} lec_bench;
+
+static guint64 decode_pq_vectors(void *ptr)
+{  lec_bench *lb = (lec_bench*)ptr;
+   int i;
+
+   for(i=0; i<lb->nVectors; i++)
+   {  int erasures[2];
+
+      /* DecodePQ() modifies both the vector and the erasure list */
+
+      memcpy(lb->work, lb->vector[i], lb->vectorSize);
+      erasures[0] = lb->erasures[i][0];
+      erasures[1] = lb->erasures[i][1];
+      DecodePQ(lb->rt, lb->work, lb->padding, erasures, lb->nErasures);
+   }
+
+   return lb->nVectors*lb->vectorSize;
+}
+
+static guint64 check_pq_frame(void *ptr)
+{  lec_bench *lb = (lec_bench*)ptr;
+   int p_result[N_P_VECTORS];
+   int q_result[N_Q_VECTORS];
+
+   CheckPQVectors(lb->rt, lb->frame, p_result, q_result);
+
+   return N_P_VECTORS*P_VECTOR_SIZE + N_Q_VECTORS*Q_VECTOR_SIZE;
+}
+
+static void prepare_pq_vectors(lec_bench *lb, int n_errors, int n_erasures)
+{  int i,j;
+
+   memset(lb->vector, 0, sizeof(lb->vector));
+   lb->nErasures = n_erasures;
+
+   for(i=0; i<lb->nVectors; i++)
+   {  int pos[2];
+
+      pos[0] = Random() % lb->vectorSize;
+      do pos[1] = Random() % lb->vectorSize; while(pos[1] == pos[0]);
+
+      for(j=0; j<n_errors; j++)
+	lb->vector[i][pos[j]] = 1 + Random() % 255;
+
+      lb->erasures[i][0] = pos[0];
+      lb->erasures[i][1] = pos[1];
+   }
+}
+
+static void bench_lec(void)
+{  lec_bench *lb = g_malloc0(sizeof(lec_bench));
+   GaloisTables *gt = CreateGaloisTables(0x11d);
+   int pq;
+
+   lb->rt = CreateReedSolomonTables(gt, 0, 1, 10);
+
+   for(pq=0; pq<2; pq++)
+   {  char *variant = pq ? "DecodePQ-Q" : "DecodePQ-P";
+
+      lb->nVectors   = pq ? N_Q_VECTORS   : N_P_VECTORS;
+      lb->vectorSize = pq ? Q_VECTOR_SIZE : P_VECTOR_SIZE;
+      lb->padding    = pq ? Q_PADDING     : P_PADDING;
+
+      prepare_pq_vectors(lb, 0, 0);
+      run_test("lec", variant, "errors=0", decode_pq_vectors, lb);
+      prepare_pq_vectors(lb, 1, 0);
+      run_test("lec", variant, "errors=1", decode_pq_vectors, lb);
+      prepare_pq_vectors(lb, 2, 2);
+      run_test("lec", variant, "erasures=2", decode_pq_vectors, lb);
+   }
+
+   /* Same number of errors per frame as for errors=1 above */
+
+   memset(lb->frame, 0, sizeof(lb->frame));
+   run_test("lec", "CheckPQVectors", "errors=0", check_pq_frame, lb);
+   for(pq=0; pq<N_P_VECTORS; pq++)
+     lb->frame[PToByteIndex(pq, Random() % P_VECTOR_SIZE)] = 1 + Random() % 255;
+   run_test("lec", "CheckPQVectors", "errors=86", check_pq_frame, lb);
+
+   FreeReedSolomonTables(lb->rt);
+   FreeGaloisTables(gt);
+   g_free(lb);
+}
+
+/***
+ *** RS03 image I/O
+ ***/
+
+/*
+ * Reads the image given by -i (and -e) in the patterns used by
+ * the RS03 codec: layer by layer in --prefetch-sectors steps
+ * as during verification, and complete ecc blocks for
+ * --cache-size MiB at once as during fixing.
+ * Note that repeated runs may be served from the page cache
+ * unless --encoding-io-strategy direct is used.
+ */
+
+typedef struct
+{  Image *image;
+   RS03Layout *lay;
+   AlignedBuffer *ab;
+   unsigned char *layer[GF_FIELDMAX];
+   gint64 chunk;
+   gint64 layerSector;
+   int currentLayer;
+} io_bench;
+
+static guint64 read_sectors(void *ptr)
+{  io_bench *ib = (io_bench*)ptr;
+   RS03Layout *lay = ib->lay;
+   gint64 n = ib->chunk;
+
+   if(ib->layerSector+n > lay->sectorsPerLayer)
+      n = lay->sectorsPerLayer - ib->layerSector;
+
+   RS03ReadSectors(ib->image, lay, ib->ab->buf, ib->currentLayer,
+		   ib->layerSector, n, RS03_READ_ALL);
+
+   ib->layerSector += n;
+   if(ib->layerSector >= lay->sectorsPerLayer)
+   {  ib->layerSector = 0;
+      ib->currentLayer = (ib->currentLayer+1) % GF_FIELDMAX;
+   }
+
+   return 2048*n;
+}
+
+static guint64 read_layers(void *ptr)
+{  io_bench *ib = (io_bench*)ptr;
+   RS03Layout *lay = ib->lay;
+   gint64 n = ib->chunk;
+
+   if(ib->layerSector+n > lay->sectorsPerLayer)
+      n = lay->sectorsPerLayer - ib->layerSector;
+
+   RS03ReadLayers(ib->image, lay, ib->layer, GF_FIELDMAX,
+		  ib->layerSector, n, RS03_READ_ALL);
+
+   ib->layerSector += n;
+   if(ib->layerSector >= lay->sectorsPerLayer)
+      ib->layerSector = 0;
+
+   return 2048*n*GF_FIELDMAX;
+}
+
+static void bench_io(void)
+{  io_bench *ib;
+   Image *image;
+   Method *method = NULL;
+   char *algorithm, *strategy;
+   char param[40];
+   int i;
+
+   image = OpenImageFromFile(Closure->imageName, O_RDONLY, IMG_PERMS);
+   image = OpenEccFileForImage(image, Closure->eccName, O_RDONLY, IMG_PERMS);
+
+   if(image && image->eccFileMethod) method = image->eccFileMethod;
+   else if(image && image->eccMethod) method = image->eccMethod;
+
+   if(!image || !image->file || !method || strncmp(method->name, "RS03", 4))
+   {  PrintCLI("# io: skipped, %s is not protected by RS03\n", Closure->imageName);
+      if(image) CloseImage(image);
+      return;
+   }
+
+   ib = g_malloc0(sizeof(io_bench));
+   ib->image = image;
+   if(image->eccFileMethod)
+        ib->lay = CalcRS03Layout(image, ECC_FILE);
+   else ib->lay = CalcRS03Layout(image, ECC_IMAGE);
+
+   DescribeRSEncoder(&algorithm, &strategy);
+   if(Closure->encodingIOStrategy == IO_STRATEGY_DIRECT)
+   {  LargeEnableDirectIO(image->file);
+      if(image->eccFile)
+	LargeEnableDirectIO(image->eccFile);
+   }
+
+   /* Layer-wise reading */
+
+   ib->chunk = MAX(1, Closure->prefetchSectors);
+   ib->ab = CreateAlignedBuffer(2048*ib->chunk);
+   g_snprintf(param, 40, "sectors=%" PRId64 ",%s", ib->chunk, strategy);
+   run_test("io", "RS03ReadSectors", param, read_sectors, ib);
+   FreeAlignedBuffer(ib->ab);
+
+   /* Complete ecc blocks; 255 medium sectors are approx. 0.5MiB */
+
+   ib->chunk = MAX(1, 2*Closure->cacheMiB);
+   ib->layerSector = 0;
+   ib->ab = CreateAlignedBuffer(2048*ib->chunk*GF_FIELDMAX);
+   for(i=0; i<GF_FIELDMAX; i++)
+     ib->layer[i] = ib->ab->buf + 2048*ib->chunk*i;
+   g_snprintf(param, 40, "blocks=%" PRId64 ",%s", ib->chunk, strategy);
+   run_test("io", "RS03ReadLayers", param, read_layers, ib);
+   FreeAlignedBuffer(ib->ab);
+
+   g_free(ib->lay);
+   g_free(ib);
+   CloseImage(image);
+}
+
+/***
+ *** Benchmark driver
+ ***/
+
+/*
+ * arg is an optional comma separated list of
+ * encoder, threads, syndromes, decoder, checksums, lec and io.
+ */
+
+static int selected(char *arg, char *name)
+{  char **list;
+   int result = FALSE;
+   int i;
+
+   if(!arg || !*arg || !strcmp(arg, "all"))
+     return TRUE;
+
+   list = g_strsplit(arg, ",", 0);
+   for(i=0; list[i]; i++)
+     if(!strcmp(list[i], name))
+       result = TRUE;
+   g_strfreev(list);
+
+   return result;
+}
+
+void Benchmark(char *arg)
+{  static char *tests[] = { "encoder", "threads", "syndromes", "decoder", "checksums", "lec", "io", NULL };
+   GaloisTables *gt;
+   char *algorithm, *strategy;
+   int i;
+
+   if(arg && *arg && strcmp(arg, "all"))
+   {  char **list = g_strsplit(arg, ",", 0);
+
+      for(i=0; list[i]; i++)
+      {  int j, known = FALSE;
+
+	 for(j=0; tests[j]; j++)
+	   if(!strcmp(list[i], tests[j]))
+	     known = TRUE;
+
+	 if(!known)
+	 {  g_strfreev(list);
+	    Stop(_("--benchmark: valid tests are encoder, threads, syndromes, decoder, checksums, lec and io"));
+	 }
+      }
+      g_strfreev(list);
+   }
+
+   SRandom(Closure->randomSeed);
+   DescribeRSEncoder(&algorithm, &strategy);
+
+   PrintCLI("# %s benchmark\n", Closure->versionString);
+   PrintCLI("# seed %d, %.1fs per test, %d processors, default encoder %s\n",
+	    Closure->randomSeed, BENCH_SECONDS, g_get_num_processors(), algorithm);
+#ifdef HAVE_TSC
+   PrintCLI("# cycles/byte are time stamp counter cycles\n");
+#else
+   PrintCLI("# cycles/byte are not available on this processor\n");
+#endif
+   PrintCLI("# %-8s %-18s %-24s %10s %8s\n",
+	    "component", "variant", "parameters", "MB/s", "cyc/byte");
+
+   gt = CreateGaloisTables(RS_GENERATOR_POLY);
+
+   if(selected(arg, "encoder"))   bench_encoder(gt);
+   if(selected(arg, "threads"))   bench_threads(gt);
+   if(selected(arg, "syndromes")) bench_syndromes(gt);
+   if(selected(arg, "decoder"))   bench_decoder(gt);
+   if(selected(arg, "checksums")) bench_checksums();
+   if(selected(arg, "lec"))       bench_lec();
+   if(selected(arg, "io"))        bench_io();
+
+   FreeGaloisTables(gt);
+}
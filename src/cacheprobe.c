@@ -82,3 +82,49 @@ int ProbeCacheLineSize()
 #endif
 
 /* TODO MINGW: https://docs.microsoft.com/en-us/windows/win32/api/winnt/ns-winnt-cache_descriptor */
+
+/*
+ * Amount of memory which can be allocated without pushing the
+ * system into swapping. Returns 0 if it can not be determined.
+ */
+
+guint64 ProbeAvailableMemory()
+{
+#if defined(SYS_MINGW)
+   MEMORYSTATUSEX ms;
+
+   ms.dwLength = sizeof(ms);
+   if(GlobalMemoryStatusEx(&ms))
+     return ms.ullAvailPhys;
+
+   return 0;
+#elif defined(_SC_PHYS_PAGES) && defined(_SC_PAGE_SIZE)
+   long pages = sysconf(_SC_PHYS_PAGES);
+   long page_size = sysconf(_SC_PAGE_SIZE);
+#if defined(SYS_LINUX)
+   FILE *file;
+   char line[128];
+   guint64 kib;
+
+   /* The page cache can be dropped, so MemAvailable is
+      a better guess than the free memory */
+
+   file = portable_fopen("/proc/meminfo", "r");
+   if(file)
+   {  while(fgets(line, sizeof(line), file))
+	if(sscanf(line, "MemAvailable: %" SCNu64 " kB", &kib) == 1)
+	{  fclose(file);
+	   return kib*1024;
+	}
+      fclose(file);
+   }
+#endif
+
+   if(pages <= 0 || page_size <= 0)
+     return 0;
+
+   return (guint64)pages*page_size / 2;
+#else
+   return 0;
+#endif
+}
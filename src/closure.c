@@ -207,6 +207,7 @@ void GuiReadDotfile()
                                              }
       if(!strcmp(symbol, "adaptive-read"))   { Closure->adaptiveRead   = atoi(value); continue; }
       if(!strcmp(symbol, "auto-suffix"))     { Closure->autoSuffix  = atoi(value); continue; }
+      if(!strcmp(symbol, "auto-tune"))       { Closure->autoTune  = atoi(value); continue; }
       if(!strcmp(symbol, "bd-size1"))        { Closure->bdSize1 = Closure->savedBDSize1 = atoll(value); continue; }
       if(!strcmp(symbol, "bd-size2"))        { Closure->bdSize2 = Closure->savedBDSize2 = atoll(value); continue; }
       if(!strcmp(symbol, "bd-size3"))        { Closure->bdSize3 = Closure->savedBDSize3 = atoll(value); continue; }
@@ -244,6 +245,7 @@ void GuiReadDotfile()
       if(!strcmp(symbol, "max-read-attempts"))   { Closure->maxReadAttempts = atoi(value); continue; }
       if(!strcmp(symbol, "min-read-attempts"))   { Closure->minReadAttempts = atoi(value); continue; }
       if(!strcmp(symbol, "old-missing-sector-marker"))  { Closure->dsmVersion  = !atoi(value); continue; }
+      if(!strcmp(symbol, "paranoid-fix"))    { Closure->paranoidFix = atoi(value); continue; }
       if(!strcmp(symbol, "prefetch-sectors")){ Closure->prefetchSectors  = atoi(value); continue; }
       if(!strcmp(symbol, "raw-mode"))        { Closure->rawMode = atoi(value); continue; }
       if(!strcmp(symbol, "read-and-create")) { Closure->readAndCreate = atoi(value); continue; }
@@ -252,6 +254,10 @@ void GuiReadDotfile()
       if(!strcmp(symbol, "redundancy"))      { if(Closure->redundancy) g_free(Closure->redundancy);
                                                Closure->redundancy  = g_strdup(value); continue; }
       if(!strcmp(symbol, "spinup-delay"))    { Closure->spinupDelay = atoi(value); continue; }
+      if(!strcmp(symbol, "tuned-cache-size")){ Closure->tunedCacheMiB = atoi(value); continue; }
+      if(!strcmp(symbol, "tuned-codec-threads")) { Closure->tunedThreads = atoi(value); continue; }
+      if(!strcmp(symbol, "tuned-encoding-algorithm")) { Closure->tunedEncoding = atoi(value); continue; }
+      if(!strcmp(symbol, "tuned-prefetch-sectors")) { Closure->tunedPrefetch = atoi(value); continue; }
       if(!strcmp(symbol, "unlink"))          { Closure->unlinkImage = atoi(value); continue; }
       if(!strcmp(symbol, "verbose"))         { Closure->verbose = atoi(value); continue; }
       if(!strcmp(symbol, "welcome-msg"))     { Closure->welcomeMessage = atoi(value); continue; }
@@ -313,6 +319,7 @@ static void update_dotfile()
 
    g_fprintf(dotfile, "adaptive-read:     %d\n", Closure->adaptiveRead);
    g_fprintf(dotfile, "auto-suffix:       %d\n", Closure->autoSuffix);
+   g_fprintf(dotfile, "auto-tune:         %d\n", Closure->autoTune);
    g_fprintf(dotfile, "bd-size1:          %lld\n", (long long int)Closure->bdSize1);
    g_fprintf(dotfile, "bd-size2:          %lld\n", (long long int)Closure->bdSize2);
    g_fprintf(dotfile, "bd-size3:          %lld\n", (long long int)Closure->bdSize3);
@@ -346,6 +353,7 @@ static void update_dotfile()
    g_fprintf(dotfile, "max-read-attempts: %d\n", Closure->maxReadAttempts);
    g_fprintf(dotfile, "min-read-attempts: %d\n", Closure->minReadAttempts);
    g_fprintf(dotfile, "old-missing-sector-marker: %d\n", !Closure->dsmVersion);
+   g_fprintf(dotfile, "paranoid-fix:      %d\n", Closure->paranoidFix);
    g_fprintf(dotfile, "prefetch-sectors:  %d\n", Closure->prefetchSectors);
    g_fprintf(dotfile, "raw-mode:          %d\n", Closure->rawMode);
    g_fprintf(dotfile, "read-and-create:   %d\n", Closure->readAndCreate);
@@ -354,6 +362,10 @@ static void update_dotfile()
    if(Closure->redundancy)
      g_fprintf(dotfile, "redundancy:        %s\n", Closure->redundancy);
    g_fprintf(dotfile, "spinup-delay:      %d\n", Closure->spinupDelay);
+   g_fprintf(dotfile, "tuned-cache-size:  %d\n", Closure->tunedCacheMiB);
+   g_fprintf(dotfile, "tuned-codec-threads: %d\n", Closure->tunedThreads);
+   g_fprintf(dotfile, "tuned-encoding-algorithm: %d\n", Closure->tunedEncoding);
+   g_fprintf(dotfile, "tuned-prefetch-sectors: %d\n", Closure->tunedPrefetch);
    g_fprintf(dotfile, "unlink:            %d\n", Closure->unlinkImage);
    g_fprintf(dotfile, "verbose:           %d\n", Closure->verbose);
    g_fprintf(dotfile, "welcome-msg:       %d\n\n", Closure->welcomeMessage);
@@ -547,11 +559,14 @@ void InitClosure()
    Closure->dDumpDir    = g_strdup(Closure->homeDir);
    Closure->cacheMiB    = 32;
    Closure->prefetchSectors = 128;
+   Closure->fullVerifyDays = 30;
+   Closure->batchDeviceJobs = 1;
    Closure->codecThreads = 1;
    Closure->eccTarget = 1;
    Closure->encodingAlgorithm = ENCODING_ALG_DEFAULT;
    Closure->minReadAttempts = 1;
    Closure->maxReadAttempts = 1;
+   Closure->lecTimeLimit = 60;
    Closure->rawMode     = 0x20;
    Closure->internalAttempts = -1;
    Closure->sectorSkip  = 16;
@@ -690,8 +705,13 @@ void FreeClosure()
    cond_free(Closure->device);
    cond_free_ptr_array(Closure->deviceNames);
    cond_free_ptr_array(Closure->deviceNodes);
+   cond_free_ptr_array(Closure->stripeDevices);
    cond_free(Closure->imageName);
    cond_free(Closure->eccName);
+   cond_free(Closure->damageMapFile);
+   cond_free(Closure->crcCacheFile);
+   cond_free(Closure->verifyStateFile);
+   cond_free(Closure->batchSummaryFile);
    cond_free(Closure->redundancy);
 
    CallMethodDestructors();
@@ -705,6 +725,7 @@ void FreeClosure()
    cond_free(Closure->docDir);
    cond_free(Closure->errorTitle);
    cond_free(Closure->simulateCD);
+   cond_free_ptr_array(Closure->simulateCDs);
    cond_free(Closure->dDumpDir);
    cond_free(Closure->dDumpPrefix);
 
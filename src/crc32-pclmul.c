@@ -0,0 +1,171 @@
+/*  dvdisaster: Additional error correction for optical media.
+ *  Copyright (C) 2004-2017 Carsten Gnoerlich.
+ *  Copyright (C) 2019-2021 The dvdisaster development team.
+ * 
+ *  Email: support@dvdisaster.org
+ *
+ *  This file is part of dvdisaster.
+ *
+ *  dvdisaster is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  dvdisaster is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with dvdisaster. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*** src type: no GUI code ***/
+
+#include "dvdisaster.h"
+
+#ifdef HAVE_PCLMUL
+  #include <emmintrin.h>
+  #include <wmmintrin.h>
+
+#ifdef HAVE_CPUID
+  #include <cpuid.h>
+#else
+  #include "compat/cpuid.h"
+#endif
+#endif
+
+/***
+ *** CRC32 using carry-less multiplication (PCLMULQDQ)
+ ***/
+
+/* 
+ * Folds the data into the CRC with 128 bit carry-less multiplications
+ * as described in Intel's "Fast CRC Computation for Generic Polynomials
+ * Using PCLMULQDQ Instruction" white paper, followed by a Barrett
+ * reduction to 32 bits. The constants are for the bit-reflected
+ * polynomial 0x04C11DB7 used by Crc32().
+ * 
+ * crc is the running (non-inverted) CRC register; len must be
+ * a multiple of 16 and at least 64.
+ */
+
+#ifdef HAVE_PCLMUL
+int ProbePCLMUL(void)
+{  unsigned int eax, ebx, ecx, edx;
+
+   if(!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+   {  Verbose("[ProbePCLMUL: get_cpuid() failed]\n");
+      return 0;
+   }
+
+   if((ecx & bit_PCLMUL) && (edx & bit_SSE2))
+   {  Verbose("[ProbePCLMUL: PCLMULQDQ available]\n");
+      return 1;
+   }
+   else
+   {  Verbose("[ProbePCLMUL: no PCLMULQDQ]\n");
+      return 0;
+   }
+}
+
+guint32 crc32_pclmul(guint32 crc, unsigned char *data, int len)
+{  __m128i k1k2 = _mm_set_epi64x(0x01c6e41596LL, 0x0154442bd4LL);
+   __m128i k3k4 = _mm_set_epi64x(0x00ccaa009eLL, 0x01751997d0LL);
+   __m128i k5k0 = _mm_set_epi64x(0x0000000000LL, 0x0163cd6124LL);
+   __m128i poly = _mm_set_epi64x(0x01f7011641LL, 0x01db710641LL);
+   __m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+   __m128i x1, x2, x3, x4, x5, x6, x7, x8;
+
+   /* Load the first 64 bytes into four accumulators */
+
+   x1 = _mm_loadu_si128((__m128i*)(data+0x00));
+   x2 = _mm_loadu_si128((__m128i*)(data+0x10));
+   x3 = _mm_loadu_si128((__m128i*)(data+0x20));
+   x4 = _mm_loadu_si128((__m128i*)(data+0x30));
+   x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(crc));
+   data += 64;
+   len  -= 64;
+
+   /* Fold 64 bytes per step */
+
+   while(len >= 64)
+   {  x5 = _mm_clmulepi64_si128(x1, k1k2, 0x00);
+      x6 = _mm_clmulepi64_si128(x2, k1k2, 0x00);
+      x7 = _mm_clmulepi64_si128(x3, k1k2, 0x00);
+      x8 = _mm_clmulepi64_si128(x4, k1k2, 0x00);
+
+      x1 = _mm_clmulepi64_si128(x1, k1k2, 0x11);
+      x2 = _mm_clmulepi64_si128(x2, k1k2, 0x11);
+      x3 = _mm_clmulepi64_si128(x3, k1k2, 0x11);
+      x4 = _mm_clmulepi64_si128(x4, k1k2, 0x11);
+
+      x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), _mm_loadu_si128((__m128i*)(data+0x00)));
+      x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), _mm_loadu_si128((__m128i*)(data+0x10)));
+      x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), _mm_loadu_si128((__m128i*)(data+0x20)));
+      x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), _mm_loadu_si128((__m128i*)(data+0x30)));
+
+      data += 64;
+      len  -= 64;
+   }
+
+   /* Fold the four accumulators into one */
+
+   x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+   x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+   x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+   x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+   x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+   x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+
+   x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+   x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+   x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+   /* Fold the remaining 16 byte blocks */
+
+   while(len >= 16)
+   {  x5 = _mm_clmulepi64_si128(x1, k3k4, 0x00);
+      x1 = _mm_clmulepi64_si128(x1, k3k4, 0x11);
+      x1 = _mm_xor_si128(_mm_xor_si128(x1, _mm_loadu_si128((__m128i*)data)), x5);
+
+      data += 16;
+      len  -= 16;
+   }
+
+   /* Reduce 128 to 64 bits */
+
+   x2 = _mm_clmulepi64_si128(x1, k3k4, 0x10);
+   x1 = _mm_xor_si128(_mm_srli_si128(x1, 8), x2);
+
+   x2 = _mm_srli_si128(x1, 4);
+   x1 = _mm_and_si128(x1, mask32);
+   x1 = _mm_clmulepi64_si128(x1, k5k0, 0x00);
+   x1 = _mm_xor_si128(x1, x2);
+
+   /* Barrett reduction to 32 bits */
+
+   x2 = _mm_and_si128(x1, mask32);
+   x2 = _mm_clmulepi64_si128(x2, poly, 0x10);
+   x2 = _mm_and_si128(x2, mask32);
+   x2 = _mm_clmulepi64_si128(x2, poly, 0x00);
+   x1 = _mm_xor_si128(x1, x2);
+
+   return _mm_cvtsi128_si32(_mm_srli_si128(x1, 4));
+}
+#else /* don't have PCLMUL */
+/* Stub functions to keep the linker happy.
+ * Should never be executed.
+ */
+
+int ProbePCLMUL()
+{  return 0;
+}
+
+guint32 crc32_pclmul(guint32 crc, unsigned char *data, int len)
+{
+   Stop("Mega borkage - crc32_pclmul() stub called.\n");
+   return 0;
+}
+#endif /* HAVE_PCLMUL */
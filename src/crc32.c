@@ -117,19 +117,106 @@ static guint32 crctable[256] =
 };
 
 /*
- * The table-based CRC32 algorithm
+ * Slicing-by-16 tables, derived from the table above by InitCrc32().
+ * crcslice[k][b] is the CRC contribution of byte b when it is
+ * followed by k more bytes; crcslice[0] is crctable itself.
+ */
+
+static guint32 crcslice[16][256];
+
+void InitCrc32(void)
+{  int i,k;
+
+   for(i=0; i<256; i++)
+     crcslice[0][i] = crctable[i];
+
+   for(k=1; k<16; k++)
+     for(i=0; i<256; i++)
+     {  guint32 crc = crcslice[k-1][i];
+
+	crcslice[k][i] = crctable[crc & 0xFF] ^ (crc >> 8);
+     }
+}
+
+/*
+ * Read 32 bits in little endian order regardless of the host
+ * byte order and alignment.
+ */
+
+static inline guint32 get_le32(unsigned char *data)
+{  return    (guint32)data[0]        | ((guint32)data[1] << 8) 
+	  | ((guint32)data[2] << 16) | ((guint32)data[3] << 24);
+}
+
+/*
+ * Process 16 bytes per step (slicing-by-16), then 8 bytes (slicing-by-8),
+ * and the remainder byte-by-byte.
+ */
+
+static guint32 crc32_slicing(guint32 crc, unsigned char *data, int len)
+{
+   while(len >= 16)
+   {  guint32 w0 = get_le32(data) ^ crc;
+      guint32 w1 = get_le32(data+4);
+      guint32 w2 = get_le32(data+8);
+      guint32 w3 = get_le32(data+12);
+
+      crc =   crcslice[15][w0 & 0xFF]  ^ crcslice[14][(w0>>8) & 0xFF]
+	    ^ crcslice[13][(w0>>16) & 0xFF] ^ crcslice[12][w0>>24]
+	    ^ crcslice[11][w1 & 0xFF]  ^ crcslice[10][(w1>>8) & 0xFF]
+	    ^ crcslice[9][(w1>>16) & 0xFF]  ^ crcslice[8][w1>>24]
+	    ^ crcslice[7][w2 & 0xFF]   ^ crcslice[6][(w2>>8) & 0xFF]
+	    ^ crcslice[5][(w2>>16) & 0xFF]  ^ crcslice[4][w2>>24]
+	    ^ crcslice[3][w3 & 0xFF]   ^ crcslice[2][(w3>>8) & 0xFF]
+	    ^ crcslice[1][(w3>>16) & 0xFF]  ^ crcslice[0][w3>>24];
+      data += 16;
+      len  -= 16;
+   }
+
+   if(len >= 8)
+   {  guint32 w0 = get_le32(data) ^ crc;
+      guint32 w1 = get_le32(data+4);
+
+      crc =   crcslice[7][w0 & 0xFF]   ^ crcslice[6][(w0>>8) & 0xFF]
+	    ^ crcslice[5][(w0>>16) & 0xFF]  ^ crcslice[4][w0>>24]
+	    ^ crcslice[3][w1 & 0xFF]   ^ crcslice[2][(w1>>8) & 0xFF]
+	    ^ crcslice[1][(w1>>16) & 0xFF]  ^ crcslice[0][w1>>24];
+      data += 8;
+      len  -= 8;
+   }
+
+   while(len--)
+      crc = crctable[(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+
+   return crc;
+}
+
+/*
+ * The CRC32 algorithm
  *
  * Note that endianess does not matter for the internal calculations,
  * but the final CRC sum will be returned in little endian format
  * so that comparing against the sums in the ecc file does not need
  * to be endian-aware.
+ *
+ * Blocks of 64 bytes and more are folded with carry-less 
+ * multiplication if the processor supports it.
  */ 
 
+guint32 crc32_pclmul(guint32, unsigned char*, int);
+
 guint32 Crc32(unsigned char *data, int len)
 {  guint32 crc = ~0;
 
-   while(len--)
-      crc = crctable[(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+   if(Closure->usePCLMUL && len >= 64)
+   {  int folded = len & ~15;
+
+      crc   = crc32_pclmul(crc, data, folded);
+      data += folded;
+      len  -= folded;
+   }
+
+   crc = crc32_slicing(crc, data, len);
 
 #ifdef HAVE_BIG_ENDIAN
    crc = SwapBytes32(crc);
@@ -138,6 +225,18 @@ guint32 Crc32(unsigned char *data, int len)
    return crc;
 }
 
+/*
+ * Calculate the CRC32 of n consecutive 2048 byte sectors.
+ */
+
+void Crc32Sectors(unsigned char *data, int n, guint32 *crc)
+{
+   while(n--)
+   {  *crc++ = Crc32(data, 2048);
+      data += 2048;
+   }
+}
+
 /***
  *** EDC checksum used in CDROM sectors
  ***/
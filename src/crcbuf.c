@@ -152,13 +152,23 @@ int AddSectorToCrcBuffer(CrcBuf *cb, int mode, guint64 idx, unsigned char *buf,
  */
 
 int CheckAgainstCrcBuffer(CrcBuf *cb, gint64 idx, unsigned char *buf)
-{  guint32 crc;
-
+{
    if(idx < 0 || idx >= cb->crcSize)
      return CRC_OUTSIDE_BOUND;
    
-   crc = Crc32(buf, 2048);
+   return CheckCrcAgainstCrcBuffer(cb, idx, Crc32(buf, 2048));
+}
 
+/*
+ * Same as above, but for an already calculated CRC sum
+ * (e.g. from Crc32Sectors()).
+ */
+
+int CheckCrcAgainstCrcBuffer(CrcBuf *cb, gint64 idx, guint32 crc)
+{
+   if(idx < 0 || idx >= cb->crcSize)
+     return CRC_OUTSIDE_BOUND;
+   
    if(!GetBit(cb->valid, idx))
       return CRC_UNKNOWN;
    
@@ -247,6 +257,230 @@ int CrcBufValid(CrcBuf *crcbuf, Image *image, int mode)
   return TRUE;
 }
 
+/***
+ *** Keep the buffer on disk
+ ***/
+
+/*
+ * The CRC cache file allows to reuse the checksums from an image read
+ * in subsequent program calls. It consists of the header below,
+ * followed by the CRC array and the words of the valid bitmap.
+ * The file is written in native byte order; it is only meant for
+ * the machine which created it.
+ * The cache is tied to the image by its size, modification time
+ * and fingerprint. If either one differs, the cache is ignored.
+ * The image must also be older than the cache; otherwise it might
+ * have been changed again without its modification time changing
+ * (e.g. on file systems storing only whole seconds).
+ */
+
+#define CRC_CACHE_COOKIE "*dvdisaster-crc*"
+#define CRC_CACHE_VERSION 2
+#define CRC_CACHE_BYTE_ORDER 0x01020304
+
+typedef struct
+{  char cookie[16];
+   guint32 version;
+   guint32 byteOrder;           /* detects caches from other architectures */
+   guint64 imageBytes;          /* size of image file in bytes */
+   gint64 imageMTime;           /* modification time of image file in nsec */
+   gint64 cacheTime;            /* time at which above values were taken, in nsec */
+   guint64 dataSectors;
+   guint64 coveredSectors;
+   guint64 allSectors;
+   gint32 fpSector;
+   gint32 md5State;
+   guint8 mediumFP[16];
+   guint8 dataMD5sum[16];
+   guint8 imageMD5sum[16];
+   guint8 payloadMD5sum[16];    /* md5sum of CRC array and bitmap */
+   guint32 selfCRC;             /* CRC32 of the preceding header bytes */
+   guint32 padding;
+} CrcCacheHeader;
+
+static void payload_md5(CrcBuf *cb, guint8 *digest)
+{  struct MD5Context md5ctxt;
+
+   MD5Init(&md5ctxt);
+   MD5Update(&md5ctxt, (unsigned char*)cb->crcbuf, cb->crcSize*sizeof(guint32));
+   MD5Update(&md5ctxt, (unsigned char*)cb->valid->bitmap, cb->valid->words*sizeof(guint32));
+   MD5Final(digest, &md5ctxt);
+}
+
+/*
+ * Write the buffer after it has been completely filled
+ * from the image file at image_path.
+ */
+
+void SaveCrcBuf(CrcBuf *cb, char *image_path, char *path)
+{  CrcCacheHeader cch;
+   FILE *file;
+   char *reason = NULL;
+   int ok;
+
+   if(!cb || (cb->md5State & MD5_BUILDING) || !(cb->md5State & MD5_COMPLETE))
+     reason = _("checksums are incomplete");
+   else if(!cb->fpValid)
+     reason = _("image has no fingerprint");
+   else if(cb->crcSize != cb->allSectors)
+     reason = _("checksums do not cover the image");
+   
+   memset(&cch, 0, sizeof(CrcCacheHeader));
+   cch.cacheTime = g_get_real_time() * 1000;
+   if(!reason && !LargeStatMTime(image_path, &cch.imageBytes, &cch.imageMTime))
+     reason = strerror(errno);
+
+   if(reason)
+   {  PrintLog(_("CRC cache %s not written: %s.\n"), path, reason);
+      return;
+   }
+
+   memcpy(cch.cookie, CRC_CACHE_COOKIE, 16);
+   cch.version        = CRC_CACHE_VERSION;
+   cch.byteOrder      = CRC_CACHE_BYTE_ORDER;
+   cch.dataSectors    = cb->dataSectors;
+   cch.coveredSectors = cb->coveredSectors;
+   cch.allSectors     = cb->allSectors;
+   cch.fpSector       = cb->fpSector;
+   cch.md5State       = cb->md5State;
+   memcpy(cch.mediumFP, cb->mediumFP, 16);
+   memcpy(cch.dataMD5sum, cb->dataMD5sum, 16);
+   memcpy(cch.imageMD5sum, cb->imageMD5sum, 16);
+   payload_md5(cb, cch.payloadMD5sum);
+   cch.selfCRC = Crc32((unsigned char*)&cch, offsetof(CrcCacheHeader, selfCRC));
+
+   file = portable_fopen(path, "wb");
+   if(!file)
+   {  PrintLog(_("Could not save the CRC cache to %s: %s\n"), path, strerror(errno));
+      return;
+   }
+
+   ok =    fwrite(&cch, sizeof(CrcCacheHeader), 1, file) == 1
+        && fwrite(cb->crcbuf, sizeof(guint32), cb->crcSize, file) == cb->crcSize
+        && fwrite(cb->valid->bitmap, sizeof(guint32), cb->valid->words, file) == cb->valid->words;
+
+   if(fclose(file) || !ok)
+        PrintLog(_("Could not save the CRC cache to %s: %s\n"), path, strerror(errno));
+   else PrintLog(_("CRC cache for %" PRId64 " sectors written to %s.\n"), cb->allSectors, path);
+}
+
+/*
+ * A change within the time stamp resolution of the file system would
+ * go unnoticed, so the image must have been written strictly before
+ * the cache. Time stamps without a fractional part are taken
+ * as coming from a file system which stores only whole seconds.
+ */
+
+static int older_than_cache(gint64 mtime, gint64 cache_time)
+{  const gint64 second = G_GINT64_CONSTANT(1000000000);
+
+   if(mtime % second)
+        return mtime < cache_time;
+   else return mtime/second < cache_time/second;
+}
+
+/*
+ * Load the buffer and make sure it still belongs to the image.
+ * Returns NULL otherwise; the caller must then calculate
+ * the checksums from the image.
+ */
+
+CrcBuf *LoadCrcBuf(Image *image, char *path)
+{  CrcCacheHeader cch;
+   CrcBuf *cb = NULL;
+   FILE *file;
+   guint64 image_bytes;
+   gint64 image_mtime;
+   guint8 digest[16];
+   char *reason = NULL;
+
+   if(image->type != IMAGE_FILE)
+     return NULL;
+
+   file = portable_fopen(path, "rb");
+   if(!file)
+   {  PrintLog(_("Could not open CRC cache %s: %s\n"), path, strerror(errno));
+      return NULL;
+   }
+
+   /*** Examine the header */
+   
+   if(   fread(&cch, sizeof(CrcCacheHeader), 1, file) != 1
+      || memcmp(cch.cookie, CRC_CACHE_COOKIE, 16))
+   {  reason = _("not a CRC cache");
+      goto failed;
+   }
+
+   if(   cch.version != CRC_CACHE_VERSION
+      || cch.byteOrder != CRC_CACHE_BYTE_ORDER
+      || cch.selfCRC != Crc32((unsigned char*)&cch, offsetof(CrcCacheHeader, selfCRC))
+      || cch.allSectors > G_MAXINT
+      || cch.dataSectors > cch.allSectors
+      || cch.coveredSectors > cch.allSectors)
+   {  reason = _("unsupported or damaged CRC cache");
+      goto failed;
+   }
+
+   /*** Make sure that the cache belongs to this image */
+
+   if(!LargeStatMTime(image->file->path, &image_bytes, &image_mtime)
+      || image_bytes != cch.imageBytes || image_mtime != cch.imageMTime
+      || !older_than_cache(image_mtime, cch.cacheTime))
+   {  reason = _("image has been modified");
+      goto failed;
+   }
+
+   if(   cch.fpSector != image->fpSector
+      || !GetImageFingerprint(image, digest, cch.fpSector)
+      || memcmp(digest, cch.mediumFP, 16))
+   {  reason = _("fingerprint does not match the image");
+      goto failed;
+   }
+
+   /*** Read the CRC sums and the bitmap */
+
+   cb = g_malloc0(sizeof(CrcBuf));
+   cb->crcbuf  = g_malloc(cch.allSectors * sizeof(guint32));
+   cb->crcSize = cch.allSectors;
+   cb->valid   = CreateBitmap0(cch.allSectors);
+
+   if(   fread(cb->crcbuf, sizeof(guint32), cb->crcSize, file) != cb->crcSize
+      || fread(cb->valid->bitmap, sizeof(guint32), cb->valid->words, file) != cb->valid->words)
+   {  reason = _("file is truncated");
+      goto failed;
+   }
+
+   payload_md5(cb, digest);
+   if(memcmp(digest, cch.payloadMD5sum, 16))
+   {  reason = _("checksum mismatch");
+      goto failed;
+   }
+   fclose(file);
+
+   cb->crcCached = TRUE;
+   cb->md5State = cch.md5State;
+   cb->lastSector = cch.allSectors;
+   memcpy(cb->dataMD5sum, cch.dataMD5sum, 16);
+   memcpy(cb->imageMD5sum, cch.imageMD5sum, 16);
+   cb->imageName = g_strdup(image->file->path);
+   cb->dataSectors = cch.dataSectors;
+   cb->coveredSectors = cch.coveredSectors;
+   cb->allSectors = cch.allSectors;
+   memcpy(cb->mediumFP, cch.mediumFP, 16);
+   cb->fpSector = cch.fpSector;
+   cb->fpValid = TRUE;
+
+   image->crcCache = cb;
+   PrintLog(_("Using checksums from CRC cache %s.\n"), path);
+   return cb;
+
+failed:
+   fclose(file);
+   if(cb) FreeCrcBuf(cb);
+   PrintLog(_("Ignoring CRC cache %s: %s.\n"), path, reason);
+   return NULL;
+}
+
 /***
  *** Clean up
  ***/
@@ -0,0 +1,262 @@
+/*  dvdisaster: Additional error correction for optical media.
+ *  Copyright (C) 2004-2017 Carsten Gnoerlich.
+ *  Copyright (C) 2019-2021 The dvdisaster development team.
+ *
+ *  Email: support@dvdisaster.org
+ *
+ *  This file is part of dvdisaster.
+ *
+ *  dvdisaster is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  dvdisaster is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with dvdisaster. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*** src type: no GUI code ***/
+
+#include "dvdisaster.h"
+
+/*
+ * A damage map records which sectors of an image were found to be
+ * unreadable or defective by the last read, scan or verify run.
+ * It is stored in a small text file so that a subsequent fix run
+ * only needs to process the ecc blocks containing these sectors:
+ *
+ * # dvdisaster damage map
+ * sectors: <image size in sectors>
+ * fingerprint: <sector>:<md5sum of that sector> | none
+ * damaged: <number of damaged sectors>
+ * <first>-<last> | <sector>
+ * ...
+ *
+ * Sectors beyond the end of the map are considered as being damaged.
+ */
+
+#define MAX_LINE_LEN 512
+
+/***
+ *** Create and maintain the map
+ ***/
+
+DamageMap *CreateDamageMap(Image *image, gint64 sectors)
+{  DamageMap *dm = g_malloc0(sizeof(DamageMap));
+
+   dm->damaged = CreateBitmap0(sectors);
+   dm->sectors = sectors;
+
+   if(image && image->fpState == FP_PRESENT)
+   {  memcpy(dm->mediumFP, image->imageFP, 16);
+      dm->fpValid = TRUE;
+   }
+   dm->fpSector = image ? image->fpSector : FINGERPRINT_SECTOR;
+
+   dm->lock = g_malloc(sizeof(GMutex));
+   g_mutex_init(dm->lock);
+
+   return dm;
+}
+
+void FreeDamageMap(DamageMap *dm)
+{  FreeBitmap(dm->damaged);
+   g_mutex_clear(dm->lock);
+   g_free(dm->lock);
+   g_free(dm);
+}
+
+/*
+ * Reader and worker threads may update the map concurrently,
+ * so the bitmap words are protected by a lock.
+ */
+
+void MarkDamagedSectors(DamageMap *dm, gint64 first, gint64 count)
+{  gint64 s;
+
+   g_mutex_lock(dm->lock);
+   for(s=first; s<first+count && s<dm->sectors; s++)
+      SetBit(dm->damaged, s);
+   g_mutex_unlock(dm->lock);
+}
+
+void ClearDamagedSectors(DamageMap *dm, gint64 first, gint64 count)
+{  gint64 s;
+
+   g_mutex_lock(dm->lock);
+   for(s=first; s<first+count && s<dm->sectors; s++)
+      ClearBit(dm->damaged, s);
+   g_mutex_unlock(dm->lock);
+}
+
+int SectorIsDamaged(DamageMap *dm, gint64 sector)
+{  if(sector < 0 || sector >= dm->sectors)
+      return TRUE;
+
+   return GetBit(dm->damaged, sector) != 0;
+}
+
+/***
+ *** Save and load the map
+ ***/
+
+void SaveDamageMap(DamageMap *dm, char *path)
+{  FILE *file;
+   gint64 s,first;
+   int i,ok;
+
+   file = portable_fopen(path, "wb");
+   if(!file)
+   {  PrintLog(_("Could not save the damage map to %s: %s\n"), path, strerror(errno));
+      return;
+   }
+
+   g_fprintf(file, "# dvdisaster damage map\n");
+   g_fprintf(file, "sectors: %" PRId64 "\n", dm->sectors);
+   if(dm->fpValid)
+   {  g_fprintf(file, "fingerprint: %d:", dm->fpSector);
+      for(i=0; i<16; i++)
+	 g_fprintf(file, "%02x", dm->mediumFP[i]);
+      g_fprintf(file, "\n");
+   }
+   else g_fprintf(file, "fingerprint: none\n");
+   g_fprintf(file, "damaged: %d\n", CountBits(dm->damaged));
+
+   /* Combine subsequent damaged sectors into one range */
+
+   for(s=0; s<dm->sectors; s++)
+   {  if(!GetBit(dm->damaged, s))
+	 continue;
+
+      first = s;
+      while(s+1 < dm->sectors && GetBit(dm->damaged, s+1))
+	 s++;
+
+      if(first == s)
+	   g_fprintf(file, "%" PRId64 "\n", s);
+      else g_fprintf(file, "%" PRId64 "-%" PRId64 "\n", first, s);
+   }
+
+   ok = !ferror(file);
+   if(fclose(file) || !ok)
+        PrintLog(_("Could not save the damage map to %s: %s\n"), path, strerror(errno));
+   else PrintLog(_("Damage map with %d damaged sectors written to %s.\n"),
+		 CountBits(dm->damaged), path);
+}
+
+/*
+ * Load the map and make sure it belongs to the given image.
+ * Returns NULL if it does not; the caller must then process
+ * the whole image.
+ */
+
+DamageMap *LoadDamageMap(Image *image, char *path)
+{  DamageMap *dm = NULL;
+   FILE *file;
+   char line[MAX_LINE_LEN];
+   gint64 sectors = -1;
+   int fp_sector = -1;
+   guint8 fp[16];
+   int fp_valid = FALSE;
+   char *reason = NULL;
+
+   file = portable_fopen(path, "rb");
+   if(!file)
+   {  PrintLog(_("Could not open damage map %s: %s\n"), path, strerror(errno));
+      return NULL;
+   }
+
+   if(!fgets(line, MAX_LINE_LEN, file) || strncmp(line, "# dvdisaster damage map", 23))
+   {  reason = _("not a damage map");
+      goto failed;
+   }
+
+   /*** The header lines */
+
+   while(fgets(line, MAX_LINE_LEN, file))
+   {  char hex[33];
+      gint64 value;
+      int i;
+
+      if(sscanf(line, "sectors: %" SCNd64, &value) == 1)
+      {  sectors = value;
+	 continue;
+      }
+
+      if(!strncmp(line, "fingerprint: none", 17))
+	 continue;
+
+      if(sscanf(line, "fingerprint: %d:%32[0-9a-f]", &fp_sector, hex) == 2)
+      {  if(strlen(hex) != 32)
+	 {  reason = _("invalid fingerprint");
+	    goto failed;
+	 }
+	 for(i=0; i<16; i++)
+	 {  unsigned int byte;
+
+	    sscanf(hex+2*i, "%2x", &byte);
+	    fp[i] = byte;
+	 }
+	 fp_valid = TRUE;
+	 continue;
+      }
+
+      if(!strncmp(line, "damaged:", 8))
+	 break;
+   }
+
+   if(sectors < 0 || sectors > G_MAXINT)
+   {  reason = _("invalid size");
+      goto failed;
+   }
+
+   /*** Make sure that the map belongs to this image.
+	Without a fingerprint, at least the size must match. */
+
+   if(fp_valid)
+   {  guint8 image_fp[16];
+
+      if(!GetImageFingerprint(image, image_fp, fp_sector)
+	 || memcmp(fp, image_fp, 16))
+      {  reason = _("fingerprint does not match the image");
+	 goto failed;
+      }
+   }
+   else if(sectors != image->sectorSize)
+   {  reason = _("size does not match the image");
+      goto failed;
+   }
+
+   dm = CreateDamageMap(NULL, sectors);
+   memcpy(dm->mediumFP, fp, 16);
+   dm->fpValid = fp_valid;
+   dm->fpSector = fp_sector;
+
+   /*** The damaged sector ranges */
+
+   while(fgets(line, MAX_LINE_LEN, file))
+   {  gint64 first,last;
+      int n = sscanf(line, "%" SCNd64 "-%" SCNd64, &first, &last);
+
+      if(n == 1) last = first;
+      if(n < 1 || first < 0 || last < first || last >= sectors)
+      {  reason = _("invalid sector range");
+	 goto failed;
+      }
+      MarkDamagedSectors(dm, first, last-first+1);
+   }
+
+   fclose(file);
+   return dm;
+
+failed:
+   fclose(file);
+   if(dm) FreeDamageMap(dm);
+   PrintLog(_("Ignoring damage map %s: %s.\n"), path, reason);
+   return NULL;
+}
@@ -34,6 +34,8 @@
  */
 struct _RawBuffer *rawbuffer_forward;
 struct _DefectiveSectorHeader *dsh_forward;
+struct _DefectiveStoreHeader *dss_forward;
+struct _DefectiveStoreRecord *dsr_forward;
 struct _DeviceHandle *dh_forward;
 struct _Image *dh_image;
 
@@ -51,7 +53,9 @@ typedef enum
    MODE_READ, 
    MODE_SCAN,
    MODE_SEQUENCE, 
+   MODE_BATCH_VERIFY,
 
+   MODE_BENCHMARK,
    MODE_BYTESET, 
    MODE_COPY_SECTOR,
    MODE_CMP_IMAGES,
@@ -75,10 +79,16 @@ typedef enum
       avoid collision with the single-char options */
    MODIFIER_ADAPTIVE_READ = 128,
    MODIFIER_AUTO_SUFFIX,
+   MODIFIER_AUTO_TUNE,
+   MODIFIER_BATCH_DEVICE_JOBS,
+   MODIFIER_BATCH_JOBS,
+   MODIFIER_BATCH_SUMMARY,
    MODIFIER_CACHE_SIZE, 
    MODIFIER_CLV_SPEED,    /* unused */ 
    MODIFIER_CAV_SPEED,    /* unused */
    MODIFIER_CDUMP, 
+   MODIFIER_CRC_CACHE,
+   MODIFIER_DAMAGE_MAP,
    MODIFIER_DAO, 
    MODIFIER_DEBUG,
    MODIFIER_DEFECTIVE_DUMP,
@@ -90,17 +100,21 @@ typedef enum
    MODIFIER_EXAMINE_RS03,
    MODIFIER_FILL_UNREADABLE,
    MODIFIER_FIXED_SPEED_VALUES,
+   MODIFIER_FULL_VERIFY_DAYS,
    MODIFIER_IGNORE_FATAL_SENSE,
    MODIFIER_IGNORE_ISO_SIZE,
    MODIFIER_IGNORE_RS03_HEADER,
    MODIFIER_INTERNAL_REREADS,
+   MODIFIER_LEC_TIME_LIMIT,
    MODIFIER_NO_BDR_DEFECT_MANAGEMENT,
    MODIFIER_NO_PROGRESS,
    MODIFIER_OLD_DS_MARKER,
+   MODIFIER_PARANOID,
    MODIFIER_PERMISSIVE_MEDIUM_TYPE,
    MODIFIER_PREFETCH_SECTORS,
    MODIFIER_RANDOM_SEED,
    MODIFIER_RAW_MODE,
+   MODIFIER_READ_AHEAD,
    MODIFIER_READ_ATTEMPTS,
    MODIFIER_READ_MEDIUM,
    MODIFIER_READ_RAW,
@@ -113,6 +127,7 @@ typedef enum
    MODIFIER_SPEED_WARNING, 
    MODIFIER_SPINUP_DELAY, 
    MODIFIER_TRUNCATE,
+   MODIFIER_VERIFY_STATE,
    MODIFIER_VERSION,
 } run_mode;
 
@@ -122,6 +137,7 @@ int main(int argc, char *argv[])
    char *debug_arg = NULL;
    char *read_range = NULL;
    int debug_mode_required=FALSE;
+   int seed_given=FALSE;
 #ifdef WITH_NLS_YES
    char *locale_test;
  #ifdef WITH_EMBEDDED_SRC_PATH_YES
@@ -207,9 +223,16 @@ int main(int argc, char *argv[])
         as some may be CPU-related. */
 
    Closure->useSSE2 = ProbeSSE2();
+   Closure->useAVX2 = ProbeAVX2();
+   Closure->useAVX512 = ProbeAVX512();
+   Closure->usePCLMUL = ProbePCLMUL();
    Closure->useAltiVec = ProbeAltiVec();
    Closure->clSize = ProbeCacheLineSize();
 
+   /*** Set up the CRC32 slicing tables */
+
+   InitCrc32();
+
    /*** Parse the options */
    
    for(;;)
@@ -217,7 +240,13 @@ int main(int argc, char *argv[])
       static struct option long_options[] =
       { {"adaptive-read", 0, 0, MODIFIER_ADAPTIVE_READ},
 	{"auto-suffix", 0, 0,  MODIFIER_AUTO_SUFFIX},
+	{"auto-tune", 0, 0,  MODIFIER_AUTO_TUNE},
 	{"assume", 1, 0, 'a'},
+	{"batch-device-jobs", 1, 0, MODIFIER_BATCH_DEVICE_JOBS },
+	{"batch-jobs", 1, 0, MODIFIER_BATCH_JOBS },
+	{"batch-summary", 1, 0, MODIFIER_BATCH_SUMMARY },
+	{"batch-verify", 1, 0, MODE_BATCH_VERIFY },
+	{"benchmark", 2, 0, MODE_BENCHMARK },
 	{"byteset", 1, 0, MODE_BYTESET },
 	{"copy-sector", 1, 0, MODE_COPY_SECTOR },
 	{"compare-images", 1, 0, MODE_CMP_IMAGES },
@@ -225,7 +254,9 @@ int main(int argc, char *argv[])
 	{"cav", 1, 0, MODIFIER_CAV_SPEED },
 	{"cdump", 0, 0, MODIFIER_CDUMP },
 	{"clv", 1, 0, MODIFIER_CLV_SPEED },
+	{"crc-cache", 1, 0, MODIFIER_CRC_CACHE },
 	{"create", 0, 0, 'c'},
+	{"damage-map", 1, 0, MODIFIER_DAMAGE_MAP },
 	{"dao", 0, 0, MODIFIER_DAO },
 	{"debug", 0, 0, MODIFIER_DEBUG },
 	{"debug1", 1, 0, MODE_DEBUG_MAINT1 },
@@ -243,6 +274,7 @@ int main(int argc, char *argv[])
 	{"fill-unreadable", 1, 0, MODIFIER_FILL_UNREADABLE },
 	{"fix", 0, 0, 'f'},
 	{"fixed-speed-values", 0, 0, MODIFIER_FIXED_SPEED_VALUES },
+	{"full-verify-days", 1, 0, MODIFIER_FULL_VERIFY_DAYS },
 	{"help", 0, 0, 'h'},
 	{"ignore-fatal-sense", 0, 0, MODIFIER_IGNORE_FATAL_SENSE },
 	{"ignore-iso-size", 0, 0, MODIFIER_IGNORE_ISO_SIZE },
@@ -250,6 +282,7 @@ int main(int argc, char *argv[])
 	{"internal-rereads", 1, 0, MODIFIER_INTERNAL_REREADS },
         {"image", 1, 0, 'i'},
 	{"jump", 1, 0, 'j'},
+	{"lec-time-limit", 1, 0, MODIFIER_LEC_TIME_LIMIT },
 	{"marked-image", 1, 0, MODE_MARKED_IMAGE },
 	{"medium-info", 0, 0, MODE_MEDIUM_INFO },
 	{"merge-images", 1, 0, MODE_MERGE_IMAGES },
@@ -257,6 +290,7 @@ int main(int argc, char *argv[])
 	{"no-bdr-defect-management", 0, 0, MODIFIER_NO_BDR_DEFECT_MANAGEMENT },
 	{"no-progress", 0, 0, MODIFIER_NO_PROGRESS },
 	{"old-ds-marker", 0, 0, MODIFIER_OLD_DS_MARKER },
+	{"paranoid", 0, 0, MODIFIER_PARANOID },
 	{"permissive-medium-type", 0, 0, MODIFIER_PERMISSIVE_MEDIUM_TYPE },
 	{"prefetch-sectors", 1, 0, MODIFIER_PREFETCH_SECTORS },
         {"prefix", 1, 0, 'p'},
@@ -266,6 +300,7 @@ int main(int argc, char *argv[])
 	{"raw-mode", 1, 0, MODIFIER_RAW_MODE },
 	{"raw-sector", 1, 0, MODE_RAW_SECTOR},
 	{"read", 2, 0,'r'},
+	{"read-ahead", 1, 0, MODIFIER_READ_AHEAD },
 	{"read-attempts", 1, 0, MODIFIER_READ_ATTEMPTS },
 	{"read-medium", 1, 0, MODIFIER_READ_MEDIUM },
 	{"read-sector", 1, 0, MODE_READ_SECTOR},
@@ -289,6 +324,7 @@ int main(int argc, char *argv[])
 	{"truncate", 2, 0, MODIFIER_TRUNCATE},
 	{"unlink", 0, 0, 'u'},
        	{"verbose", 0, 0, 'v'},
+	{"verify-state", 1, 0, MODIFIER_VERIFY_STATE },
 	{"version", 0, 0, MODIFIER_VERSION},
 	{"zero-unreadable", 0, 0, MODE_ZERO_UNREADABLE},
         {0, 0, 0, 0}
@@ -309,9 +345,29 @@ int main(int argc, char *argv[])
 		   break;	       
          case 'c': mode = MODE_SEQUENCE; sequence |= 1<<MODE_CREATE; break;
          case 'd': if(optarg) 
-		   {  if(Closure->device)
+		   {  char **devices = g_strsplit(optarg, ",", 0);
+		      int j;
+
+		      if(Closure->device)
 			 g_free(Closure->device);
-	              Closure->device = g_strdup(optarg); 
+	              Closure->device = g_strdup(devices[0]); 
+
+		      /* Further devices read the same medium in parallel */
+
+		      if(Closure->stripeDevices)
+		      {  for(j=0; j<Closure->stripeDevices->len; j++)
+			    g_free(g_ptr_array_index(Closure->stripeDevices, j));
+			 g_ptr_array_free(Closure->stripeDevices, TRUE);
+		      }
+		      Closure->stripeDevices = g_ptr_array_new();
+
+		      for(j=1; devices[0] && devices[j]; j++)
+			 if(*devices[j])
+			    g_ptr_array_add(Closure->stripeDevices, g_strdup(devices[j]));
+		      g_strfreev(devices);
+
+		      if(Closure->stripeDevices->len >= MAX_STRIPE_DRIVES)
+			 Stop(_("At most %d drives can read the same medium.\n"), MAX_STRIPE_DRIVES);
 	              break;
                    }
          case 'e': if(optarg) 
@@ -411,6 +467,24 @@ int main(int argc, char *argv[])
          case MODIFIER_AUTO_SUFFIX:
 	   Closure->autoSuffix = TRUE;
 	   break;
+         case MODIFIER_AUTO_TUNE:
+	   Closure->autoTune = TRUE;
+	   break;
+         case MODIFIER_BATCH_DEVICE_JOBS:
+	   Closure->batchDeviceJobs = atoi(optarg);
+	   if(Closure->batchDeviceJobs < 0)
+	     Stop(_("--batch-device-jobs must not be negative."));
+	   break;
+         case MODIFIER_BATCH_JOBS:
+	   Closure->batchJobs = atoi(optarg);
+	   if(Closure->batchJobs < 0)
+	     Stop(_("--batch-jobs must not be negative."));
+	   break;
+         case MODIFIER_BATCH_SUMMARY:
+	   if(Closure->batchSummaryFile)
+	     g_free(Closure->batchSummaryFile);
+	   Closure->batchSummaryFile = g_strdup(optarg);
+	   break;
          case MODIFIER_CACHE_SIZE:
 	   Closure->cacheMiB = atoi(optarg);
 	   if(Closure->cacheMiB <   8) 
@@ -422,6 +496,16 @@ int main(int argc, char *argv[])
 	   Closure->debugCDump = TRUE;
 	   debug_mode_required = TRUE;
 	   break;
+         case MODIFIER_CRC_CACHE:
+	   if(Closure->crcCacheFile)
+	     g_free(Closure->crcCacheFile);
+	   Closure->crcCacheFile = g_strdup(optarg);
+	   break;
+         case MODIFIER_DAMAGE_MAP:
+	   if(Closure->damageMapFile)
+	     g_free(Closure->damageMapFile);
+	   Closure->damageMapFile = g_strdup(optarg);
+	   break;
          case MODIFIER_DAO: 
 	   Closure->noTruncate = 1; 
 	   break;
@@ -441,10 +525,32 @@ int main(int argc, char *argv[])
 	     if(!Closure->useSSE2)
 	       Stop(_("--encoding-algorithm: SSE2 not supported on this processor!"));
 	   }
+#ifdef HAVE_AVX2
+	   if(!strcmp(optarg, "AVX2"))
+	   {  Closure->encodingAlgorithm = ENCODING_ALG_AVX2;
+
+	     if(!Closure->useAVX2)
+	       Stop(_("--encoding-algorithm: AVX2 not supported on this processor!"));
+	   }
+#endif
+#ifdef HAVE_AVX512
+	   if(!strcmp(optarg, "AVX512"))
+	   {  Closure->encodingAlgorithm = ENCODING_ALG_AVX512;
+
+	     if(!Closure->useAVX512)
+	       Stop(_("--encoding-algorithm: AVX-512BW not supported on this processor!"));
+	   }
+#endif
 
 	   if(Closure->encodingAlgorithm == ENCODING_ALG_INVALID)
+#if defined(HAVE_AVX2) && defined(HAVE_AVX512)
+	     Stop(_("--encoding-algorithm: valid types are 32bit, 64bit, SSE2, AVX2, AVX512"));
+#elif defined(HAVE_AVX2)
+	     Stop(_("--encoding-algorithm: valid types are 32bit, 64bit, SSE2, AVX2"));
+#else
 	     Stop(_("--encoding-algorithm: valid types are 32bit, 64bit, SSE2"));
 #endif
+#endif
 #ifdef HAVE_ALTIVEC
 	   if(!strcmp(optarg, "AltiVec"))
 	   {  Closure->encodingAlgorithm = ENCODING_ALG_ALTIVEC;
@@ -467,10 +573,16 @@ int main(int argc, char *argv[])
 	   {  Closure->encodingIOStrategy = IO_STRATEGY_MMAP;
 #ifndef HAVE_MMAP
 	      Stop(_("--encoding-io-strategy: mmap not supported on this OS"));
+#endif
+	   }
+	   else if(!strcmp(optarg, "direct"))
+	   {  Closure->encodingIOStrategy = IO_STRATEGY_DIRECT;
+#if !defined(HAVE_O_DIRECT) || defined(SYS_MINGW)
+	      Stop(_("--encoding-io-strategy: direct not supported on this OS"));
 #endif
 	   }
 	   else
-	      Stop(_("--encoding-io-strategy: valid types are readwrite and mmap"));
+	      Stop(_("--encoding-io-strategy: valid types are readwrite, mmap and direct"));
 	   break;
 	 case MODIFIER_DRIVER:
 #if defined(SYS_LINUX)
@@ -500,6 +612,11 @@ int main(int argc, char *argv[])
 	    Closure->fixedSpeedValues=TRUE;
  	    debug_mode_required = TRUE;
 	    break;
+         case MODIFIER_FULL_VERIFY_DAYS:
+	   Closure->fullVerifyDays = atoi(optarg);
+	   if(Closure->fullVerifyDays < 0)
+	     Stop(_("--full-verify-days must be 0 or more."));
+	   break;
          case MODIFIER_IGNORE_FATAL_SENSE:
 	   Closure->ignoreFatalSense = TRUE;
 	   break;
@@ -518,6 +635,11 @@ int main(int argc, char *argv[])
 	    if(Closure->internalAttempts > 10) 
 	       Closure->internalAttempts = 10;
 	    break;
+         case MODIFIER_LEC_TIME_LIMIT:
+	   Closure->lecTimeLimit = atoi(optarg);
+	   if(Closure->lecTimeLimit < 0)
+	     Stop(_("--lec-time-limit must be 0 or more."));
+	   break;
          case MODIFIER_DEBUG:
 	   Closure->debugMode = TRUE;
 	   break;
@@ -543,6 +665,9 @@ int main(int argc, char *argv[])
 	 case MODIFIER_OLD_DS_MARKER:
 	    Closure->dsmVersion = 0;
 	    break;
+	 case MODIFIER_PARANOID:
+	    Closure->paranoidFix = TRUE;
+	    break;
 	 case MODIFIER_PERMISSIVE_MEDIUM_TYPE:
 	    Closure->permissiveMediumType = TRUE;
 	    debug_mode_required = TRUE;
@@ -556,11 +681,16 @@ int main(int argc, char *argv[])
 	    break;
          case MODIFIER_RANDOM_SEED:
 	   if(optarg) Closure->randomSeed = atoi(optarg);
-	   debug_mode_required = TRUE;
+	   seed_given = TRUE;
 	   break;
          case MODIFIER_RAW_MODE:
 	    if(optarg) Closure->rawMode = strtol(optarg,NULL,16);
 	   break;
+         case MODIFIER_READ_AHEAD:
+	   Closure->readAhead = atoi(optarg);
+	   if(Closure->readAhead < 0 || Closure->readAhead > MAX_READ_AHEAD)
+	     Stop(_("--read-ahead must be in the range 0...%d."), MAX_READ_AHEAD);
+	   break;
          case MODIFIER_READ_ATTEMPTS:
 	   if(optarg) 
 	   {  char copy[strlen(optarg)+1];
@@ -614,7 +744,15 @@ int main(int argc, char *argv[])
 	 } 
 	    break;
         case MODIFIER_SIMULATE_CD:
-	   if(optarg) Closure->simulateCD = g_strdup(optarg);
+	   if(optarg)
+	   {  if(!Closure->simulateCD)
+		 Closure->simulateCD = g_strdup(optarg);
+	      else /* further images become sim-cd2, sim-cd3, ... */
+	      {  if(!Closure->simulateCDs)
+		    Closure->simulateCDs = g_ptr_array_new();
+		 g_ptr_array_add(Closure->simulateCDs, g_strdup(optarg));
+	      }
+	   }
 	   debug_mode_required = TRUE;
 	   break;
         case MODIFIER_SIMULATE_DEFECTS:
@@ -643,11 +781,24 @@ int main(int argc, char *argv[])
          case MODIFIER_CAV_SPEED:
 	   Closure->driveSpeed = -atoi(optarg);
 	   break;
+         case MODIFIER_VERIFY_STATE:
+	   if(Closure->verifyStateFile)
+	     g_free(Closure->verifyStateFile);
+	   Closure->verifyStateFile = g_strdup(optarg);
+	   break;
          case MODIFIER_VERSION:
 	    PrintCLI("\n%s\n\n", Closure->versionString);
 	    FreeClosure();
 	    exit(EXIT_SUCCESS); 
 	    break;
+         case MODE_BATCH_VERIFY:
+	   mode = MODE_BATCH_VERIFY;
+	   debug_arg = g_strdup(optarg);
+	   break;
+         case MODE_BENCHMARK:
+	   mode = MODE_BENCHMARK;
+	   debug_arg = g_strdup(optarg);
+	   break;
          case MODE_BYTESET:
 	   mode = MODE_BYTESET;
 	   debug_arg = g_strdup(optarg);
@@ -716,8 +867,12 @@ int main(int argc, char *argv[])
       }
    }
 
-   /*** Don't allow debugging option if --debug wasn't given */
+   /*** Don't allow debugging option if --debug wasn't given.
+	Benchmarks may choose their random seed without it. */
    
+   if(seed_given && mode != MODE_BENCHMARK)
+      debug_mode_required = TRUE;
+
    if(!Closure->debugMode)
    { if(debug_mode_required)
 	 mode=MODE_HELP;
@@ -769,6 +924,11 @@ int main(int argc, char *argv[])
       Closure->imageName = ApplyAutoSuffix(Closure->imageName, "iso");
    }
 
+   /*** Start --auto-tune from what has been learned about this host */
+
+   if(Closure->autoTune)
+      ReadTuneProfile();
+
    /*** Determine the default device (OS dependent!) if 
 	- none has been specified on the command line
         - and one if actually required in command line mode.
@@ -840,22 +1000,16 @@ int main(int argc, char *argv[])
 	}
 
 	if(sequence & 1<<MODE_VERIFY)
-	{  Method *method;
-	   Image *image;
-
-	   image = OpenImageFromFile(Closure->imageName, O_RDONLY, IMG_PERMS);
-	   image = OpenEccFileForImage(image, Closure->eccName, O_RDONLY, IMG_PERMS);
+	   VerifyImageFiles();
+	break;
 
-	   /* Determine method. Ecc files win over augmented ecc. */
+      case MODE_BATCH_VERIFY:
+	 BatchVerify(debug_arg);
+	 break;
 
-	   if(image && image->eccFileMethod) method = image->eccFileMethod;
-	   else if(image && image->eccMethod) method = image->eccMethod;
-	   else if(!(method = FindMethod("RS01")))
-	           Stop(_("RS01 method not available for comparing files."));
-	     
-	   method->verify(image);
-	}
-	break;
+      case MODE_BENCHMARK:
+         Benchmark(debug_arg);
+	 break;
 
       case MODE_BYTESET:
          Byteset(debug_arg);
@@ -939,6 +1093,10 @@ int main(int argc, char *argv[])
 
    if(debug_arg) g_free(debug_arg);
 
+   /*** Remember the outcome of --auto-tune for the next run */
+
+   SaveTuneProfile();
+
    /*** If no mode was selected, print the help screen. */
 
 #ifdef WITH_GUI_YES
@@ -961,6 +1119,7 @@ int main(int argc, char *argv[])
 
       PrintCLI(_("Drive and file specification:\n"
 	     "  -d, --device device         - read from given device   (default: %s)\n"
+	     "               dev1,dev2,...  - read one medium with several drives in parallel\n"
 	     "  -p, --prefix prefix         - prefix of .iso/.ecc file (default: medium.*  )\n"
 	     "  -i, --image imagefile       - name of image file       (default: medium.iso)\n"
 	     "  -e, --ecc eccfile           - name of parity file      (default: medium.ecc)\n"
@@ -979,25 +1138,37 @@ int main(int argc, char *argv[])
       PrintCLI(_("  -x, --threads n            - use n threads for en-/decoding (if supported by codec)\n"));
       PrintCLI(_("  --adaptive-read            - use optimized strategy for reading damaged media\n"));
       PrintCLI(_("  --auto-suffix              - automatically add .iso and .ecc file suffixes\n"));
+      PrintCLI(_("  --auto-tune                - adapt RS03 threads and cache sizes at runtime\n"));
+      PrintCLI(_("  --batch-device-jobs n      - with --batch-verify: at most n images per device (default: 1)\n"));
+      PrintCLI(_("  --batch-jobs n             - with --batch-verify: verify n images at once\n"));
+      PrintCLI(_("  --batch-summary file       - with --batch-verify: write results as table to file\n"));
+      PrintCLI(_("  --batch-verify manifest    - verify all image/ecc pairs listed in manifest\n"));
+      PrintCLI(_("  --benchmark[=tests]        - measure codec and I/O throughput (see man page)\n"));
       PrintCLI(_("  --cache-size n             - image cache size in MiB during -c mode (default: 32MiB)\n"));
+      PrintCLI(_("  --crc-cache file           - keep checksums of image read (-r) for later use (-c, -t)\n"));
+      PrintCLI(_("  --damage-map file          - record damaged sectors (-r,-s,-t) / repair only those (-f)\n"));
       PrintCLI(_("  --dao                      - assume DAO disc; do not trim image end\n"));
       PrintCLI(_("  --defective-dump d         - directory for saving incomplete raw sectors\n"));
 #ifdef SYS_LINUX
       PrintCLI(_("  --driver=sg/cdrom          - use sg(default) or alternative cdrom driver (see man page!)\n"));
 #endif
       PrintCLI(_("  --eject                    - eject medium after successful read\n"));
-      PrintCLI(_("  --encoding-algorithm x     - possible values: 32bit, 64bit, SSE2, AltiVec\n"));
-      PrintCLI(_("  --encoding-io-strategy x   - possible values: readwrite, mmap\n"));
+      PrintCLI(_("  --encoding-algorithm x     - possible values: 32bit, 64bit, SSE2, AVX2, AVX512, AltiVec\n"));
+      PrintCLI(_("  --encoding-io-strategy x   - possible values: readwrite, mmap, direct\n"));
       PrintCLI(_("  --fill-unreadable n        - fill unreadable sectors with byte n\n"));
+      PrintCLI(_("  --full-verify-days n       - with --verify-state: verify everything after n days (default: 30)\n"));
       PrintCLI(_("  --ignore-fatal-sense       - continue reading after potentially fatal error conditon\n"));
       PrintCLI(_("  --ignore-iso-size          - ignore image size from ISO/UDF data (dangerous - see man page!)\n"));
       PrintCLI(_("  --internal-rereads n       - drive may attempt n rereads before reporting an error\n"));
+      PrintCLI(_("  --lec-time-limit n         - spend at most n seconds per sector on raw L-EC heuristics\n"));
       PrintCLI(_("  --medium-info              - print info about medium in drive\n"));
       PrintCLI(_("  --no-bdr-defect-management - use bigger RS03 images for BD-R (see man page!)\n"));
       PrintCLI(_("  --no-progress              - do not print progress information\n"));
       PrintCLI(_("  --old-ds-marker            - mark missing sectors compatible with dvdisaster <= 0.70\n"));
+      PrintCLI(_("  --paranoid                 - check all ecc blocks in -f mode, even those with good CRCs\n"));
       PrintCLI(_("  --prefetch-sectors n       - prefetch n sectors for RS03 encoding (uses ~nMiB)\n"));
       PrintCLI(_("  --raw-mode n               - mode for raw reading CD media (20 or 21)\n"));
+      PrintCLI(_("  --read-ahead n             - keep n read commands queued at the drive while reading\n"));
       PrintCLI(_("  --read-attempts n-m        - attempts n up to m reads of a defective sector\n"));
       PrintCLI(_("  --read-medium n            - read the whole medium up to n times\n"));
       PrintCLI(_("  --read-raw                 - performs read in raw mode if possible\n"));
@@ -1005,6 +1176,7 @@ int main(int argc, char *argv[])
       PrintCLI(_("  --resource-file p          - get resource file from given path\n"));
       PrintCLI(_("  --speed-warning n          - print warning if speed changes by more than n percent\n"));
       PrintCLI(_("  --spinup-delay n           - wait n seconds for drive to spin up\n"));
+      PrintCLI(_("  --verify-state file        - only re-check RS03 ecc blocks changed since last -t\n"));
       PrintCLI(_("  --version                  - print version and some configuration info\n"));
       PrintCLI(_("  --debug                    - allow advanced dangerous options (use with --help for a list)\n"));
 
@@ -1037,7 +1209,8 @@ int main(int argc, char *argv[])
 	PrintCLI(_("  --set-version            - set program version for debugging purposes (dangerous!)\n"));
 	PrintCLI(_("  --show-header n          - assumes given sector is a ecc header and prints it\n"));
 	PrintCLI(_("  --show-sector n          - shows hexdump of the given sector in an image file\n"));
-	PrintCLI(_("  --sim-cd image           - simulate a SCSI-Level CD with contents supplied by the ISO image\n"));
+	PrintCLI(_("  --sim-cd image           - simulate a SCSI-Level CD with contents supplied by the ISO image;\n"
+		   "                             given again, further drives appear as sim-cd2, sim-cd3, ...\n"));
 	PrintCLI(_("  --sim-defects n          - simulate n%% defective sectors on medium\n"));
 	PrintCLI(_("  --truncate n             - truncates image to n sectors\n")); 
 	PrintCLI(_("  --zero-unreadable        - replace the \"unreadable sector\" markers with zeros\n\n"));
@@ -203,6 +203,7 @@ typedef void PangoLayout;
 
 #define IO_STRATEGY_READWRITE 0
 #define IO_STRATEGY_MMAP 1
+#define IO_STRATEGY_DIRECT 2
 
 /* SCSI driver selection on Linux */
 
@@ -232,8 +233,13 @@ typedef struct _GlobalClosure
    char *device;        /* currently selected device to read from */
    GPtrArray *deviceNames;  /* List of drive names */
    GPtrArray *deviceNodes;  /* List of device nodes (C: or /dev/foo) */
+   GPtrArray *stripeDevices; /* further devices reading the same medium in parallel */
    char *imageName;     /* complete path of current image file */
    char *eccName;       /* complete path of current ecc file */
+   char *damageMapFile; /* damage map written by read/scan/verify, used by fix */
+   char *crcCacheFile;  /* CRC and md5 sums written by read, used by create and verify */
+   char *verifyStateFile; /* state of the last verify, see verify-state.c */
+   char *batchSummaryFile; /* per image results of --batch-verify */
    GPtrArray *methodList; /* List of available methods */
    char *methodName;    /* Name of currently selected codec */
    gint64 readStart;    /* Range to read */
@@ -255,9 +261,19 @@ typedef struct _GlobalClosure
    gint64 mediumSize;   /* Maximum medium size (for augmented images) */
    int cacheMiB;        /* Cache setting for the parity codec, in megabytes */
    int prefetchSectors; /* Prefetch setting per encoder thread */
+   int fullVerifyDays;  /* Incremental verify does a full verify after this many days */
+   int batchJobs;       /* concurrent --batch-verify workers; 0 = one per processor */
+   int batchDeviceJobs; /* ... of which may read from the same device; 0 = no limit */
    int codecThreads;    /* Number of threads to use for RS encoders */
    int encodingAlgorithm; /* Force a certain codec type for RS03 */
    int encodingIOStrategy; /* Force a IO strategy for RS03 encoding */
+   int autoTune;        /* Adapt threads and chunk sizes at runtime */
+   int paranoidFix;     /* Decode ecc blocks even if all CRCs are good */
+   int tunedThreads;    /* Host profile found by the auto-tuner; */
+   int tunedPrefetch;   /* 0 means not determined yet */
+   int tunedCacheMiB;
+   int tunedEncoding;
+   int tunedChanged;    /* profile needs to be saved */
    int sectorSkip;      /* Number of sectors to skip after read error occurs */
    char *redundancy;    /* Error correction code redundancy */
    int eccTarget;       /* 0=file; 1=augmented image */
@@ -265,6 +281,8 @@ typedef struct _GlobalClosure
    int rawMode;         /* mode for mode page */
    int minReadAttempts; /* minimum reading attempts */
    int maxReadAttempts; /* maximal reading attempts */
+   int lecTimeLimit;    /* seconds per sector for the raw sector heuristics; 0 = no limit */
+   int readAhead;       /* read commands queued at the drive by the linear reader; 0 = off */
    int internalAttempts;/* read attempts by the drive itself */
    int adaptiveRead;    /* Use optimized strategy for reading defective images */
    int speedWarning;    /* Print warning if speed changes by more than given percentage */
@@ -293,6 +311,7 @@ typedef struct _GlobalClosure
    int dotFileVersion;  /* version of dotfile */
    int simulateDefects; /* if >0, this is the percentage of simulated media defects */
    char *simulateCD;    /* Simulate CD from given image */
+   GPtrArray *simulateCDs; /* further images for sim-cd2, sim-cd3, ... */
    int defectiveDump;   /* dump non-recoverable sectors into given path */
    char *dDumpDir;      /* directory for above */
    char *dDumpPrefix;   /* file name prefix for above */
@@ -303,6 +322,9 @@ typedef struct _GlobalClosure
    int pauseEject;      /* Eject medium during pause */
    int ignoreFatalSense;/* Continue reading after potential fatal sense errors */
    int useSSE2;         /* TRUE means to use SSE2 version of the codec. */
+   int useAVX2;         /* TRUE means to use AVX2 version of the codec. */
+   int useAVX512;       /* TRUE means to use AVX-512BW version of the codec. */
+   int usePCLMUL;       /* TRUE means to use carry-less multiplication for CRC32. */
    int useAltiVec;      /* TRUE means to use AltiVec version of the codec. */
    int clSize;          /* Bytesize of cache line */
    int useSCSIDriver;   /* Whether to use generic or sg driver on Linux */
@@ -434,6 +456,16 @@ typedef struct _GlobalClosure
 extern GlobalClosure *Closure;  /* these should be the only global variables! */
 extern int exitCode;            /* value to use on exit() */
 
+/* Exit codes reporting the outcome of verify (-t) */
+
+#define EXIT_CODE_SIZE_MISMATCH 1
+#define EXIT_CODE_VERSION_MISMATCH 2
+
+#define EXIT_CODE_UNEXPECTED_EOF 10
+#define EXIT_CODE_MISSING_SECTOR 11
+#define EXIT_CODE_CHECKSUM_ERROR 12
+#define EXIT_CODE_SYNDROME_ERROR 13
+
 #ifdef WITH_GUI_YES
    extern GdkRGBA transparent;
 #endif  /* WITH_GUI_YES */
@@ -450,8 +482,29 @@ typedef struct _LargeFile
    char *path;
    guint64 size;
    int flags;
+   struct _LargeRing *ring;  /* io_uring for vectored I/O, created on demand */
+   int directHandle;         /* O_DIRECT handle for vectored I/O, or 0 */
+   int directIO;             /* use above handle for aligned requests */
 } LargeFile;
 
+/* One request for LargeReadV() / LargeWriteV() */
+
+typedef struct _LargeIOVec
+{  guint64 offset;           /* byte position in the file */
+   void *buf;
+   size_t count;             /* number of bytes to transfer */
+   ssize_t result;           /* bytes actually transferred or -1 */
+} LargeIOVec;
+
+/* Physical location of a part of the file, see LargeExtents() */
+
+typedef struct _LargeExtent
+{  guint64 logical;          /* byte position in the file */
+   guint64 physical;         /* byte position on the device */
+   guint64 length;
+   guint32 flags;
+} LargeExtent;
+
 /***
  *** Aligned 64bit data types
  ***
@@ -531,9 +584,52 @@ typedef struct _CrcBlock
 
 extern struct _RawBuffer *rawbuffer_forward;
 extern struct _DefectiveSectorHeader *dsh_forward;
+extern struct _DefectiveStoreHeader *dss_forward;
+extern struct _DefectiveStoreRecord *dsr_forward;
 extern struct _DeviceHandle *dh_forward;
 extern struct _Image *dh_image;
 
+/***
+ *** autotune.c
+ ***/
+
+typedef struct _AutoTune
+{  GTimer *timer;
+   int activeThreads;      /* codec threads allowed to take work */
+   int maxThreads;         /* codec threads which have been spawned */
+   int chunk;              /* current chunk size, unit chosen by the caller */
+   int minChunk, maxChunk;
+   int threadsSettled;     /* parameters which are no longer changed */
+   int chunkSettled;
+   int move;               /* change currently being evaluated */
+   int undo;               /* value before that change */
+   double lastRate;        /* bytes per second in the previous sample */
+   double bytes;           /* bytes processed in the current sample */
+   int cpuBound, ioBound;  /* chunk counts in the current sample */
+   int samples;
+} AutoTune;
+
+AutoTune* CreateAutoTune(int, int, int);
+void FreeAutoTune(AutoTune*);
+int AutoTuneChunk(AutoTune*, int, double);
+void AutoTuneRemember(AutoTune*, int*, int);
+int AutoTuneEncoder(int);
+void ReadTuneProfile(void);
+void SaveTuneProfile(void);
+
+/***
+ *** batch-verify.c
+ ***/
+
+void VerifyImageFiles(void);
+void BatchVerify(char*);
+
+/***
+ *** benchmark.c
+ ***/
+
+void Benchmark(char*);
+
 /***
  *** bitmap.c
  ***/
@@ -562,6 +658,7 @@ extern const char *const buildCount;
  ***/
 
 int ProbeCacheLineSize();
+guint64 ProbeAvailableMemory();
 
 /***
  *** closure.c
@@ -583,8 +680,11 @@ void GuiUpdateMarkup(char**, GdkRGBA*);
  *** crc32.c
  ***/
 
+void InitCrc32(void);
 guint32 Crc32(unsigned char*, int);
+void Crc32Sectors(unsigned char*, int, guint32*);
 guint32 EDCCrc32(unsigned char*, int);
+int ProbePCLMUL(void);
 
 /***
  *** crcbuf.c
@@ -645,11 +745,36 @@ CrcBuf *CreateCrcBuf(struct _Image*);
 void FreeCrcBuf(CrcBuf*);
 
 int CheckAgainstCrcBuffer(CrcBuf*, gint64, unsigned char*);
+int CheckCrcAgainstCrcBuffer(CrcBuf*, gint64, guint32);
 int AddSectorToCrcBuffer(CrcBuf*, int, guint64, unsigned char*, int);
 int CrcBufValid(CrcBuf*, struct _Image*, int);
 
+void SaveCrcBuf(CrcBuf*, char*, char*);
+CrcBuf *LoadCrcBuf(struct _Image*, char*);
+
 void PrintCrcBuf(CrcBuf*);
 
+/***
+ *** damage-map.c
+ ***/
+
+typedef struct _DamageMap
+{  Bitmap *damaged;             /* set bits mark damaged sectors */
+   gint64 sectors;              /* number of sectors covered by the map */
+   guint8 mediumFP[16];         /* fingerprint of image */
+   gint32 fpSector;             /* sector which was fingerprinted */
+   gint32 fpValid;
+   GMutex *lock;                /* updated from reader and worker threads */
+} DamageMap;
+
+DamageMap *CreateDamageMap(struct _Image*, gint64);
+void FreeDamageMap(DamageMap*);
+void MarkDamagedSectors(DamageMap*, gint64, gint64);
+void ClearDamagedSectors(DamageMap*, gint64, gint64);
+int SectorIsDamaged(DamageMap*, gint64);
+void SaveDamageMap(DamageMap*, char*);
+DamageMap *LoadDamageMap(struct _Image*, char*);
+
 /***
  *** curve.c
  ***/
@@ -755,6 +880,8 @@ guint32 SwapBytes32(guint32);
 guint64 SwapBytes64(guint64);
 void    SwapEccHeaderBytes(EccHeader*);
 void    SwapDefectiveHeaderBytes(struct _DefectiveSectorHeader*);
+void    SwapDefectiveStoreHeaderBytes(struct _DefectiveStoreHeader*);
+void    SwapDefectiveStoreRecordBytes(struct _DefectiveStoreRecord*);
 void    SwapCrcBlockBytes(CrcBlock*);
 void    PrintEccHeader(EccHeader*);
 
@@ -812,6 +939,7 @@ typedef struct _ReedSolomonTables
 
    guint8 *bLut[GF_FIELDSIZE];   /* 8bit encoder lookup table */
    guint8 *synLut;       /* Syndrome calculation speedup */
+   guint8 *synNibbleLut; /* split-nibble syndrome tables for the SIMD decoders */
 } ReedSolomonTables;
 
 GaloisTables* CreateGaloisTables(gint32);
@@ -952,9 +1080,15 @@ int LargeSeek(LargeFile*, off_t);
 int LargeEOF(LargeFile*);
 ssize_t LargeRead(LargeFile*, void*, size_t);
 ssize_t LargeWrite(LargeFile*, void*, size_t);
+int LargeReadV(LargeFile*, LargeIOVec*, int);
+int LargeWriteV(LargeFile*, LargeIOVec*, int);
+int LargeEnableDirectIO(LargeFile*);
 int LargeClose(LargeFile*);
 int LargeTruncate(LargeFile*, off_t);
+int LargeExtents(LargeFile*, LargeExtent**);
+int LargeCopyOnWrite(LargeFile*);
 int LargeStat(char*, guint64*);
+int LargeStatMTime(char*, guint64*, gint64*);
 int LargeUnlink(char*);
 
 int DirStat(char*);
@@ -995,6 +1129,7 @@ void AndQVector(unsigned char*, unsigned char, int);
 void OrQVector(unsigned char*, unsigned char, int);
 
 int DecodePQ(ReedSolomonTables*, unsigned char*, int, int*, int);
+void CheckPQVectors(ReedSolomonTables*, unsigned char*, int*, int*);
 
 int CountC2Errors(unsigned char*);
 
@@ -1286,9 +1421,36 @@ enum                                 /* for ->properties above */
    DSH_XA_MODE         = (1<<1)
 };
 
+/* All defective sectors of a medium are kept in one append-only store,
+   consisting of the header below followed by records made from
+   a DefectiveStoreRecord and sectorSize bytes of the raw sector. */
+
+#define DEFECTIVE_STORE_COOKIE "*dvdisaster-dss*"
+#define DEFECTIVE_STORE_FORMAT 1
+
+typedef struct _DefectiveStoreHeader
+{  gint8 cookie[16];                  /* DEFECTIVE_STORE_COOKIE */
+   unsigned char mediumFP[16];       /* Medium fingerprint */
+   gint32 sectorSize;                /* Sector size in bytes */
+   gint32 properties;                /* DSH_HAS_FINGERPRINT */
+   gint32 dssFormat;                 /* Format of this file */
+   gint32 reserved;
+} DefectiveStoreHeader;
+
+typedef struct _DefectiveStoreRecord
+{  gint64 lba;                       /* LBA of the following sector */
+   gint32 properties;                /* DSH_XA_MODE */
+   gint32 reserved;
+   unsigned char md5sum[16];         /* over lba and sector, for finding duplicates */
+} DefectiveStoreRecord;
+
 int SaveDefectiveSector(struct _RawBuffer*, int);
 int TryDefectiveSectorCache(struct _RawBuffer*, unsigned char*);
 void ReadDefectiveSectorFile(DefectiveSectorHeader *, struct _RawBuffer*, char*);
+int IsDefectiveSectorStore(char*);
+gint64* ListDefectiveStoreSectors(char*, int*);
+void ReadDefectiveSectorStore(DefectiveSectorHeader *, struct _RawBuffer*, char*, gint64);
+void CloseDefectiveSectorStore(void);
 
 /*** 
  *** read-linear.c
@@ -1406,6 +1568,7 @@ typedef struct _RawBuffer
    int bestFrame;                      /* Frame with lowest failures */
    int bestP1, bestP2, bestQ1, bestQ2;
 
+   gint64 searchDeadline;   /* monotonic time for giving up the heuristics; 0 = never */
 } RawBuffer;
 
 enum                          /* values for byteState */
@@ -1434,6 +1597,9 @@ int ValidateRawSector(RawBuffer*, unsigned char*, char*);
 int IterativeLEC(RawBuffer*);
 int TryCDFrameRecovery(RawBuffer*, unsigned char*);
 
+int LECTimeExceeded(RawBuffer*);
+void RunLECSearchTasks(GFunc, gpointer*, int);
+
 /*** 
  *** scsi-layer.c
  ***
@@ -1446,12 +1612,21 @@ int TryCDFrameRecovery(RawBuffer*, unsigned char*);
 #define MAX_CLUSTER_SIZE (32*2048)
 #define MAX_CLUSTER_SECTORS 32
 
+/* Maximum number of read commands queued at the drive */
+
+#define MAX_READ_AHEAD 32
+
+/* Maximum number of drives reading one medium in parallel */
+
+#define MAX_STRIPE_DRIVES 8
+
 typedef struct _AlignedBuffer
 {  unsigned char *base;
    unsigned char *buf;
 } AlignedBuffer;
 
 AlignedBuffer *CreateAlignedBuffer(int);
+AlignedBuffer *TryCreateAlignedBuffer(size_t);
 void FreeAlignedBuffer(AlignedBuffer*);
 
 char* DefaultDevice(void);
@@ -1465,12 +1640,51 @@ int SendReadCDB(char*, unsigned char*, unsigned char*, int, int);
  ***/
 
 void InitSimulatedCD(void);
+char* SimulatedCDImage(char*);
 
 /***
  *** rs-decoder.c
  ***/
 
+/* Number of byte columns processed by one ComputeSyndromeColumns() call */
+
+#define SYNDROME_COLUMNS 32
+
 int TestErrorSyndromes(ReedSolomonTables*, unsigned char*);
+guint32 ComputeSyndromeColumns(ReedSolomonTables*, unsigned char**, int, int, guint8*);
+int CountErrorSyndromes(ReedSolomonTables*, unsigned char**, int, int);
+
+/* Errors and erasures decoder shared by the RS01, RS02 and RS03 codecs */
+
+typedef struct _RSDecoder
+{  ReedSolomonTables *rt;
+   int rootOf[GF_FIELDMAX];       /* Chien search root of each codeword position */
+   int positionOf[GF_FIELDSIZE];  /* and vice versa */
+   int erasureCount;
+   int isErasure[GF_FIELDMAX];
+   int gamma[GF_FIELDSIZE];       /* erasure locator polynomial, index form */
+   int erasureOrder[GF_FIELDMAX]; /* erasure positions by descending root */
+   int erasureScale[GF_FIELDMAX]; /* num2/den from Forney's formula, index form */
+   int degLambda, rootCount;      /* diagnostics for uncorrectable codewords */
+
+   /* for decoding all 2048 columns of an ecc block at once */
+
+   guint8 *blockSyn;              /* nroots rows of 2048 syndromes */
+   guint8 *blockError;            /* error values, one row per erasure */
+   guint8 *erasureMatrix;         /* maps syndromes to erasure error values */
+   guint8 *scratch;
+   int matrixValid;
+   int useSSE2, useAVX2;
+   guint32 nonzero[2048/SYNDROME_COLUMNS];  /* columns with nonzero syndromes */
+   guint32 fallback[2048/SYNDROME_COLUMNS]; /* columns to be decoded one by one */
+} RSDecoder;
+
+RSDecoder* CreateRSDecoder(ReedSolomonTables*);
+void FreeRSDecoder(RSDecoder*);
+void SetRSDecoderErasures(RSDecoder*, int*, int);
+int RSDecodeColumn(RSDecoder*, guint8*, int, int*, int*);
+void RSDecodeBlock(RSDecoder*, unsigned char**, int);
+int RSDecodeBlockColumn(RSDecoder*, int, int*, int*);
 
 /***
  *** rs-encoder.c and friends
@@ -1482,12 +1696,16 @@ typedef enum
    ENCODING_ALG_32BIT,
    ENCODING_ALG_64BIT,
    ENCODING_ALG_SSE2,   
-   ENCODING_ALG_ALTIVEC
+   ENCODING_ALG_ALTIVEC,
+   ENCODING_ALG_AVX2,
+   ENCODING_ALG_AVX512
 } CODEC_TYPE;
 
 void EncodeNextLayer(ReedSolomonTables*, unsigned char*, unsigned char*, guint64, int);
 void DescribeRSEncoder(char**, char**);
 int ProbeSSE2(void);
+int ProbeAVX2(void);
+int ProbeAVX512(void);
 int ProbeAltiVec(void);
 
 /***
@@ -1545,6 +1763,41 @@ void GuiSetSpiralSegmentColor(Spiral*, GdkRGBA*, GdkRGBA*, int);
 #define GuiFreeSpiral(s)
 #endif
 
+/***
+ *** verify-state.c
+ ***/
+
+/* Returns the location of a stripe of sectors belonging to a group of
+   ecc blocks; file is 0 for the image and 1 for the ecc file. */
+
+typedef void (*VerifyStripeFunc)(gpointer, gint64, int, int*, guint64*, guint64*);
+
+typedef struct _VerifyState
+{  char *path;
+   gint64 groups;               /* number of ecc block groups */
+   gint64 groupBlocks;          /* ecc blocks per group */
+   int stripes;                 /* stripes per group */
+   Bitmap *clean;               /* groups without defects */
+   Bitmap *check;               /* groups which must be verified in this run */
+   guint8 *extentDigest;        /* md5sum of physical extents, per group */
+   int extentsKnown;
+   guint8 layoutId[16];
+   guint8 mediumFP[16];
+   guint64 imageBytes, eccBytes;
+   gint64 imageMTime, eccMTime;
+   gint64 lastFullVerify;
+   gint64 now;
+   int fullVerify;              /* all groups are verified */
+   char *reason;                /* why a full verify is done */
+   gint64 unchanged;            /* groups skipped in this run */
+} VerifyState;
+
+VerifyState *CreateVerifyState(Image*, char*, gint64, gint64, int, VerifyStripeFunc, gpointer, guint8*);
+#define VerifyGroup(vs,g) GetBit((vs)->check,g)
+void MarkGroupDefective(VerifyState*, gint64);
+void SaveVerifyState(VerifyState*);
+void FreeVerifyState(VerifyState*);
+
 /***
  *** welcome-window.c
  ***/
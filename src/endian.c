@@ -181,3 +181,16 @@ void SwapDefectiveHeaderBytes(DefectiveSectorHeader *dsh)
   dsh->dshFormat  = SwapBytes32(dsh->dshFormat);
   dsh->nSectors   = SwapBytes32(dsh->nSectors);
 }
+
+void SwapDefectiveStoreHeaderBytes(DefectiveStoreHeader *dss)
+{  
+  dss->sectorSize = SwapBytes32(dss->sectorSize);
+  dss->properties = SwapBytes32(dss->properties);
+  dss->dssFormat  = SwapBytes32(dss->dssFormat);
+}
+
+void SwapDefectiveStoreRecordBytes(DefectiveStoreRecord *dsr)
+{  
+  dsr->lba        = SwapBytes64(dsr->lba);
+  dsr->properties = SwapBytes32(dsr->properties);
+}
@@ -185,6 +185,23 @@ ReedSolomonTables *CreateReedSolomonTables(GaloisTables *gt,
      for(j=0; j<GF_FIELDSIZE; j++)
        *lut++ = gt->alphaTo[mod_fieldmax(gt->indexOf[j] + (rt->fcr+i)*rt->primElem)];
 
+   /*
+    * Split the syndrome multiplications into low and high nibble
+    * lookups for the SIMD decoders: 
+    * x * alpha^((fcr+i)*primElem) = lo[x & 15] ^ hi[x >> 4].
+    * Unlike synLut, these tables map 0 to 0.
+    */
+
+   lut = rt->synNibbleLut = g_malloc(rt->nroots * 32);
+   for(i=0; i<rt->nroots; i++)
+   {  guint8 *syn_lut = rt->synLut + (i<<8);
+
+      for(j=0; j<16; j++)
+	*lut++ = j ? syn_lut[j] : 0;
+      for(j=0; j<16; j++)
+	*lut++ = j ? syn_lut[j<<4] : 0;
+   }
+
    return rt;
 }
 
@@ -197,6 +214,7 @@ void FreeReedSolomonTables(ReedSolomonTables *rt)
   {  g_free(rt->bLut[i]);
   }
   g_free(rt->synLut);
+  g_free(rt->synNibbleLut);
 
   g_free(rt);
 }
@@ -66,28 +66,24 @@ void UpdateByteCounts(RawBuffer *rb)
  */
 
 void CalculatePQLoad(RawBuffer *rb)
-{  unsigned char p_vector[P_VECTOR_SIZE];
-   unsigned char q_vector[Q_VECTOR_SIZE];
-   int frame_idx = rb->samplesRead - 1;
+{  int frame_idx = rb->samplesRead - 1;
    unsigned char *new_frame = rb->rawBuf[frame_idx];
-   int ignore[2];
+   int p_result[N_P_VECTORS];
+   int q_result[N_Q_VECTORS];
    int q, p;
-   int err;
         
+   CheckPQVectors(rb->rt, new_frame, p_result, q_result);
+
    for(q = 0; q < N_Q_VECTORS; q++)
    {
-     GetQVector(new_frame, q_vector, q);
-     err = DecodePQ(rb->rt, q_vector, Q_PADDING, ignore, 0);
-     if(err <  0) rb->qLoad[frame_idx] += 2;
-     if(err == 1) rb->qLoad[frame_idx]++; /* We assume without any erasures specified there can't be more than 1 errors corrected. */
+     if(q_result[q] <  0) rb->qLoad[frame_idx] += 2;
+     if(q_result[q] == 1) rb->qLoad[frame_idx]++; /* We assume without any erasures specified there can't be more than 1 errors corrected. */
    }      
 
    for(p = 0; p < N_P_VECTORS; p++)
    {
-     GetPVector(new_frame, p_vector, p);
-     err = DecodePQ(rb->rt, p_vector, P_PADDING, ignore, 0);
-     if(err <  0) rb->pLoad[frame_idx] += 2;
-     if(err == 1) rb->pLoad[frame_idx]++; /* We assume without any erasures specified there can't be more than 1 errors corrected. */
+     if(p_result[p] <  0) rb->pLoad[frame_idx] += 2;
+     if(p_result[p] == 1) rb->pLoad[frame_idx]++; /* We assume without any erasures specified there can't be more than 1 errors corrected. */
    }      
 }   
 
@@ -165,24 +161,21 @@ void UpdatePQParityList(RawBuffer *rb, unsigned char *new_frame)
 static int eval_q_candidate(RawBuffer *rb, unsigned char *q_vector, int q, 
                             int *p_failures_out, int *p_errors_out)
 {
-   unsigned char     p_vector[P_VECTOR_SIZE];
    unsigned char old_q_vector[Q_VECTOR_SIZE];
-   int ignore[2];
+   int p_result[N_P_VECTORS];
    int p, p_errors = 0;
    int p_failures = 0;
-   int err;
    
    GetQVector(rb->recovered, old_q_vector, q);
    SetQVector(rb->recovered,     q_vector, q);
    
    /* Count P failures after setting our Q vector. */
 
+   CheckPQVectors(rb->rt, rb->recovered, p_result, NULL);
    for(p = 0; p < N_P_VECTORS; p++)
    {
-      GetPVector(rb->recovered, p_vector, p);
-      err = DecodePQ(rb->rt, p_vector, P_PADDING, ignore, 0);
-      if(err <  0) p_failures++;
-      else if(err == 1) p_errors++;
+      if(p_result[p] <  0) p_failures++;
+      else if(p_result[p] == 1) p_errors++;
    }            
 
    SetQVector(rb->recovered, old_q_vector, q);
@@ -196,24 +189,21 @@ static int eval_q_candidate(RawBuffer *rb, unsigned char *q_vector, int q,
 static void eval_p_candidate(RawBuffer *rb, unsigned char *p_vector, int p, 
                             int *q_failures_out, int *q_errors_out)
 {
-   unsigned char     q_vector[Q_VECTOR_SIZE];
    unsigned char old_p_vector[P_VECTOR_SIZE];
-   int ignore[2];
+   int q_result[N_Q_VECTORS];
    int q, q_errors = 0;
    int q_failures = 0;
-   int err;
    
    GetPVector(rb->recovered, old_p_vector, p);
    SetPVector(rb->recovered,     p_vector, p);
    
    /* Count Q failures after setting our P vector. */
 
+   CheckPQVectors(rb->rt, rb->recovered, NULL, q_result);
    for(q = 0; q < N_Q_VECTORS; q++)
    {
-      GetQVector(rb->recovered, q_vector, q);
-      err = DecodePQ(rb->rt, q_vector, Q_PADDING, ignore, 0);
-      if(err <  0) q_failures++;
-      else if(err == 1) q_errors++;
+      if(q_result[q] <  0) q_failures++;
+      else if(q_result[q] == 1) q_errors++;
    }            
 
    SetPVector(rb->recovered, old_p_vector, p);
@@ -1158,6 +1148,8 @@ int AckHeuristic(RawBuffer *rb)
    unsigned char pq_sector_exist[26];
    unsigned char p_status[N_P_VECTORS];
    unsigned char q_status[N_Q_VECTORS];
+   int p_result[N_P_VECTORS];
+   int q_result[N_Q_VECTORS];
    int decimated_erasures[2];
    int ignore[2];
    int p_failures, q_failures;
@@ -1186,24 +1178,21 @@ int AckHeuristic(RawBuffer *rb)
       p_corrected = q_corrected = 0;
       p_err = q_err = 0;
       
-      /* Get the entire Q status */
+      /* Get the entire P and Q status */
+      CheckPQVectors(rb->rt, rb->recovered, p_result, q_result);
+
       for(q = 0; q < N_Q_VECTORS; q++)
       {  
-	 GetQVector(rb->recovered, q_vector, q);
-	 err = DecodePQ(rb->rt, q_vector, Q_PADDING, ignore, 0);
-	 if(err <  0) q_status[q] = 2;
-	 if(err == 1) q_status[q] = 1;
-	 if(!err)	 q_status[q] = 0;
+	 if(q_result[q] <  0) q_status[q] = 2;
+	 if(q_result[q] == 1) q_status[q] = 1;
+	 if(!q_result[q])     q_status[q] = 0;
       }
       
-      /* Get the entire P status */
       for(p = 0; p < N_P_VECTORS; p++)
       {  
-	 GetPVector(rb->recovered, p_vector, p);
-	 err = DecodePQ(rb->rt, p_vector, P_PADDING, ignore, 0);
-	 if(err <  0) p_status[p] = 2;
-	 if(err == 1) p_status[p] = 1;
-	 if(!err)	 p_status[p] = 0;
+	 if(p_result[p] <  0) p_status[p] = 2;
+	 if(p_result[p] == 1) p_status[p] = 1;
+	 if(!p_result[p])     p_status[p] = 0;
       }
       
       /* Perform Q-Parity error correction */
@@ -1887,6 +1876,148 @@ int AckHeuristic(RawBuffer *rb)
    return 1;
 }
 
+/*
+ * Enumerate the byte combinations for one P or Q vector.
+ * The candidates are numbered in a mixed radix system with position 0 
+ * as the lowest digit. The candidate space is cut into ranges
+ * which are searched in parallel; merging the ranges in order
+ * gives the same result as a sequential walk over all candidates.
+ */
+
+typedef struct
+{  RawBuffer *rb;
+   unsigned char (*zList)[256];
+   unsigned char *czList;
+   int length, padding;
+   int first, last;       /* candidate range [first, last) */
+   int decodable, clean;  /* first candidate with err >= 0 resp. err == 0; -1 = none */
+   gint *bestClean;       /* lowest clean candidate found in any range */
+} candidate_range;
+
+static void build_candidate(candidate_range *cr, int index, unsigned char *vector)
+{  int a;
+
+   for(a = 0; a < cr->length; a++)
+   {  vector[a] = cr->zList[a][index % cr->czList[a]];
+      index /= cr->czList[a];
+   }
+}
+
+static void scan_candidates(gpointer data, gpointer unused)
+{  candidate_range *cr = (candidate_range*)data;
+   unsigned char vector[45];
+   int zStack[45];
+   int ignore[2];
+   int a, idx, err;
+
+   cr->decodable = cr->clean = -1;
+
+   idx = cr->first;
+   for(a = 0; a < cr->length; a++)
+   {  zStack[a] = idx % cr->czList[a];
+      idx /= cr->czList[a];
+   }
+
+   for(idx = cr->first; idx < cr->last; idx++)
+   {  
+      /* Stop if a lower range already has a solution or time is up */
+
+      if(!((idx - cr->first) & 255))
+      {  if(idx > g_atomic_int_get(cr->bestClean)) break;
+	 if(LECTimeExceeded(cr->rb)) break;
+      }
+
+      for(a = 0; a < cr->length; a++)
+	vector[a] = cr->zList[a][zStack[a]];
+
+      err = DecodePQ(cr->rb->rt, vector, cr->padding, ignore, 0);
+
+      if(err >= 0 && cr->decodable < 0)
+	cr->decodable = idx;
+
+      if(err == 0)
+      {  int old;
+
+	 cr->clean = idx;
+	 do
+	 {  old = g_atomic_int_get(cr->bestClean);
+	    if(idx >= old) break;
+	 } while(!g_atomic_int_compare_and_exchange(cr->bestClean, old, idx));
+	 break;
+      }
+
+      for(a = 0; a < cr->length; a++)
+      {  if(++zStack[a] < cr->czList[a]) break;
+	 zStack[a] = 0;
+      }
+   }
+}
+
+/*
+ * Returns the number of corrections found (0, 1 or 2) and
+ * the corrected vector. For referr < 0 the first decodable
+ * candidate is taken, and possibly replaced by a later one
+ * which decodes without errors. For referr == 1 only a
+ * candidate without errors is acceptable.
+ */
+
+static int search_candidates(RawBuffer *rb, unsigned char zList[][256], unsigned char *czList,
+			     int length, int padding, int complexity, int referr, 
+			     unsigned char *vector)
+{  candidate_range *ranges;
+   gpointer *tasks;
+   gint best_clean = G_MAXINT;
+   int ignore[2];
+   int n_ranges = 1;
+   int decodable = -1, clean = -1;
+   int corrected, i;
+
+   if(Closure->codecThreads > 1 && complexity >= 4096)
+     n_ranges = Closure->codecThreads;
+
+   ranges = g_malloc(n_ranges*sizeof(candidate_range));
+   tasks  = g_malloc(n_ranges*sizeof(gpointer));
+
+   for(i=0; i<n_ranges; i++)
+   {  ranges[i].rb        = rb;
+      ranges[i].zList     = zList;
+      ranges[i].czList    = czList;
+      ranges[i].length    = length;
+      ranges[i].padding   = padding;
+      ranges[i].first     = (int)(((gint64)complexity*i)/n_ranges);
+      ranges[i].last      = (int)(((gint64)complexity*(i+1))/n_ranges);
+      ranges[i].bestClean = &best_clean;
+      tasks[i] = &ranges[i];
+   }
+
+   RunLECSearchTasks(scan_candidates, tasks, n_ranges);
+
+   for(i=0; i<n_ranges; i++)
+   {  if(decodable < 0) decodable = ranges[i].decodable;
+      if(clean < 0)     clean     = ranges[i].clean;
+   }
+
+   if(referr == 1)
+   {  if(clean < 0) corrected = 0;
+      else          corrected = 1;
+   }
+   else
+   {  if(decodable < 0)         corrected = 0;
+      else if(clean < 0 || clean == decodable) corrected = 1;
+      else                      corrected = 2;
+   }
+
+   if(corrected)
+   {  build_candidate(&ranges[0], clean >= 0 ? clean : decodable, vector);
+      DecodePQ(rb->rt, vector, padding, ignore, 0);
+   }
+
+   g_free(ranges);
+   g_free(tasks);
+
+   return corrected;
+}
+
 int BruteForceSearchPlausibleSector(RawBuffer *rb)
 {
    unsigned char p_vector[26];
@@ -1907,7 +2038,6 @@ int BruteForceSearchPlausibleSector(RawBuffer *rb)
    
    unsigned char  zList[45][256]; /* stores different bytes which were read for each position in a sector */   
    unsigned char czList[45];	   /* counts different bytes which were read for each position in a sector */
-   int zStack[45], pzStack;
 
    /* Re-Initialize sector */     
    InitializeCDFrame(rb->recovered, rb->lba, rb->xaMode, 1);
@@ -1929,7 +2059,7 @@ int BruteForceSearchPlausibleSector(RawBuffer *rb)
 	 /* If it is not correct. */
 	 if(referr == 1 || referr < 0)
 	 {	        
-	    int a, b, c, complexity = 1;
+	    int a, b, c, complexity = 1, corrected;
 	    
 	    if(referr  < 0) { q_failures++; q_err += 2; }
 	    if(referr == 1) {				q_err++;    }
@@ -1981,37 +2111,11 @@ int BruteForceSearchPlausibleSector(RawBuffer *rb)
 	    /* no degrees of freedom */
 	    if(complexity == 1) continue; 
 
-	    memset(zStack, 0, 45 * sizeof(int));
-	    while(1)
-	    {
-	       for(a = 0; a < 45; a++)
-	       {
-		  cq_vector[a] = zList[a][zStack[a]];
-	       }					
-	       
-	       err = DecodePQ(rb->rt, cq_vector, Q_PADDING, ignore, 0);
-	       if((referr < 0 && err >= 0) || (referr == 1 && err == 0)) 
-	       {
-		  SetQVector(rb->recovered, cq_vector, q);
-		  q_corrected++;
-
-		  referr = err;
-		  if(referr == 0) break;
-	       }
-	       
-	       pzStack = 0;
-	       while(pzStack < 45)
-	       {
-		  zStack[pzStack]++;
-		  if(zStack[pzStack] == czList[pzStack]) 
-		  {
-		     zStack[pzStack] = 0;
-		     pzStack++;
-		  }
-		  else break;
-	       }
-	       
-	       if(pzStack == 45) break;
+	    corrected = search_candidates(rb, zList, czList, 45, Q_PADDING, 
+					  complexity, referr, cq_vector);
+	    if(corrected)
+	    {  SetQVector(rb->recovered, cq_vector, q);
+	       q_corrected += corrected;
 	    }
 	 }
       }
@@ -2027,7 +2131,7 @@ int BruteForceSearchPlausibleSector(RawBuffer *rb)
 	 /* If it is not correct. */
 	 if(referr == 1 || referr < 0)
 	 {	        
-	    int a, b, c, complexity = 1;
+	    int a, b, c, complexity = 1, corrected;
 	    
 	    if(referr  < 0) { p_failures++; p_err += 2; }
 	    if(referr == 1) { p_err++;    }
@@ -2078,37 +2182,11 @@ int BruteForceSearchPlausibleSector(RawBuffer *rb)
 	    /* no degrees of freedom */
 	    if(complexity == 1) continue; 
 	    
-	    memset(zStack, 0, 26 * sizeof(int));
-	    while(1)
-	    {
-	       for(a = 0; a < 26; a++)
-	       {
-		  cp_vector[a] = zList[a][zStack[a]];
-	       }					
-
-	       err = DecodePQ(rb->rt, cp_vector, P_PADDING, ignore, 0);
-	       if((referr < 0 && err >= 0) || (referr == 1 && err == 0)) 
-	       {
-		  SetPVector(rb->recovered, cp_vector, p);
-		  p_corrected++;
-		  
-		  referr = err;
-		  if(referr == 0) break;
-	       }
-	       
-	       pzStack = 0;
-	       while(pzStack < 26)
-	       {
-		  zStack[pzStack]++;
-		  if(zStack[pzStack] == czList[pzStack]) 
-		  {
-		     zStack[pzStack] = 0;
-		     pzStack++;
-		  }
-		  else break;
-	       }
-	       
-	       if(pzStack == 26) break;
+	    corrected = search_candidates(rb, zList, czList, 26, P_PADDING, 
+					  complexity, referr, cp_vector);
+	    if(corrected)
+	    {  SetPVector(rb->recovered, cp_vector, p);
+	       p_corrected += corrected;
 	    }
 	 }
       }
@@ -2125,6 +2203,7 @@ int BruteForceSearchPlausibleSector(RawBuffer *rb)
       if(last_p_err <= p_err && last_q_err <= q_err && last_p_failures <= p_failures && last_q_failures <= q_failures) break;
 
       if(iteration > N_P_VECTORS + N_Q_VECTORS) break;
+      if(LECTimeExceeded(rb)) break;
       if(p_failures == 0)
       {
 	 if(CheckEDC(rb->recovered, rb->xaMode)) break;
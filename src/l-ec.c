@@ -237,11 +237,13 @@ int CountC2Errors(unsigned char *frame)
 #define LEC_PRIMTH_ROOT 1
 
 /*
- * Calculate the error syndrome
+ * Generic errors and erasures decoder.
+ * Only used by DecodePQ() for the erasure combinations
+ * which have no closed form solution below.
  */
 
-int DecodePQ(ReedSolomonTables *rt, unsigned char *data, int padding,
-	     int *erasure_list, int erasure_count)
+static int decode_pq_generic(ReedSolomonTables *rt, unsigned char *data, int padding,
+			     int *erasure_list, int erasure_count)
 {  GaloisTables *gt = rt->gfTables;
    int syndrome[NROOTS];
    int lambda[NROOTS+1];
@@ -489,4 +491,186 @@ int DecodePQ(ReedSolomonTables *rt, unsigned char *data, int padding,
    return corrected;
 }
 
+/*
+ * Specialized decoder for the two roots (alpha^0, alpha^1) of the L-EC codes.
+ *
+ * A vector of length n has the syndromes
+ *   s0 = sum data[j] and s1 = sum data[j] * alpha^(n-1-j).
+ * s1 is evaluated by Horner's rule; multiplying by alpha is a shift
+ * and a conditional xor with the field generator.
+ * A single error e at position j yields s0 = e and s1 = e * alpha^(n-1-j),
+ * so both its location and value follow directly from the syndromes.
+ * Two erasures at known positions are solved with Forney's formula.
+ * The results are identical to those of the generic decoder above,
+ * including the error codes for uncorrectable vectors.
+ */
+
+static inline unsigned char mul_alpha(unsigned char x, unsigned char gen)
+{  return (x<<1) ^ (-(x>>7) & gen);
+}
+
+static inline void pq_syndromes(unsigned char *data, int n, unsigned char gen,
+				int *s0_out, int *s1_out)
+{  unsigned char s0 = 0, s1 = 0;
+   int j;
+
+   for(j=0; j<n; j++)
+   {  s0 ^= data[j];
+      s1 = data[j] ^ mul_alpha(s1, gen);
+   }
+
+   *s0_out = s0;
+   *s1_out = s1;
+}
+
+/*
+ * Classify a vector with nonzero syndrome like the generic decoder
+ * does without erasures: 1 for a correctable single error (whose
+ * position is returned in *pos_out), negative values otherwise.
+ */
+
+static inline int locate_single_error(GaloisTables *gt, int s0, int s1, int n, int *pos_out)
+{  int degree;
+
+   if(!s0) return -1;   /* error locator has no roots */
+   if(!s1) return -2;   /* degenerate locator, syndrome remains */
+
+   degree = gt->indexOf[s1] - gt->indexOf[s0];
+   if(degree < 0) degree += GF_FIELDMAX;
+
+   if(degree >= n)      /* error would be located in the padding */
+     return -3;
+
+   *pos_out = n-1-degree;
+   return 1;
+}
+
+int DecodePQ(ReedSolomonTables *rt, unsigned char *data, int padding,
+	     int *erasure_list, int erasure_count)
+{  GaloisTables *gt = rt->gfTables;
+   unsigned char gen = gt->gfGenerator & GF_FIELDMAX;
+   int n = GF_FIELDMAX - padding;
+   int s0,s1;
+
+   pq_syndromes(data, n, gen, &s0, &s1);
+
+   if(!(s0 | s1))
+     return 0;
+
+   /*** Single error correction */
+
+   if(erasure_count == 0 || erasure_count > 2)
+   {  int pos,result;
+
+      erasure_list[1] += padding;
+      result = locate_single_error(gt, s0, s1, n, &pos);
+      if(result < 0) 
+      {  erasure_list[0] += padding;
+	 return result;
+      }
+
+      data[pos] ^= s0;
+      erasure_list[0] = pos;
+      return 1;
+   }
+
+   /*** Two erasures at distinct positions inside the vector */
+
+   if(erasure_count == 2
+      && erasure_list[0] != erasure_list[1]
+      && erasure_list[0] >= 0 && erasure_list[0] < n
+      && erasure_list[1] >= 0 && erasure_list[1] < n)
+   {  int pos[2],x[2],omega1,sum;
+      int i;
 
+      /* The generic decoder corrects the last position first */
+
+      pos[0] = MAX(erasure_list[0], erasure_list[1]);
+      pos[1] = MIN(erasure_list[0], erasure_list[1]);
+      erasure_list[0] += padding;
+      erasure_list[1] += padding;
+
+      x[0] = gt->alphaTo[n-1-pos[0]];
+      x[1] = gt->alphaTo[n-1-pos[1]];
+      sum  = gt->indexOf[x[0] ^ x[1]];
+
+      /* omega(x) = s0 + (s1 + s0*(x0+x1)) * x */
+
+      omega1 = s1;
+      if(s0) omega1 ^= gt->alphaTo[mod_fieldmax(gt->indexOf[s0] + sum)];
+
+      for(i=0; i<2; i++)
+      {  int num = omega1;
+
+	 /* error value = (s0*x + omega1) / (x0+x1) */
+
+	 if(s0) num ^= gt->alphaTo[mod_fieldmax(gt->indexOf[s0] + gt->indexOf[x[i]])];
+	 if(!num) return -3;
+
+	 data[pos[i]] ^= gt->alphaTo[mod_fieldmax(gt->indexOf[num] + GF_FIELDMAX - sum)];
+      }
+
+      return 2;
+   }
+
+   return decode_pq_generic(rt, data, padding, erasure_list, erasure_count);
+}
+
+/*
+ * Check all P vectors and/or all Q vectors of a frame in one call.
+ * The results are those of DecodePQ() without erasures,
+ * but the frame is not modified.
+ * Pass NULL for p_result or q_result to skip the respective vectors.
+ */
+
+void CheckPQVectors(ReedSolomonTables *rt, unsigned char *frame, int *p_result, int *q_result)
+{  GaloisTables *gt = rt->gfTables;
+   unsigned char gen = gt->gfGenerator & GF_FIELDMAX;
+   int pos,i,n;
+
+   /* The P vectors are the columns of a 26x86 matrix,
+      so that all of their syndromes can be built row by row. */
+
+   if(p_result)
+   {  unsigned char s0[N_P_VECTORS], s1[N_P_VECTORS];
+      unsigned char *row = frame+12;
+
+      memset(s0, 0, sizeof(s0));
+      memset(s1, 0, sizeof(s1));
+
+      for(i=0; i<P_VECTOR_SIZE; i++, row+=N_P_VECTORS)
+	for(n=0; n<N_P_VECTORS; n++)
+	{  s0[n] ^= row[n];
+	   s1[n] = row[n] ^ mul_alpha(s1[n], gen);
+	}
+
+      for(n=0; n<N_P_VECTORS; n++)
+	p_result[n] = (s0[n] | s1[n]) ? locate_single_error(gt, s0[n], s1[n], P_VECTOR_SIZE, &pos) : 0;
+   }
+
+   /* The Q vectors are diagonals; see GetQVector() */
+
+   if(q_result)
+   {  for(n=0; n<N_Q_VECTORS; n++)
+      {  unsigned char *base = frame + 12 + (n & 1);
+	 unsigned char s0 = 0, s1 = 0;
+	 int w_idx = (n&~1) * 43;
+
+	 for(i=0; i<43; i++)
+	 {  unsigned char byte = base[w_idx];
+
+	    s0 ^= byte;
+	    s1 = byte ^ mul_alpha(s1, gen);
+	    w_idx += 88;
+	    if(w_idx >= 2236) w_idx -= 2236;
+	 }
+
+	 s0 ^= frame[2248 + n];
+	 s1  = frame[2248 + n] ^ mul_alpha(s1, gen);
+	 s0 ^= frame[2300 + n];
+	 s1  = frame[2300 + n] ^ mul_alpha(s1, gen);
+
+	 q_result[n] = (s0 | s1) ? locate_single_error(gt, s0, s1, Q_VECTOR_SIZE, &pos) : 0;
+      }
+   }
+}
@@ -24,6 +24,20 @@
 
 #include "dvdisaster.h"
 
+#ifdef HAVE_IO_URING
+  #include <linux/io_uring.h>
+  #include <sys/mman.h>
+  #include <sys/syscall.h>
+  #include <sys/uio.h>
+#endif
+
+#ifdef HAVE_FIEMAP
+  #include <linux/fs.h>
+  #include <linux/fiemap.h>
+  #include <sys/ioctl.h>
+  #include <sys/vfs.h>
+#endif
+
 /***
  *** Wrappers around the standard low level file system interface.
  ***
@@ -107,6 +121,40 @@ int LargeStat(char *path, guint64 *length_return)
    return TRUE;
 }
 
+/*
+ * Same as above, but also returns the modification time
+ * in nanoseconds since the epoch. File systems which only
+ * store whole seconds return a multiple of 10^9.
+ */
+
+int LargeStatMTime(char *path, guint64 *length_return, gint64 *mtime_return)
+{  struct stat mystat;
+   gchar *cp_path = os_path(path);
+
+   if(!cp_path) return FALSE;
+
+   if(large_stat(cp_path, &mystat) == -1)
+   {  g_free(cp_path);
+      return FALSE;
+   }
+   g_free(cp_path);
+
+   if(!S_ISREG(mystat.st_mode))
+      return FALSE;
+
+   *length_return = mystat.st_size;
+#if defined(SYS_MINGW)
+   *mtime_return  = (gint64)mystat.st_mtime * G_GINT64_CONSTANT(1000000000);
+#elif defined(SYS_DARWIN)
+   *mtime_return  =   (gint64)mystat.st_mtimespec.tv_sec * G_GINT64_CONSTANT(1000000000)
+                    + mystat.st_mtimespec.tv_nsec;
+#else
+   *mtime_return  =   (gint64)mystat.st_mtim.tv_sec * G_GINT64_CONSTANT(1000000000)
+                    + mystat.st_mtim.tv_nsec;
+#endif
+   return TRUE;
+}
+
 /*
  * Stat() variant for testing directories
  */
@@ -285,6 +333,482 @@ ssize_t LargeWrite(LargeFile *lf, void *buf, size_t count)
    return n;
 }
 
+/***
+ *** Vectored reading and writing
+ ***
+ * LargeReadV() and LargeWriteV() transfer a vector of (offset, buffer)
+ * requests and return when all of them have completed.
+ * Requests are kept in flight concurrently so that the disk sees a deep
+ * queue instead of one outstanding request at a time.
+ * On Linux, io_uring is used when the kernel supports it; otherwise the
+ * requests are handed to a small pool of threads doing pread()/pwrite().
+ *
+ * Each request records the number of bytes transferred (or -1) in its
+ * result field. The functions return TRUE if all requests were fully
+ * transferred, and FALSE otherwise with errno set from the first error.
+ * The file position is undefined afterwards; use LargeSeek() before
+ * calling LargeRead() or LargeWrite() again.
+ *
+ * After LargeEnableDirectIO(), requests bypass the page cache where
+ * possible. O_DIRECT needs the buffer, file offset and length aligned
+ * to the logical block size, so only the aligned part of a request
+ * is transferred that way; an unaligned remainder (e.g. the end of an
+ * image which is not a multiple of 2048 bytes) goes through the normal
+ * file handle. Note that there is no kernel read-ahead for direct
+ * transfers; the callers must submit large enough requests themselves.
+ */
+
+#define LARGE_IO_DEPTH   64   /* io_uring submission queue size */
+#define LARGE_IO_THREADS  8   /* threads in the fallback pool */
+#define LARGE_IO_ALIGN  512   /* alignment required for O_DIRECT */
+
+/*
+ * Open a second handle with O_DIRECT for the file.
+ */
+
+int LargeEnableDirectIO(LargeFile *lf)
+{
+#if defined(HAVE_O_DIRECT) && !defined(SYS_MINGW)
+   gchar *cp_path;
+   int flags = (lf->flags & O_ACCMODE) | O_DIRECT;
+   int fd;
+
+   if(lf->directIO)
+     return TRUE;
+
+#ifdef HAVE_O_LARGEFILE
+   flags |= O_LARGEFILE;
+#endif
+
+   cp_path = os_path(lf->path);
+   if(!cp_path)
+     return FALSE;
+
+   fd = open(cp_path, flags);
+   g_free(cp_path);
+
+   if(fd < 0)
+   {  Verbose("%s: direct I/O not available (%s); using buffered I/O\n",
+	      lf->path, strerror(errno));
+      return FALSE;
+   }
+
+   if(lf->directHandle > 0)
+     close(lf->directHandle);
+   lf->directHandle = fd;
+   lf->directIO = TRUE;
+   return TRUE;
+#else
+   return FALSE;
+#endif
+}
+
+/*
+ * Number of bytes from the start of the request
+ * which may be transferred with O_DIRECT.
+ */
+
+static size_t direct_count(LargeFile *lf, void *buf, guint64 offset, size_t count)
+{
+   if(!lf->directIO
+      || ((intptr_t)buf & (LARGE_IO_ALIGN-1))
+      || (offset & (LARGE_IO_ALIGN-1)))
+     return 0;
+
+   return count & ~(size_t)(LARGE_IO_ALIGN-1);
+}
+
+/*
+ * Some file systems accept O_DIRECT in open() but not the transfer
+ * sizes we use. Continue with buffered I/O in that case.
+ */
+
+static void disable_direct_io(LargeFile *lf)
+{
+   if(lf->directIO)
+   {  lf->directIO = FALSE;
+      Verbose("%s: direct I/O rejected; using buffered I/O\n", lf->path);
+   }
+}
+
+/*
+ * Synchronous transfer of the remaining part of a request
+ */
+
+static void sync_transfer(LargeFile *lf, LargeIOVec *v, int write)
+{  unsigned char *buf = (unsigned char*)v->buf;
+   ssize_t done = v->result > 0 ? v->result : 0;
+
+#ifdef SYS_MINGW
+   if(!LargeSeek(lf, v->offset+done))
+   {  v->result = -1;
+      return;
+   }
+   if(write) v->result = done + LargeWrite(lf, buf+done, v->count-done);
+   else      v->result = done + LargeRead(lf, buf+done, v->count-done);
+#else
+   while(done < v->count)
+   {  size_t direct = direct_count(lf, buf+done, v->offset+done, v->count-done);
+      int fd = direct ? lf->directHandle : lf->fileHandle;
+      size_t count = direct ? direct : v->count-done;
+      ssize_t n;
+
+      if(write) n = pwrite(fd, buf+done, count, v->offset+done);
+      else      n = pread(fd, buf+done, count, v->offset+done);
+
+      if(n < 0)
+      {  if(errno == EINTR) continue;
+	 if(errno == EINVAL && direct)
+	 {  disable_direct_io(lf);
+	    continue;
+	 }
+	 v->result = -1;
+	 return;
+      }
+      if(n == 0) break;  /* end of file */
+      done += n;
+   }
+   v->result = done;
+#endif
+}
+
+#ifdef HAVE_IO_URING
+
+/*
+ * Minimal io_uring setup using the raw system calls,
+ * so that we do not depend on liburing.
+ */
+
+typedef struct _LargeRing
+{  int fd;
+   unsigned entries;
+   unsigned *sqHead, *sqTail, *sqMask, *sqArray;
+   unsigned *cqHead, *cqTail, *cqMask;
+   struct io_uring_sqe *sqes;
+   struct io_uring_cqe *cqes;
+   void *sqRing, *cqRing;
+   size_t sqRingSize, cqRingSize, sqesSize;
+} LargeRing;
+
+static int ring_unavailable;  /* io_uring_setup() failed once; do not retry */
+
+static void free_ring(LargeRing *r)
+{  
+   if(r->sqes && r->sqes != MAP_FAILED)
+     munmap(r->sqes, r->sqesSize);
+   if(r->cqRing && r->cqRing != MAP_FAILED && r->cqRing != r->sqRing)
+     munmap(r->cqRing, r->cqRingSize);
+   if(r->sqRing && r->sqRing != MAP_FAILED)
+     munmap(r->sqRing, r->sqRingSize);
+   close(r->fd);
+   g_free(r);
+}
+
+static LargeRing* create_ring(void)
+{  struct io_uring_params p;
+   LargeRing *r;
+   int fd;
+
+   memset(&p, 0, sizeof(p));
+   fd = syscall(__NR_io_uring_setup, LARGE_IO_DEPTH, &p);
+   if(fd < 0)
+   {  Verbose("io_uring not available (%s); using I/O threads\n", strerror(errno));
+      ring_unavailable = TRUE;
+      return NULL;
+   }
+
+   r = g_malloc0(sizeof(LargeRing));
+   r->fd = fd;
+   r->entries = p.sq_entries;
+   r->sqRingSize = p.sq_off.array + p.sq_entries*sizeof(unsigned);
+   r->cqRingSize = p.cq_off.cqes + p.cq_entries*sizeof(struct io_uring_cqe);
+   r->sqesSize   = p.sq_entries*sizeof(struct io_uring_sqe);
+
+   if(p.features & IORING_FEAT_SINGLE_MMAP)
+   {  if(r->cqRingSize > r->sqRingSize)
+	r->sqRingSize = r->cqRingSize;
+      r->cqRingSize = r->sqRingSize;
+   }
+
+   r->sqRing = mmap(NULL, r->sqRingSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE,
+		    fd, IORING_OFF_SQ_RING);
+   if(r->sqRing == MAP_FAILED)
+     goto failed;
+
+   if(p.features & IORING_FEAT_SINGLE_MMAP)
+     r->cqRing = r->sqRing;
+   else
+   {  r->cqRing = mmap(NULL, r->cqRingSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE,
+		       fd, IORING_OFF_CQ_RING);
+      if(r->cqRing == MAP_FAILED)
+	goto failed;
+   }
+
+   r->sqes = mmap(NULL, r->sqesSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE,
+		  fd, IORING_OFF_SQES);
+   if(r->sqes == MAP_FAILED)
+     goto failed;
+
+   r->sqHead  = (unsigned*)((char*)r->sqRing + p.sq_off.head);
+   r->sqTail  = (unsigned*)((char*)r->sqRing + p.sq_off.tail);
+   r->sqMask  = (unsigned*)((char*)r->sqRing + p.sq_off.ring_mask);
+   r->sqArray = (unsigned*)((char*)r->sqRing + p.sq_off.array);
+   r->cqHead  = (unsigned*)((char*)r->cqRing + p.cq_off.head);
+   r->cqTail  = (unsigned*)((char*)r->cqRing + p.cq_off.tail);
+   r->cqMask  = (unsigned*)((char*)r->cqRing + p.cq_off.ring_mask);
+   r->cqes    = (struct io_uring_cqe*)((char*)r->cqRing + p.cq_off.cqes);
+
+   return r;
+
+failed:
+   Verbose("io_uring ring mapping failed (%s); using I/O threads\n", strerror(errno));
+   free_ring(r);
+   ring_unavailable = TRUE;
+   return NULL;
+}
+
+/*
+ * Keep up to r->entries requests in flight until all are done.
+ */
+
+static int ring_transfer(LargeFile *lf, LargeIOVec *v, int n, int write)
+{  LargeRing *r = lf->ring;
+   struct iovec *iov = g_malloc(n*sizeof(struct iovec));
+   int *direct = g_malloc(n*sizeof(int));
+   int submitted = 0, completed = 0;
+   int error = 0;
+   int i;
+
+   while(completed < n)
+   {  unsigned tail = *r->sqTail;
+      unsigned head;
+      int in_flight = submitted - completed;
+      int ret;
+
+      /* Fill up the submission queue */
+
+      while(submitted < n && in_flight < r->entries)
+      {  unsigned idx = tail & *r->sqMask;
+	 struct io_uring_sqe *sqe = &r->sqes[idx];
+
+	 /* Only the aligned part goes through the O_DIRECT handle;
+	    the rest is done below as a short transfer. */
+
+	 iov[submitted].iov_base = v[submitted].buf;
+	 iov[submitted].iov_len  = direct_count(lf, v[submitted].buf,
+						v[submitted].offset, v[submitted].count);
+	 direct[submitted] = iov[submitted].iov_len > 0;
+	 if(!direct[submitted])
+	   iov[submitted].iov_len = v[submitted].count;
+
+	 memset(sqe, 0, sizeof(*sqe));
+	 sqe->opcode    = write ? IORING_OP_WRITEV : IORING_OP_READV;
+	 sqe->fd        = direct[submitted] ? lf->directHandle : lf->fileHandle;
+	 sqe->off       = v[submitted].offset;
+	 sqe->addr      = (unsigned long)&iov[submitted];
+	 sqe->len       = 1;
+	 sqe->user_data = submitted;
+	 r->sqArray[idx] = idx;
+
+	 tail++; submitted++; in_flight++;
+      }
+      __atomic_store_n(r->sqTail, tail, __ATOMIC_RELEASE);
+
+      /* Submit whatever the kernel has not consumed yet
+	 and wait for at least one completion */
+
+      ret = syscall(__NR_io_uring_enter, r->fd,
+		    tail - __atomic_load_n(r->sqHead, __ATOMIC_ACQUIRE),
+		    1, IORING_ENTER_GETEVENTS, NULL, 0);
+      if(ret < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+	Stop("io_uring_enter() failed: %s\n", strerror(errno));
+
+      /* Reap the completions */
+
+      head = *r->cqHead;
+      while(head != __atomic_load_n(r->cqTail, __ATOMIC_ACQUIRE))
+      {  struct io_uring_cqe *cqe = &r->cqes[head & *r->cqMask];
+	 LargeIOVec *vi = &v[cqe->user_data];
+
+	 if(cqe->res == -EINVAL && direct[cqe->user_data])
+	 {  disable_direct_io(lf);
+	    vi->result = 0;  /* redone with buffered I/O below */
+	 }
+	 else if(cqe->res < 0)
+	 {  vi->result = -1;
+	    if(!error) error = -cqe->res;
+	 }
+	 else vi->result = cqe->res;
+
+	 head++; completed++;
+      }
+      __atomic_store_n(r->cqHead, head, __ATOMIC_RELEASE);
+   }
+
+   g_free(iov);
+   g_free(direct);
+
+   /* Short transfers are rare with regular files; finish them here.
+      They also occur for the unaligned end of direct requests. */
+
+   for(i=0; i<n; i++)
+     if(v[i].result >= 0 && v[i].result < v[i].count)
+     {  sync_transfer(lf, &v[i], write);
+	if(v[i].result < 0 && !error) error = errno;
+     }
+
+   errno = error;
+   return error == 0;
+}
+#endif /* HAVE_IO_URING */
+
+/*
+ * The thread pool fallback
+ */
+
+typedef struct
+{  GMutex *lock;
+   GCond *cond;
+   int pending;
+   int error;
+} io_batch;
+
+typedef struct
+{  LargeFile *lf;
+   LargeIOVec *v;
+   int write;
+   io_batch *batch;
+} io_job;
+
+static GThreadPool *io_pool;
+static GMutex io_pool_lock;
+
+static void io_worker(gpointer data, gpointer unused)
+{  io_job *job = (io_job*)data;
+   io_batch *batch = job->batch;
+
+   job->v->result = 0;
+   sync_transfer(job->lf, job->v, job->write);
+
+   g_mutex_lock(batch->lock);
+   if(job->v->result < 0 && !batch->error)
+     batch->error = errno;
+   if(!--batch->pending)
+     g_cond_signal(batch->cond);
+   g_mutex_unlock(batch->lock);
+}
+
+static int pool_transfer(LargeFile *lf, LargeIOVec *v, int n, int write)
+{  io_job *jobs;
+   io_batch batch;
+   int i;
+
+   /* Without pread()/pwrite() the requests can not run concurrently */
+
+#ifndef SYS_MINGW
+   g_mutex_lock(&io_pool_lock);
+   if(!io_pool)
+     io_pool = g_thread_pool_new(io_worker, NULL, LARGE_IO_THREADS, FALSE, NULL);
+   g_mutex_unlock(&io_pool_lock);
+#endif
+
+   /* No threads at all; do it the old-fashioned way */
+
+   if(!io_pool)
+   {  int error = 0;
+
+      for(i=0; i<n; i++)
+      {  v[i].result = 0;
+	 sync_transfer(lf, &v[i], write);
+	 if(v[i].result < 0 && !error) error = errno;
+      }
+      errno = error;
+      return error == 0;
+   }
+
+   batch.lock = g_malloc(sizeof(GMutex)); g_mutex_init(batch.lock);
+   batch.cond = g_malloc(sizeof(GCond));  g_cond_init(batch.cond);
+   batch.pending = n;
+   batch.error = 0;
+
+   jobs = g_malloc(n*sizeof(io_job));
+   for(i=0; i<n; i++)
+   {  jobs[i].lf = lf;
+      jobs[i].v = &v[i];
+      jobs[i].write = write;
+      jobs[i].batch = &batch;
+      g_thread_pool_push(io_pool, &jobs[i], NULL);
+   }
+
+   g_mutex_lock(batch.lock);
+   while(batch.pending)
+     g_cond_wait(batch.cond, batch.lock);
+   g_mutex_unlock(batch.lock);
+
+   g_free(jobs);
+   g_mutex_clear(batch.lock);
+   g_free(batch.lock);
+   g_cond_clear(batch.cond);
+   g_free(batch.cond);
+
+   errno = batch.error;
+   return batch.error == 0;
+}
+
+static int transfer_vector(LargeFile *lf, LargeIOVec *v, int n, int write)
+{  int i,result;
+
+   if(n <= 0) return TRUE;
+
+#ifdef HAVE_IO_URING
+   if(!lf->ring && !ring_unavailable)
+     lf->ring = create_ring();
+
+   if(lf->ring)
+        result = ring_transfer(lf, v, n, write);
+   else result = pool_transfer(lf, v, n, write);
+#else
+   result = pool_transfer(lf, v, n, write);
+#endif
+
+   /* Errors may show up as short transfers, too */
+
+   if(result)
+     for(i=0; i<n; i++)
+       if(v[i].result != v[i].count)
+	 return FALSE;
+
+   return result;
+}
+
+int LargeReadV(LargeFile *lf, LargeIOVec *v, int n)
+{  
+   return transfer_vector(lf, v, n, FALSE);
+}
+
+int LargeWriteV(LargeFile *lf, LargeIOVec *v, int n)
+{  int result = transfer_vector(lf, v, n, TRUE);
+   int i;
+
+   /* Give the user a chance to free more space in GUI mode;
+      see xwrite() */
+
+   if(!result && Closure->guiMode)
+   {  result = TRUE;
+      for(i=0; i<n; i++)
+	if(v[i].result != v[i].count)
+	{  ssize_t done = v[i].result > 0 ? v[i].result : 0;
+
+	   if(LargeSeek(lf, v[i].offset+done))
+	     v[i].result = done + LargeWrite(lf, (unsigned char*)v[i].buf+done, v[i].count-done);
+	   if(v[i].result != v[i].count)
+	     result = FALSE;
+	}
+   }
+
+   return result;
+}
+
 /*
  * Large file closing
  */
@@ -292,6 +816,14 @@ ssize_t LargeWrite(LargeFile *lf, void *buf, size_t count)
 int LargeClose(LargeFile *lf)
 {  int result = TRUE;
 
+#ifdef HAVE_IO_URING
+   if(lf->ring)
+     free_ring(lf->ring);
+#endif
+
+   if(lf->directHandle > 0)
+     close(lf->directHandle);
+
    result = (close(lf->fileHandle) == 0);
 
    /* Free the LargeFile struct and return results */
@@ -317,6 +849,111 @@ int LargeTruncate(LargeFile *lf, off_t length)
    return result;
 }
 
+/*
+ * Query the physical layout of the file.
+ * Returns the number of extents (sorted by file position),
+ * or -1 if the operating system or file system can not tell.
+ */
+
+#define FIEMAP_BATCH 256
+
+int LargeExtents(LargeFile *lf, LargeExtent **extents_return)
+{
+#ifdef HAVE_FIEMAP
+   struct fiemap *fm;
+   LargeExtent *extents = NULL;
+   guint64 start = 0;
+   int n = 0, allocated = 0;
+   int last = FALSE;
+
+   fm = g_malloc0(sizeof(struct fiemap) + FIEMAP_BATCH*sizeof(struct fiemap_extent));
+
+   while(!last)
+   {  unsigned int i;
+
+      fm->fm_start  = start;
+      fm->fm_length = FIEMAP_MAX_OFFSET - start;
+      fm->fm_flags  = FIEMAP_FLAG_SYNC;  /* get real allocations for delayed writes */
+      fm->fm_mapped_extents = 0;
+      fm->fm_extent_count = FIEMAP_BATCH;
+
+      if(ioctl(lf->fileHandle, FS_IOC_FIEMAP, fm) < 0)
+      {  g_free(fm);
+	 g_free(extents);
+	 return -1;
+      }
+
+      if(!fm->fm_mapped_extents)
+	break;
+
+      if(n + fm->fm_mapped_extents > allocated)
+      {  allocated = 2*(n + fm->fm_mapped_extents);
+	 extents = g_realloc(extents, allocated*sizeof(LargeExtent));
+      }
+
+      for(i=0; i<fm->fm_mapped_extents; i++)
+      {  struct fiemap_extent *fe = &fm->fm_extents[i];
+
+	 extents[n].logical  = fe->fe_logical;
+	 extents[n].physical = fe->fe_physical;
+	 extents[n].length   = fe->fe_length;
+	 extents[n].flags    = fe->fe_flags & ~FIEMAP_EXTENT_LAST;
+	 n++;
+
+	 if(fe->fe_flags & FIEMAP_EXTENT_LAST)
+	   last = TRUE;
+	 start = fe->fe_logical + fe->fe_length;
+      }
+   }
+
+   g_free(fm);
+   *extents_return = extents;
+   return n;
+#else
+   *extents_return = NULL;
+   return -1;
+#endif
+}
+
+/*
+ * Find out whether the file system writes modified data to new
+ * locations (copy on write). Only then does an in-place modification
+ * of the file show up in its extents.
+ */
+
+#define BTRFS_MAGIC    0x9123683e
+#define BCACHEFS_MAGIC 0xca451a4e
+#define ZFS_MAGIC      0x2fc12fc1
+
+int LargeCopyOnWrite(LargeFile *lf)
+{
+#ifdef HAVE_FIEMAP
+   struct statfs fs;
+   int attr = 0;
+
+   if(fstatfs(lf->fileHandle, &fs) < 0)
+     return FALSE;
+
+   switch((guint32)fs.f_type)
+   {  case BTRFS_MAGIC:
+      case BCACHEFS_MAGIC:
+      case ZFS_MAGIC:
+	break;
+      default:
+	return FALSE;
+   }
+
+   /* chattr +C files are overwritten in place */
+
+   if(ioctl(lf->fileHandle, FS_IOC_GETFLAGS, &attr) == 0 && (attr & FS_NOCOW_FL))
+     return FALSE;
+
+   return TRUE;
+#else
+   return FALSE;
+#endif
+}
+
 /*
  * Large file unlinking
  */
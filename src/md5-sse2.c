@@ -0,0 +1,190 @@
+/*  dvdisaster: Additional error correction for optical media.
+ *  Copyright (C) 2004-2017 Carsten Gnoerlich.
+ *  Copyright (C) 2019-2021 The dvdisaster development team.
+ * 
+ *  Email: support@dvdisaster.org
+ *
+ *  This file is part of dvdisaster.
+ *
+ *  dvdisaster is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  dvdisaster is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with dvdisaster. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*** src type: no GUI code ***/
+
+#include "dvdisaster.h"
+
+#ifdef HAVE_SSE2
+  #include <emmintrin.h>
+#endif
+
+/***
+ *** Multi-buffer MD5 using SSE2
+ ***/
+
+/*
+ * Advances four independent MD5 states by the given number of
+ * 64 byte blocks. Each state lives in one 32 bit lane;
+ * in[i] points to the data for ctx[i].
+ * Padding and bit counting is left to MD5UpdateMulti().
+ */
+
+#ifdef HAVE_SSE2
+
+#define F1(x, y, z) _mm_xor_si128(z, _mm_and_si128(x, _mm_xor_si128(y, z)))
+#define F2(x, y, z) F1(z, x, y)
+#define F3(x, y, z) _mm_xor_si128(_mm_xor_si128(x, y), z)
+#define F4(x, y, z) _mm_xor_si128(y, _mm_or_si128(x, _mm_xor_si128(z, ones)))
+
+#define MD5STEP(f, w, x, y, z, data, t, s) \
+   w = _mm_add_epi32(w, _mm_add_epi32(f(x, y, z), _mm_add_epi32(data, _mm_set1_epi32((int)t)))), \
+   w = _mm_or_si128(_mm_slli_epi32(w, s), _mm_srli_epi32(w, 32-s)), \
+   w = _mm_add_epi32(w, x)
+
+/* Gather message word i of all four lanes into x[i] */
+
+static void load_words(__m128i *x, unsigned char const **in, unsigned offset)
+{  int q;
+
+   for(q=0; q<4; q++)
+   {  __m128i r0 = _mm_loadu_si128((__m128i*)(in[0]+offset+16*q));
+      __m128i r1 = _mm_loadu_si128((__m128i*)(in[1]+offset+16*q));
+      __m128i r2 = _mm_loadu_si128((__m128i*)(in[2]+offset+16*q));
+      __m128i r3 = _mm_loadu_si128((__m128i*)(in[3]+offset+16*q));
+      __m128i t0 = _mm_unpacklo_epi32(r0, r1);
+      __m128i t1 = _mm_unpacklo_epi32(r2, r3);
+      __m128i t2 = _mm_unpackhi_epi32(r0, r1);
+      __m128i t3 = _mm_unpackhi_epi32(r2, r3);
+
+      x[4*q  ] = _mm_unpacklo_epi64(t0, t1);
+      x[4*q+1] = _mm_unpackhi_epi64(t0, t1);
+      x[4*q+2] = _mm_unpacklo_epi64(t2, t3);
+      x[4*q+3] = _mm_unpackhi_epi64(t2, t3);
+   }
+}
+
+void md5_transform_sse2(struct MD5Context **ctx, unsigned char const **in, unsigned blocks)
+{  __m128i ones = _mm_set1_epi32(-1);
+   __m128i a,b,c,d;
+   __m128i x[16];
+   guint32 out[4][4];
+   unsigned offset = 0;
+   int i;
+
+   a = _mm_setr_epi32(ctx[0]->buf[0], ctx[1]->buf[0], ctx[2]->buf[0], ctx[3]->buf[0]);
+   b = _mm_setr_epi32(ctx[0]->buf[1], ctx[1]->buf[1], ctx[2]->buf[1], ctx[3]->buf[1]);
+   c = _mm_setr_epi32(ctx[0]->buf[2], ctx[1]->buf[2], ctx[2]->buf[2], ctx[3]->buf[2]);
+   d = _mm_setr_epi32(ctx[0]->buf[3], ctx[1]->buf[3], ctx[2]->buf[3], ctx[3]->buf[3]);
+
+   while(blocks--)
+   {  __m128i aa = a, bb = b, cc = c, dd = d;
+
+      load_words(x, in, offset);
+
+      MD5STEP(F1, a, b, c, d, x[0], 0xd76aa478, 7);
+      MD5STEP(F1, d, a, b, c, x[1], 0xe8c7b756, 12);
+      MD5STEP(F1, c, d, a, b, x[2], 0x242070db, 17);
+      MD5STEP(F1, b, c, d, a, x[3], 0xc1bdceee, 22);
+      MD5STEP(F1, a, b, c, d, x[4], 0xf57c0faf, 7);
+      MD5STEP(F1, d, a, b, c, x[5], 0x4787c62a, 12);
+      MD5STEP(F1, c, d, a, b, x[6], 0xa8304613, 17);
+      MD5STEP(F1, b, c, d, a, x[7], 0xfd469501, 22);
+      MD5STEP(F1, a, b, c, d, x[8], 0x698098d8, 7);
+      MD5STEP(F1, d, a, b, c, x[9], 0x8b44f7af, 12);
+      MD5STEP(F1, c, d, a, b, x[10], 0xffff5bb1, 17);
+      MD5STEP(F1, b, c, d, a, x[11], 0x895cd7be, 22);
+      MD5STEP(F1, a, b, c, d, x[12], 0x6b901122, 7);
+      MD5STEP(F1, d, a, b, c, x[13], 0xfd987193, 12);
+      MD5STEP(F1, c, d, a, b, x[14], 0xa679438e, 17);
+      MD5STEP(F1, b, c, d, a, x[15], 0x49b40821, 22);
+
+      MD5STEP(F2, a, b, c, d, x[1], 0xf61e2562, 5);
+      MD5STEP(F2, d, a, b, c, x[6], 0xc040b340, 9);
+      MD5STEP(F2, c, d, a, b, x[11], 0x265e5a51, 14);
+      MD5STEP(F2, b, c, d, a, x[0], 0xe9b6c7aa, 20);
+      MD5STEP(F2, a, b, c, d, x[5], 0xd62f105d, 5);
+      MD5STEP(F2, d, a, b, c, x[10], 0x02441453, 9);
+      MD5STEP(F2, c, d, a, b, x[15], 0xd8a1e681, 14);
+      MD5STEP(F2, b, c, d, a, x[4], 0xe7d3fbc8, 20);
+      MD5STEP(F2, a, b, c, d, x[9], 0x21e1cde6, 5);
+      MD5STEP(F2, d, a, b, c, x[14], 0xc33707d6, 9);
+      MD5STEP(F2, c, d, a, b, x[3], 0xf4d50d87, 14);
+      MD5STEP(F2, b, c, d, a, x[8], 0x455a14ed, 20);
+      MD5STEP(F2, a, b, c, d, x[13], 0xa9e3e905, 5);
+      MD5STEP(F2, d, a, b, c, x[2], 0xfcefa3f8, 9);
+      MD5STEP(F2, c, d, a, b, x[7], 0x676f02d9, 14);
+      MD5STEP(F2, b, c, d, a, x[12], 0x8d2a4c8a, 20);
+
+      MD5STEP(F3, a, b, c, d, x[5], 0xfffa3942, 4);
+      MD5STEP(F3, d, a, b, c, x[8], 0x8771f681, 11);
+      MD5STEP(F3, c, d, a, b, x[11], 0x6d9d6122, 16);
+      MD5STEP(F3, b, c, d, a, x[14], 0xfde5380c, 23);
+      MD5STEP(F3, a, b, c, d, x[1], 0xa4beea44, 4);
+      MD5STEP(F3, d, a, b, c, x[4], 0x4bdecfa9, 11);
+      MD5STEP(F3, c, d, a, b, x[7], 0xf6bb4b60, 16);
+      MD5STEP(F3, b, c, d, a, x[10], 0xbebfbc70, 23);
+      MD5STEP(F3, a, b, c, d, x[13], 0x289b7ec6, 4);
+      MD5STEP(F3, d, a, b, c, x[0], 0xeaa127fa, 11);
+      MD5STEP(F3, c, d, a, b, x[3], 0xd4ef3085, 16);
+      MD5STEP(F3, b, c, d, a, x[6], 0x04881d05, 23);
+      MD5STEP(F3, a, b, c, d, x[9], 0xd9d4d039, 4);
+      MD5STEP(F3, d, a, b, c, x[12], 0xe6db99e5, 11);
+      MD5STEP(F3, c, d, a, b, x[15], 0x1fa27cf8, 16);
+      MD5STEP(F3, b, c, d, a, x[2], 0xc4ac5665, 23);
+
+      MD5STEP(F4, a, b, c, d, x[0], 0xf4292244, 6);
+      MD5STEP(F4, d, a, b, c, x[7], 0x432aff97, 10);
+      MD5STEP(F4, c, d, a, b, x[14], 0xab9423a7, 15);
+      MD5STEP(F4, b, c, d, a, x[5], 0xfc93a039, 21);
+      MD5STEP(F4, a, b, c, d, x[12], 0x655b59c3, 6);
+      MD5STEP(F4, d, a, b, c, x[3], 0x8f0ccc92, 10);
+      MD5STEP(F4, c, d, a, b, x[10], 0xffeff47d, 15);
+      MD5STEP(F4, b, c, d, a, x[1], 0x85845dd1, 21);
+      MD5STEP(F4, a, b, c, d, x[8], 0x6fa87e4f, 6);
+      MD5STEP(F4, d, a, b, c, x[15], 0xfe2ce6e0, 10);
+      MD5STEP(F4, c, d, a, b, x[6], 0xa3014314, 15);
+      MD5STEP(F4, b, c, d, a, x[13], 0x4e0811a1, 21);
+      MD5STEP(F4, a, b, c, d, x[4], 0xf7537e82, 6);
+      MD5STEP(F4, d, a, b, c, x[11], 0xbd3af235, 10);
+      MD5STEP(F4, c, d, a, b, x[2], 0x2ad7d2bb, 15);
+      MD5STEP(F4, b, c, d, a, x[9], 0xeb86d391, 21);
+
+      a = _mm_add_epi32(a, aa);
+      b = _mm_add_epi32(b, bb);
+      c = _mm_add_epi32(c, cc);
+      d = _mm_add_epi32(d, dd);
+      offset += 64;
+   }
+
+   _mm_storeu_si128((__m128i*)out[0], a);
+   _mm_storeu_si128((__m128i*)out[1], b);
+   _mm_storeu_si128((__m128i*)out[2], c);
+   _mm_storeu_si128((__m128i*)out[3], d);
+
+   for(i=0; i<4; i++)
+   {  ctx[i]->buf[0] = out[0][i];
+      ctx[i]->buf[1] = out[1][i];
+      ctx[i]->buf[2] = out[2][i];
+      ctx[i]->buf[3] = out[3][i];
+   }
+}
+#else /* don't have SSE2 */
+/* Stub function to keep the linker happy.
+ * Should never be executed.
+ */
+
+void md5_transform_sse2(struct MD5Context **ctx, unsigned char const **in, unsigned blocks)
+{
+   Stop("Mega borkage - md5_transform_sse2() stub called.\n");
+}
+#endif /* HAVE_SSE2 */
@@ -37,7 +37,7 @@
 
 #include "md5.h"
 
-static void MD5Transform(guint32 buf[4], guint32 const in[16]);
+static void MD5Transform(guint32 buf[4], guint32 const *in, unsigned blocks);
 
 /*
  * Note: this code is harmless on little-endian machines.
@@ -104,16 +104,28 @@ MD5Update(struct MD5Context *ctx, unsigned char const *buf, unsigned len)
 		}
 		memmove(p, buf, t);
 		byteReverse(ctx->in, 16);
-		MD5Transform(ctx->buf, (guint32 *) ctx->in);
+		MD5Transform(ctx->buf, (guint32 *) ctx->in, 1);
 		buf += t;
 		len -= t;
 	}
+
+	/* On little endian machines, aligned input can be transformed
+	   in place without copying it into ctx->in first. */
+
+#ifdef HAVE_LITTLE_ENDIAN
+	if (len >= 64 && !((size_t)buf & 3)) {
+		MD5Transform(ctx->buf, (guint32 const *) buf, len >> 6);
+		buf += len & ~63;
+		len &= 63;
+	}
+#endif
+
 	/* Process data in 64-byte chunks */
 
 	while (len >= 64) {
 		memmove(ctx->in, buf, 64);
 		byteReverse(ctx->in, 16);
-		MD5Transform(ctx->buf, (guint32 *) ctx->in);
+		MD5Transform(ctx->buf, (guint32 *) ctx->in, 1);
 		buf += 64;
 		len -= 64;
 	}
@@ -150,7 +162,7 @@ MD5Final(unsigned char digest[16], struct MD5Context *ctx)
 		/* Two lots of padding:  Pad the first block to 64 bytes */
 		memset(p, 0, count);
 		byteReverse(ctx->in, 16);
-		MD5Transform(ctx->buf, (guint32 *) ctx->in);
+		MD5Transform(ctx->buf, (guint32 *) ctx->in, 1);
 
 		/* Now fill the next block with 56 bytes */
 		memset(ctx->in, 0, 56);
@@ -185,7 +197,7 @@ MD5Final(unsigned char digest[16], struct MD5Context *ctx)
 	*in++ = (unsigned char)((ctx->bits[1]      ) & 0xff);
 #endif
 
-	MD5Transform(ctx->buf, (guint32 *) ctx->in);
+	MD5Transform(ctx->buf, (guint32 *) ctx->in, 1);
 	byteReverse((unsigned char *) ctx->buf, 4);
 	memmove(digest, ctx->buf, 16);
 	memset(ctx, 0, sizeof(struct MD5Context));	/* In case it's sensitive */
@@ -203,13 +215,20 @@ MD5Final(unsigned char digest[16], struct MD5Context *ctx)
 #define MD5STEP(f, w, x, y, z, data, s) \
 	( w += f(x, y, z) + data,  w = w<<s | w>>(32-s),  w += x )
 
+/* F2 is the sum of two disjoint terms. The one not depending on x
+   (the result of the previous step) can be added in early. */
+#define MD5STEP2(w, x, y, z, data, s) \
+	( w += (y & ~z) + data,  w += x & z,  w = w<<s | w>>(32-s),  w += x )
+
 /*
  * The core of the MD5 algorithm, this alters an existing MD5 hash to
  * reflect the addition of 16 longwords of new data.  MD5Update blocks
  * the data and converts bytes into longwords for this routine.
+ * Several consecutive blocks can be processed at once, keeping
+ * the hash state in registers in between.
  */
 static void
-MD5Transform(guint32 buf[4], guint32 const in[16])
+MD5Transform(guint32 buf[4], guint32 const *in, unsigned blocks)
 {
 	register guint32 a, b, c, d;
 
@@ -218,78 +237,88 @@ MD5Transform(guint32 buf[4], guint32 const in[16])
 	c = buf[2];
 	d = buf[3];
 
-	MD5STEP(F1, a, b, c, d, in[0] + 0xd76aa478, 7);
-	MD5STEP(F1, d, a, b, c, in[1] + 0xe8c7b756, 12);
-	MD5STEP(F1, c, d, a, b, in[2] + 0x242070db, 17);
-	MD5STEP(F1, b, c, d, a, in[3] + 0xc1bdceee, 22);
-	MD5STEP(F1, a, b, c, d, in[4] + 0xf57c0faf, 7);
-	MD5STEP(F1, d, a, b, c, in[5] + 0x4787c62a, 12);
-	MD5STEP(F1, c, d, a, b, in[6] + 0xa8304613, 17);
-	MD5STEP(F1, b, c, d, a, in[7] + 0xfd469501, 22);
-	MD5STEP(F1, a, b, c, d, in[8] + 0x698098d8, 7);
-	MD5STEP(F1, d, a, b, c, in[9] + 0x8b44f7af, 12);
-	MD5STEP(F1, c, d, a, b, in[10] + 0xffff5bb1, 17);
-	MD5STEP(F1, b, c, d, a, in[11] + 0x895cd7be, 22);
-	MD5STEP(F1, a, b, c, d, in[12] + 0x6b901122, 7);
-	MD5STEP(F1, d, a, b, c, in[13] + 0xfd987193, 12);
-	MD5STEP(F1, c, d, a, b, in[14] + 0xa679438e, 17);
-	MD5STEP(F1, b, c, d, a, in[15] + 0x49b40821, 22);
-
-	MD5STEP(F2, a, b, c, d, in[1] + 0xf61e2562, 5);
-	MD5STEP(F2, d, a, b, c, in[6] + 0xc040b340, 9);
-	MD5STEP(F2, c, d, a, b, in[11] + 0x265e5a51, 14);
-	MD5STEP(F2, b, c, d, a, in[0] + 0xe9b6c7aa, 20);
-	MD5STEP(F2, a, b, c, d, in[5] + 0xd62f105d, 5);
-	MD5STEP(F2, d, a, b, c, in[10] + 0x02441453, 9);
-	MD5STEP(F2, c, d, a, b, in[15] + 0xd8a1e681, 14);
-	MD5STEP(F2, b, c, d, a, in[4] + 0xe7d3fbc8, 20);
-	MD5STEP(F2, a, b, c, d, in[9] + 0x21e1cde6, 5);
-	MD5STEP(F2, d, a, b, c, in[14] + 0xc33707d6, 9);
-	MD5STEP(F2, c, d, a, b, in[3] + 0xf4d50d87, 14);
-	MD5STEP(F2, b, c, d, a, in[8] + 0x455a14ed, 20);
-	MD5STEP(F2, a, b, c, d, in[13] + 0xa9e3e905, 5);
-	MD5STEP(F2, d, a, b, c, in[2] + 0xfcefa3f8, 9);
-	MD5STEP(F2, c, d, a, b, in[7] + 0x676f02d9, 14);
-	MD5STEP(F2, b, c, d, a, in[12] + 0x8d2a4c8a, 20);
-
-	MD5STEP(F3, a, b, c, d, in[5] + 0xfffa3942, 4);
-	MD5STEP(F3, d, a, b, c, in[8] + 0x8771f681, 11);
-	MD5STEP(F3, c, d, a, b, in[11] + 0x6d9d6122, 16);
-	MD5STEP(F3, b, c, d, a, in[14] + 0xfde5380c, 23);
-	MD5STEP(F3, a, b, c, d, in[1] + 0xa4beea44, 4);
-	MD5STEP(F3, d, a, b, c, in[4] + 0x4bdecfa9, 11);
-	MD5STEP(F3, c, d, a, b, in[7] + 0xf6bb4b60, 16);
-	MD5STEP(F3, b, c, d, a, in[10] + 0xbebfbc70, 23);
-	MD5STEP(F3, a, b, c, d, in[13] + 0x289b7ec6, 4);
-	MD5STEP(F3, d, a, b, c, in[0] + 0xeaa127fa, 11);
-	MD5STEP(F3, c, d, a, b, in[3] + 0xd4ef3085, 16);
-	MD5STEP(F3, b, c, d, a, in[6] + 0x04881d05, 23);
-	MD5STEP(F3, a, b, c, d, in[9] + 0xd9d4d039, 4);
-	MD5STEP(F3, d, a, b, c, in[12] + 0xe6db99e5, 11);
-	MD5STEP(F3, c, d, a, b, in[15] + 0x1fa27cf8, 16);
-	MD5STEP(F3, b, c, d, a, in[2] + 0xc4ac5665, 23);
-
-	MD5STEP(F4, a, b, c, d, in[0] + 0xf4292244, 6);
-	MD5STEP(F4, d, a, b, c, in[7] + 0x432aff97, 10);
-	MD5STEP(F4, c, d, a, b, in[14] + 0xab9423a7, 15);
-	MD5STEP(F4, b, c, d, a, in[5] + 0xfc93a039, 21);
-	MD5STEP(F4, a, b, c, d, in[12] + 0x655b59c3, 6);
-	MD5STEP(F4, d, a, b, c, in[3] + 0x8f0ccc92, 10);
-	MD5STEP(F4, c, d, a, b, in[10] + 0xffeff47d, 15);
-	MD5STEP(F4, b, c, d, a, in[1] + 0x85845dd1, 21);
-	MD5STEP(F4, a, b, c, d, in[8] + 0x6fa87e4f, 6);
-	MD5STEP(F4, d, a, b, c, in[15] + 0xfe2ce6e0, 10);
-	MD5STEP(F4, c, d, a, b, in[6] + 0xa3014314, 15);
-	MD5STEP(F4, b, c, d, a, in[13] + 0x4e0811a1, 21);
-	MD5STEP(F4, a, b, c, d, in[4] + 0xf7537e82, 6);
-	MD5STEP(F4, d, a, b, c, in[11] + 0xbd3af235, 10);
-	MD5STEP(F4, c, d, a, b, in[2] + 0x2ad7d2bb, 15);
-	MD5STEP(F4, b, c, d, a, in[9] + 0xeb86d391, 21);
-
-	buf[0] += a;
-	buf[1] += b;
-	buf[2] += c;
-	buf[3] += d;
+	while (blocks--) {
+		guint32 aa = a, bb = b, cc = c, dd = d;
+
+		MD5STEP(F1, a, b, c, d, in[0] + 0xd76aa478, 7);
+		MD5STEP(F1, d, a, b, c, in[1] + 0xe8c7b756, 12);
+		MD5STEP(F1, c, d, a, b, in[2] + 0x242070db, 17);
+		MD5STEP(F1, b, c, d, a, in[3] + 0xc1bdceee, 22);
+		MD5STEP(F1, a, b, c, d, in[4] + 0xf57c0faf, 7);
+		MD5STEP(F1, d, a, b, c, in[5] + 0x4787c62a, 12);
+		MD5STEP(F1, c, d, a, b, in[6] + 0xa8304613, 17);
+		MD5STEP(F1, b, c, d, a, in[7] + 0xfd469501, 22);
+		MD5STEP(F1, a, b, c, d, in[8] + 0x698098d8, 7);
+		MD5STEP(F1, d, a, b, c, in[9] + 0x8b44f7af, 12);
+		MD5STEP(F1, c, d, a, b, in[10] + 0xffff5bb1, 17);
+		MD5STEP(F1, b, c, d, a, in[11] + 0x895cd7be, 22);
+		MD5STEP(F1, a, b, c, d, in[12] + 0x6b901122, 7);
+		MD5STEP(F1, d, a, b, c, in[13] + 0xfd987193, 12);
+		MD5STEP(F1, c, d, a, b, in[14] + 0xa679438e, 17);
+		MD5STEP(F1, b, c, d, a, in[15] + 0x49b40821, 22);
+
+		MD5STEP2(a, b, c, d, in[1] + 0xf61e2562, 5);
+		MD5STEP2(d, a, b, c, in[6] + 0xc040b340, 9);
+		MD5STEP2(c, d, a, b, in[11] + 0x265e5a51, 14);
+		MD5STEP2(b, c, d, a, in[0] + 0xe9b6c7aa, 20);
+		MD5STEP2(a, b, c, d, in[5] + 0xd62f105d, 5);
+		MD5STEP2(d, a, b, c, in[10] + 0x02441453, 9);
+		MD5STEP2(c, d, a, b, in[15] + 0xd8a1e681, 14);
+		MD5STEP2(b, c, d, a, in[4] + 0xe7d3fbc8, 20);
+		MD5STEP2(a, b, c, d, in[9] + 0x21e1cde6, 5);
+		MD5STEP2(d, a, b, c, in[14] + 0xc33707d6, 9);
+		MD5STEP2(c, d, a, b, in[3] + 0xf4d50d87, 14);
+		MD5STEP2(b, c, d, a, in[8] + 0x455a14ed, 20);
+		MD5STEP2(a, b, c, d, in[13] + 0xa9e3e905, 5);
+		MD5STEP2(d, a, b, c, in[2] + 0xfcefa3f8, 9);
+		MD5STEP2(c, d, a, b, in[7] + 0x676f02d9, 14);
+		MD5STEP2(b, c, d, a, in[12] + 0x8d2a4c8a, 20);
+
+		MD5STEP(F3, a, b, c, d, in[5] + 0xfffa3942, 4);
+		MD5STEP(F3, d, a, b, c, in[8] + 0x8771f681, 11);
+		MD5STEP(F3, c, d, a, b, in[11] + 0x6d9d6122, 16);
+		MD5STEP(F3, b, c, d, a, in[14] + 0xfde5380c, 23);
+		MD5STEP(F3, a, b, c, d, in[1] + 0xa4beea44, 4);
+		MD5STEP(F3, d, a, b, c, in[4] + 0x4bdecfa9, 11);
+		MD5STEP(F3, c, d, a, b, in[7] + 0xf6bb4b60, 16);
+		MD5STEP(F3, b, c, d, a, in[10] + 0xbebfbc70, 23);
+		MD5STEP(F3, a, b, c, d, in[13] + 0x289b7ec6, 4);
+		MD5STEP(F3, d, a, b, c, in[0] + 0xeaa127fa, 11);
+		MD5STEP(F3, c, d, a, b, in[3] + 0xd4ef3085, 16);
+		MD5STEP(F3, b, c, d, a, in[6] + 0x04881d05, 23);
+		MD5STEP(F3, a, b, c, d, in[9] + 0xd9d4d039, 4);
+		MD5STEP(F3, d, a, b, c, in[12] + 0xe6db99e5, 11);
+		MD5STEP(F3, c, d, a, b, in[15] + 0x1fa27cf8, 16);
+		MD5STEP(F3, b, c, d, a, in[2] + 0xc4ac5665, 23);
+
+		MD5STEP(F4, a, b, c, d, in[0] + 0xf4292244, 6);
+		MD5STEP(F4, d, a, b, c, in[7] + 0x432aff97, 10);
+		MD5STEP(F4, c, d, a, b, in[14] + 0xab9423a7, 15);
+		MD5STEP(F4, b, c, d, a, in[5] + 0xfc93a039, 21);
+		MD5STEP(F4, a, b, c, d, in[12] + 0x655b59c3, 6);
+		MD5STEP(F4, d, a, b, c, in[3] + 0x8f0ccc92, 10);
+		MD5STEP(F4, c, d, a, b, in[10] + 0xffeff47d, 15);
+		MD5STEP(F4, b, c, d, a, in[1] + 0x85845dd1, 21);
+		MD5STEP(F4, a, b, c, d, in[8] + 0x6fa87e4f, 6);
+		MD5STEP(F4, d, a, b, c, in[15] + 0xfe2ce6e0, 10);
+		MD5STEP(F4, c, d, a, b, in[6] + 0xa3014314, 15);
+		MD5STEP(F4, b, c, d, a, in[13] + 0x4e0811a1, 21);
+		MD5STEP(F4, a, b, c, d, in[4] + 0xf7537e82, 6);
+		MD5STEP(F4, d, a, b, c, in[11] + 0xbd3af235, 10);
+		MD5STEP(F4, c, d, a, b, in[2] + 0x2ad7d2bb, 15);
+		MD5STEP(F4, b, c, d, a, in[9] + 0xeb86d391, 21);
+
+		a += aa;
+		b += bb;
+		c += cc;
+		d += dd;
+		in += 16;
+	}
+
+	buf[0] = a;
+	buf[1] = b;
+	buf[2] = c;
+	buf[3] = d;
 }
 
 /***
@@ -312,6 +341,207 @@ void AsciiDigest(char *out, unsigned char *in)
    out[o] = 0;
 }
 
+#ifndef SIMPLE_MD5SUM
+
+/*
+ * Multi-buffer MD5: advance n independent contexts by len bytes each.
+ * Contexts sitting at a block boundary are processed side by side
+ * in the SIMD lanes of md5_transform_sse2() / md5_transform_avx2();
+ * all others take the ordinary MD5Update() path.
+ * The resulting digests are identical to n separate MD5Update() calls.
+ */
+
+static void advance_lanes(struct MD5Context **lane, unsigned char const **in, 
+			  int count, unsigned len)
+{  unsigned blocks = len >> 6;
+   int i;
+
+   if(count == 1)
+   {  MD5Update(lane[0], in[0], len);
+      return;
+   }
+
+   /* Pad unused lanes with copies of the first one; 
+      they write back the same result. */
+
+   if(count <= 4 && Closure->useSSE2)
+   {  for(i=count; i<4; i++)
+      {  lane[i] = lane[0];
+	 in[i] = in[0];
+      }
+      md5_transform_sse2(lane, in, blocks);
+   }
+   else
+   {  for(i=count; i<8; i++)
+      {  lane[i] = lane[0];
+	 in[i] = in[0];
+      }
+      md5_transform_avx2(lane, in, blocks);
+   }
+
+   /* Update the bit counters and keep the remaining bytes */
+
+   for(i=0; i<count; i++)
+   {  struct MD5Context *ctx = lane[i];
+      guint32 t = ctx->bits[0];
+
+      if((ctx->bits[0] = t + ((guint32) len << 3)) < t)
+	ctx->bits[1]++;
+      ctx->bits[1] += len >> 29;
+
+      memcpy(ctx->in, in[i] + (blocks << 6), len & 63);
+   }
+}
+
+void MD5UpdateMulti(struct MD5Context **ctx, unsigned char const **buf, unsigned len, int n)
+{  struct MD5Context *lane[MD5_MAX_LANES];
+   unsigned char const *in[MD5_MAX_LANES];
+   int width,i,count;
+
+   if(Closure->useAVX2) width = 8;
+   else if(Closure->useSSE2) width = 4;
+   else width = 1;
+
+   if(width == 1 || len < 64)
+   {  for(i=0; i<n; i++)
+	MD5Update(ctx[i], buf[i], len);
+      return;
+   }
+
+   count = 0;
+   for(i=0; i<n; i++)
+   {  if((ctx[i]->bits[0] >> 3) & 0x3f)  /* not at a block boundary */
+      {  MD5Update(ctx[i], buf[i], len);
+	 continue;
+      }
+
+      lane[count] = ctx[i];
+      in[count]   = buf[i];
+      if(++count == width)
+      {  advance_lanes(lane, in, count, len);
+	 count = 0;
+      }
+   }
+
+   if(count)
+     advance_lanes(lane, in, count, len);
+}
+
+/*
+ * Computing the md5sum of a whole image is inherently sequential,
+ * but it does not need to hold up the reading and checking loop.
+ * A MD5Pipe collects the data in a pair of buffers and hashes
+ * the filled one on a helper thread while the other one is refilled.
+ */
+
+static gpointer md5_pipe_thread(MD5Pipe *mp)
+{
+   g_mutex_lock(mp->lock);
+   for(;;)
+   {  while(!mp->pending && !mp->quit)
+	g_cond_wait(mp->cond, mp->lock);
+      if(!mp->pending) 
+	break;
+      g_mutex_unlock(mp->lock);
+
+      MD5Update(&mp->ctxt, mp->buf[!mp->active], mp->pending);
+
+      g_mutex_lock(mp->lock);
+      mp->pending = 0;
+      g_cond_broadcast(mp->cond);
+   }
+   g_mutex_unlock(mp->lock);
+
+   return NULL;
+}
+
+MD5Pipe* CreateMD5Pipe(void)
+{  MD5Pipe *mp = g_malloc0(sizeof(MD5Pipe));
+
+   MD5Init(&mp->ctxt);
+   mp->buf[0] = g_malloc(MD5_PIPE_BUFSIZE);
+   mp->buf[1] = g_malloc(MD5_PIPE_BUFSIZE);
+   mp->lock = g_malloc(sizeof(GMutex)); g_mutex_init(mp->lock);
+   mp->cond = g_malloc(sizeof(GCond));  g_cond_init(mp->cond);
+
+   /* Without the helper thread everything is hashed in place */
+
+   mp->thread = g_thread_try_new("md5", (GThreadFunc)md5_pipe_thread, (gpointer)mp, NULL);
+
+   return mp;
+}
+
+static void hand_over(MD5Pipe *mp)
+{
+   g_mutex_lock(mp->lock);
+   while(mp->pending)
+     g_cond_wait(mp->cond, mp->lock);
+   mp->pending = mp->fill;
+   mp->active = !mp->active;
+   mp->fill = 0;
+   g_cond_broadcast(mp->cond);
+   g_mutex_unlock(mp->lock);
+}
+
+void MD5PipeUpdate(MD5Pipe *mp, unsigned char const *buf, unsigned len)
+{
+   if(!mp->thread)
+   {  MD5Update(&mp->ctxt, buf, len);
+      return;
+   }
+
+   while(len)
+   {  unsigned n = MD5_PIPE_BUFSIZE - mp->fill;
+
+      if(n > len) n = len;
+      memcpy(mp->buf[mp->active] + mp->fill, buf, n);
+      mp->fill += n;
+      buf += n;
+      len -= n;
+
+      if(mp->fill == MD5_PIPE_BUFSIZE)
+	hand_over(mp);
+   }
+}
+
+static void stop_md5_pipe(MD5Pipe *mp)
+{
+   if(!mp->thread)
+     return;
+
+   g_mutex_lock(mp->lock);
+   mp->quit = TRUE;
+   g_cond_broadcast(mp->cond);
+   g_mutex_unlock(mp->lock);
+
+   g_thread_join(mp->thread);
+   mp->thread = NULL;
+}
+
+void MD5PipeFinal(unsigned char digest[16], MD5Pipe *mp)
+{
+   if(mp->thread && mp->fill)
+     hand_over(mp);
+   stop_md5_pipe(mp);
+
+   MD5Final(digest, &mp->ctxt);
+}
+
+void FreeMD5Pipe(MD5Pipe *mp)
+{
+   stop_md5_pipe(mp);
+
+   g_mutex_clear(mp->lock);
+   g_free(mp->lock);
+   g_cond_clear(mp->cond);
+   g_free(mp->cond);
+   g_free(mp->buf[0]);
+   g_free(mp->buf[1]);
+   g_free(mp);
+}
+
+#endif /* SIMPLE_MD5SUM */
+
 /*
  * Wrapper for creating a simple md5sum binary.
  * This emulates "md5sum -b", as md5sum is not available per
@@ -18,4 +18,38 @@ void MD5Final(unsigned char digest[16], struct MD5Context *context);
 
 void AsciiDigest(char*, unsigned char*);
 
+#if !defined(SIMPLE_MD5SUM)
+
+/* Multi-buffer md5 sums */
+
+#define MD5_MAX_LANES 8
+
+void MD5UpdateMulti(struct MD5Context**, unsigned char const**, unsigned, int);
+
+void md5_transform_sse2(struct MD5Context**, unsigned char const**, unsigned);
+void md5_transform_avx2(struct MD5Context**, unsigned char const**, unsigned);
+
+/* md5 sums computed on a helper thread */
+
+#define MD5_PIPE_BUFSIZE (256*1024)
+
+typedef struct _MD5Pipe
+{  struct MD5Context ctxt;
+   GThread *thread;
+   GMutex *lock;
+   GCond *cond;
+   unsigned char *buf[2];
+   int active;        /* buffer currently filled by the caller */
+   unsigned fill;     /* bytes in the active buffer */
+   unsigned pending;  /* bytes in the other buffer waiting to be hashed */
+   int quit;
+} MD5Pipe;
+
+MD5Pipe* CreateMD5Pipe(void);
+void MD5PipeUpdate(MD5Pipe*, unsigned char const*, unsigned);
+void MD5PipeFinal(unsigned char digest[16], MD5Pipe*);
+void FreeMD5Pipe(MD5Pipe*);
+
+#endif
+
 #endif /* MD5_H */
@@ -282,6 +282,52 @@ static void calculate_failures(raw_editor_context *rec)
  *** Browsing heuristics
  ***/
 
+/*
+ * Sectors from the defective sector store are picked by LBA
+ */
+
+static int select_store_sector(raw_editor_context *rec, gint64 *lba_out)
+{  GtkWidget *dialog, *combo;
+   gint64 *lbas;
+   int n_sectors,i,selected = -1;
+
+   lbas = ListDefectiveStoreSectors(rec->filepath, &n_sectors);
+   if(!n_sectors)
+   {  g_free(lbas);
+      GuiSetLabelText(rec->rightLabel, _("%s contains no sectors."), rec->filepath);
+      return FALSE;
+   }
+
+   dialog = gtk_dialog_new_with_buttons(_utf("Select sector from store"),
+					Closure->window,
+					GTK_DIALOG_MODAL | GTK_DIALOG_DESTROY_WITH_PARENT,
+					_("_Cancel"), GTK_RESPONSE_CANCEL,
+					_("_Open"), GTK_RESPONSE_ACCEPT,
+					NULL);
+
+   combo = gtk_combo_box_text_new();
+   for(i=0; i<n_sectors; i++)
+   {  char text[40];
+
+      g_snprintf(text, 40, "LBA %" PRId64, lbas[i]);
+      gtk_combo_box_text_append_text(GTK_COMBO_BOX_TEXT(combo), text);
+   }
+   gtk_combo_box_set_active(GTK_COMBO_BOX(combo), 0);
+   gtk_box_pack_start(GTK_BOX(gtk_dialog_get_content_area(GTK_DIALOG(dialog))), 
+		      combo, FALSE, FALSE, 10);
+   gtk_widget_show_all(dialog);
+
+   if(gtk_dialog_run(GTK_DIALOG(dialog)) == GTK_RESPONSE_ACCEPT)
+      selected = gtk_combo_box_get_active(GTK_COMBO_BOX(combo));
+   gtk_widget_destroy(dialog);
+
+   if(selected >= 0)
+      *lba_out = lbas[selected];
+
+   g_free(lbas);
+   return selected >= 0;
+}
+
 /*
  * raw sector file selection
  */
@@ -307,7 +353,20 @@ static void file_select_cb(GtkWidget *widget, gpointer data)
             g_free(rec->filepath);
          rec->filepath = gtk_file_chooser_get_filename (GTK_FILE_CHOOSER (dialog));
          ResetRawBuffer(rec->rb);
-         ReadDefectiveSectorFile(rec->dsh, rec->rb, rec->filepath);
+         if(IsDefectiveSectorStore(rec->filepath))
+         {  gint64 lba;
+
+            if(!select_store_sector(rec, &lba))
+            {  gtk_widget_destroy (dialog);
+               return;
+            }
+            ReadDefectiveSectorStore(rec->dsh, rec->rb, rec->filepath, lba);
+         }
+         else ReadDefectiveSectorFile(rec->dsh, rec->rb, rec->filepath);
+         if(!rec->rb->samplesRead)
+         {  gtk_widget_destroy (dialog);
+            return;
+         }
          PrintPQStats(rec->rb);
          memcpy(rec->rb->recovered, rec->rb->rawBuf[0], rec->rb->sampleSize);
          memcpy(rec->undoRing[0], rec->rb->rawBuf[0], rec->rb->sampleSize);
@@ -24,44 +24,10 @@
 
 #include "dvdisaster.h"
 
-/*
- * Write the raw dump header
- */
-
-static void init_defective_sector_file(char *path, RawBuffer *rb, LargeFile **file, DefectiveSectorHeader *dsh)
-{   int n;
-
-    *file = LargeOpen(path, O_RDWR | O_CREAT, IMG_PERMS);
-
-    if(!*file)
-       Stop(_("Could not open %s: %s"), path, strerror(errno));
-
-    memset(dsh, 0, sizeof(DefectiveSectorHeader));
-    dsh->lba        = rb->lba;
-    dsh->sectorSize = CD_RAW_DUMP_SIZE;
-
-    if(rb->xaMode)
-       dsh->properties |= DSH_XA_MODE;
-
-    if(rb->validFP)
-    {  memcpy(dsh->mediumFP, rb->mediumFP, 16);
-       dsh->properties |= DSH_HAS_FINGERPRINT;
-    }
-
-#ifdef HAVE_BIG_ENDIAN
-    SwapDefectiveHeaderBytes(dsh);
-#endif
-
-    n = LargeWrite(*file, dsh, sizeof(DefectiveSectorHeader));
-
-#ifdef HAVE_BIG_ENDIAN
-    SwapDefectiveHeaderBytes(dsh);
+#ifdef HAVE_MMAP
+  #include <sys/mman.h>
 #endif
 
-    if(n != sizeof(DefectiveSectorHeader))
-       Stop(_("Failed writing to defective sector file: %s"), strerror(errno));
-}
-
 /*
  * Open raw dump, read the header
  */
@@ -172,160 +138,686 @@ static void open_defective_sector_file(RawBuffer *rb, char *path, LargeFile **fi
     }
 }
 
+/***
+ *** The defective sector store
+ ***
+ * All raw samples of defective sectors are appended to a single file
+ * <dDumpDir>/<dDumpPrefix>store.rss. When the store is opened, an
+ * index is built from the memory mapped file: one hash table maps
+ * each LBA to the offsets of its records, another one contains the
+ * md5 sums of all records for finding duplicate samples.
+ * The store stays open until the raw reading is finished.
+ */
+
+typedef struct
+{  gint64 lba;
+   int nRecords, maxRecords;
+   guint64 *offsets;          /* file positions of the records */
+} StoreEntry;
+
+typedef struct
+{  char *path;
+   LargeFile *file;
+   DefectiveStoreHeader dss;
+   guint64 recordSize;        /* DefectiveStoreRecord plus sector */
+   guint64 size;              /* current file size */
+   unsigned char *map;        /* mmap()ed part of the file */
+   guint64 mapSize;
+   unsigned char *buf;        /* one record, if we can not mmap() */
+   GHashTable *lbaIndex;      /* lba -> StoreEntry */
+   GHashTable *md5Index;      /* md5sums of all records */
+} DefectiveStore;
+
+static DefectiveStore *store;
+
+static guint md5_hash(gconstpointer key)
+{  guint hash;
+
+   memcpy(&hash, key, sizeof(guint));
+   return hash;
+}
+
+static gboolean md5_equal(gconstpointer a, gconstpointer b)
+{
+   return !memcmp(a, b, 16);
+}
+
+static void free_store_entry(gpointer data)
+{  StoreEntry *entry = (StoreEntry*)data;
+
+   g_free(entry->offsets);
+   g_free(entry);
+}
+
 /*
- * Append RawBuffer contents to defective sector dump
+ * The md5sum of a record covers its LBA and the sector.
+ * As before, the last byte is excluded as it carries the C2 flag.
  */
 
-int SaveDefectiveSector(RawBuffer *rb, int can_c2_scan)
-{  LargeFile *file;
-   DefectiveSectorHeader *dsh = alloca(sizeof(DefectiveSectorHeader));
-   unsigned char *cache_sectors = NULL;
-   char *filename;
-   guint64 length,offset;
-   int count=0;
-   int i,j,idx;
+static void sample_md5sum(gint64 lba, unsigned char *sample, int size, unsigned char *md5sum)
+{  MD5Context ctxt;
+   guint64 le_lba = lba;
 
-   if(!rb->samplesRead) 
-     return 0;  /* Nothing to be done */
+#ifdef HAVE_BIG_ENDIAN
+   le_lba = SwapBytes64(le_lba);
+#endif
 
-   /* Open cache file */
+   MD5Init(&ctxt);
+   MD5Update(&ctxt, (unsigned char*)&le_lba, sizeof(le_lba));
+   MD5Update(&ctxt, sample, size-1);
+   MD5Final(md5sum, &ctxt);
+}
 
-   filename = g_strdup_printf("%s/%s%lld.raw", 
-			      Closure->dDumpDir, Closure->dDumpPrefix, 
-			      (long long)rb->lba);
+/*
+ * Make the record at the given file offset accessible.
+ * The mapping is extended when records were appended since.
+ */
 
-   if(!LargeStat(filename, &length))
-   {  PrintCLIorLabel(Closure->status,_(" [Creating new cache file %s]\n"), filename);
-      init_defective_sector_file(filename, rb, &file, dsh);
+static unsigned char* get_record(DefectiveStore *ds, guint64 offset)
+{
+#ifdef HAVE_MMAP
+   if(offset + ds->recordSize > ds->mapSize)
+   {  if(ds->map)
+	 munmap(ds->map, ds->mapSize);
+
+      ds->mapSize = ds->size;
+      ds->map = mmap(NULL, ds->mapSize, PROT_READ, MAP_SHARED, 
+		     ds->file->fileHandle, 0);
+      if(ds->map == MAP_FAILED)
+      {  ds->map = NULL;
+	 ds->mapSize = 0;
+	 Stop(_("Failed mmap()ing defective sector store %s: %s"), ds->path, strerror(errno));
+      }
    }
-   else 
-   {  open_defective_sector_file(rb, filename, &file, dsh);
-      if(!file)
-	 Stop(_("Could not open %s: %s"), filename, strerror(errno));
+
+   return ds->map + offset;
+#else
+   if(!LargeSeek(ds->file, offset))
+      Stop(_("Failed seeking in defective sector file: %s"), strerror(errno));
+   if(LargeRead(ds->file, ds->buf, ds->recordSize) != ds->recordSize)
+      Stop(_("Failed reading from defective sector file: %s"), strerror(errno));
+
+   return ds->buf;
+#endif
+}
+
+/*
+ * Enter a record into both indices
+ */
+
+static void index_record(DefectiveStore *ds, gint64 lba, unsigned char *md5sum, guint64 offset)
+{  StoreEntry *entry = g_hash_table_lookup(ds->lbaIndex, &lba);
+
+   if(!entry)
+   {  entry = g_malloc0(sizeof(StoreEntry));
+      entry->lba = lba;
+      g_hash_table_insert(ds->lbaIndex, &entry->lba, entry);
    }
 
-   /* Read already cached sectors */
+   if(entry->nRecords >= entry->maxRecords)
+   {  entry->maxRecords = entry->maxRecords ? 2*entry->maxRecords : 4;
+      entry->offsets = g_realloc(entry->offsets, entry->maxRecords*sizeof(guint64));
+   }
+   entry->offsets[entry->nRecords++] = offset;
 
-   if(dsh->nSectors > 0)
-   {  if(!LargeSeek(file, sizeof(DefectiveSectorHeader)))
-	 Stop(_("Failed seeking in defective sector file: %s"), strerror(errno));
+   if(!g_hash_table_lookup(ds->md5Index, md5sum))
+   {  unsigned char *key = g_malloc(16);
 
-      cache_sectors = g_malloc((gsize)dsh->sectorSize*dsh->nSectors);
-      for(i=0, idx=0; i<dsh->nSectors; i++, idx+=dsh->sectorSize)
-      {  int n=LargeRead(file, cache_sectors+idx, dsh->sectorSize);
-	 
-	 if(n != dsh->sectorSize)
-	    Stop(_("Failed reading from defective sector file: %s"), strerror(errno));
-      }
+      memcpy(key, md5sum, 16);
+      g_hash_table_insert(ds->md5Index, key, key);
    }
+}
 
-   /* Store sectors which are not already cached */
-   
-   offset = sizeof(DefectiveSectorHeader) + (guint64)dsh->sectorSize*dsh->nSectors;
-   if(!LargeSeek(file, offset))
+static void write_store_header(DefectiveStore *ds)
+{  int n;
+
+   if(!LargeSeek(ds->file, 0))
       Stop(_("Failed seeking in defective sector file: %s"), strerror(errno));
 
-   for(i=0; i<rb->samplesRead; i++)
-   {  int new_sector = TRUE;
+#ifdef HAVE_BIG_ENDIAN
+   SwapDefectiveStoreHeaderBytes(&ds->dss);
+#endif
+   n = LargeWrite(ds->file, &ds->dss, sizeof(DefectiveStoreHeader));
+#ifdef HAVE_BIG_ENDIAN
+   SwapDefectiveStoreHeaderBytes(&ds->dss);
+#endif
+
+   if(n != sizeof(DefectiveStoreHeader))
+      Stop(_("Failed writing to defective sector file: %s"), strerror(errno));
+}
 
-      /* See comment below on C2 mask field to understand rb->sampleSize-1 */
+void CloseDefectiveSectorStore(void)
+{
+   if(!store) return;
 
-      if(cache_sectors)  /* Sector already in cache? */
-      {  
-	 for(j=0, idx=0; j<dsh->nSectors; j++, idx+=dsh->sectorSize) 
-	 {  if(!memcmp(rb->rawBuf[i], cache_sectors+idx, rb->sampleSize-1))
-	    {  new_sector = FALSE;
-	       break;
-	    }
-	 }
+#ifdef HAVE_MMAP
+   if(store->map)
+      munmap(store->map, store->mapSize);
+#endif
+   if(store->file)
+      LargeClose(store->file);
+
+   g_hash_table_destroy(store->lbaIndex);
+   g_hash_table_destroy(store->md5Index);
+   g_free(store->buf);
+   g_free(store->path);
+   g_free(store);
+   store = NULL;
+}
+
+/*
+ * Open (or create) the store and build its index
+ */
+
+static DefectiveStore* open_store(RawBuffer *rb)
+{  DefectiveStore *ds;
+   char *path;
+   guint64 length,offset;
+   int n;
+
+   path = g_strdup_printf("%s/%sstore.rss", Closure->dDumpDir, Closure->dDumpPrefix);
+
+   if(store && !strcmp(store->path, path))
+   {  g_free(path);
+      return store;
+   }
+
+   CloseDefectiveSectorStore();
+
+   ds = store = g_malloc0(sizeof(DefectiveStore));
+   ds->path       = path;
+   ds->recordSize = sizeof(DefectiveStoreRecord) + CD_RAW_DUMP_SIZE;
+   ds->buf        = g_malloc(ds->recordSize);
+   ds->lbaIndex   = g_hash_table_new_full(g_int64_hash, g_int64_equal, NULL, free_store_entry);
+   ds->md5Index   = g_hash_table_new_full(md5_hash, md5_equal, g_free, NULL);
+
+   /* Create a new store */
+
+   if(!LargeStat(path, &length))
+   {  PrintCLIorLabel(Closure->status,_(" [Creating new defective sector store %s]\n"), path);
+
+      ds->file = LargeOpen(path, O_RDWR | O_CREAT, IMG_PERMS);
+      if(!ds->file)
+	 Stop(_("Could not open %s: %s"), path, strerror(errno));
+
+      memcpy(ds->dss.cookie, DEFECTIVE_STORE_COOKIE, 16);
+      ds->dss.sectorSize = CD_RAW_DUMP_SIZE;
+      ds->dss.dssFormat  = DEFECTIVE_STORE_FORMAT;
+      if(rb->validFP)
+      {  memcpy(ds->dss.mediumFP, rb->mediumFP, 16);
+	 ds->dss.properties |= DSH_HAS_FINGERPRINT;
       }
+      write_store_header(ds);
+      ds->size = sizeof(DefectiveStoreHeader);
+
+      return ds;
+   }
+
+   /* Open an existing one */
+
+   ds->file = LargeOpen(path, O_RDWR, IMG_PERMS);
+   if(!ds->file)
+      Stop(_("Could not open %s: %s"), path, strerror(errno));
+
+   n = LargeRead(ds->file, &ds->dss, sizeof(DefectiveStoreHeader));
+   if(n != sizeof(DefectiveStoreHeader))
+      Stop(_("Failed reading from defective sector file: %s"), strerror(errno));
+
+#ifdef HAVE_BIG_ENDIAN
+   SwapDefectiveStoreHeaderBytes(&ds->dss);
+#endif
+
+   if(   memcmp(ds->dss.cookie, DEFECTIVE_STORE_COOKIE, 16)
+      || ds->dss.dssFormat != DEFECTIVE_STORE_FORMAT
+      || ds->dss.sectorSize != CD_RAW_DUMP_SIZE)
+      Stop(_("%s is not a defective sector store of this dvdisaster version."), path);
+
+   /* If the store has no fingerprint, add it now */
+
+   if(!(ds->dss.properties & DSH_HAS_FINGERPRINT) && rb->validFP)
+   {  memcpy(ds->dss.mediumFP, rb->mediumFP, 16);
+      ds->dss.properties |= DSH_HAS_FINGERPRINT;
+      write_store_header(ds);
+   }
+
+   /* Verify store and medium fingerprint */
+
+   if((ds->dss.properties & DSH_HAS_FINGERPRINT) && rb->validFP)
+   {  if(memcmp(ds->dss.mediumFP, rb->mediumFP, 16))
+	  Stop(_("Fingerprints of medium and defective sector cache do not match!"));
+   }
+
+   /* A partial record at the end is left over from an interrupted
+      program run; cut it off. */
 
-      for(j=0; j<i; j++) /* Some drives return cached data after first read */
-      {  if(!memcmp(rb->rawBuf[i], rb->rawBuf[j], rb->sampleSize-1))
-	 {  new_sector = FALSE;
+   ds->size = length - (length - sizeof(DefectiveStoreHeader)) % ds->recordSize;
+   if(ds->size != length)
+   {  PrintLog(_("* Removing incomplete record from defective sector store %s\n"), path);
+      if(!LargeTruncate(ds->file, ds->size))
+	 Stop(_("Could not truncate %s: %s\n"), path, strerror(errno));
+   }
+
+   /* Build the index */
+
+   for(offset = sizeof(DefectiveStoreHeader); offset < ds->size; offset += ds->recordSize)
+   {  DefectiveStoreRecord dsr;
+
+      memcpy(&dsr, get_record(ds, offset), sizeof(DefectiveStoreRecord));
+#ifdef HAVE_BIG_ENDIAN
+      SwapDefectiveStoreRecordBytes(&dsr);
+#endif
+      index_record(ds, dsr.lba, dsr.md5sum, offset);
+   }
+
+   return ds;
+}
+
+/*
+ * Append those samples which are not yet in the store.
+ * All new records are written in one go.
+ */
+
+static int append_samples(DefectiveStore *ds, gint64 lba, int properties, 
+			  unsigned char **samples, int n_samples, int sample_size,
+			  int can_c2_scan)
+{  unsigned char *batch, *ptr;
+   unsigned char (*md5sums)[16];
+   guint64 offset;
+   int count = 0;
+   int i,n;
+
+   batch   = g_malloc(n_samples*ds->recordSize);
+   md5sums = g_malloc(n_samples*16);
+
+   for(i=0, ptr=batch; i<n_samples; i++)
+   {  DefectiveStoreRecord *dsr = (DefectiveStoreRecord*)ptr;
+      int j,duplicate = FALSE;
+
+      /* Same sample already in the store, or read twice in this pass?
+	 (some drives return cached data after first read) */
+
+      sample_md5sum(lba, samples[i], sample_size, md5sums[count]);
+      if(g_hash_table_lookup(ds->md5Index, md5sums[count]))
+	 continue;
+
+      for(j=0; j<count; j++)
+	 if(!memcmp(md5sums[j], md5sums[count], 16))
+	 {  duplicate = TRUE;
 	    break;
 	 }
-      }
+      if(duplicate)
+	 continue;
 
-      if(new_sector)   /* same sector already in cache */
-      {  int n;
+      /* The C2 mask field is not used; so we put a flag into it
+	 to mark raw sectors containing C2 error information. */
 
-        /* The C2 mask field is not used; so we put a flag into it
-	   to mark raw sectors containing C2 error information. */
+      if(can_c2_scan)
+	 samples[i][CD_RAW_DUMP_SIZE-1] = 1;
 
-	 if(can_c2_scan)
-	    rb->rawBuf[i][CD_RAW_DUMP_SIZE-1] = 1;
+      memset(dsr, 0, sizeof(DefectiveStoreRecord));
+      dsr->lba = lba;
+      dsr->properties = properties;
+      memcpy(dsr->md5sum, md5sums[count], 16);
+#ifdef HAVE_BIG_ENDIAN
+      SwapDefectiveStoreRecordBytes(dsr);
+#endif
+      memcpy(ptr+sizeof(DefectiveStoreRecord), samples[i], CD_RAW_DUMP_SIZE);
 
-	 n=LargeWrite(file, rb->rawBuf[i], dsh->sectorSize);
-	 
-	 if(n != dsh->sectorSize)
-	    Stop(_("Failed writing to defective sector file: %s"), strerror(errno));
-	 count++;
-      }
+      ptr += ds->recordSize;
+      count++;
    }
 
-   LargeClose(file);
+   if(count)
+   {  if(!LargeSeek(ds->file, ds->size))
+	 Stop(_("Failed seeking in defective sector file: %s"), strerror(errno));
 
-   PrintCLIorLabel(Closure->status,
-		   _(" [Appended %d/%d sectors to cache file %s; LBA=%" PRId64 ", ssize=%d, %d sectors]\n"), 
-		   count, rb->samplesRead, filename, dsh->lba, dsh->sectorSize, dsh->nSectors);
+      n = LargeWrite(ds->file, batch, count*ds->recordSize);
+      if(n != count*ds->recordSize)
+	 Stop(_("Failed writing to defective sector file: %s"), strerror(errno));
+
+      for(i=0, offset=ds->size; i<count; i++, offset+=ds->recordSize)
+	 index_record(ds, lba, md5sums[i], offset);
+      ds->size = offset;
+   }
 
-   g_free(filename);
-   if(cache_sectors)
-      g_free(cache_sectors);
+   g_free(batch);
+   g_free(md5sums);
 
    return count;
 }
 
 /*
- * Read sectors from the defective sector dump,
- * feed them into the raw buffer one by one
- * and retry recovery.
+ * Per sector files from previous versions are taken over into
+ * the store the first time their sector is seen.
  */
 
-int TryDefectiveSectorCache(RawBuffer *rb, unsigned char *outbuf)
+static void import_defective_sector_file(DefectiveStore *ds, RawBuffer *rb)
 {  DefectiveSectorHeader dsh;
    LargeFile *file;
+   unsigned char **samples;
    char *path;
-   int status;
-   int last_sector;
-   int i;
+   guint64 length;
+   int i,count;
 
    path = g_strdup_printf("%s/%s%lld.raw", 
 			  Closure->dDumpDir, Closure->dDumpPrefix, 
 			  (long long)rb->lba);
+
+   if(!LargeStat(path, &length))
+   {  g_free(path);
+      return;
+   }
+
    open_defective_sector_file(rb, path, &file, &dsh);
+   if(!file)
+      Stop(_("Could not open %s: %s"), path, strerror(errno));
+
+   samples = g_malloc(dsh.nSectors*sizeof(unsigned char*));
+   for(i=0; i<dsh.nSectors; i++)
+   {  samples[i] = g_malloc(dsh.sectorSize);
+      if(LargeRead(file, samples[i], dsh.sectorSize) != dsh.sectorSize)
+	 Stop(_("Failed reading from defective sector file: %s"), strerror(errno));
+   }
+   LargeClose(file);
+
+   count = append_samples(ds, rb->lba, dsh.properties & DSH_XA_MODE, 
+			  samples, dsh.nSectors, rb->sampleSize, FALSE);
+
+   PrintCLIorLabel(Closure->status,
+		   _(" [Imported %d/%d sectors from cache file %s]\n"), 
+		   count, dsh.nSectors, path);
+
+   for(i=0; i<dsh.nSectors; i++)
+      g_free(samples[i]);
+   g_free(samples);
    g_free(path);
+}
+
+/*
+ * Append RawBuffer contents to the defective sector store
+ */
+
+int SaveDefectiveSector(RawBuffer *rb, int can_c2_scan)
+{  DefectiveStore *ds;
+   StoreEntry *entry;
+   int count;
+
+   if(!rb->samplesRead) 
+     return 0;  /* Nothing to be done */
+
+   ds = open_store(rb);
+
+   if(!g_hash_table_lookup(ds->lbaIndex, &rb->lba))
+      import_defective_sector_file(ds, rb);
+
+   count = append_samples(ds, rb->lba, rb->xaMode ? DSH_XA_MODE : 0,
+			  rb->rawBuf, rb->samplesRead, rb->sampleSize, can_c2_scan);
+
+   entry = g_hash_table_lookup(ds->lbaIndex, &rb->lba);
+   PrintCLIorLabel(Closure->status,
+		   _(" [Appended %d/%d sectors to defective sector store %s; LBA=%" PRId64 ", %d sectors]\n"), 
+		   count, rb->samplesRead, ds->path, rb->lba, entry ? entry->nRecords : 0);
+
+   return count;
+}
+
+/*
+ * Feed the cached samples of the sector into the raw buffer
+ * one by one and retry recovery. Samples from the current
+ * pass are already in the raw buffer and are skipped.
+ */
+
+int TryDefectiveSectorCache(RawBuffer *rb, unsigned char *outbuf)
+{  DefectiveStore *ds = open_store(rb);
+   StoreEntry *entry;
+   unsigned char (*current)[16];
+   int n_current = rb->samplesRead;
+   int status;
+   int i,j;
 
-   if(!file)   /* No cache file */
+   entry = g_hash_table_lookup(ds->lbaIndex, &rb->lba);
+   if(!entry)  /* Nothing cached */
       return -1;
 
-   /* skip sectors added in current pass */
+   current = g_malloc(n_current*16 + 1);
+   for(i=0; i<n_current; i++)
+      sample_md5sum(rb->lba, rb->rawBuf[i], rb->sampleSize, current[i]);
 
-   last_sector = dsh.nSectors - rb->samplesRead; 
+   ReallocRawBuffer(rb, n_current + entry->nRecords);
 
-   ReallocRawBuffer(rb, dsh.nSectors);
+   for(i=0; i<entry->nRecords; i++)
+   {  unsigned char *record = get_record(ds, entry->offsets[i]);
+      DefectiveStoreRecord *dsr = (DefectiveStoreRecord*)record;
+      int in_buffer = FALSE;
 
-   for(i=0; i<last_sector; i++)
-   {  int n;
-  
-      n = LargeRead(file, rb->workBuf->buf, dsh.sectorSize);
-      if(n != dsh.sectorSize)
-	 Stop(_("Failed reading from defective sector file: %s"), strerror(errno));
+      for(j=0; j<n_current; j++)
+	 if(!memcmp(dsr->md5sum, current[j], 16))
+	 {  in_buffer = TRUE;
+	    break;
+	 }
+      if(in_buffer)
+	 continue;
+
+      memcpy(rb->workBuf->buf, record+sizeof(DefectiveStoreRecord), CD_RAW_DUMP_SIZE);
 
       status = TryCDFrameRecovery(rb, outbuf);
       if(!status) 
       {  PrintCLIorLabel(Closure->status,
 			 " [Success after processing cached sector %d]\n", i+1);
+	 g_free(current);
 	 return status; 
       }
    }
 
-   LargeClose(file);
-   
+   g_free(current);
    return -1;
 }
 
+/*
+ * Read access to a store for the raw editor.
+ * The store of a running reader is not touched; the file
+ * is opened separately and scanned record by record.
+ */
+
+static LargeFile* open_store_for_reading(char *path, DefectiveStoreHeader *dss, guint64 *length)
+{  LargeFile *file;
+   int n;
+
+   file = LargeOpen(path, O_RDONLY, IMG_PERMS);
+   if(!file || !LargeStat(path, length))
+   {  Stop(_("Could not open %s: %s"), path, strerror(errno));
+      if(file) LargeClose(file);
+      return NULL;
+   }
+
+   n = LargeRead(file, dss, sizeof(DefectiveStoreHeader));
+   if(n != sizeof(DefectiveStoreHeader))
+   {  LargeClose(file);
+      Stop(_("Failed reading from defective sector file: %s"), strerror(errno));
+      return NULL;
+   }
+
+#ifdef HAVE_BIG_ENDIAN
+   SwapDefectiveStoreHeaderBytes(dss);
+#endif
+
+   if(   memcmp(dss->cookie, DEFECTIVE_STORE_COOKIE, 16)
+      || dss->dssFormat != DEFECTIVE_STORE_FORMAT
+      || dss->sectorSize != CD_RAW_DUMP_SIZE)
+   {  LargeClose(file);
+      Stop(_("%s is not a defective sector store of this dvdisaster version."), path);
+      return NULL;
+   }
+
+   return file;
+}
+
+static int next_store_record(LargeFile *file, guint64 offset, guint64 length,
+			     DefectiveStoreRecord *dsr)
+{  guint64 record_size = sizeof(DefectiveStoreRecord) + CD_RAW_DUMP_SIZE;
+
+   if(offset + record_size > length)  /* incomplete record at the end */
+      return FALSE;
+
+   if(   !LargeSeek(file, offset)
+      || LargeRead(file, dsr, sizeof(DefectiveStoreRecord)) != sizeof(DefectiveStoreRecord))
+   {  Stop(_("Failed reading from defective sector file: %s"), strerror(errno));
+      return FALSE;
+   }
+
+#ifdef HAVE_BIG_ENDIAN
+   SwapDefectiveStoreRecordBytes(dsr);
+#endif
+   return TRUE;
+}
+
+int IsDefectiveSectorStore(char *path)
+{  LargeFile *file;
+   char cookie[16];
+   int n;
+
+   file = LargeOpen(path, O_RDONLY, IMG_PERMS);
+   if(!file)
+      return FALSE;
+
+   n = LargeRead(file, cookie, 16);
+   LargeClose(file);
+
+   return n == 16 && !memcmp(cookie, DEFECTIVE_STORE_COOKIE, 16);
+}
+
+static int lba_cmp(const void *a, const void *b)
+{  gint64 la = *(gint64*)a;
+   gint64 lb = *(gint64*)b;
+
+   if(la < lb) return -1;
+   if(la > lb) return  1;
+   return 0;
+}
+
+/*
+ * Return the sorted LBAs of all sectors in the store
+ */
+
+gint64* ListDefectiveStoreSectors(char *path, int *n_sectors)
+{  DefectiveStoreHeader dss;
+   DefectiveStoreRecord dsr;
+   LargeFile *file;
+   GHashTable *seen;
+   guint64 length,offset;
+   gint64 *lbas = NULL;
+   int n_max = 0;
+
+   *n_sectors = 0;
+   file = open_store_for_reading(path, &dss, &length);
+   if(!file)
+      return NULL;
+
+   seen = g_hash_table_new_full(g_int64_hash, g_int64_equal, g_free, NULL);
+
+   for(offset = sizeof(DefectiveStoreHeader); 
+       next_store_record(file, offset, length, &dsr);
+       offset += sizeof(DefectiveStoreRecord) + CD_RAW_DUMP_SIZE)
+   {  gint64 *key;
+
+      if(g_hash_table_lookup(seen, &dsr.lba))
+	 continue;
+
+      key = g_malloc(sizeof(gint64));
+      *key = dsr.lba;
+      g_hash_table_insert(seen, key, key);
+
+      if(*n_sectors >= n_max)
+      {  n_max = n_max ? 2*n_max : 64;
+	 lbas = g_realloc(lbas, n_max*sizeof(gint64));
+      }
+      lbas[(*n_sectors)++] = dsr.lba;
+   }
+
+   g_hash_table_destroy(seen);
+   LargeClose(file);
+
+   if(*n_sectors)
+      qsort(lbas, *n_sectors, sizeof(gint64), lba_cmp);
+
+   return lbas;
+}
+
+/*
+ * Read all samples of the given sector from the store.
+ * The DefectiveSectorHeader is filled in as if the samples
+ * came from a per sector file.
+ */
+
+void ReadDefectiveSectorStore(DefectiveSectorHeader *dsh, RawBuffer *rb, char *path, gint64 lba)
+{  DefectiveStoreHeader dss;
+   DefectiveStoreRecord dsr;
+   LargeFile *file;
+   guint64 length,offset;
+   guint64 *offsets = NULL;
+   int n_offsets = 0, n_max = 0;
+   int i;
+
+   file = open_store_for_reading(path, &dss, &length);
+   if(!file)
+      return;
+
+   memset(dsh, 0, sizeof(DefectiveSectorHeader));
+   dsh->lba        = lba;
+   dsh->sectorSize = dss.sectorSize;
+   dsh->properties = dss.properties & DSH_HAS_FINGERPRINT;
+   memcpy(dsh->mediumFP, dss.mediumFP, 16);
+
+   /* Collect the records of the sector */
+
+   for(offset = sizeof(DefectiveStoreHeader); 
+       next_store_record(file, offset, length, &dsr);
+       offset += sizeof(DefectiveStoreRecord) + CD_RAW_DUMP_SIZE)
+   {  if(dsr.lba != lba)
+	 continue;
+
+      if(n_offsets >= n_max)
+      {  n_max = n_max ? 2*n_max : 4;
+	 offsets = g_realloc(offsets, n_max*sizeof(guint64));
+      }
+      offsets[n_offsets++] = offset + sizeof(DefectiveStoreRecord);
+      dsh->properties |= dsr.properties & DSH_XA_MODE;
+   }
+
+   if(!n_offsets)
+   {  LargeClose(file);
+      Stop(_("Sector %" PRId64 " is not contained in %s."), lba, path);
+      return;
+   }
+
+   dsh->nSectors = n_offsets;
+
+   /* and feed them into the raw buffer */
+
+   rb->lba = lba;
+
+   if(dsh->properties & DSH_XA_MODE)
+        rb->dataOffset = 24;
+   else rb->dataOffset = 16;
+
+   ReallocRawBuffer(rb, n_offsets);
+
+   for(i=0, rb->samplesRead=0; i<n_offsets; i++)
+   {  if(   !LargeSeek(file, offsets[i])
+	 || LargeRead(file, rb->rawBuf[rb->samplesRead], dsh->sectorSize) != dsh->sectorSize)
+      {  Stop(_("Failed reading from defective sector file: %s"), strerror(errno));
+	 break;
+      }
+
+      rb->samplesRead++;
+      UpdateFrameStats(rb);
+      CollectGoodVectors(rb);
+   }
+
+   g_free(offsets);
+   LargeClose(file);
+}
+
 /*
  * Read sectors from the defective sector dump
  */
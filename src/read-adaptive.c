@@ -381,7 +381,10 @@ bail_out:
      if(!LargeClose(rc->image))
        Stop(_("Error closing image file:\n%s"), strerror(errno));
 
-   if(rc->medium) CloseImage(rc->medium);
+   if(rc->medium)
+   {  CloseStripedDevices(rc->medium->dh);
+      CloseImage(rc->medium);
+   }
  
    if(rc->ei) free_ecc_info(rc->ei);
 
@@ -624,6 +627,7 @@ static void open_and_determine_mode(read_closure *rc)
 
    rc->medium = OpenImageFromDevice(Closure->device, 0);
    rc->dh = rc->medium->dh;
+   OpenStripedDevices(rc->medium);
    rc->readMode = IMAGE_ONLY;
 
    /* save some useful information for the missing sector marker */
@@ -1571,6 +1575,7 @@ reopen_image:
 
       /*** Try reading the next interval */
 
+      SetStripedReading(rc->dh, rc->crcBuf, rc->intervalEnd);
       print_progress(rc, TRUE);
 
       for(s=rc->intervalStart; s<=rc->intervalEnd; ) /* s is incremented elsewhere */
@@ -1672,7 +1677,8 @@ reread:
 	 /* Reading was successful. */
 
 	 if(!status)   
-	 {  gint64 b;
+	 {  guint32 crc[nsectors];
+	    gint64 b;
 
 	    if(!LargeSeek(rc->image, (gint64)(2048*s)))
 	      Stop(_("Failed seeking to sector %" PRId64 " in image [%s]: %s"),
@@ -1681,6 +1687,9 @@ reread:
 	    /* Store sector(s) in the image file if they pass the CRC test,
 	       otherwise treat them as unprocessed. */
 
+	    if(rc->crcBuf)
+	      Crc32Sectors(rc->buf, nsectors, crc);
+
 	    for(i=0, b=s; i<nsectors; i++,b++)
 	    {  int result;
 	       int err;
@@ -1690,7 +1699,7 @@ reread:
 		  but do not terminate the current interval. */
 
 	       if(rc->crcBuf) /* we have crc information */
-		    result = CheckAgainstCrcBuffer(rc->crcBuf, b, rc->buf+i*2048);
+		    result = CheckCrcAgainstCrcBuffer(rc->crcBuf, b, crc[i]);
 	       else result = CRC_UNKNOWN;
 
 	       switch(result)
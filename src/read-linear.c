@@ -129,6 +129,10 @@ static void cleanup(gpointer data)
      if(!LargeClose(rc->writerImage))
        Stop(_("Error closing image file:\n%s"), strerror(errno));
 
+   if(rc->image && rc->image->dh)
+   {  CloseStripedDevices(rc->image->dh);
+      StopReadAhead(rc->image->dh);
+   }
    if(rc->image)   CloseImage(rc->image);
 
    if(rc->mutex)
@@ -153,6 +157,7 @@ static void cleanup(gpointer data)
    if(rc->speedTimer) g_timer_destroy(rc->speedTimer);
    if(rc->readTimer)  g_timer_destroy(rc->readTimer);
    if(rc->readMap) FreeBitmap(rc->readMap);
+   if(rc->damageMap) FreeDamageMap(rc->damageMap);
    if(rc->volumeLabel) g_free(rc->volumeLabel);
 
    if(rc->rendererMutex)
@@ -418,7 +423,8 @@ static void prepare_crc_cache(read_closure *rc)
 	- scan/read and verify create the crc cache,
 	- but do not use cached information from previous run themselves;
 	  e.g. existing caches are deleted here
-	- create uses cached information if it is available
+	- create uses cached information if it is available,
+	  either from memory or from the --crc-cache file
 	- fix is agnostic about cached information */
 
   if(Closure->crcBuf)  /* release old cached information */
@@ -681,7 +687,14 @@ static gpointer worker_thread(read_closure *rc)
          in scan mode, but also done while reading. */         
 
       if(rc->bufState[rc->writePtr] != BUF_DEAD)
-      {
+      {	guint32 crc[nsectors];
+
+	/* Checksum the whole block at once if we are going to compare
+	   against the CRCs from the ecc data */
+
+	if(rc->eccMethod && Closure->crcBuf && s < Closure->crcBuf->coveredSectors)
+	  Crc32Sectors(rc->alignedBuf[rc->writePtr]->buf, nsectors, crc);
+
 	for(i=0; i<nsectors; i++)
 	{  unsigned char *buf = rc->alignedBuf[rc->writePtr]->buf+2048*i;
 	   gint64 sector = s+i;
@@ -702,13 +715,15 @@ static gpointer worker_thread(read_closure *rc)
 	   /* Check against CRCs in the ecc data */
 	   
 	   if(Closure->crcBuf && sector < Closure->crcBuf->coveredSectors)
-	   {  switch(CheckAgainstCrcBuffer(Closure->crcBuf, sector, buf))
+	   {  switch(CheckCrcAgainstCrcBuffer(Closure->crcBuf, sector, crc[i]))
 	      {  case CRC_BAD:
 		   ClearProgress();
 		   PrintCLI(_("* CRC error, sector: %lld\n"), (long long int)s+i);
 		   Closure->crcErrors++;
 		   if(rc->readMap)  /* trigger re-read FIXME*/
 		     ClearBit(rc->readMap, sector);
+		   if(rc->damageMap)
+		     MarkDamagedSectors(rc->damageMap, sector, 1);
 		   break;
 
 	         case CRC_UNKNOWN:  /* CRC data missing or detected as defective */
@@ -798,6 +813,7 @@ void ReadMediumLinear(gpointer data)
         The on disk image is maintained in rc->reader|writerImage. */
 
    rc->image = OpenImageFromDevice(Closure->device, 0);
+   OpenStripedDevices(rc->image);
    Closure->readErrors = Closure->crcErrors = rc->readOK = 0;
 
    /*** Save some useful information for the missing sector marker */
@@ -907,6 +923,14 @@ void ReadMediumLinear(gpointer data)
    if(Closure->readingPasses > 1)
       rc->readMap = CreateBitmap0(rc->image->dh->sectors);
 
+   /*** Keep track of the damaged sectors if requested.
+	Sectors which are not read in this run remain marked as damaged. */
+
+   if(Closure->damageMapFile)
+   {  rc->damageMap = CreateDamageMap(rc->image, rc->image->dh->sectors);
+      MarkDamagedSectors(rc->damageMap, 0, rc->image->dh->sectors);
+   }
+
    /*** Start the worker thread. We concentrate on reading from the drive here;
 	writing the image file and calculating the checksums is done in a
 	concurrent thread. */
@@ -926,6 +950,16 @@ void ReadMediumLinear(gpointer data)
 
    prepare_timer(rc);
 
+   /*** Keep the drive busy while the worker checksums and writes */
+
+   if(Closure->readAhead)
+      StartReadAhead(rc->image->dh, Closure->readAhead, rc->lastSector);
+
+   /*** Let the other drives check their sectors against the ecc data.
+	Without ecc data the CRC buffer is still being built from the image. */
+
+   SetStripedReading(rc->image->dh, rc->eccMethod ? Closure->crcBuf : NULL, rc->lastSector);
+
    /*** Reset for the next reading pass */
 
    rc->lastReadOK = 0;  /* keep between passes */
@@ -1045,6 +1079,8 @@ reread:
 		  {  ok++;  /* CRC unavailable or good */
 		     if(rc->readMap)
 		       SetBit(rc->readMap, rc->readPos+i);
+		     if(rc->damageMap)
+		       ClearDamagedSectors(rc->damageMap, rc->readPos+i, 1);
 		  }
 	       }
 	    }
@@ -1145,6 +1181,14 @@ reread:
 	    {  ExplainMissingSector(sector_buf+i*2048, rc->readPos+i, err, SOURCE_MEDIUM, &unrecoverable_sectors);
 	       corrupted_sectors++;  /* readable, but written corrupted */
 	    }
+
+	    /* CRC errors are added later by the worker thread */
+
+	    if(rc->damageMap)
+	    {  if(err != SECTOR_PRESENT)
+		    MarkDamagedSectors(rc->damageMap, rc->readPos+i, 1);
+	       else ClearDamagedSectors(rc->damageMap, rc->readPos+i, 1);
+	    }
 	 }
       }
 
@@ -1255,6 +1299,8 @@ reread:
 	    PrintCLIorLabel(Closure->status,
 			    _("Sector %" PRId64 ": %s Skipping %d sectors.\n"),
 			    rc->readPos, GetLastSenseString(FALSE), nfill-1);  
+	    if(rc->damageMap)
+	       MarkDamagedSectors(rc->damageMap, rc->readPos, nfill);
 	    for(i=0; i<nfill; i++)         /* workaround: large values for nfill */
 	    {  Closure->readErrors++;      /* would exceed sampling of green/red */
 	       rc->readPos++;              /* in the spiral. Internal NOTE01 */
@@ -1285,6 +1331,8 @@ reread:
 			       rc->readPos, GetLastSenseString(FALSE));  
 	       if(rc->readPos >= rc->image->dh->sectors - 2) tao_tail++;
 	       Closure->readErrors++;
+	       if(rc->damageMap)
+		  MarkDamagedSectors(rc->damageMap, rc->readPos, 1);
 	    }
 	 }
       }
@@ -1454,8 +1502,11 @@ step_counter:
 			       );
       }
       if(!rc->scanMode && answer)
-        if(!LargeTruncate(rc->writerImage, (gint64)(2048*(rc->image->dh->sectors-tao_tail))))
-	  Stop(_("Could not truncate %s: %s\n"),Closure->imageName,strerror(errno));
+      {  if(!LargeTruncate(rc->writerImage, (gint64)(2048*(rc->image->dh->sectors-tao_tail))))
+	   Stop(_("Could not truncate %s: %s\n"),Closure->imageName,strerror(errno));
+	 if(rc->damageMap)
+	   rc->damageMap->sectors -= tao_tail;
+      }
    }
    else if(Closure->readErrors) exitCode = EXIT_FAILURE;
 
@@ -1468,6 +1519,16 @@ step_counter:
 
    if(Closure->readErrors || Closure->crcErrors) 
      Closure->crcBuf->md5State = MD5_INVALID;
+
+   /*** Remember the damaged sectors for a subsequent fix */
+
+   if(rc->damageMap)
+     SaveDamageMap(rc->damageMap, Closure->damageMapFile);
+
+   /*** Keep the checksums for creating ecc data in a later program call */
+
+   if(Closure->crcCacheFile && !rc->scanMode)
+     SaveCrcBuf(Closure->crcBuf, Closure->imageName, Closure->crcCacheFile);
      
    rc->unreportedError = FALSE;
    rc->earlyTermination = FALSE;
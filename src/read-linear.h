@@ -63,6 +63,7 @@ typedef struct
 
    gint64 readPos;                   /* current sector reading position */
    Bitmap *readMap;                  /* map of already read sectors */
+   DamageMap *damageMap;             /* damaged sectors for --damage-map */
 
    gint64 readMarker;
    int rereading;                    /* TRUE if working on existing image */
@@ -0,0 +1,543 @@
+/*  dvdisaster: Additional error correction for optical media.
+ *  Copyright (C) 2004-2017 Carsten Gnoerlich.
+ *  Copyright (C) 2019-2021 The dvdisaster development team.
+ *
+ *  Email: support@dvdisaster.org
+ *
+ *  This file is part of dvdisaster.
+ *
+ *  dvdisaster is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  dvdisaster is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with dvdisaster. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*** src type: no GUI code ***/
+
+#include "dvdisaster.h"
+
+#include "scsi-layer.h"
+
+/***
+ *** Reading one medium with several drives.
+ ***
+ * The drives given with -d dev1,dev2,... must contain the same medium
+ * (or copies of it). The first drive is the one the linear and adaptive
+ * readers work with; the others are attached to its DeviceHandle.
+ *
+ * While the reader proceeds through a range of readable sectors, each
+ * drive gets a run of consecutive clusters assigned whenever it becomes
+ * idle. Faster drives get longer runs, so the drives stay busy in
+ * proportion to their observed speed. The reader collects the clusters
+ * in sector order through ReadSectors().
+ *
+ * If a cluster can not be read, or some of its sectors fail the CRC
+ * test against the CrcBuf from the ecc data, the pipeline is stopped
+ * and the other drives are asked for the missing sectors one after
+ * another. Only if no drive delivers them does the request fail;
+ * ReadSectors() then continues with its usual error handling
+ * on the first drive.
+ */
+
+#define STRIPE_SLOTS 64          /* clusters queued at all drives together */
+#define STRIPE_RUN   8           /* clusters per run for the fastest drive */
+
+enum
+{  SLOT_QUEUED,                  /* waiting for its drive */
+   SLOT_BUSY,                    /* drive is reading it */
+   SLOT_DONE                     /* status and data available */
+};
+
+typedef struct
+{  DeviceHandle *dh;
+   Image *image;                 /* NULL for the first drive */
+   GThread *thread;
+   int idx;                      /* position in the drive list */
+   double usecPerSector;         /* observed reading speed; 0 = not yet known */
+   gint64 sectorsRead;           /* sectors delivered from the pipeline */
+   gint64 sectorsMerged;         /* sectors supplied after other drives failed */
+} StripeDrive;
+
+typedef struct
+{  gint64 lba;                   /* first sector of the cluster */
+   int nsectors;
+   int drive;                    /* drive assigned to it */
+   AlignedBuffer *ab;
+   int status;
+   int state;
+} StripeSlot;
+
+typedef struct _Stripe
+{  StripeDrive drive[MAX_STRIPE_DRIVES];
+   int nDrives;
+
+   StripeSlot slot[STRIPE_SLOTS];
+   int head;                     /* oldest queued slot */
+   int count;                    /* number of queued slots */
+   int nsectors;                 /* sectors per cluster in the pipeline */
+   gint64 nextSector;            /* first sector of the next run */
+   gint64 lastSector;            /* do not read beyond this sector */
+
+   CrcBuf *crcBuf;               /* CRC sums from the ecc data, or NULL */
+   AlignedBuffer *mergeBuf;      /* for asking the other drives */
+
+   GMutex *lock;
+   GCond *cond;
+   int exit;
+} Stripe;
+
+typedef struct
+{  Stripe *st;
+   StripeDrive *drive;
+} drive_context;
+
+/*
+ * One thread per drive works through the slots assigned to it.
+ */
+
+static gpointer stripe_thread(gpointer data)
+{  drive_context *dc = (drive_context*)data;
+   Stripe *st = dc->st;
+   StripeDrive *drive = dc->drive;
+
+   g_free(dc);
+
+   g_mutex_lock(st->lock);
+   while(!st->exit)
+   {  StripeSlot *slot = NULL;
+      gint64 start;
+      int i,status;
+
+      for(i=0; i<st->count; i++)
+      {  StripeSlot *candidate = &st->slot[(st->head+i) % STRIPE_SLOTS];
+
+	 if(candidate->drive == drive->idx && candidate->state == SLOT_QUEUED)
+	 {  slot = candidate;
+	    break;
+	 }
+      }
+
+      if(!slot)
+      {  g_cond_wait(st->cond, st->lock);
+	 continue;
+      }
+
+      slot->state = SLOT_BUSY;
+      g_mutex_unlock(st->lock);
+
+      start  = g_get_monotonic_time();
+      status = drive->dh->read(drive->dh, slot->ab->buf, slot->lba, slot->nsectors);
+
+      g_mutex_lock(st->lock);
+      if(!status)
+      {  double usec = (double)(g_get_monotonic_time()-start)/slot->nsectors;
+
+	 if(drive->usecPerSector > 0.0)
+	      drive->usecPerSector = 0.75*drive->usecPerSector + 0.25*usec;
+	 else drive->usecPerSector = usec;
+      }
+      slot->status = status;
+      slot->state  = SLOT_DONE;
+      g_cond_broadcast(st->cond);
+   }
+   g_mutex_unlock(st->lock);
+
+   return NULL;
+}
+
+/*
+ * Hand out runs of clusters to the idle drives.
+ * Must be called with st->lock held.
+ */
+
+static int drive_is_idle(Stripe *st, int d)
+{  int i;
+
+   for(i=0; i<st->count; i++)
+   {  StripeSlot *slot = &st->slot[(st->head+i) % STRIPE_SLOTS];
+
+      if(slot->drive == d && slot->state != SLOT_DONE)
+	return FALSE;
+   }
+
+   return TRUE;
+}
+
+static void assign_runs(Stripe *st)
+{  double fastest = 0.0;
+   int d;
+
+   for(d=0; d<st->nDrives; d++)
+   {  double usec = st->drive[d].usecPerSector;
+
+      if(usec > 0.0 && (fastest == 0.0 || usec < fastest))
+	fastest = usec;
+   }
+
+   for(d=0; d<st->nDrives; d++)
+   {  StripeDrive *drive = &st->drive[d];
+      int run = STRIPE_RUN;
+
+      if(st->nextSector > st->lastSector || st->count >= STRIPE_SLOTS)
+	break;
+
+      if(!drive_is_idle(st, d))
+	continue;
+
+      /* Slower drives get proportionally shorter runs */
+
+      if(fastest > 0.0 && drive->usecPerSector > 0.0)
+      {  run = (int)(STRIPE_RUN*fastest/drive->usecPerSector + 0.5);
+	 if(run < 1) run = 1;
+      }
+
+      while(run-- > 0 && st->count < STRIPE_SLOTS && st->nextSector <= st->lastSector)
+      {  StripeSlot *slot = &st->slot[(st->head+st->count) % STRIPE_SLOTS];
+	 int n = st->nsectors;
+
+	 if(st->nextSector+n-1 > st->lastSector)
+	    n = st->lastSector-st->nextSector+1;
+
+	 slot->lba      = st->nextSector;
+	 slot->nsectors = n;
+	 slot->drive    = d;
+	 slot->status   = 0;
+	 slot->state    = SLOT_QUEUED;
+
+	 st->nextSector += n;
+	 st->count++;
+      }
+   }
+
+   g_cond_broadcast(st->cond);
+}
+
+/*
+ * Stop the pipeline. Clusters not yet picked up by their drive
+ * are discarded; those being read must be waited for.
+ */
+
+static void drain_stripe(Stripe *st)
+{  int i;
+
+   g_mutex_lock(st->lock);
+   for(i=0; i<st->count; i++)
+   {  StripeSlot *slot = &st->slot[(st->head+i) % STRIPE_SLOTS];
+
+      if(slot->state == SLOT_QUEUED)
+      {  slot->status = -1;
+	 slot->state  = SLOT_DONE;
+      }
+   }
+
+   for(i=0; i<st->count; i++)
+   {  StripeSlot *slot = &st->slot[(st->head+i) % STRIPE_SLOTS];
+
+      while(slot->state != SLOT_DONE)
+	g_cond_wait(st->cond, st->lock);
+   }
+
+   st->head  = 0;
+   st->count = 0;
+   g_mutex_unlock(st->lock);
+}
+
+/*
+ * Ask the drives one after another for the sectors which are still
+ * missing in buf. Missing sectors are those in the failed[] array.
+ * Returns TRUE if all sectors are present afterwards.
+ */
+
+static int merge_sectors(Stripe *st, unsigned char *buf, gint64 s, int nsectors,
+			 int *failed, int skip_drive)
+{  int d,i,missing = 0;
+
+   for(i=0; i<nsectors; i++)
+      if(failed[i]) missing++;
+
+   for(d=0; d<st->nDrives && missing; d++)
+   {  StripeDrive *drive = &st->drive[d];
+      unsigned char *mbuf = st->mergeBuf->buf;
+
+      if(d == skip_drive)
+	continue;
+
+      if(drive->dh->read(drive->dh, mbuf, s, nsectors))
+	continue;
+
+      for(i=0; i<nsectors; i++)
+      {  if(!failed[i])
+	    continue;
+
+	 if(   st->crcBuf
+	    && CheckAgainstCrcBuffer(st->crcBuf, s+i, mbuf+2048*i) == CRC_BAD)
+	    continue;
+
+	 memcpy(buf+2048*i, mbuf+2048*i, 2048);
+	 failed[i] = FALSE;
+	 missing--;
+	 drive->sectorsMerged++;
+	 Verbose("# Striping: sector %" PRId64 " taken from %s\n", s+i, drive->dh->device);
+      }
+   }
+
+   return missing == 0;
+}
+
+/*
+ * Mark the sectors in buf which do not match the CRC sums
+ * from the ecc data. Returns the number of such sectors.
+ */
+
+static int check_crcs(Stripe *st, unsigned char *buf, gint64 s, int nsectors, int *failed)
+{  int i,bad = 0;
+
+   for(i=0; i<nsectors; i++)
+   {  failed[i] = st->crcBuf && CheckAgainstCrcBuffer(st->crcBuf, s+i, buf+2048*i) == CRC_BAD;
+      if(failed[i]) bad++;
+   }
+
+   return bad;
+}
+
+/*
+ * Deliver the requested sectors, either from the pipeline
+ * or by asking all drives. Returns FALSE if the caller must
+ * continue with its own error handling.
+ */
+
+int ReadStripedSectors(DeviceHandle *dh, unsigned char *buf, gint64 s, int nsectors)
+{  Stripe *st = dh->stripe;
+   int failed[MAX_CLUSTER_SECTORS];
+   int got_data = FALSE;
+   int tried_drive = -1;
+   int d,i;
+
+   if(nsectors > MAX_CLUSTER_SECTORS)
+      return FALSE;
+
+   for(d=1; d<st->nDrives; d++)
+      st->drive[d].dh->pass = dh->pass;
+
+   /* Restart the pipeline when the caller left the predicted sequence.
+      This is only worth it for full cluster reads; single sector reads
+      near defective areas are served synchronously. */
+
+   if(   !st->count
+      || st->slot[st->head].lba != s
+      || st->slot[st->head].nsectors != nsectors)
+   {  drain_stripe(st);
+
+      if(nsectors == dh->clusterSize && s <= st->lastSector)
+      {  g_mutex_lock(st->lock);
+	 st->nextSector = s;
+	 st->nsectors   = nsectors;
+	 assign_runs(st);
+	 g_mutex_unlock(st->lock);
+      }
+   }
+
+   /* Take the cluster from the pipeline. Drives becoming idle 
+      in the meantime get their next run right away. */
+
+   if(st->count)
+   {  StripeSlot *slot = &st->slot[st->head];
+
+      g_mutex_lock(st->lock);
+      while(slot->state != SLOT_DONE)
+      {  g_cond_wait(st->cond, st->lock);
+	 assign_runs(st);
+      }
+      g_mutex_unlock(st->lock);
+
+      tried_drive = slot->drive;
+
+      if(!slot->status)
+      {  int bad;
+
+	 got_data = TRUE;
+	 memcpy(buf, slot->ab->buf, 2048*nsectors);
+	 bad = check_crcs(st, buf, s, nsectors, failed);
+	 st->drive[tried_drive].sectorsRead += nsectors-bad;
+
+	 if(!bad)
+	 {  g_mutex_lock(st->lock);
+	    st->head = (st->head+1) % STRIPE_SLOTS;
+	    st->count--;
+	    assign_runs(st);
+	    g_mutex_unlock(st->lock);
+	    return TRUE;
+	 }
+      }
+
+      drain_stripe(st);
+   }
+
+   /* Requests outside of the pipeline go to the first drive */
+
+   else
+   {  tried_drive = 0;
+
+      if(!dh->read(dh, buf, s, nsectors))
+      {  int bad = check_crcs(st, buf, s, nsectors, failed);
+
+	 got_data = TRUE;
+	 st->drive[0].sectorsRead += nsectors-bad;
+	 if(!bad)
+	    return TRUE;
+      }
+   }
+
+   /* Ask the other drives one after another */
+
+   if(!got_data)
+   {  for(i=0; i<nsectors; i++)
+	 failed[i] = TRUE;
+   }
+
+   if(merge_sectors(st, buf, s, nsectors, failed, tried_drive))
+      return TRUE;
+
+   /* Some sectors are still bad. If a drive returned data,
+      hand it out; the reader will find the CRC errors itself. */
+
+   return got_data;
+}
+
+/*
+ * Open the additional drives and attach them to dh.
+ */
+
+void OpenStripedDevices(Image *image)
+{  DeviceHandle *dh = image->dh;
+   guint8 fp[16],other_fp[16];
+   int fp_read;
+   Stripe *st;
+   unsigned int i;
+
+   if(!Closure->stripeDevices || !Closure->stripeDevices->len || dh->stripe)
+      return;
+
+   if(Closure->readRaw || dh->defects)
+   {  PrintCLI(_("* Warning: Reading with several drives is not possible\n"
+		 "*          in raw reading mode or with simulated defects.\n"
+		 "*          Using %s only.\n"), dh->device);
+      return;
+   }
+
+   st = g_malloc0(sizeof(Stripe));
+   dh->stripe = st;
+
+   st->lock = g_malloc(sizeof(GMutex));
+   g_mutex_init(st->lock);
+   st->cond = g_malloc(sizeof(GCond));
+   g_cond_init(st->cond);
+
+   st->drive[0].dh = dh;
+   st->nDrives = 1;
+
+   fp_read = GetImageFingerprint(image, fp, FINGERPRINT_SECTOR);
+
+   for(i=0; i<Closure->stripeDevices->len; i++)
+   {  char *device = g_ptr_array_index(Closure->stripeDevices, i);
+      StripeDrive *drive = &st->drive[st->nDrives];
+
+      drive->image = OpenImageFromDevice(device, 0);
+      if(!drive->image)
+	Stop(_("Could not open %s.\n"), device);
+      drive->dh = drive->image->dh;
+      drive->idx = st->nDrives++;
+
+      if(   drive->dh->sectors != dh->sectors
+	 || drive->dh->clusterSize != dh->clusterSize
+	 || drive->dh->read == NULL)
+	Stop(_("Medium in %s does not match the one in %s.\n"), device, dh->device);
+
+      if(fp_read && GetImageFingerprint(drive->image, other_fp, FINGERPRINT_SECTOR)
+	 && memcmp(fp, other_fp, 16))
+	Stop(_("Medium in %s does not match the one in %s.\n"), device, dh->device);
+   }
+
+   for(i=0; i<STRIPE_SLOTS; i++)
+      st->slot[i].ab = CreateAlignedBuffer(MAX_CLUSTER_SIZE);
+   st->mergeBuf = CreateAlignedBuffer(MAX_CLUSTER_SIZE);
+
+   for(i=0; i<st->nDrives; i++)
+   {  drive_context *dc = g_malloc(sizeof(drive_context));
+      GError *err = NULL;
+
+      dc->st = st;
+      dc->drive = &st->drive[i];
+      st->drive[i].thread = g_thread_try_new("stripe", stripe_thread, (gpointer)dc, &err);
+      if(!st->drive[i].thread)
+	Stop("Could not create drive thread: %s", err->message);
+   }
+
+   PrintLog(_("Reading with %d drives.\n"), st->nDrives);
+}
+
+/*
+ * Set the CRC information and the end of the range to be read.
+ * The adaptive reader calls this for each interval.
+ */
+
+void SetStripedReading(DeviceHandle *dh, CrcBuf *crcBuf, gint64 last_sector)
+{  Stripe *st = dh->stripe;
+
+   if(!st)
+      return;
+
+   drain_stripe(st);
+   st->crcBuf = crcBuf;
+   st->lastSector = last_sector;
+}
+
+void CloseStripedDevices(DeviceHandle *dh)
+{  Stripe *st = dh->stripe;
+   int i;
+
+   if(!st)
+      return;
+
+   drain_stripe(st);
+
+   g_mutex_lock(st->lock);
+   st->exit = TRUE;
+   g_cond_broadcast(st->cond);
+   g_mutex_unlock(st->lock);
+
+   for(i=0; i<st->nDrives; i++)
+   {  StripeDrive *drive = &st->drive[i];
+
+      if(drive->thread)
+	g_thread_join(drive->thread);
+
+      Verbose("# Striping: %s: %" PRId64 " sectors read, %" PRId64 " supplied for other drives, %.0f usec/sector\n",
+	      drive->dh->device, drive->sectorsRead, drive->sectorsMerged, drive->usecPerSector);
+
+      if(drive->image)
+	CloseImage(drive->image);
+   }
+
+   for(i=0; i<STRIPE_SLOTS; i++)
+      if(st->slot[i].ab)
+	FreeAlignedBuffer(st->slot[i].ab);
+   if(st->mergeBuf)
+      FreeAlignedBuffer(st->mergeBuf);
+
+   g_mutex_clear(st->lock);
+   g_free(st->lock);
+   g_cond_clear(st->cond);
+   g_free(st->cond);
+
+   g_free(st);
+   dh->stripe = NULL;
+}
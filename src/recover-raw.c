@@ -235,6 +235,10 @@ void FreeRawBuffer(RawBuffer *rb)
    g_free(rb->byteCount);
    g_free(rb->reference);
    g_free(rb);
+
+   /* The defective sector store is kept open while raw reading */
+
+   CloseDefectiveSectorStore();
 }
 
 /***
@@ -820,6 +824,93 @@ void UpdateFrameStats(RawBuffer *rb)
    rb->bestQ2 = q_err;
 }
 
+/***
+ *** Worker pool for the L-EC searches.
+ ***
+ * The heuristics split their candidate space into independent
+ * tasks which are run here on up to Closure->codecThreads threads.
+ * The tasks must only write into their own task structures;
+ * merging the results is up to the caller.
+ */
+
+typedef struct
+{  GMutex *lock;
+   GCond *cond;
+   int pending;
+} lec_batch;
+
+typedef struct
+{  GFunc func;
+   gpointer task;
+   lec_batch *batch;
+} lec_job;
+
+static GThreadPool *lec_pool;
+static GMutex lec_pool_lock;
+
+static void lec_worker(gpointer data, gpointer unused)
+{  lec_job *job = (lec_job*)data;
+   lec_batch *batch = job->batch;
+
+   job->func(job->task, NULL);
+
+   g_mutex_lock(batch->lock);
+   if(!--batch->pending)
+     g_cond_signal(batch->cond);
+   g_mutex_unlock(batch->lock);
+}
+
+void RunLECSearchTasks(GFunc func, gpointer *tasks, int n)
+{  lec_job *jobs;
+   lec_batch batch;
+   int i;
+
+   /* Single threaded; do it the old-fashioned way */
+
+   if(Closure->codecThreads <= 1 || n <= 1)
+   {  for(i=0; i<n; i++)
+	func(tasks[i], NULL);
+      return;
+   }
+
+   g_mutex_lock(&lec_pool_lock);
+   if(!lec_pool)
+     lec_pool = g_thread_pool_new(lec_worker, NULL, Closure->codecThreads, FALSE, NULL);
+   g_mutex_unlock(&lec_pool_lock);
+
+   batch.lock = g_malloc(sizeof(GMutex)); g_mutex_init(batch.lock);
+   batch.cond = g_malloc(sizeof(GCond));  g_cond_init(batch.cond);
+   batch.pending = n;
+
+   jobs = g_malloc(n*sizeof(lec_job));
+   for(i=0; i<n; i++)
+   {  jobs[i].func = func;
+      jobs[i].task = tasks[i];
+      jobs[i].batch = &batch;
+      g_thread_pool_push(lec_pool, &jobs[i], NULL);
+   }
+
+   g_mutex_lock(batch.lock);
+   while(batch.pending)
+     g_cond_wait(batch.cond, batch.lock);
+   g_mutex_unlock(batch.lock);
+
+   g_free(jobs);
+   g_mutex_clear(batch.lock);
+   g_free(batch.lock);
+   g_cond_clear(batch.cond);
+   g_free(batch.cond);
+}
+
+/*
+ * See whether the time budget for the current sector is used up.
+ */
+
+int LECTimeExceeded(RawBuffer *rb)
+{
+   return rb->searchDeadline && g_get_monotonic_time() > rb->searchDeadline;
+}
+
 /*** 
  *** The grand wrapper:
  ***
@@ -941,7 +1032,12 @@ int TryCDFrameRecovery(RawBuffer *rb, unsigned char *outbuf)
    CalculatePQLoad(rb);
    UpdatePQParityList(rb, new_frame);
 
-   /* The actual heuristics */
+   /* The actual heuristics. They may take a long time on badly
+      damaged sectors, so give up after the configured time limit. */
+
+   if(Closure->lecTimeLimit > 0)
+        rb->searchDeadline = g_get_monotonic_time() + (gint64)Closure->lecTimeLimit*G_USEC_PER_SEC;
+   else rb->searchDeadline = 0;
 
 #if 0
    SmartLEC(rb);
@@ -967,6 +1063,9 @@ int TryCDFrameRecovery(RawBuffer *rb, unsigned char *outbuf)
       return 0; 
    }
 
+   if(LECTimeExceeded(rb))
+     goto timeout;
+
    BruteForceSearchPlausibleSector(rb);
 
    if(CheckEDC(rb->recovered, rb->xaMode)
@@ -978,6 +1077,9 @@ int TryCDFrameRecovery(RawBuffer *rb, unsigned char *outbuf)
       return 0; 
    }
 
+   if(LECTimeExceeded(rb))
+     goto timeout;
+
    AckHeuristic(rb);
 
    if(CheckEDC(rb->recovered, rb->xaMode)
@@ -989,6 +1091,9 @@ int TryCDFrameRecovery(RawBuffer *rb, unsigned char *outbuf)
       return 0; 
    }
 
+   if(LECTimeExceeded(rb))
+     goto timeout;
+
    HeuristicLEC(rb->recovered, rb, outbuf);
 
    if(CheckEDC(rb->recovered, rb->xaMode)
@@ -1000,6 +1105,9 @@ int TryCDFrameRecovery(RawBuffer *rb, unsigned char *outbuf)
       return 0; 
    }
 
+   if(LECTimeExceeded(rb))
+     goto timeout;
+
    SearchPlausibleSector(rb, 1);
 
    if(CheckEDC(rb->recovered, rb->xaMode)
@@ -1011,6 +1119,9 @@ int TryCDFrameRecovery(RawBuffer *rb, unsigned char *outbuf)
       return 0; 
    }
 
+   if(LECTimeExceeded(rb))
+     goto timeout;
+
    BruteForceSearchPlausibleSector(rb);
 
    if(CheckEDC(rb->recovered, rb->xaMode)
@@ -1022,6 +1133,9 @@ int TryCDFrameRecovery(RawBuffer *rb, unsigned char *outbuf)
       return 0; 
    }
 
+   if(LECTimeExceeded(rb))
+     goto timeout;
+
    AckHeuristic(rb);
 
    if(CheckEDC(rb->recovered, rb->xaMode)
@@ -1033,6 +1147,9 @@ int TryCDFrameRecovery(RawBuffer *rb, unsigned char *outbuf)
       return 0; 
    }
 
+   if(LECTimeExceeded(rb))
+     goto timeout;
+
    HeuristicLEC(rb->recovered, rb, outbuf);
 
    if(CheckEDC(rb->recovered, rb->xaMode)
@@ -1046,6 +1163,11 @@ int TryCDFrameRecovery(RawBuffer *rb, unsigned char *outbuf)
 
    /*** Recovery failed */
 
+timeout:
+   if(LECTimeExceeded(rb))
+     Verbose("Sector %" PRId64 ": L-EC heuristics stopped after %d seconds.\n",
+	     rb->lba, Closure->lecTimeLimit);
+
    RememberSense(3, 255, 6);  /* Sector accumulated for analysis */
    rb->recommendedAttempts = Closure->maxReadAttempts;
    return -1;
@@ -0,0 +1,118 @@
+/*  dvdisaster: Additional error correction for optical media.
+ *  Copyright (C) 2004-2017 Carsten Gnoerlich.
+ *  Copyright (C) 2019-2021 The dvdisaster development team.
+ * 
+ *  Email: support@dvdisaster.org
+ *
+ *  This file is part of dvdisaster.
+ *
+ *  dvdisaster is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  dvdisaster is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with dvdisaster. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*** src type: no GUI code ***/
+
+#include "dvdisaster.h"
+
+#ifdef HAVE_AVX2
+  #include <immintrin.h>
+#endif
+
+/***
+ *** Syndrome calculation using AVX2 intrinsics
+ ***/
+
+#ifdef HAVE_AVX2
+/* The constant multiplications are done with two 16 byte table
+ * lookups (one per nibble) using the byte shuffle instruction.
+ * Evaluates 32 codewords at once.
+ */
+
+guint32 syndrome_columns_avx2(ReedSolomonTables *rt, unsigned char **layer, int offset, guint8 *syn)
+{  __m256i low_nibble = _mm256_set1_epi8(0x0f);
+   __m256i zero = _mm256_setzero_si256();
+   __m256i all = zero;
+   int nroots = rt->nroots;
+   int i,j;
+
+   for(i=0; i<nroots; i++)
+   {  guint8 *nibble_lut = rt->synNibbleLut + 32*i;
+      __m256i lo = _mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i*)nibble_lut));
+      __m256i hi = _mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i*)(nibble_lut+16)));
+      __m256i s;
+
+      s = _mm256_loadu_si256((__m256i*)(layer[0]+offset));
+
+      for(j=1; j<GF_FIELDMAX; j++)
+      {  __m256i x_lo = _mm256_and_si256(s, low_nibble);
+	 __m256i x_hi = _mm256_and_si256(_mm256_srli_epi16(s, 4), low_nibble);
+	 __m256i data = _mm256_loadu_si256((__m256i*)(layer[j]+offset));
+
+	 s = _mm256_xor_si256(_mm256_shuffle_epi8(lo, x_lo), _mm256_shuffle_epi8(hi, x_hi));
+	 s = _mm256_xor_si256(s, data);
+      }
+
+      _mm256_storeu_si256((__m256i*)(syn+i*SYNDROME_COLUMNS), s);
+      all = _mm256_or_si256(all, s);
+   }
+
+   return ~(guint32)_mm256_movemask_epi8(_mm256_cmpeq_epi8(all, zero));
+}
+#else /* don't have AVX2 */
+/* Stub function to keep the linker happy.
+ * Should never be executed.
+ */
+
+guint32 syndrome_columns_avx2(ReedSolomonTables *rt, unsigned char **layer, int offset, guint8 *syn)
+{
+   Stop("Mega borkage - syndrome_columns_avx2() stub called.\n");
+   return 0;
+}
+#endif /* HAVE_AVX2 */
+
+/***
+ *** Multiply-add of byte columns using AVX2 intrinsics
+ ***/
+
+/* dst ^= factor * src, with the factor given by its nibble tables.
+ * Processes 32 bytes per step.
+ */
+
+#ifdef HAVE_AVX2
+void mul_add_columns_avx2(guint8 *dst, guint8 *src, int n, guint8 *nibble_lut)
+{  __m256i low_nibble = _mm256_set1_epi8(0x0f);
+   __m256i lo = _mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i*)nibble_lut));
+   __m256i hi = _mm256_broadcastsi128_si256(_mm_loadu_si128((__m128i*)(nibble_lut+16)));
+   int i;
+
+   for(i=0; i<n; i+=32)
+   {  __m256i s = _mm256_loadu_si256((__m256i*)(src+i));
+      __m256i x_lo = _mm256_and_si256(s, low_nibble);
+      __m256i x_hi = _mm256_and_si256(_mm256_srli_epi16(s, 4), low_nibble);
+      __m256i d = _mm256_loadu_si256((__m256i*)(dst+i));
+
+      d = _mm256_xor_si256(d, _mm256_shuffle_epi8(lo, x_lo));
+      d = _mm256_xor_si256(d, _mm256_shuffle_epi8(hi, x_hi));
+      _mm256_storeu_si256((__m256i*)(dst+i), d);
+   }
+}
+#else /* don't have AVX2 */
+/* Stub function to keep the linker happy.
+ * Should never be executed.
+ */
+
+void mul_add_columns_avx2(guint8 *dst, guint8 *src, int n, guint8 *nibble_lut)
+{
+   Stop("Mega borkage - mul_add_columns_avx2() stub called.\n");
+}
+#endif /* HAVE_AVX2 */
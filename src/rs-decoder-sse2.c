@@ -0,0 +1,132 @@
+/*  dvdisaster: Additional error correction for optical media.
+ *  Copyright (C) 2004-2017 Carsten Gnoerlich.
+ *  Copyright (C) 2019-2021 The dvdisaster development team.
+ * 
+ *  Email: support@dvdisaster.org
+ *
+ *  This file is part of dvdisaster.
+ *
+ *  dvdisaster is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  dvdisaster is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with dvdisaster. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*** src type: no GUI code ***/
+
+#include "dvdisaster.h"
+
+#ifdef HAVE_SSE2
+  #include <emmintrin.h>
+#endif
+
+/***
+ *** Syndrome calculation using SSE2 intrinsics
+ ***/
+
+/* SSE2 has no byte shuffle, so the constant multiplications are
+ * done bitwise: x * c = sum of (bit b of x) * (c * 2^b).
+ * The c * 2^b values are taken from the split-nibble tables.
+ * Evaluates 16 codewords at once.
+ */
+
+#ifdef HAVE_SSE2
+guint32 syndrome_columns_sse2(ReedSolomonTables *rt, unsigned char **layer, int offset, guint8 *syn)
+{  __m128i zero = _mm_setzero_si128();
+   __m128i all = zero;
+   int nroots = rt->nroots;
+   int i,j,b;
+
+   for(i=0; i<nroots; i++)
+   {  guint8 *nibble_lut = rt->synNibbleLut + 32*i;
+      __m128i mul[8];
+      __m128i s;
+
+      for(b=0; b<4; b++)
+      {  mul[b]   = _mm_set1_epi8(nibble_lut[1<<b]);
+	 mul[b+4] = _mm_set1_epi8(nibble_lut[16+(1<<b)]);
+      }
+
+      s = _mm_loadu_si128((__m128i*)(layer[0]+offset));
+
+      for(j=1; j<GF_FIELDMAX; j++)
+      {  __m128i x = s;
+
+	 s = _mm_loadu_si128((__m128i*)(layer[j]+offset));
+	 for(b=7; b>=0; b--)
+	 {  __m128i mask = _mm_cmplt_epi8(x, zero);
+
+	    s = _mm_xor_si128(s, _mm_and_si128(mask, mul[b]));
+	    x = _mm_add_epi8(x, x);
+	 }
+      }
+
+      _mm_storeu_si128((__m128i*)(syn+i*SYNDROME_COLUMNS), s);
+      all = _mm_or_si128(all, s);
+   }
+
+   return ~_mm_movemask_epi8(_mm_cmpeq_epi8(all, zero)) & 0xffff;
+}
+#else /* don't have SSE2 */
+/* Stub function to keep the linker happy.
+ * Should never be executed.
+ */
+
+guint32 syndrome_columns_sse2(ReedSolomonTables *rt, unsigned char **layer, int offset, guint8 *syn)
+{
+   Stop("Mega borkage - syndrome_columns_sse2() stub called.\n");
+   return 0;
+}
+#endif /* HAVE_SSE2 */
+
+/***
+ *** Multiply-add of byte columns using SSE2 intrinsics
+ ***/
+
+/* dst ^= factor * src, with the factor given by its nibble tables.
+ * Uses the same bitwise multiplication as the syndrome code above.
+ */
+
+#ifdef HAVE_SSE2
+void mul_add_columns_sse2(guint8 *dst, guint8 *src, int n, guint8 *nibble_lut)
+{  __m128i zero = _mm_setzero_si128();
+   __m128i mul[8];
+   int i,b;
+
+   for(b=0; b<4; b++)
+   {  mul[b]   = _mm_set1_epi8(nibble_lut[1<<b]);
+      mul[b+4] = _mm_set1_epi8(nibble_lut[16+(1<<b)]);
+   }
+
+   for(i=0; i<n; i+=16)
+   {  __m128i x = _mm_loadu_si128((__m128i*)(src+i));
+      __m128i d = _mm_loadu_si128((__m128i*)(dst+i));
+
+      for(b=7; b>=0; b--)
+      {  __m128i mask = _mm_cmplt_epi8(x, zero);
+
+	 d = _mm_xor_si128(d, _mm_and_si128(mask, mul[b]));
+	 x = _mm_add_epi8(x, x);
+      }
+
+      _mm_storeu_si128((__m128i*)(dst+i), d);
+   }
+}
+#else /* don't have SSE2 */
+/* Stub function to keep the linker happy.
+ * Should never be executed.
+ */
+
+void mul_add_columns_sse2(guint8 *dst, guint8 *src, int n, guint8 *nibble_lut)
+{
+   Stop("Mega borkage - mul_add_columns_sse2() stub called.\n");
+}
+#endif /* HAVE_SSE2 */
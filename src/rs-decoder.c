@@ -26,7 +26,7 @@
 #include "galois-inlines.h"
 
 /***
- *** Reed-Solomon decoding (work in progress; incomplete)
+ *** Reed-Solomon decoding
  ***/
 
 /*
@@ -64,3 +64,727 @@ int TestErrorSyndromes(ReedSolomonTables *rt, unsigned char *data)
 
    return syn_error;
 }
+
+/***
+ *** Syndrome calculation for several codewords at once
+ ***/
+
+/*
+ * Portable version. Evaluates the codewords one after another
+ * in the same way as TestErrorSyndromes().
+ */
+
+static guint32 syndrome_columns_portable(ReedSolomonTables *rt, unsigned char **layer, 
+					 int offset, int columns, guint8 *syn)
+{  guint32 nonzero = 0;
+   int nroots = rt->nroots;
+   int c,i,j;
+
+   for(c=0; c<columns; c++)
+   {  int syndrome[nroots];
+      int syn_error = 0;
+
+      for(i=0; i<nroots; i++)
+	syndrome[i] = layer[0][offset+c];
+
+      for(j=1; j<GF_FIELDMAX; j++)
+      {  int data = layer[j][offset+c];
+
+	 for(i=0; i<nroots; i++)
+	   if(syndrome[i] == 0) 
+	        syndrome[i] = data;
+	   else syndrome[i] = data ^ rt->synLut[(i<<8) + syndrome[i]];
+      }
+
+      for(i=0; i<nroots; i++)
+      {  syn[i*SYNDROME_COLUMNS+c] = syndrome[i];
+	 syn_error |= syndrome[i];
+      }
+
+      if(syn_error)
+	nonzero |= 1U<<c;
+   }
+
+   return nonzero;
+}
+
+/*
+ * Dispatch upon availability of SIMD instructions.
+ * Each codeword is made from the bytes at layer[j][offset+c],
+ * j=0..254, for the columns c=0..columns-1 (columns <= SYNDROME_COLUMNS).
+ * Syndrome i of column c is stored in syn[i*SYNDROME_COLUMNS+c].
+ * Returns a bit mask of the columns with a nonzero syndrome.
+ */
+
+guint32 syndrome_columns_sse2(ReedSolomonTables*, unsigned char**, int, guint8*);
+guint32 syndrome_columns_avx2(ReedSolomonTables*, unsigned char**, int, guint8*);
+
+static void select_simd(int *use_sse2, int *use_avx2)
+{  *use_sse2 = *use_avx2 = FALSE;
+
+   switch(Closure->encodingAlgorithm)
+   {  case ENCODING_ALG_SSE2:
+	 *use_sse2 = TRUE;
+	 break;
+      case ENCODING_ALG_AVX2:
+	 *use_avx2 = TRUE;
+	 break;
+      case ENCODING_ALG_AVX512:  /* no wider decoder code yet */
+      case ENCODING_ALG_DEFAULT:
+	 *use_avx2 = Closure->useAVX2;
+	 *use_sse2 = Closure->useSSE2;
+	 break;
+      default:
+	 break;
+   }
+}
+
+guint32 ComputeSyndromeColumns(ReedSolomonTables *rt, unsigned char **layer, 
+			       int offset, int columns, guint8 *syn)
+{  int use_sse2, use_avx2;
+   guint32 nonzero;
+
+   select_simd(&use_sse2, &use_avx2);
+
+   if(use_avx2 && columns == 32)
+     return syndrome_columns_avx2(rt, layer, offset, syn);
+
+   if(use_sse2 && columns >= 16)
+   {  nonzero = syndrome_columns_sse2(rt, layer, offset, syn);
+
+      if(columns == 32)
+	nonzero |= syndrome_columns_sse2(rt, layer, offset+16, syn+16) << 16;
+      else nonzero |= syndrome_columns_portable(rt, layer, offset+16, columns-16, syn+16) << 16;
+
+      return nonzero;
+   }
+
+   return syndrome_columns_portable(rt, layer, offset, columns, syn);
+}
+
+/*
+ * Count the codewords with nonzero syndromes in the columns
+ * offset..offset+columns-1 of the given layers.
+ */
+
+int CountErrorSyndromes(ReedSolomonTables *rt, unsigned char **layer, int offset, int columns)
+{  guint8 syn[rt->nroots*SYNDROME_COLUMNS];
+   int count = 0;
+   int c;
+
+   for(c=0; c<columns; c+=SYNDROME_COLUMNS)
+   {  guint32 nonzero = ComputeSyndromeColumns(rt, layer, offset+c, 
+						MIN(columns-c, SYNDROME_COLUMNS), syn);
+
+      while(nonzero)
+      {  count++;
+	 nonzero &= nonzero-1;
+      }
+   }
+
+   return count;
+}
+
+/***
+ *** Errors and erasures decoding
+ ***
+ * Shared by the RS01, RS02 and RS03 codecs. All codewords of an ecc block
+ * have the same erasures, so the erasure locator polynomial and the Forney
+ * constants for the erasure positions are computed once per ecc block
+ * by SetRSDecoderErasures() and then reused for each byte column.
+ */
+
+RSDecoder* CreateRSDecoder(ReedSolomonTables *rt)
+{  RSDecoder *dec = g_malloc0(sizeof(RSDecoder));
+   int k;
+
+   dec->rt = rt;
+   dec->blockSyn      = g_malloc(rt->nroots*2048);
+   dec->blockError    = g_malloc(rt->nroots*2048);
+   dec->erasureMatrix = g_malloc(rt->nroots*rt->nroots);
+   dec->scratch       = g_malloc(2048);
+
+   /* Position k is found by the Chien search at alpha**rootOf[k],
+      with the roots counted from 1 to GF_FIELDMAX. */
+
+   for(k=0; k<GF_FIELDMAX; k++)
+   {  int root = mod_fieldmax(rt->primElem*(k+1));
+
+      dec->rootOf[k] = root ? root : GF_FIELDMAX;
+      dec->positionOf[dec->rootOf[k]] = k;
+   }
+
+   return dec;
+}
+
+void FreeRSDecoder(RSDecoder *dec)
+{  g_free(dec->blockSyn);
+   g_free(dec->blockError);
+   g_free(dec->erasureMatrix);
+   g_free(dec->scratch);
+   g_free(dec);
+}
+
+/*
+ * Prepare the decoder for a new ecc block with the given erasures.
+ */
+
+void SetRSDecoderErasures(RSDecoder *dec, int *erasure_list, int erasure_count)
+{  ReedSolomonTables *rt = dec->rt;
+   gint32 *gf_index_of = rt->gfTables->indexOf;
+   gint32 *gf_alpha_to = rt->gfTables->alphaTo;
+   int nroots = rt->nroots;
+   int gamma[GF_FIELDSIZE];
+   int i,j,u,tmp;
+
+   memset(dec->isErasure, 0, sizeof(dec->isErasure));
+   dec->erasureCount = erasure_count;
+   dec->matrixValid = FALSE;
+   if(erasure_count > nroots)   /* uncorrectable anyways */
+     return;
+
+   /* Erasure locator polynomial gamma(x) = prod (1 + x*alpha**-root) */
+
+   memset(gamma+1, 0, nroots*sizeof(gamma[0]));
+   gamma[0] = 1;
+
+   if(erasure_count > 0)
+   {  gamma[1] = gf_alpha_to[mod_fieldmax(rt->primElem*(GF_FIELDMAX-1-erasure_list[0]))];
+      for(i=1; i<erasure_count; i++) 
+      {  u = mod_fieldmax(rt->primElem*(GF_FIELDMAX-1-erasure_list[i]));
+	 for(j=i+1; j>0; j--) 
+	 {  tmp = gf_index_of[gamma[j-1]];
+	    if(tmp != GF_ALPHA0)
+	      gamma[j] ^= gf_alpha_to[mod_fieldmax(u + tmp)];
+	 }
+      }
+   }
+
+   for(i=0; i<=nroots; i++)
+     dec->gamma[i] = gf_index_of[gamma[i]];
+
+   /* The Chien search delivers the roots in ascending order and the
+      corrections are reported in reverse; do the same for the erasures. */
+
+   for(i=0; i<erasure_count; i++)
+   {  int pos = erasure_list[i];
+
+      dec->isErasure[pos] = TRUE;
+      for(j=i; j>0 && dec->rootOf[dec->erasureOrder[j-1]] < dec->rootOf[pos]; j--)
+	dec->erasureOrder[j] = dec->erasureOrder[j-1];
+      dec->erasureOrder[j] = pos;
+   }
+
+   /* Forney constants num2/den for the erasure-only case,
+      where the error locator polynomial is gamma(x) itself. */
+
+   for(i=0; i<erasure_count; i++)
+   {  int root = dec->rootOf[dec->erasureOrder[i]];
+      int num2 = mod_fieldmax(root * (rt->fcr - 1) + GF_FIELDMAX);
+      int den = 0;
+
+      /* gamma[j+1] for j even is the formal derivative of gamma[j] */
+
+      for(j=MIN(erasure_count, nroots-1) & ~1; j>=0; j-=2) 
+      {  if(dec->gamma[j+1] != GF_ALPHA0)
+	   den ^= gf_alpha_to[mod_fieldmax(dec->gamma[j+1] + j * root)];
+      }
+
+      dec->erasureScale[i] = mod_fieldmax(num2 + GF_FIELDMAX - gf_index_of[den]);
+   }
+}
+
+/*
+ * Erasures only: The syndromes are fully explained by the erasures
+ * if the Forney syndromes, e.g. the coefficients erasure_count..nroots-1
+ * of syn(x)*gamma(x), are zero. Berlekamp-Massey would leave the
+ * error locator at gamma(x) then, so the error positions are known
+ * and the error values can be calculated directly.
+ */
+
+static int erasures_only(RSDecoder *dec, int *syn)
+{  gint32 *gf_alpha_to = dec->rt->gfTables->alphaTo;
+   int nroots = dec->rt->nroots;
+   int erasure_count = dec->erasureCount;
+   int j,r,tmp;
+
+   for(r=erasure_count; r<nroots; r++)
+   {  tmp = 0;
+      for(j=0; j<=erasure_count; j++)
+	if(dec->gamma[j] != GF_ALPHA0 && syn[r-j] != GF_ALPHA0)
+	  tmp ^= gf_alpha_to[mod_fieldmax(dec->gamma[j] + syn[r-j])];
+
+      if(tmp) return FALSE;
+   }
+
+   return TRUE;
+}
+
+/* Error values for all erasures, in the order of dec->erasureOrder */
+
+static void erasure_values(RSDecoder *dec, int *syn, int *value)
+{  gint32 *gf_index_of = dec->rt->gfTables->indexOf;
+   gint32 *gf_alpha_to = dec->rt->gfTables->alphaTo;
+   int erasure_count = dec->erasureCount;
+   int omega[erasure_count+1];
+   int i,j,tmp;
+
+   /* Error evaluator omega(x) = syn(x)*gamma(x) mod x**erasure_count */
+
+   for(i=0; i<erasure_count; i++)
+   {  tmp = 0;
+      for(j=i; j>=0; j--)
+	if(syn[i-j] != GF_ALPHA0 && dec->gamma[j] != GF_ALPHA0)
+	  tmp ^= gf_alpha_to[mod_fieldmax(syn[i-j] + dec->gamma[j])];
+
+      omega[i] = gf_index_of[tmp];
+   }
+
+   for(j=0; j<erasure_count; j++)
+   {  int root = dec->rootOf[dec->erasureOrder[j]];
+      int num1 = 0;
+
+      for(i=erasure_count-1; i>=0; i--)
+	if(omega[i] != GF_ALPHA0)
+	  num1 ^= gf_alpha_to[mod_fieldmax(omega[i] + i * root)];
+
+      value[j] = num1 ? gf_alpha_to[mod_fieldmax(gf_index_of[num1] + dec->erasureScale[j])] : 0;
+   }
+}
+
+static int decode_erasures(RSDecoder *dec, int *syn, int *location, int *error)
+{  int value[dec->erasureCount+1];
+   int count = 0;
+   int j;
+
+   if(!erasures_only(dec, syn))
+     return -1;
+
+   erasure_values(dec, syn, value);
+
+   for(j=0; j<dec->erasureCount; j++)
+   {  if(value[j])
+      {  location[count] = dec->erasureOrder[j];
+	 error[count++] = value[j];
+      }
+   }
+
+   return count;
+}
+
+/*
+ * Find the roots of lambda(x). Since lambda(x) is a multiple of gamma(x),
+ * the erasure positions are roots and only the other positions need to be
+ * evaluated, using the quotient sigma(x) = lambda(x)/gamma(x) of smaller degree.
+ * If the division leaves a remainder, search all positions as usual.
+ */
+
+static int find_roots(RSDecoder *dec, int *lambda, int deg_lambda, int *root)
+{  ReedSolomonTables *rt = dec->rt;
+   gint32 *gf_index_of = rt->gfTables->indexOf;
+   gint32 *gf_alpha_to = rt->gfTables->alphaTo;
+   int erasure_count = dec->erasureCount;
+   int rem[deg_lambda+1], sigma[deg_lambda+1];
+   int deg_sigma = deg_lambda - erasure_count;
+   int count = 0;
+   int i,j,k;
+
+   if(deg_sigma >= 0)
+   {  int lead = dec->gamma[erasure_count];
+
+      for(i=0; i<=deg_lambda; i++)
+	rem[i] = lambda[i] == GF_ALPHA0 ? 0 : gf_alpha_to[lambda[i]];
+
+      for(i=deg_sigma; i>=0; i--)
+      {  int q = rem[i+erasure_count];
+
+	 sigma[i] = q;
+	 if(!q) continue;
+	 q = mod_fieldmax(gf_index_of[q] + GF_FIELDMAX - lead);
+	 sigma[i] = gf_alpha_to[q];
+
+	 for(j=0; j<=erasure_count; j++)
+	   if(dec->gamma[j] != GF_ALPHA0)
+	     rem[i+j] ^= gf_alpha_to[mod_fieldmax(dec->gamma[j] + q)];
+      }
+
+      for(i=0; i<erasure_count; i++)
+	if(rem[i]) break;
+
+      if(i == erasure_count)
+      {  for(i=0; i<=deg_sigma; i++)
+	   sigma[i] = gf_index_of[sigma[i]];
+
+	 for(i=1; i<=GF_FIELDMAX; i++)
+	 {  int q;
+
+	    if(dec->isErasure[dec->positionOf[i]])
+	    {  root[count++] = i;
+	       if(count == deg_lambda) break;
+	       continue;
+	    }
+
+	    if(!deg_sigma) continue;
+
+	    /* Horner's scheme for sigma(alpha**i) */
+
+	    q = sigma[deg_sigma] == GF_ALPHA0 ? 0 : gf_alpha_to[sigma[deg_sigma]];
+	    for(j=deg_sigma-1; j>=0; j--)
+	    {  q = q ? gf_alpha_to[mod_fieldmax(gf_index_of[q] + i)] : 0;
+	       if(sigma[j] != GF_ALPHA0)
+		 q ^= gf_alpha_to[sigma[j]];
+	    }
+
+	    if(q) continue; /* Not a root */
+
+	    root[count] = i;
+	    if(++count == deg_lambda) break;
+	 }
+
+	 return count;
+      }
+   }
+
+   /* Chien search over all positions */
+
+   {  int reg[deg_lambda+1];
+
+      memcpy(reg+1, lambda+1, deg_lambda*sizeof(reg[0]));
+
+      for(i=1; i<=GF_FIELDMAX; i++)
+      {  int q = 1; /* lambda[0] is always 0 */
+
+	 for(k=deg_lambda; k>0; k--)
+	 {  if(reg[k] != GF_ALPHA0) 
+	    {  reg[k] = mod_fieldmax(reg[k] + k);
+	       q ^= gf_alpha_to[reg[k]];
+	    }
+	 }
+
+	 if(q != 0) continue; /* Not a root */
+
+	 root[count] = i;
+
+	 /* If we've already found max possible roots, abort the search to save time */
+
+	 if(++count == deg_lambda) break;
+      }
+   }
+
+   return count;
+}
+
+/*
+ * Decode one codeword from its syndromes, given in poly form
+ * at syndrome[0], syndrome[stride], ... Returns the number of
+ * corrections stored in location[] and error[], or -1 if the
+ * codeword is uncorrectable. The corrections are delivered in the
+ * same order as by the original Berlekamp-Massey/Chien/Forney code,
+ * so that the log output does not depend on the decoding path.
+ */
+
+int RSDecodeColumn(RSDecoder *dec, guint8 *syndrome, int stride, int *location, int *error)
+{  ReedSolomonTables *rt = dec->rt;
+   gint32 *gf_index_of = rt->gfTables->indexOf;
+   gint32 *gf_alpha_to = rt->gfTables->alphaTo;
+   int nroots = rt->nroots;
+   int erasure_count = dec->erasureCount;
+   int syn[nroots];
+   int lambda[nroots+1], b[nroots+1], t[nroots+1], omega[nroots+1];
+   int root[GF_FIELDMAX];
+   int r, deg_lambda, el, deg_omega;
+   int tmp,num1,num2,den,discr_r;
+   int count,corrections;
+   int i,j;
+
+   if(erasure_count > nroots)
+     return -1;
+
+   /* Convert syndromes to index form */
+
+   for(i=0; i<nroots; i++)
+     syn[i] = gf_index_of[syndrome[i*stride]];
+
+   corrections = decode_erasures(dec, syn, location, error);
+   if(corrections >= 0)
+     return corrections;
+
+   /* Initialize lambda to be the erasure locator polynomial */
+
+   for(i=0; i<nroots+1; i++)
+   {  b[i] = dec->gamma[i];
+      lambda[i] = b[i] == GF_ALPHA0 ? 0 : gf_alpha_to[b[i]];
+   }
+
+   /* Begin Berlekamp-Massey algorithm to determine error+erasure locator polynomial */
+
+   r = erasure_count;   /* r is the step number */
+   el = erasure_count;
+   while(++r <= nroots) /* Compute discrepancy at the r-th step in poly-form */
+   {  
+      discr_r = 0;
+      for(i=0; i<r; i++)
+	if((lambda[i] != 0) && (syn[r-i-1] != GF_ALPHA0))
+	  discr_r ^= gf_alpha_to[mod_fieldmax(gf_index_of[lambda[i]] + syn[r-i-1])];
+
+      discr_r = gf_index_of[discr_r];	/* Index form */
+
+      if(discr_r == GF_ALPHA0) 
+      {  /* B(x) = x*B(x) */
+	 memmove(b+1, b, nroots*sizeof(b[0]));
+	 b[0] = GF_ALPHA0;
+      } 
+      else 
+      {  /* T(x) = lambda(x) - discr_r*x*b(x) */
+	 t[0] = lambda[0];
+	 for(i=0; i<nroots; i++) 
+	 {  if(b[i] != GF_ALPHA0)
+		 t[i+1] = lambda[i+1] ^ gf_alpha_to[mod_fieldmax(discr_r + b[i])];
+	    else t[i+1] = lambda[i+1];
+	 }
+
+	 if(2*el <= r+erasure_count-1) 
+	 {  el = r + erasure_count - el;
+
+	    /* B(x) <-- inv(discr_r) * lambda(x) */
+	    for(i=0; i<=nroots; i++)
+	      b[i] = (lambda[i] == 0) ? GF_ALPHA0 : mod_fieldmax(gf_index_of[lambda[i]] - discr_r + GF_FIELDMAX);
+	 } 
+	 else 
+	 {  /* 2 lines below: B(x) <-- x*B(x) */
+	    memmove(b+1, b, nroots*sizeof(b[0]));
+	    b[0] = GF_ALPHA0;
+	 }
+
+	 memcpy(lambda,t,(nroots+1)*sizeof(t[0]));
+      }
+   }
+
+   /* Convert lambda to index form and compute deg(lambda(x)) */
+   deg_lambda = 0;
+   for(i=0; i<nroots+1; i++)
+   {  lambda[i] = gf_index_of[lambda[i]];
+      if(lambda[i] != GF_ALPHA0)
+	deg_lambda = i;
+   }
+
+   count = find_roots(dec, lambda, deg_lambda, root);
+
+   /* deg(lambda) unequal to number of roots => uncorrectable error detected */
+
+   if(deg_lambda != count)
+   {  dec->degLambda = deg_lambda;
+      dec->rootCount = count;
+      return -1;
+   }
+
+   /* Compute err+eras evaluator poly omega(x) = syn(x)*lambda(x) 
+      (modulo x**nroots). in index form. Also find deg(omega). */
+
+   deg_omega = deg_lambda-1;
+
+   for(i=0; i<=deg_omega; i++)
+   {  tmp = 0;
+      for(j=i; j>=0; j--)
+      {  if((syn[i - j] != GF_ALPHA0) && (lambda[j] != GF_ALPHA0))
+	   tmp ^= gf_alpha_to[mod_fieldmax(syn[i - j] + lambda[j])];
+      }
+
+      omega[i] = gf_index_of[tmp];
+   }
+
+   /* Compute error values in poly-form. 
+      num1 = omega(inv(X(l))), 
+      num2 = inv(X(l))**(FIRST_ROOT-1) and 
+      den  = lambda_pr(inv(X(l))) all in poly-form. */
+
+   corrections = 0;
+   for(j=count-1; j>=0; j--)
+   {  num1 = 0;
+
+      for(i=deg_omega; i>=0; i--) 
+      {  if(omega[i] != GF_ALPHA0)
+	    num1 ^= gf_alpha_to[mod_fieldmax(omega[i] + i * root[j])];
+      }
+
+      if(num1 == 0)
+	continue;
+
+      num2 = gf_alpha_to[mod_fieldmax(root[j] * (rt->fcr - 1) + GF_FIELDMAX)];
+      den = 0;
+    
+      /* lambda[i+1] for i even is the formal derivative lambda_pr of lambda[i] */
+
+      for(i=MIN(deg_lambda, nroots-1) & ~1; i>=0; i-=2) 
+      {  if(lambda[i+1] != GF_ALPHA0)
+	   den ^= gf_alpha_to[mod_fieldmax(lambda[i+1] + i * root[j])];
+      }
+
+      location[corrections] = dec->positionOf[root[j]];
+      error[corrections++]  = gf_alpha_to[mod_fieldmax(gf_index_of[num1] + gf_index_of[num2] + GF_FIELDMAX - gf_index_of[den])];
+   }
+
+   return corrections;
+}
+
+/***
+ *** Column-batched decoding
+ ***
+ * All 2048 codewords of an ecc block share the same erasures. Unless a
+ * codeword has errors besides them, its error values are a linear function
+ * of its first erasure_count syndromes. The respective matrix is computed
+ * once per ecc block and then applied to all columns at once as a
+ * GF matrix-vector product, using the SIMD multiply-add routines below.
+ * Columns with additional errors are recognized by their nonzero
+ * Forney syndromes and handed over to RSDecodeColumn().
+ */
+
+/*
+ * dst[i] ^= factor * src[i] for i=0..n-1, with the multiplication
+ * split into nibble lookups like in the SIMD syndrome code.
+ */
+
+void mul_add_columns_sse2(guint8*, guint8*, int, guint8*);
+void mul_add_columns_avx2(guint8*, guint8*, int, guint8*);
+
+static void mul_add_columns(RSDecoder *dec, guint8 *dst, guint8 *src, int factor)
+{  gint32 *gf_index_of = dec->rt->gfTables->indexOf;
+   gint32 *gf_alpha_to = dec->rt->gfTables->alphaTo;
+   guint8 nibble_lut[32];
+   int i;
+
+   if(!factor) return;
+
+   for(i=0; i<16; i++)
+   {  nibble_lut[i]    = i ? gf_alpha_to[mod_fieldmax(gf_index_of[i] + gf_index_of[factor])] : 0;
+      nibble_lut[16+i] = i ? gf_alpha_to[mod_fieldmax(gf_index_of[i<<4] + gf_index_of[factor])] : 0;
+   }
+
+   if(dec->useAVX2)
+     mul_add_columns_avx2(dst, src, 2048, nibble_lut);
+   else if(dec->useSSE2)
+     mul_add_columns_sse2(dst, src, 2048, nibble_lut);
+   else
+   {  for(i=0; i<2048; i++)
+	dst[i] ^= nibble_lut[src[i] & 15] ^ nibble_lut[16 + (src[i] >> 4)];
+   }
+}
+
+/*
+ * Evaluate the error values for unit syndromes to obtain
+ * the columns of the erasure decoding matrix.
+ */
+
+static void build_erasure_matrix(RSDecoder *dec)
+{  int nroots = dec->rt->nroots;
+   int erasure_count = dec->erasureCount;
+   int syn[nroots], value[erasure_count];
+   int i,j;
+
+   for(i=0; i<nroots; i++)
+     syn[i] = GF_ALPHA0;
+
+   for(i=0; i<erasure_count; i++)
+   {  syn[i] = 0;   /* alpha**0 = 1 */
+      erasure_values(dec, syn, value);
+      syn[i] = GF_ALPHA0;
+
+      for(j=0; j<erasure_count; j++)
+	dec->erasureMatrix[j*erasure_count+i] = value[j];
+   }
+
+   dec->matrixValid = TRUE;
+}
+
+/*
+ * Calculate the syndromes of the ecc block made from the 2048 bytes at
+ * layer[j]+offset, j=0..254, and the error values for all columns
+ * whose errors are restricted to the erasures given by SetRSDecoderErasures().
+ * Afterwards, dec->nonzero marks the columns with nonzero syndromes and
+ * RSDecodeBlockColumn() delivers their corrections.
+ */
+
+void RSDecodeBlock(RSDecoder *dec, unsigned char **layer, int offset)
+{  ReedSolomonTables *rt = dec->rt;
+   gint32 *gf_alpha_to = rt->gfTables->alphaTo;
+   int nroots = rt->nroots;
+   int erasure_count = dec->erasureCount;
+   guint8 syn[nroots*SYNDROME_COLUMNS];
+   guint32 any = 0;
+   int c,i,j,r;
+
+   /* Syndromes of all columns, one row of 2048 bytes per syndrome */
+
+   for(c=0; c<2048; c+=SYNDROME_COLUMNS)
+   {  guint32 nonzero = ComputeSyndromeColumns(rt, layer, offset+c, SYNDROME_COLUMNS, syn);
+
+      dec->nonzero[c/SYNDROME_COLUMNS] = dec->fallback[c/SYNDROME_COLUMNS] = nonzero;
+      any |= nonzero;
+
+      for(i=0; i<nroots; i++)
+	memcpy(dec->blockSyn+i*2048+c, syn+i*SYNDROME_COLUMNS, SYNDROME_COLUMNS);
+   }
+
+   /* Nothing to batch; remaining columns are decoded one by one */
+
+   if(!any || erasure_count == 0 || erasure_count > nroots)
+     return;
+
+   select_simd(&dec->useSSE2, &dec->useAVX2);
+
+   if(!dec->matrixValid)
+     build_erasure_matrix(dec);
+
+   /* Columns with nonzero Forney syndromes have errors besides the erasures */
+
+   memset(dec->fallback, 0, sizeof(dec->fallback));
+
+   for(r=erasure_count; r<nroots; r++)
+   {  memset(dec->scratch, 0, 2048);
+
+      for(j=0; j<=erasure_count; j++)
+	if(dec->gamma[j] != GF_ALPHA0)
+	  mul_add_columns(dec, dec->scratch, dec->blockSyn+(r-j)*2048, gf_alpha_to[dec->gamma[j]]);
+
+      for(c=0; c<2048; c++)
+	if(dec->scratch[c])
+	  dec->fallback[c/SYNDROME_COLUMNS] |= 1U<<(c%SYNDROME_COLUMNS);
+   }
+
+   for(c=0; c<2048/SYNDROME_COLUMNS; c++)
+     dec->fallback[c] &= dec->nonzero[c];
+
+   /* Error values of the erasures */
+
+   for(j=0; j<erasure_count; j++)
+   {  guint8 *error = dec->blockError+j*2048;
+
+      memset(error, 0, 2048);
+      for(i=0; i<erasure_count; i++)
+	mul_add_columns(dec, error, dec->blockSyn+i*2048, dec->erasureMatrix[j*erasure_count+i]);
+   }
+}
+
+/*
+ * Corrections for the given column after RSDecodeBlock(),
+ * with the same results as RSDecodeColumn().
+ */
+
+int RSDecodeBlockColumn(RSDecoder *dec, int column, int *location, int *error)
+{  int count = 0;
+   int j;
+
+   if(dec->fallback[column/SYNDROME_COLUMNS] & (1U<<(column%SYNDROME_COLUMNS)))
+     return RSDecodeColumn(dec, dec->blockSyn+column, 2048, location, error);
+
+   for(j=0; j<dec->erasureCount; j++)
+   {  int value = dec->blockError[j*2048+column];
+
+      if(value)
+      {  location[count] = dec->erasureOrder[j];
+	 error[count++] = value;
+      }
+   }
+
+   return count;
+}
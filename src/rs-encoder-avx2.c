@@ -0,0 +1,144 @@
+/*  dvdisaster: Additional error correction for optical media.
+ *  Copyright (C) 2004-2017 Carsten Gnoerlich.
+ *  Copyright (C) 2019-2021 The dvdisaster development team.
+ * 
+ *  Email: support@dvdisaster.org
+ *
+ *  This file is part of dvdisaster.
+ *
+ *  dvdisaster is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  dvdisaster is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with dvdisaster. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*** src type: no GUI code ***/
+
+#include "dvdisaster.h"
+
+#ifdef HAVE_AVX2
+  #include <immintrin.h>
+
+#ifdef HAVE_CPUID
+  #include <cpuid.h>
+#else
+  #include "compat/cpuid.h"
+#endif
+#endif
+
+/***
+ *** Reed-Solomon encoding using AVX2 intrinsics
+ ***/
+
+/* AVX2 version */
+
+#ifdef HAVE_AVX2
+int ProbeAVX2(void)
+{  unsigned int eax, ebx, ecx, edx;
+   unsigned int xcr0_lo, xcr0_hi;
+
+   if(!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+   {  Verbose("[ProbeAVX2: get_cpuid() failed]\n");
+      return 0;
+   }
+
+   /* The OS must save the ymm registers on context switches */
+
+   if(!(ecx & bit_OSXSAVE) || !(ecx & bit_AVX))
+   {  Verbose("[ProbeAVX2: no AVX2]\n");
+      return 0;
+   }
+
+   __asm__ volatile ("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+   if((xcr0_lo & 6) != 6)
+   {  Verbose("[ProbeAVX2: AVX2 not enabled by OS]\n");
+      return 0;
+   }
+
+   if(__get_cpuid_max(0, NULL) < 7)
+   {  Verbose("[ProbeAVX2: no AVX2]\n");
+      return 0;
+   }
+
+   __cpuid_count(7, 0, eax, ebx, ecx, edx);
+   if(ebx & bit_AVX2)
+   {  Verbose("[ProbeAVX2: AVX2 available]\n");
+      return 1;
+   }
+   else
+   {  Verbose("[ProbeAVX2: no AVX2]\n");
+      return 0;
+   }
+}
+
+/* Same as the SSE2 version, but processes the lut in 256 bit steps.
+ * The remaining 128 bits (if nroots_aligned is not a multiple of 32)
+ * are done in one 128 bit step. 
+ */
+
+void encode_next_layer_avx2(ReedSolomonTables *rt, unsigned char *data, unsigned char *parity, guint64 layer_size, int shift)
+{  gint32 *gf_index_of  = rt->gfTables->indexOf;
+   gint32 *enc_alpha_to = rt->gfTables->encAlphaTo;
+   gint32 *rs_gpoly     = rt->gpoly;
+   int nroots           = rt->nroots;
+   int nroots_aligned   = (nroots+15)&~15;
+   int nroots_full      = nroots_aligned>>5;
+   int nroots_half      = nroots_aligned&16;
+   int i,j;
+
+   for(i=0; i<layer_size; i++)
+   {  int feedback    = gf_index_of[data[i] ^ parity[shift]];
+      int offset      = nroots-shift-1;
+
+      if(feedback != GF_ALPHA0) /* non-zero feedback term */
+      {	 guint8 *par_idx = (guint8*)parity;
+	 guint8 *e_lut = rt->bLut[feedback]+offset;
+
+	 /* Process lut in 256 bit steps */
+
+	 for(j=nroots_full; j; j--)
+	 {  __m256i par = _mm256_loadu_si256((__m256i*)par_idx);
+	    __m256i lut = _mm256_loadu_si256((__m256i*)e_lut);
+
+	    _mm256_storeu_si256((__m256i*)par_idx, _mm256_xor_si256(par, lut));
+	    par_idx += 32;
+	    e_lut += 32;
+	 }
+
+	 if(nroots_half)
+	 {  __m128i par = _mm_loadu_si128((__m128i*)par_idx);
+	    __m128i lut = _mm_loadu_si128((__m128i*)e_lut);
+
+	    _mm_storeu_si128((__m128i*)par_idx, _mm_xor_si128(par, lut));
+	 }
+
+	 parity[shift] = enc_alpha_to[feedback + rs_gpoly[0]];
+      }
+      else  /* zero feedback term */
+	parity[shift] = 0;
+
+      parity += nroots_aligned;
+   }
+}
+#else /* don't have AVX2 */
+/* Stub functions to keep the linker happy.
+ * Should never be executed.
+ */
+
+int ProbeAVX2()
+{  return 0;
+}
+
+void encode_next_layer_avx2(ReedSolomonTables *rt, unsigned char *data, unsigned char *parity, guint64 layer_size, int shift)
+{
+   Stop("Mega borkage - EncodeNextLayerAVX2() stub called.\n");
+}
+#endif /* HAVE_AVX2 */
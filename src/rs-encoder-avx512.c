@@ -0,0 +1,147 @@
+/*  dvdisaster: Additional error correction for optical media.
+ *  Copyright (C) 2004-2017 Carsten Gnoerlich.
+ *  Copyright (C) 2019-2021 The dvdisaster development team.
+ * 
+ *  Email: support@dvdisaster.org
+ *
+ *  This file is part of dvdisaster.
+ *
+ *  dvdisaster is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  dvdisaster is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with dvdisaster. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*** src type: no GUI code ***/
+
+#include "dvdisaster.h"
+
+#ifdef HAVE_AVX512
+  #include <immintrin.h>
+
+#ifdef HAVE_CPUID
+  #include <cpuid.h>
+#else
+  #include "compat/cpuid.h"
+#endif
+#endif
+
+/***
+ *** Reed-Solomon encoding using AVX-512BW intrinsics
+ ***/
+
+/* AVX-512BW version */
+
+#ifdef HAVE_AVX512
+int ProbeAVX512(void)
+{  unsigned int eax, ebx, ecx, edx;
+   unsigned int xcr0_lo, xcr0_hi;
+
+   if(!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+   {  Verbose("[ProbeAVX512: get_cpuid() failed]\n");
+      return 0;
+   }
+
+   /* The OS must save the opmask and zmm registers on context switches */
+
+   if(!(ecx & bit_OSXSAVE))
+   {  Verbose("[ProbeAVX512: no AVX-512BW]\n");
+      return 0;
+   }
+
+   __asm__ volatile ("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+   if((xcr0_lo & 0xe6) != 0xe6)
+   {  Verbose("[ProbeAVX512: AVX-512 not enabled by OS]\n");
+      return 0;
+   }
+
+   if(__get_cpuid_max(0, NULL) < 7)
+   {  Verbose("[ProbeAVX512: no AVX-512BW]\n");
+      return 0;
+   }
+
+   __cpuid_count(7, 0, eax, ebx, ecx, edx);
+   if((ebx & bit_AVX512F) && (ebx & bit_AVX512BW))
+   {  Verbose("[ProbeAVX512: AVX-512BW available]\n");
+      return 1;
+   }
+   else
+   {  Verbose("[ProbeAVX512: no AVX-512BW]\n");
+      return 0;
+   }
+}
+
+/* Same as the SSE2 version, but processes the lut in 512 bit steps.
+ * The remainder of nroots_aligned is done in 128 bit steps;
+ * masked 512 bit loads and stores are much slower for the
+ * short parity rows of small nroots.
+ */
+
+void encode_next_layer_avx512(ReedSolomonTables *rt, unsigned char *data, unsigned char *parity, guint64 layer_size, int shift)
+{  gint32 *gf_index_of  = rt->gfTables->indexOf;
+   gint32 *enc_alpha_to = rt->gfTables->encAlphaTo;
+   gint32 *rs_gpoly     = rt->gpoly;
+   int nroots           = rt->nroots;
+   int nroots_aligned   = (nroots+15)&~15;
+   int nroots_full      = nroots_aligned>>6;
+   int nroots_tail      = (nroots_aligned&63)>>4;
+   int i,j;
+
+   for(i=0; i<layer_size; i++)
+   {  int feedback    = gf_index_of[data[i] ^ parity[shift]];
+      int offset      = nroots-shift-1;
+
+      if(feedback != GF_ALPHA0) /* non-zero feedback term */
+      {	 guint8 *par_idx = (guint8*)parity;
+	 guint8 *e_lut = rt->bLut[feedback]+offset;
+
+	 /* Process lut in 512 bit steps */
+
+	 for(j=nroots_full; j; j--)
+	 {  __m512i par = _mm512_loadu_si512((void*)par_idx);
+	    __m512i lut = _mm512_loadu_si512((void*)e_lut);
+
+	    _mm512_storeu_si512((void*)par_idx, _mm512_xor_si512(par, lut));
+	    par_idx += 64;
+	    e_lut += 64;
+	 }
+
+	 for(j=nroots_tail; j; j--)
+	 {  __m128i par = _mm_loadu_si128((__m128i*)par_idx);
+	    __m128i lut = _mm_loadu_si128((__m128i*)e_lut);
+
+	    _mm_storeu_si128((__m128i*)par_idx, _mm_xor_si128(par, lut));
+	    par_idx += 16;
+	    e_lut += 16;
+	 }
+
+	 parity[shift] = enc_alpha_to[feedback + rs_gpoly[0]];
+      }
+      else  /* zero feedback term */
+	parity[shift] = 0;
+
+      parity += nroots_aligned;
+   }
+}
+#else /* don't have AVX-512BW */
+/* Stub functions to keep the linker happy.
+ * Should never be executed.
+ */
+
+int ProbeAVX512()
+{  return 0;
+}
+
+void encode_next_layer_avx512(ReedSolomonTables *rt, unsigned char *data, unsigned char *parity, guint64 layer_size, int shift)
+{
+   Stop("Mega borkage - EncodeNextLayerAVX512() stub called.\n");
+}
+#endif /* HAVE_AVX512 */
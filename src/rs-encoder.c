@@ -221,10 +221,12 @@ static void encode_next_layer_64bit(ReedSolomonTables *rt, unsigned char *data,
 }
 
 /*
- * Dispatch upon availability of SSE2 intrinsics
+ * Dispatch upon availability of SSE2/AVX2/AVX-512BW intrinsics
  */
 
 void encode_next_layer_sse2(ReedSolomonTables*, unsigned char*, unsigned char*, guint64, int);
+void encode_next_layer_avx2(ReedSolomonTables*, unsigned char*, unsigned char*, guint64, int);
+void encode_next_layer_avx512(ReedSolomonTables*, unsigned char*, unsigned char*, guint64, int);
 void encode_next_layer_altivec(ReedSolomonTables*, unsigned char*, unsigned char*, guint64, int);
 
 void EncodeNextLayer(ReedSolomonTables *rt, unsigned char *data, unsigned char *parity, guint64 layer_size, int shift)
@@ -239,11 +241,21 @@ void EncodeNextLayer(ReedSolomonTables *rt, unsigned char *data, unsigned char *
        case ENCODING_ALG_SSE2:
 	  encode_next_layer_sse2(rt, data, parity, layer_size, shift);
 	  break;
+       case ENCODING_ALG_AVX2:
+	  encode_next_layer_avx2(rt, data, parity, layer_size, shift);
+	  break;
+       case ENCODING_ALG_AVX512:
+	  encode_next_layer_avx512(rt, data, parity, layer_size, shift);
+	  break;
        case ENCODING_ALG_ALTIVEC:
 	  encode_next_layer_altivec(rt, data, parity, layer_size, shift);
 	  break;
        case ENCODING_ALG_DEFAULT:
-	 if(Closure->useSSE2)
+	 if(Closure->useAVX512)
+	   encode_next_layer_avx512(rt, data, parity, layer_size, shift);
+	 else if(Closure->useAVX2)
+	   encode_next_layer_avx2(rt, data, parity, layer_size, shift);
+	 else if(Closure->useSSE2)
 	   encode_next_layer_sse2(rt, data, parity, layer_size, shift);
 	 else if(Closure->useAltiVec)
 	   encode_next_layer_altivec(rt, data, parity, layer_size, shift);
@@ -269,11 +281,21 @@ void DescribeRSEncoder(char **algorithm, char **iostrategy)
      case ENCODING_ALG_SSE2:
         *algorithm="SSE2";
 	break;
+     case ENCODING_ALG_AVX2:
+        *algorithm="AVX2";
+	break;
+     case ENCODING_ALG_AVX512:
+        *algorithm="AVX512";
+	break;
      case ENCODING_ALG_ALTIVEC:
         *algorithm="AltiVec";
 	break;
      case ENCODING_ALG_DEFAULT:
-        if(Closure->useSSE2)
+        if(Closure->useAVX512)
+	  *algorithm="AVX512";
+	else if(Closure->useAVX2)
+	  *algorithm="AVX2";
+	else if(Closure->useSSE2)
 	  *algorithm="SSE2";
 	else if(Closure->useAltiVec)
 	  *algorithm="AltiVec";
@@ -284,5 +306,7 @@ void DescribeRSEncoder(char **algorithm, char **iostrategy)
 
   if(Closure->encodingIOStrategy == IO_STRATEGY_MMAP)
        *iostrategy="mmap";
+  else if(Closure->encodingIOStrategy == IO_STRATEGY_DIRECT)
+       *iostrategy="direct";
   else *iostrategy="read/write";
 }
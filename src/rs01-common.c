@@ -207,12 +207,86 @@ void RS01ReadSector(Image *image, unsigned char *buf, gint64 s)
 
 #define CRCBUFSIZE (1024*256)
 
+/*
+ * When verifying, the checksums may come from the CRC cache
+ * written by a previous read of the image. The cache is only
+ * written for images which were read completely, so there are
+ * no missing sectors; only the CRC sums need to be compared
+ * against the ecc file.
+ * Returns FALSE if the image must be scanned normally.
+ */
+
+static int scan_crc_cache(Method *method, Image *image)
+{  CrcBuf *cb;
+   guint32 *crcbuf;
+   gint64 s,count;
+   int crcidx = CRCBUFSIZE;
+
+   if(Closure->crcBuf || !Closure->crcCacheFile || image->inLast != 2048)
+     return FALSE;
+
+   cb = LoadCrcBuf(image, Closure->crcCacheFile);
+   if(!cb)
+     return FALSE;
+
+   if(   !CrcBufValid(cb, image, FULL_IMAGE)
+      || !(cb->md5State & MD5_IMAGE_COMPLETE)
+      || CountBits(cb->valid) != cb->allSectors)
+   {  PrintLog(_("Ignoring CRC cache %s: %s.\n"), Closure->crcCacheFile,
+	       _("checksums do not cover the image"));
+      image->crcCache = NULL;
+      FreeCrcBuf(cb);
+      return FALSE;
+   }
+
+   if(!LargeSeek(image->eccFile, (gint64)sizeof(EccHeader)))
+      Stop(_("Failed skipping the ecc header: %s"),strerror(errno));
+
+   crcbuf = g_malloc(sizeof(guint32) * CRCBUFSIZE);
+   image->sectorsMissing = 0;
+   count = MIN(image->sectorSize, image->expectedSectors);
+
+   for(s=0; s<count; s++)
+   {  if(crcidx >= CRCBUFSIZE)
+      {  size_t remain = count-s;
+	 size_t size;
+
+	 if(remain < CRCBUFSIZE)
+	      size = remain*sizeof(guint32);
+	 else size = CRCBUFSIZE*sizeof(guint32);
+
+	 if(LargeRead(image->eccFile, crcbuf, size) != size)
+	 {  g_free(crcbuf);
+	    Stop(_("Error reading CRC information: %s"),strerror(errno));
+	 }
+	 crcidx = 0;
+      }
+
+      if(cb->crcbuf[s] != crcbuf[crcidx++])
+      {  PrintCLI(_("* CRC error, sector: %" PRId64 "\n"), s);
+	 image->crcErrors++;
+      }
+   }
+   g_free(crcbuf);
+
+#ifdef WITH_GUI_YES
+   if(Closure->guiMode && method->widgetList)
+      RS01AddVerifyValues(method, VERIFY_IMAGE_SEGMENTS, 0, image->crcErrors,
+			  0, image->crcErrors);
+#endif
+
+   memcpy(image->mediumSum, cb->imageMD5sum, 16);
+   image->crcCache = NULL;
+   FreeCrcBuf(cb);
+   return TRUE;
+}
+
 void RS01ScanImage(Method *method, Image* image, struct MD5Context *ecc_ctxt, int mode)
 {  unsigned char buf[2048];
    guint32 *crcbuf = NULL;
    int unrecoverable_sectors = 0;
    int crcidx = 0;
-   struct MD5Context image_md5;
+   MD5Pipe *image_md5;
    gint64 s, first_missing, last_missing;
    int last_percent,current_missing;
    char *msg;
@@ -229,6 +303,11 @@ void RS01ScanImage(Method *method, Image* image, struct MD5Context *ecc_ctxt, in
      wl = (RS01Widgets*)method->widgetList;
 #endif
    
+   /* Take the checksums from the CRC cache if possible */
+
+   if((mode & PRINT_MODE) && image->eccFile && scan_crc_cache(method, image))
+      return;
+
    /* Position behind the ecc file header,
       initialize CRC buffer pointers */
 
@@ -244,7 +323,7 @@ void RS01ScanImage(Method *method, Image* image, struct MD5Context *ecc_ctxt, in
 
    /* Prepare for scanning the image and calculating its md5sum */
 
-   MD5Init(&image_md5);              /* md5sum of image file itself */
+   image_md5 = CreateMD5Pipe();      /* md5sum of image file itself */
    LargeSeek(image->file, 0);        /* rewind image file */   
       
    if(mode & PRINT_MODE)
@@ -265,6 +344,7 @@ void RS01ScanImage(Method *method, Image* image, struct MD5Context *ecc_ctxt, in
       if(Closure->stopActions)   
       {  image->sectorsMissing += image->sectorSize - s;
 	 if(crcbuf) g_free(crcbuf);
+	 FreeMD5Pipe(image_md5);
          return;
       }
 
@@ -274,6 +354,7 @@ void RS01ScanImage(Method *method, Image* image, struct MD5Context *ecc_ctxt, in
       if(n != 2048)
       {  if(s != image->sectorSize - 1 || n != image->inLast)
          {  if(crcbuf) g_free(crcbuf);
+	    FreeMD5Pipe(image_md5);
 	    Stop(_("premature end in image (only %d bytes): %s\n"),n,strerror(errno));
          }
 	 else /* Zero unused sectors for CRC generation */
@@ -321,6 +402,7 @@ void RS01ScanImage(Method *method, Image* image, struct MD5Context *ecc_ctxt, in
 	       MD5Update(ecc_ctxt, (unsigned char*)crcbuf, size);
 	       if(LargeWrite(image->eccFile, crcbuf, size) != size)
 	       { if(crcbuf) g_free(crcbuf);
+		 FreeMD5Pipe(image_md5);
 		 Stop(_("Error writing CRC information: %s"),strerror(errno));
 	       }
 	       crcidx = 0;
@@ -344,6 +426,7 @@ void RS01ScanImage(Method *method, Image* image, struct MD5Context *ecc_ctxt, in
 
 	       if(LargeRead(image->eccFile, crcbuf, size) != size)
 	       { if(crcbuf) g_free(crcbuf);
+		 FreeMD5Pipe(image_md5);
 		 Stop(_("Error reading CRC information: %s"),strerror(errno));
 	       }
 	       crcidx = 0;
@@ -356,7 +439,7 @@ void RS01ScanImage(Method *method, Image* image, struct MD5Context *ecc_ctxt, in
 	 }
       }
 
-      MD5Update(&image_md5, buf, n);  /* update image md5sum */
+      MD5PipeUpdate(image_md5, buf, n);  /* update image md5sum */
 
       if(Closure->guiMode && mode & PRINT_MODE) 
 	   percent = (VERIFY_IMAGE_SEGMENTS*(s+1))/image->sectorSize;
@@ -392,13 +475,15 @@ void RS01ScanImage(Method *method, Image* image, struct MD5Context *ecc_ctxt, in
       MD5Update(ecc_ctxt, (unsigned char*)crcbuf, size);
       if(LargeWrite(image->eccFile, crcbuf, size) != size)
       {	if(crcbuf) g_free(crcbuf);
+	FreeMD5Pipe(image_md5);
 	Stop(_("Error writing CRC information: %s"),strerror(errno));
       }
    }
 
    /*** The image md5sum can only be calculated if all blocks have been successfully read. */
 
-   MD5Final(image->mediumSum, &image_md5);
+   MD5PipeFinal(image->mediumSum, image_md5);
+   FreeMD5Pipe(image_md5);
 
    LargeSeek(image->file, 0);
    if(crcbuf) g_free(crcbuf);
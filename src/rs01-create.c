@@ -29,6 +29,30 @@
 
 #include "rs01-includes.h"
 
+#ifdef SYS_MINGW
+#include <windows.h>
+#endif
+
+#ifdef HAVE_MMAP
+  #include <sys/mman.h>
+
+#if defined(SYS_LINUX)
+
+  #define MMAP_FLAGS (MAP_SHARED | MAP_POPULATE | MAP_NORESERVE)
+
+#elif defined(SYS_FREEBSD)
+
+  #define MMAP_FLAGS (MAP_SHARED | MAP_PREFAULT_READ)
+
+#else
+
+  /* SYS_NETBSD and others. */
+  #define MMAP_FLAGS (MAP_SHARED)
+
+#endif
+
+#endif
+
 /***
  *** Interpret our redundancy settings
  ***
@@ -130,17 +154,88 @@ typedef struct
    ReedSolomonTables *rt;
    Image *image;
    int earlyTermination;
-   unsigned char *data;
-   unsigned char *parity;
+   struct MD5Context md5Ctxt;  /* md5sum of CRC and parity portion of ecc file */
+   guint64 sectionSize;        /* the image is divided into ndata sections */
+
+   guint32 pageSize;           /* needed for memory mapping */
+   unsigned char **ioData;     /* shared buffers between IO and RS threads */
+   unsigned char **encoderData;/* point into the buffers below or into a mmap()ed area */
+   unsigned char **ioBuf;      /* aligned buffers of the respective data sets */
+   unsigned char **encoderBuf;
+   unsigned char **ioMmapBase; /* mmap() works on multiples of page sizes */
+   guint64 *ioMmapSize;        /* so the mmap area might differ from sector range */
+   unsigned char **encoderMmapBase;
+   guint64 *encoderMmapSize;
+   AlignedBuffer *dataAligned[512]; /* backing store of both data sets */
+   LargeIOVec *ioVec;          /* request vector of the IO thread */
+   unsigned char *paritybase;
+   unsigned char *parity;      /* parity as produced by the encoder */
+   unsigned char *out;         /* parity in ecc file layout */
+   guint64 chunkSize;          /* we can process this much section sectors at a time */
+   guint64 readSectors;        /* sectors per read in the fused pass */
+   guint32 *crc;               /* CRC sums calculated in the fused pass */
+   MD5Pipe *imageMD5;          /* md5sum of the image in the fused pass */
+   int unrecoverable;          /* missing sectors from a different medium */
+
+   /* The IO and encoder threads are working interleaved.
+      Each one keeps track of its state in a separate data set. */
+
+   guint64 ioChunk;            /* chunk we are currently working on */
+   guint64 ioLayerSectors;     /* last chunk maybe smaller than chunkSize */
+   guint64 encoderLayerSectors;
+   guint64 flushLayerSectors;
+   int ioLayer;                /* first section and number of sections in the chunk */
+   int ioLayers;
+   int encoderLayer;
+   int encoderLayers;
+   unsigned char *encoderParity;
+
+   GMutex *lock;               /* lock on this struct */
+   GCond *ioCond;              /* sync between encoder and IO threads */
+   guint64 sectorsToEncode;    /* total number of sector to encode */
+   guint64 buffersToEncode;    /* number of unprocessed sector columns */
+   guint64 nextBufferIndex;    /* next sector column which needs to be encoded */
+   int outFree;                /* flag for sharing ec->out between IO and encoder */
+   GThread *thread[MAX_CODEC_THREADS];
+   int nThreads;
+   int abortImmediately;
+   guint64 progress;
+   int lastPercent;
+
    char *msg;
    GTimer *timer;
+   int fusedScan;              /* checksums are calculated in the encoding pass */
 } ecc_closure;
 
+#ifdef HAVE_MMAP
+static void unmap_layer(unsigned char **base, guint64 *size, int layer)
+{
+   if(base[layer])
+   {  if(munmap(base[layer], size[layer]) == -1)
+	 Stop("munmap() failed: %s\n", strerror(errno));
+      base[layer] = NULL;
+   }
+}
+#endif
+
 static void ecc_cleanup(gpointer data)
 {  ecc_closure *ec = (ecc_closure*)data;
+   int i;
 
    UnregisterCleanup();
 
+   /* Wait for the encoder threads if we aborted prematurely */
+
+   if(ec->nThreads)
+   {  g_mutex_lock(ec->lock);
+      ec->abortImmediately = TRUE;
+      g_cond_broadcast(ec->ioCond);
+      g_mutex_unlock(ec->lock);
+
+      for(i=0; i<ec->nThreads; i++)
+	g_thread_join(ec->thread[i]);
+   }
+
    if(Closure->guiMode)
    {  if(ec->earlyTermination)
       {  GuiSetLabelText(ec->wl->encFootline,
@@ -152,10 +247,43 @@ static void ecc_cleanup(gpointer data)
    
    /** Clean up */
 
+#ifdef HAVE_MMAP
+   if(ec->rt && ec->ioMmapBase)
+   {  for(i=0; i<ec->rt->ndata; i++)
+      {  unmap_layer(ec->ioMmapBase, ec->ioMmapSize, i);
+	 unmap_layer(ec->encoderMmapBase, ec->encoderMmapSize, i);
+      }
+   }
+#endif
+
    if(ec->gt) FreeGaloisTables(ec->gt);
    if(ec->rt) FreeReedSolomonTables(ec->rt);
-   if(ec->data) g_free(ec->data);
-   if(ec->parity) g_free(ec->parity);
+   if(ec->paritybase) g_free(ec->paritybase);
+   if(ec->out) g_free(ec->out);
+   if(ec->crc) g_free(ec->crc);
+   if(ec->imageMD5) FreeMD5Pipe(ec->imageMD5);
+   if(ec->ioVec) g_free(ec->ioVec);
+   if(ec->lock)
+   {  g_mutex_clear(ec->lock);
+      g_free(ec->lock);
+   }
+   if(ec->ioCond)
+   {  g_cond_clear(ec->ioCond);
+      g_free(ec->ioCond);
+   }
+
+   for(i=0; i<512; i++)
+     if(ec->dataAligned[i])
+       FreeAlignedBuffer(ec->dataAligned[i]);
+
+   g_free(ec->ioData);
+   g_free(ec->encoderData);
+   g_free(ec->ioBuf);
+   g_free(ec->encoderBuf);
+   g_free(ec->ioMmapBase);
+   g_free(ec->encoderMmapBase);
+   g_free(ec->ioMmapSize);
+   g_free(ec->encoderMmapSize);
 
    if(ec->image) CloseImage(ec->image);
    if(ec->msg)   g_free(ec->msg);
@@ -175,10 +303,584 @@ static void ecc_cleanup(gpointer data)
 }
 
 /*
- * Create the parity file.
+ * Abort encoding upon user request
  */
 
-enum { NORMAL, HIGH, GENERIC };
+static void abort_encoding(ecc_closure *ec)
+{
+   if(Closure->stopActions == STOP_CURRENT_ACTION) /* suppress memleak warning when closing window */
+   {  GuiSetLabelText(ec->wl->encFootline,
+		      _("<span %s>Aborted by user request!</span> (partial error correction file removed)"),
+		      Closure->redMarkup);
+   }
+   ec->earlyTermination = FALSE;  /* suppress respective error message */
+   LargeClose(ec->image->eccFile);
+   ec->image->eccFile = NULL;
+   LargeUnlink(Closure->eccName); /* Do not leave partial .ecc file behind */
+
+   ecc_cleanup((gpointer)ec);
+}
+
+/*
+ * Calculate the Reed-Solomon error correction code
+ */
+
+/* The image is divided into ndata sections of ec->sectionSize sectors;
+   ecc block i is made from the i-th sector of each section.
+   The IO thread reads the next chunk of all sections while the encoder
+   threads work on the current one. Each encoder takes one sector column
+   (the same sector of all ndata sections) at a time and finally packs
+   its parity into nroots byte sequences as required by the ecc file format.
+   The parity of the previous chunk is written out by the IO thread
+   while the encoders are busy.
+
+   If the parity of the whole image fits into memory, the fused pass
+   is used instead: The sections are read one after another, which is
+   the order of the sectors in the image. So the IO thread can check
+   the sectors and calculate their CRC and md5 sums while the encoders
+   work the previously read sections into the parity. */
+
+static void flip_buffers(ecc_closure *ec)
+{  unsigned char **dtmp;
+   guint64 *stmp;
+
+   dtmp = ec->ioData;     ec->ioData     = ec->encoderData;     ec->encoderData     = dtmp;
+   dtmp = ec->ioBuf;      ec->ioBuf      = ec->encoderBuf;      ec->encoderBuf      = dtmp;
+   dtmp = ec->ioMmapBase; ec->ioMmapBase = ec->encoderMmapBase; ec->encoderMmapBase = dtmp;
+   stmp = ec->ioMmapSize; ec->ioMmapSize = ec->encoderMmapSize; ec->encoderMmapSize = stmp;
+}
+
+static void read_sections(ecc_closure *ec, int first_layer, int n_layers, guint64 chunk, guint64 n_sectors)
+{  Image *image = ec->image;
+   int n_vec = 0;
+   int layer,i;
+   guint64 si;
+
+   ec->ioLayer = first_layer;
+   ec->ioLayers = n_layers;
+   ec->ioChunk = chunk;
+   ec->ioLayerSectors = n_sectors;
+
+   /* Queue the sectors of all sections and read them in one go */
+
+   for(i=0; i<n_layers; i++)
+   {  gint64 first_sec;
+      gint64 n_plain;
+
+      layer = first_layer+i;
+      first_sec = layer*ec->sectionSize + chunk;
+
+      if(Closure->stopActions) /* User hit the Stop button */
+	abort_encoding(ec);
+
+      /* Sectors up to the last (possibly incomplete) image sector
+	 can be transferred directly. The remaining ones are
+	 completed or synthesized by RS01ReadSector(). */
+
+      n_plain = image->sectorSize - 1 - first_sec;
+      if(n_plain < 0) n_plain = 0;
+      if(n_plain > ec->ioLayerSectors) n_plain = ec->ioLayerSectors;
+
+#ifdef HAVE_MMAP
+      if(Closure->encodingIOStrategy == IO_STRATEGY_MMAP)
+      {  unmap_layer(ec->ioMmapBase, ec->ioMmapSize, i);
+
+	 if(n_plain == ec->ioLayerSectors)
+	 {  guint64 page_offset = 2048*first_sec;
+	    int shift = page_offset % ec->pageSize;
+
+	    page_offset -= shift;
+	    ec->ioMmapSize[i] = 2048*ec->ioLayerSectors + shift;
+	    ec->ioMmapBase[i] = mmap(NULL, ec->ioMmapSize[i],
+					 PROT_READ, MMAP_FLAGS,
+					 image->file->fileHandle,
+					 page_offset);
+	    if(ec->ioMmapBase[i] == MAP_FAILED)
+	    {  ec->ioMmapBase[i] = NULL;
+	       Stop(_("Failed mmap()ing layer %d: %s\n"), layer, strerror(errno));
+	    }
+	    ec->ioData[i] = ec->ioMmapBase[i]+shift;
+	    continue;
+	 }
+      }
+#endif /* HAVE_MMAP */
+
+      ec->ioData[i] = ec->ioBuf[i];
+      if(n_plain)
+      {  ec->ioVec[n_vec].offset = 2048*first_sec;
+	 ec->ioVec[n_vec].buf    = ec->ioData[i];
+	 ec->ioVec[n_vec].count  = 2048*n_plain;
+	 n_vec++;
+      }
+
+      for(si=n_plain; si<ec->ioLayerSectors; si++)
+	RS01ReadSector(image, ec->ioData[i]+2048*si, first_sec+si);
+   }
+
+   if(!LargeReadV(image->file, ec->ioVec, n_vec))
+   {  for(i=0; i<n_vec; i++)
+	if(ec->ioVec[i].result != (ssize_t)ec->ioVec[i].count)
+	  Stop(_("Failed reading sector %" PRId64 " in image: %s"),
+	       (gint64)ec->ioVec[i].offset/2048, strerror(errno));
+   }
+}
+
+/* The last chunk may contain fewer sectors. */
+
+static void read_next_chunk(ecc_closure *ec, guint64 chunk)
+{
+   if(chunk+ec->chunkSize < ec->sectionSize)
+        read_sections(ec, 0, ec->rt->ndata, chunk, ec->chunkSize);
+   else read_sections(ec, 0, ec->rt->ndata, chunk, ec->sectionSize-chunk);
+}
+
+/* Check an image sector for completeness and add it to the checksums */
+
+static void scan_sector(ecc_closure *ec, unsigned char *buf, gint64 sector)
+{  Image *image = ec->image;
+   int err;
+
+   err = CheckForMissingSector(buf, sector, image->fpState == FP_PRESENT ? image->imageFP : NULL,
+			       FINGERPRINT_SECTOR);
+   if(err != SECTOR_PRESENT)
+   {  ExplainMissingSector(buf, sector, err, SOURCE_IMAGE, &ec->unrecoverable);
+      image->sectorsMissing++;
+   }
+
+   ec->crc[sector] = Crc32(buf, 2048);
+   MD5PipeUpdate(ec->imageMD5, buf, sector < image->sectorSize-1 ? 2048 : image->inLast);
+}
+
+/* In the fused pass, a chunk consists of as many complete sections
+   as fit into the read buffer, or of a part of a single section.
+   Subsequent sections are adjacent in the image, so the sectors
+   are still read and summed up in image order. */
+
+static void read_fused_chunk(ecc_closure *ec, int layer, guint64 chunk)
+{  Image *image = ec->image;
+   guint64 n_sectors = ec->sectionSize-chunk;
+   int n_layers = 1;
+   int i;
+   guint64 si;
+
+   if(!chunk && ec->sectionSize <= ec->readSectors)
+   {  n_layers = ec->readSectors / ec->sectionSize;
+      if(n_layers > ec->rt->ndata-layer)
+	n_layers = ec->rt->ndata-layer;
+   }
+   if(n_sectors > ec->readSectors)
+     n_sectors = ec->readSectors;
+
+   read_sections(ec, layer, n_layers, chunk, n_sectors);
+
+   for(i=0; i<n_layers; i++)
+   {  gint64 first_sec = (layer+i)*ec->sectionSize + chunk;
+
+      for(si=0; si<n_sectors && first_sec+si<image->sectorSize; si++)
+	scan_sector(ec, ec->ioData[i]+2048*si, first_sec+si);
+   }
+}
+
+/* Pack the parity of a sector column into nroots byte sequences
+   as required by the ecc file format */
+
+static void pack_parity(ecc_closure *ec, unsigned char *parity, guint64 si)
+{  int nroots = ec->rt->nroots;
+   int nroots_aligned = (nroots+15)&~15;
+   unsigned char *out = ec->out + 2048*nroots*si;
+   int j;
+
+   for(j=0; j<2048; j++)
+   {  memcpy(out, parity, nroots);
+      out    += nroots;
+      parity += nroots_aligned;
+   }
+}
+
+/* Write the nroots bytes of parity information of the previous chunk */
+
+static void flush_parity(ecc_closure *ec)
+{  guint64 size = 2048*(guint64)ec->rt->nroots*ec->flushLayerSectors;
+   guint64 n;
+
+   n = LargeWrite(ec->image->eccFile, ec->out, size);
+
+   if(n != size)
+     Stop(_("could not write to ecc file \"%s\":\n%s"),Closure->eccName,strerror(errno));
+
+   MD5Update(&ec->md5Ctxt, ec->out, size);
+}
+
+/* Hand the chunk which has just been read over to the encoders */
+
+static void dispatch_chunk(ecc_closure *ec)
+{  int nroots_aligned = (ec->rt->nroots+15)&~15;
+
+   flip_buffers(ec);
+
+   g_mutex_lock(ec->lock);
+   ec->buffersToEncode     = ec->ioLayerSectors;
+   ec->encoderLayerSectors = ec->ioLayerSectors;
+   ec->nextBufferIndex     = 0;
+   ec->encoderLayer        = ec->ioLayer;
+   ec->encoderLayers       = ec->ioLayers;
+   if(ec->fusedScan)
+        ec->encoderParity  = ec->parity + 2048*nroots_aligned*ec->ioChunk;
+   else ec->encoderParity  = ec->parity;
+   ec->outFree             = FALSE;
+   g_cond_broadcast(ec->ioCond);
+   g_mutex_unlock(ec->lock);
+}
+
+static void wait_for_encoders(ecc_closure *ec)
+{
+   g_mutex_lock(ec->lock);
+   while(ec->buffersToEncode)
+     g_cond_wait(ec->ioCond, ec->lock);
+   g_mutex_unlock(ec->lock);
+
+   ec->flushLayerSectors = ec->encoderLayerSectors;
+}
+
+static void release_output(ecc_closure *ec)
+{
+   g_mutex_lock(ec->lock);
+   ec->outFree = TRUE;  /* we have saved the parity; go ahead */
+   g_cond_broadcast(ec->ioCond);
+   g_mutex_unlock(ec->lock);
+}
+
+static void io_thread(ecc_closure *ec)
+{  guint64 chunk;
+
+   /* Preload the first chunk */
+
+   read_next_chunk(ec, 0);
+
+   /* Process the image.
+      From each section a chunk of ec->chunkSize sectors is read in at once.
+      So after (ec->sectionSize/ec->chunkSize)+1 iterations
+      the whole image has been processed. */
+
+   for(chunk=ec->ioLayerSectors; chunk<ec->sectionSize; chunk+=ec->ioLayerSectors)
+   {
+      dispatch_chunk(ec);
+
+      /* Write out parity from last run */
+
+      if(ec->flushLayerSectors)
+	flush_parity(ec);
+      release_output(ec);
+
+      /* Read the next chunk while encoders are working */
+
+      read_next_chunk(ec, chunk);
+      wait_for_encoders(ec);
+   }
+
+   /* Encode the last chunk */
+
+   dispatch_chunk(ec);
+   if(ec->flushLayerSectors)
+     flush_parity(ec);
+   release_output(ec);
+
+   wait_for_encoders(ec);
+   flush_parity(ec);
+}
+
+static void fused_io_thread(ecc_closure *ec)
+{  int layer = 0;
+   guint64 chunk = 0;
+
+   /* Preload the first chunk */
+
+   read_fused_chunk(ec, 0, 0);
+
+   /* Process the sections in image order. A chunk must not be encoded
+      before the same sectors of the previous section have been worked
+      into the parity, so the encoders are waited for after each chunk. */
+
+   for(;;)
+   {  chunk += ec->ioLayerSectors;
+      if(chunk >= ec->sectionSize)
+      {  chunk = 0;
+	 layer += ec->ioLayers;
+      }
+
+      dispatch_chunk(ec);
+      if(layer >= ec->rt->ndata)
+	break;
+
+      read_fused_chunk(ec, layer, chunk);
+      wait_for_encoders(ec);
+   }
+
+   wait_for_encoders(ec);
+}
+
+/* Write out the parity which has been kept in memory by the fused pass */
+
+static void write_parity(ecc_closure *ec)
+{  int nroots_aligned = (ec->rt->nroots+15)&~15;
+   guint64 chunk;
+
+   for(chunk=0; chunk<ec->sectionSize; chunk+=ec->flushLayerSectors)
+   {  guint64 si;
+
+      if(chunk+ec->chunkSize < ec->sectionSize)
+           ec->flushLayerSectors = ec->chunkSize;
+      else ec->flushLayerSectors = ec->sectionSize-chunk;
+
+      for(si=0; si<ec->flushLayerSectors; si++)
+	pack_parity(ec, ec->parity + 2048*nroots_aligned*(chunk+si), si);
+
+      flush_parity(ec);
+   }
+}
+
+/* Write out the CRC sums calculated in the fused pass */
+
+static void write_crc(ecc_closure *ec)
+{  Image *image = ec->image;
+   size_t size = image->sectorSize*sizeof(guint32);
+
+   MD5Init(&ec->md5Ctxt);    /*  md5sum of CRC portion of ecc file */
+
+   if(!LargeSeek(image->eccFile, (gint64)sizeof(EccHeader)))
+     Stop(_("Failed skipping the ecc header: %s"),strerror(errno));
+
+   if(LargeWrite(image->eccFile, ec->crc, size) != size)
+     Stop(_("Error writing CRC information: %s"),strerror(errno));
+
+   MD5Update(&ec->md5Ctxt, (unsigned char*)ec->crc, size);
+}
+
+static gpointer encoder_thread(ecc_closure *ec)
+{  ReedSolomonTables *rt = ec->rt;
+   int nroots = rt->nroots;
+   int ndata  = rt->ndata;
+   int nroots_aligned = (nroots+15)&~15;
+   int percent;
+   int i;
+
+   for(;;)
+   {  unsigned char *parity;
+      int layer_offset;
+      int layer;
+
+      g_mutex_lock(ec->lock);
+      while(   ec->sectorsToEncode
+	    && !ec->abortImmediately
+	    && ec->nextBufferIndex >= ec->encoderLayerSectors)
+ 	 g_cond_wait(ec->ioCond, ec->lock);
+
+      /* Termination criterion */
+
+      if(!ec->sectorsToEncode || ec->abortImmediately)
+      {  g_mutex_unlock(ec->lock);
+	 return NULL;
+      }
+      layer_offset = ec->nextBufferIndex++;
+      g_mutex_unlock(ec->lock);
+
+      /* Work the sections of the chunk into the parity data
+	 of the current sector column. */
+
+      parity = ec->encoderParity + 2048*nroots_aligned*layer_offset;
+      if(!ec->encoderLayer)
+	memset(parity, 0, 2048*nroots_aligned);
+
+      for(i=0; i<ec->encoderLayers; i++)
+      {  layer = ec->encoderLayer+i;
+	 EncodeNextLayer(rt, ec->encoderData[i] + 2048*layer_offset,
+			 parity, 2048, (rt->shiftInit+layer) % nroots);
+      }
+
+      /* Pack the parity bytes into the output buffer
+	 as soon as the IO thread has written out the previous ones.
+	 In the fused pass, this is done after all sections have been read. */
+
+      if(!ec->fusedScan)
+      {  g_mutex_lock(ec->lock);
+	 while(!ec->outFree && !ec->abortImmediately)
+	   g_cond_wait(ec->ioCond, ec->lock);
+	 g_mutex_unlock(ec->lock);
+
+	 if(ec->abortImmediately)
+	   return NULL;
+
+	 pack_parity(ec, parity, layer_offset);
+      }
+
+      /* Report progress and finish processing of this column */
+
+      g_mutex_lock(ec->lock);
+      ec->progress += ec->encoderLayers;
+      percent = (1000*ec->progress)/(ndata*ec->sectionSize);
+      if(ec->lastPercent != percent)
+      {  ec->lastPercent = percent;
+	 GuiSetProgress(ec->wl->encPBar2, percent, 1000);
+	 PrintProgress(_("Ecc generation: %3d.%1d%%"), percent/10, percent%10);
+      }
+
+      ec->sectorsToEncode -= ec->encoderLayers;
+      if(!--ec->buffersToEncode)
+	g_cond_broadcast(ec->ioCond);
+      g_mutex_unlock(ec->lock);
+   }
+}
+
+static void create_reed_solomon(ecc_closure *ec)
+{  Image *image = ec->image;
+   int nroots = ec->rt->nroots;
+   int ndata  = ec->rt->ndata;
+   int nroots_aligned = (nroots+15)&~15; /* 128bit alignment */
+   guint64 n_parity_bytes;
+   int out_of_memory = 0;
+   int i;
+
+   /*** Allocate buffers for the parity calculation and image data caching.
+
+        The algorithm builds the parity file consecutively in chunks of ec->chunkSize
+	ecc blocks. Each chunk is built iteratively by processing the data in layers
+	(first all bytes at pos 0, then pos 1, until ndata layers have been processed).
+	All ndata sections of a chunk are buffered twice (one set is read in while
+	the other one is encoded), plus the parity in encoder and file layout.
+        We use all the amount of memory allowed by cacheMiB for these buffers.
+
+	In the fused pass the parity of the whole image is kept in memory,
+	and the remaining cache is used for the two sets of read buffers.
+	If the parity alone exceeds the cache, it has been allocated from
+	the available memory and the read buffers get the whole cache. */
+
+   ec->chunkSize = ((guint64)Closure->cacheMiB<<20) / (2048*(guint64)(2*ndata+nroots_aligned+nroots));
+   if(ec->chunkSize < 1)
+     ec->chunkSize = 1;
+   if(ec->chunkSize > ec->sectionSize)
+     ec->chunkSize = ec->sectionSize;
+
+   if(ec->fusedScan)
+   {  n_parity_bytes = 2048*(guint64)nroots_aligned*ec->sectionSize;
+      if(n_parity_bytes < (guint64)Closure->cacheMiB<<20)
+	   ec->readSectors = (((guint64)Closure->cacheMiB<<20) - n_parity_bytes) / (2*2048);
+      else ec->readSectors = ((guint64)Closure->cacheMiB<<20) / (2*2048);
+      if(ec->readSectors < 64)
+	ec->readSectors = 64;
+      if(ec->readSectors > ndata*ec->sectionSize)
+	ec->readSectors = ndata*ec->sectionSize;
+
+      ec->crc = g_try_malloc(image->sectorSize*sizeof(guint32));
+      if(!ec->crc)
+	out_of_memory = 1;
+   }
+   else n_parity_bytes = 2048*(guint64)nroots_aligned*ec->chunkSize;
+
+   ec->paritybase = g_try_malloc(n_parity_bytes+16);
+   if(ec->paritybase)
+     ec->parity = ec->paritybase + (16 - ((intptr_t)ec->paritybase & 15));
+   ec->out = g_try_malloc(2048*(guint64)nroots*ec->chunkSize);
+
+   /* Data buffers are aligned so that they can be used with O_DIRECT */
+
+   ec->ioData          = g_malloc0(256*sizeof(unsigned char*));
+   ec->encoderData     = g_malloc0(256*sizeof(unsigned char*));
+   ec->ioBuf           = g_malloc0(256*sizeof(unsigned char*));
+   ec->encoderBuf      = g_malloc0(256*sizeof(unsigned char*));
+   ec->ioMmapBase      = g_malloc0(256*sizeof(unsigned char*));
+   ec->encoderMmapBase = g_malloc0(256*sizeof(unsigned char*));
+   ec->ioMmapSize      = g_malloc0(256*sizeof(guint64));
+   ec->encoderMmapSize = g_malloc0(256*sizeof(guint64));
+   ec->ioVec           = g_malloc(256*sizeof(LargeIOVec));
+
+   for(i=0; i<(ec->fusedScan ? 1 : ndata) && !out_of_memory; i++)
+   {  guint64 size = 2048*(ec->fusedScan ? ec->readSectors : ec->chunkSize);
+
+      ec->dataAligned[i]     = TryCreateAlignedBuffer(size);
+      ec->dataAligned[i+256] = TryCreateAlignedBuffer(size);
+      if(!ec->dataAligned[i] || !ec->dataAligned[i+256])
+      {  out_of_memory = 1;
+	 break;
+      }
+      ec->ioBuf[i]      = ec->dataAligned[i]->buf;
+      ec->encoderBuf[i] = ec->dataAligned[i+256]->buf;
+   }
+
+   /* The read buffers of the fused pass may hold several complete sections */
+
+   if(ec->fusedScan && !out_of_memory)
+   {  for(i=1; i<ndata && (i+1)*ec->sectionSize <= ec->readSectors; i++)
+      {  ec->ioBuf[i]      = ec->ioBuf[0]      + 2048*i*ec->sectionSize;
+	 ec->encoderBuf[i] = ec->encoderBuf[0] + 2048*i*ec->sectionSize;
+      }
+   }
+
+   if(out_of_memory || !ec->paritybase || !ec->out)
+      Stop(_("Failed allocating memory for I/O cache.\n"
+	     "Cache size is currently %d MiB.\n"
+	     "Try reducing it.\n"),
+	   Closure->cacheMiB);
+
+#ifdef SYS_MINGW
+   {
+      SYSTEM_INFO si;
+      GetSystemInfo(&si);
+      ec->pageSize = si.dwPageSize;
+   }
+#else
+   ec->pageSize = sysconf(_SC_PAGE_SIZE);
+#endif
+
+   if(Closure->encodingIOStrategy == IO_STRATEGY_DIRECT)
+     LargeEnableDirectIO(image->file);
+
+   /*** Spawn the RS encoder threads */
+
+   ec->lock   = g_malloc(sizeof(GMutex)); g_mutex_init(ec->lock);
+   ec->ioCond = g_malloc(sizeof(GCond));  g_cond_init(ec->ioCond);
+   ec->sectorsToEncode = ndata*ec->sectionSize;
+   ec->lastPercent = -1;
+
+   g_timer_start(ec->timer);
+
+   g_mutex_lock(ec->lock);  /* ec->thread[i] = ... may produce race condition */
+   for(i=0; i<Closure->codecThreads; i++)
+   {  GError *err = NULL;
+
+      ec->thread[i] = g_thread_try_new("encoder", (GThreadFunc)encoder_thread, (gpointer)ec, &err);
+      if(!ec->thread[i])
+      {  g_mutex_unlock(ec->lock);
+         Stop("Could not create encoder thread: %s", err->message);
+      }
+      ec->nThreads++;
+   }
+   g_mutex_unlock(ec->lock);
+
+   /*** Now we actually become being the IO thread */
+
+   if(ec->fusedScan)
+   {  image->sectorsMissing = 0;
+      ec->imageMD5 = CreateMD5Pipe();
+      fused_io_thread(ec);
+   }
+   else io_thread(ec);
+
+   /*** Wait for workers to finish */
+
+   for(i=0; i<ec->nThreads; i++)
+     g_thread_join(ec->thread[i]);
+   ec->nThreads = 0;
+
+   if(ec->imageMD5)
+   {  MD5PipeFinal(image->mediumSum, ec->imageMD5);
+      FreeMD5Pipe(ec->imageMD5);
+      ec->imageMD5 = NULL;
+   }
+}
+
+/*
+ * Create the parity file.
+ */
 
 void RS01Create(void)
 {  Method *self = FindMethod("RS01");
@@ -186,23 +888,12 @@ void RS01Create(void)
    GaloisTables *gt;
    ReedSolomonTables *rt;
    ecc_closure *ec = g_malloc0(sizeof(ecc_closure));
-   struct MD5Context md5Ctxt;
    EccHeader *eh;
    Image *image;
-   guint64 block_idx[256];  /* must be >= ndata */
-   guint64 s,si,n;
+   guint64 n,parity_bytes;
    int i;
-   int percent = 0,max_percent,progress = 0, last_percent = -1;
-   guint64 n_parity_blocks,n_layer_sectors;
-   guint64 n_parity_bytes,n_layer_bytes;
-   guint64 chunk;
-   int layer;
-   int loop_type = GENERIC;
-   gint32 nroots;         /* These are copied to increase performance. */
+   gint32 nroots,nroots_aligned;
    gint32 ndata;
-   gint32 *gf_index_of;
-   gint32 *enc_alpha_to;
-   gint32 *rs_gpoly;
 
    /*** Register the cleanup procedure for GUI mode */
 
@@ -216,19 +907,13 @@ void RS01Create(void)
    /* Calculate number of roots (= max. number of erasures)
       and number of data bytes from redundancy setting */
 
-   if(!Closure->redundancy || !strcmp(Closure->redundancy, "normal")) 
-	                                          loop_type = NORMAL;
-   else if(!strcmp(Closure->redundancy, "high"))  loop_type = HIGH;
-
    i  = calculate_redundancy(Closure->imageName);
    gt = ec->gt = CreateGaloisTables(RS_GENERATOR_POLY);
    rt = ec->rt = CreateReedSolomonTables(gt, RS_FIRST_ROOT, RS_PRIM_ELEM, i);
 
    nroots       = rt->nroots;
    ndata        = rt->ndata;
-   rs_gpoly     = rt->gpoly;
-   enc_alpha_to = gt->encAlphaTo;
-   gf_index_of  = gt->indexOf;
+   nroots_aligned = (nroots+15)&~15;
 
    /*** Announce what we are going to do */
 
@@ -280,8 +965,54 @@ void RS01Create(void)
 
    ec->timer   = g_timer_new();
 
+   /*** Prepare Ecc file header.
+        The .mediumSum will be filled in after the image has been scanned,
+	and the .eccSum after all ecc blocks have been created. */
+
+   image->eccFileHeader = eh = g_malloc0(sizeof(EccHeader));
+   memcpy(eh->cookie, "*dvdisaster*", 12);
+   memcpy(eh->method, "RS01", 4);
+   eh->methodFlags[0] = 1;
+   if(!Closure->regtestMode)
+     eh->methodFlags[3] = Closure->releaseFlags;
+   gint64_to_uchar(eh->sectors, image->sectorSize);
+   eh->dataBytes       = ndata;
+   eh->eccBytes        = nroots;
+
+   eh->creatorVersion  = Closure->version;
+   eh->fpSector        = FINGERPRINT_SECTOR;
+   eh->inLast          = image->inLast;
+
+   /* dvdisaster 0.66 brings some extensions which are not compatible with
+      prior versions. These are:
+      - If the methodFlags contains any other bits set than methodFlags[0] == 1,
+        prior versions will incorrectly reject ecc files as being produced by
+	version 0.40.7 due to a bug in the version processing code.
+	So ecc files tagged with -devel or -rc status will not work with prior
+	versions. But they are experimental versions available only through CVS, 
+	so this issue is not as big as it appears.
+      - Version 0.66 records the inLast value in the ecc file to facilitate
+        processing non-image files. Previous versions do not use this field
+	and may round up file length to the next multiple of 2048 when doing
+	error correction.
+   */
+
+   if(image->inLast != 2048)
+        eh->neededVersion = 6600;
+   else eh->neededVersion = 5500;
+
+   memcpy(eh->mediumFP, image->imageFP, 16);
+
+   /*** The image is divided into ndata sections;
+        with each section spanning ec->sectionSize sectors. */
+
+   ec->sectionSize = (image->sectorSize+ndata-1)/ndata;
+
    /* Try to use CRC values created during last read */
 
+   if(!Closure->crcBuf && Closure->crcCacheFile)
+      Closure->crcBuf = LoadCrcBuf(image, Closure->crcCacheFile);
+
    if(CrcBufValid(Closure->crcBuf, image, FULL_IMAGE))   
    {  guint32 crc_idx;
       int percent, last_percent = 0;
@@ -291,7 +1022,7 @@ void RS01Create(void)
 		      _("<b>1. Writing image sector checksums:</b>"));
 
       memcpy(image->mediumSum, Closure->crcBuf->imageMD5sum, 16);
-      MD5Init(&md5Ctxt);    /*  md5sum of CRC portion of ecc file */
+      MD5Init(&ec->md5Ctxt);    /*  md5sum of CRC portion of ecc file */
 
       /* Write out the cached CRC sectors */
 
@@ -310,7 +1041,7 @@ void RS01Create(void)
 	 crcbuf = &Closure->crcBuf->crcbuf[crc_idx];
 
 	 n = LargeWrite(image->eccFile, crcbuf, size);
-	 MD5Update(&md5Ctxt, (unsigned char*)crcbuf, size);
+	 MD5Update(&ec->md5Ctxt, (unsigned char*)crcbuf, size);
 
 	 if(size != n)
 	   Stop(_("Error writing CRC information: %s"), strerror(errno));
@@ -336,8 +1067,26 @@ void RS01Create(void)
 
       FreeCrcBuf(Closure->crcBuf);  /* just a defensive measure */
       Closure->crcBuf = NULL;
-     
-      RS01ScanImage(self, image, &md5Ctxt, CREATE_CRC);
+
+      /* If the parity of the whole image fits into memory,
+	 the checksums are calculated from the same buffers
+	 which are fed into the encoder. The image is then
+	 read only once. The parity may use up to half of
+	 the available memory in addition to the cache. */
+
+      parity_bytes = 2048*(guint64)nroots_aligned*ec->sectionSize;
+      if(   parity_bytes <= (guint64)Closure->cacheMiB<<20
+	 || (parity_bytes <= ProbeAvailableMemory()/2 && parity_bytes <= (guint64)SIZE_MAX/4))
+      {  Verbose("Single pass over the image; keeping %" PRIu64 " MiB of parity in memory.\n",
+		 parity_bytes>>20);
+	 ec->fusedScan = TRUE;
+	 create_reed_solomon(ec);
+      }
+      else
+      {  Verbose("Two passes over the image; %" PRIu64 " MiB of parity do not fit into memory.\n",
+		 parity_bytes>>20);
+	 RS01ScanImage(self, image, &ec->md5Ctxt, CREATE_CRC);
+      }
 
       if(image->sectorsMissing)
       {  LargeClose(image->eccFile); /* Will be deleted anyways; no need to test for errors */
@@ -361,6 +1110,9 @@ void RS01Create(void)
 	    Stop(_("%" PRId64 " sectors unread or missing due to errors.\n"), image->sectorsMissing);
 	 }
       }
+
+      if(ec->fusedScan)
+	write_crc(ec);
    }
 
    PrintTimeToLog(ec->timer, "for CRC writing/generation.\n");
@@ -372,639 +1124,21 @@ void RS01Create(void)
    if(!Closure->guiMode)
      PrintLog("%s\n",ec->msg);
 
-   /*** Prepare Ecc file header.
-        The .eccSum will be filled in after all ecc blocks have been created. */
-
-   image->eccFileHeader = eh = g_malloc0(sizeof(EccHeader));
-   memcpy(eh->cookie, "*dvdisaster*", 12);
-   memcpy(eh->method, "RS01", 4);
-   eh->methodFlags[0] = 1;
-   if(!Closure->regtestMode)
-     eh->methodFlags[3] = Closure->releaseFlags;
-   gint64_to_uchar(eh->sectors, image->sectorSize);
-   eh->dataBytes       = ndata;
-   eh->eccBytes        = nroots;
-
-   eh->creatorVersion  = Closure->version;
-   eh->fpSector        = FINGERPRINT_SECTOR;
-   eh->inLast          = image->inLast;
-
-   /* dvdisaster 0.66 brings some extensions which are not compatible with
-      prior versions. These are:
-      - If the methodFlags contains any other bits set than methodFlags[0] == 1,
-        prior versions will incorrectly reject ecc files as being produced by
-	version 0.40.7 due to a bug in the version processing code.
-	So ecc files tagged with -devel or -rc status will not work with prior
-	versions. But they are experimental versions available only through CVS, 
-	so this issue is not as big as it appears.
-      - Version 0.66 records the inLast value in the ecc file to facilitate
-        processing non-image files. Previous versions do not use this field
-	and may round up file length to the next multiple of 2048 when doing
-	error correction.
-   */
-
-   if(image->inLast != 2048)
-        eh->neededVersion = 6600;
-   else eh->neededVersion = 5500;
-
-   memcpy(eh->mediumFP, image->imageFP, 16);
    memcpy(eh->mediumSum, image->mediumSum, 16);
 
    if(!LargeSeek(image->eccFile, (gint64)sizeof(EccHeader) + image->sectorSize*sizeof(guint32)))
 	Stop(_("Failed skipping ecc+crc header: %s"),strerror(errno));
 
-   /*** Allocate buffers for the parity calculation and image data caching. 
-
-        The algorithm builds the parity file consecutively in chunks of n_parity_blocks.
-        We use all the amount of memory allowed by cacheMiB for caching the parity blocks. */
-
-   n_parity_blocks = ((guint64)Closure->cacheMiB<<20) / (guint64)nroots;
-   n_parity_blocks &= ~0x7ff;                   /* round down to multiple of 2048 */
-   n_parity_bytes  = (guint64)nroots * n_parity_blocks;
-
-   /* Each chunk of parity blocks is built iteratively by processing the data in layers
-      (first all bytes at pos 0, then pos 1, until ndata layers have been processed).
-      So one buffer of n_layer_bytes = n_parity_blocks needs to be buffered.
-      For practical reasons we require that the layer size is a multiple of the
-      medium sector size of 2048 bytes. */
-
-   n_layer_bytes   = n_parity_blocks;
-   n_layer_sectors = n_parity_blocks/2048;
-
-   if(n_layer_sectors*2048 != n_parity_blocks)
-     Stop("Internal error: parity blocks are not a multiple of sector size.\n");
-
-   ec->parity = g_try_malloc(n_parity_bytes);
-   ec->data   = g_try_malloc(n_layer_bytes);
-
-   if(!ec->parity || !ec->data)
-      Stop(_("Failed allocating memory for I/O cache.\n"
-	     "Cache size is currently %d MiB.\n"
-	     "Try reducing it.\n"),
-	   Closure->cacheMiB);
-
-   /*** Setup the block counters for mapping medium sectors to ecc blocks 
-        The image is divided into ndata sections;
-        with each section spanning s sectors. */
-
-   s = (image->sectorSize+ndata-1)/ndata;
-
-   for(si=0, i=0; i<ndata; si+=s, i++)
-     block_idx[i] = si;
-
-   /*** Create ecc information for the medium image. */ 
-
-   max_percent = ndata * ((s / n_layer_sectors) + 1);
-   g_timer_start(ec->timer);
-
-   /* Process the image.
-      From each section a chunk of n_layer_sectors is read in at once.
-      So after (s/n_layer_sectors)+1 iterations the whole image has been processed. */
-
-   for(chunk=0; chunk<s; chunk+=n_layer_sectors) 
-   {  guint64 actual_layer_bytes,actual_layer_sectors;
-
-      /* Prepare the parity data for the next chunk. */
-
-      memset(ec->parity, 0, n_parity_bytes);
-
-      /* The last chunk may contain fewer sectors. */
-
-      if(chunk+n_layer_sectors < s)
-           actual_layer_sectors = n_layer_sectors;
-      else actual_layer_sectors = s-chunk;
-
-      actual_layer_bytes   = 2048*actual_layer_sectors;
-
-      /* Work each of the ndata data layers 
-	 into the parity data of the current chunk. */
-
-      switch(loop_type)
-      { case NORMAL:  /* Inner loop unrolled for nroots = 32. */
-	{int sp=1;    /* sp==1 makes sure sp==0 after ndata bytes [since (223+1) mod 32 = 0]*/
-  
-         for(layer=0; layer<ndata; layer++)
-	 {  int offset = 0;
-            unsigned char *par_idx = ec->parity;
-
-	    if(Closure->stopActions) /* User hit the Stop button */
-	    {  if(Closure->stopActions == STOP_CURRENT_ACTION) /* suppress memleak warning when closing window */
-	       {  GuiSetLabelText(wl->encFootline, 
-				  _("<span %s>Aborted by user request!</span> (partial error correction file removed)"),
-				  Closure->redMarkup);
-	       }
-	       ec->earlyTermination = FALSE;  /* suppress respective error message */
-	       LargeClose(image->eccFile);
-	       image->eccFile = NULL;
-	       LargeUnlink(Closure->eccName); /* Do not leave partial .ecc file behind */
-	       goto terminate;
-	    }
+   /*** Create ecc information for the medium image.
+	In the fused pass it has already been calculated. */
 
-	    /* Read the next data sectors of this layer. */
-
-	    for(si=0; si<actual_layer_sectors; si++)
-	    {  RS01ReadSector(image, ec->data+offset, block_idx[layer]);
-	       block_idx[layer]++;
-	       offset += 2048;
-	    }
-
-	    /* Now process the data bytes of the current layer. */
-
-	    for(si=0; si<actual_layer_bytes; si++)
-	    {  register int feedback;
-
-	       feedback = gf_index_of[ec->data[si] ^ par_idx[sp]];
-
-	       if(feedback != GF_ALPHA0) /* non-zero feedback term */
-	       {  register int spk = sp;
-
-                  par_idx[((++spk)&31)] ^= enc_alpha_to[feedback + 249];
-                  par_idx[((++spk)&31)] ^= enc_alpha_to[feedback +  59];
-                  par_idx[((++spk)&31)] ^= enc_alpha_to[feedback +  66];
-                  par_idx[((++spk)&31)] ^= enc_alpha_to[feedback +   4];
-                  par_idx[((++spk)&31)] ^= enc_alpha_to[feedback +  43];
-                  par_idx[((++spk)&31)] ^= enc_alpha_to[feedback + 126];
-                  par_idx[((++spk)&31)] ^= enc_alpha_to[feedback + 251];
-                  par_idx[((++spk)&31)] ^= enc_alpha_to[feedback +  97];
-                  par_idx[((++spk)&31)] ^= enc_alpha_to[feedback +  30];
-                  par_idx[((++spk)&31)] ^= enc_alpha_to[feedback +   3];
-                  par_idx[((++spk)&31)] ^= enc_alpha_to[feedback + 213];
-                  par_idx[((++spk)&31)] ^= enc_alpha_to[feedback +  50];
-                  par_idx[((++spk)&31)] ^= enc_alpha_to[feedback +  66];
-                  par_idx[((++spk)&31)] ^= enc_alpha_to[feedback + 170];
-                  par_idx[((++spk)&31)] ^= enc_alpha_to[feedback +   5];
-                  par_idx[((++spk)&31)] ^= enc_alpha_to[feedback +  24];
-                  par_idx[((++spk)&31)] ^= enc_alpha_to[feedback +   5];
-                  par_idx[((++spk)&31)] ^= enc_alpha_to[feedback + 170];
-                  par_idx[((++spk)&31)] ^= enc_alpha_to[feedback +  66];
-                  par_idx[((++spk)&31)] ^= enc_alpha_to[feedback +  50];
-                  par_idx[((++spk)&31)] ^= enc_alpha_to[feedback + 213];
-                  par_idx[((++spk)&31)] ^= enc_alpha_to[feedback +   3];
-                  par_idx[((++spk)&31)] ^= enc_alpha_to[feedback +  30];
-                  par_idx[((++spk)&31)] ^= enc_alpha_to[feedback +  97];
-                  par_idx[((++spk)&31)] ^= enc_alpha_to[feedback + 251];
-                  par_idx[((++spk)&31)] ^= enc_alpha_to[feedback + 126];
-                  par_idx[((++spk)&31)] ^= enc_alpha_to[feedback +  43];
-                  par_idx[((++spk)&31)] ^= enc_alpha_to[feedback +   4];
-                  par_idx[((++spk)&31)] ^= enc_alpha_to[feedback +  66];
-                  par_idx[((++spk)&31)] ^= enc_alpha_to[feedback +  59];
-                  par_idx[((++spk)&31)] ^= enc_alpha_to[feedback + 249];
-
-		  par_idx[sp] = enc_alpha_to[feedback];  /* feedback + 0 */
-	       }
-	       else                   /* zero feedback term */
-		 par_idx[sp] = 0;
-
-	       par_idx += nroots;
-	    }
-
-	    sp = (sp+1) & 31;         /* shift */
-
-	    /* Report progress */
-
-	    progress++;
-	    percent = (1000*progress)/max_percent;
-	    if(last_percent != percent) 
-	    {  GuiSetProgress(wl->encPBar2, percent, 1000);
-	       PrintProgress(_("Ecc generation: %3d.%1d%%"), percent/10, percent%10);
-	       last_percent = percent;
-	    }
-	 }
-	}
-	break;
-
-        case HIGH: /* Inner loop is unrolled for nroots = 64. */
-	{int sp=1; /* sp==1 makes sure sp==0 after ndata bytes [since (191+1) mod 64 = 0] */
-         for(layer=0; layer<ndata; layer++)
-	 {  int offset = 0;
-	    unsigned char *par_idx = ec->parity;
-
-	    if(Closure->stopActions) /* User hit the Stop button */
-	    {  if(Closure->stopActions == STOP_CURRENT_ACTION) /* suppress memleak warning when closing window */
-	       {  GuiSetLabelText(wl->encFootline, 
-				  _("<span %s>Aborted by user request!</span> (partial error correction file removed)"),
-				  Closure->redMarkup);
-	       }
-	       ec->earlyTermination = FALSE;   /* suppress respective error message */
-	       LargeClose(image->eccFile);
-	       image->eccFile = NULL;
-	       LargeUnlink(Closure->eccName);  /* Do not leave partial .ecc file behind */
-	       goto terminate;
-	    }
-
-	    /* Read the next data sectors of this layer. */
-
-	    for(si=0; si<actual_layer_sectors; si++)
-	    {  RS01ReadSector(image, ec->data+offset, block_idx[layer]);
-	       block_idx[layer]++;
-	       offset += 2048;
-	    }
-
-	    /* Now process the data bytes of the current layer. */
-
-	    for(si=0; si<actual_layer_bytes; si++)
-	    {  register int feedback;
-
-	       feedback = gf_index_of[ec->data[si] ^ par_idx[sp]];
-
-	       if(feedback != GF_ALPHA0) /* non-zero feedback term */
-	       {  register int spk = sp;
-
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback +  98];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback + 247];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback + 160];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback +  15];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback +  96];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback +  27];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback +  87];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback + 175];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback +  64];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback + 170];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback +  53];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback +  39];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback + 236];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback +  39];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback +  58];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback +  82];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback +  44];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback +  89];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback +  97];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback + 182];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback +  80];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback + 120];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback +  40];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback + 104];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback +  73];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback +  73];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback +  12];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback + 152];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback + 205];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback +  96];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback +  50];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback +  21];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback + 147];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback +  35];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback + 241];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback +  30];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback + 242];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback + 145];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback + 242];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback + 115];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback + 148];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback +  70];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback + 127];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback +  71];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback +  83];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback + 172];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback + 224];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback + 104];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback + 177];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback +   0];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback +  39];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback + 194];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback +  50];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback +   9];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback +   0];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback + 208];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback + 217];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback + 254];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback + 165];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback + 181];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback + 168];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback +  97];
-                  par_idx[((++spk)&63)] ^= enc_alpha_to[feedback +  45];
-
-                  par_idx[sp] = enc_alpha_to[feedback +  44];
-	       }
-	       else                   /* zero feedback term */
-		 par_idx[sp] = 0;
-
-	       par_idx += nroots;
-	    }
-
-	    sp = (sp+1) & 63;         /* shift */
-
-	    /* Report progress */
-
-	    progress++;
-	    percent = (1000*progress)/max_percent;
-	    if(last_percent != percent) 
-	    {  GuiSetProgress(wl->encPBar2, percent, 1000);
-	       PrintProgress(_("Ecc generation: %3d.%1d%%"), percent/10, percent%10);
-	       last_percent = percent;
-	    }
-	 }
-	}
-	break;
-
-        default:   /* general case for nroots other than 32 or 64 */
-	{int sp = nroots - ndata % nroots; /* => (ndata + sp) mod nroots = 0 so that parity */
-	                                   /* is aligned at sp=0 after ndata iterations */
-      	 if(sp==nroots) sp=0;
-
-	 for(layer=0; layer<ndata; layer++)
-	 {  int offset = 0;
-            unsigned char *par_idx = ec->parity;
-
-	    if(Closure->stopActions) /* User hit the Stop button */
-	    {  if(Closure->stopActions == STOP_CURRENT_ACTION) /* suppress memleak warning when closing window */
-	       {  GuiSetLabelText(wl->encFootline, 
-				  _("<span %s>Aborted by user request!</span>"),
-				  Closure->redMarkup);
-	       }
-	       ec->earlyTermination = FALSE;   /* suppress respective error message */
-	       LargeClose(image->eccFile);
-	       image->eccFile = NULL;
-	       LargeUnlink(Closure->eccName);  /* Do not leave partial .ecc file behind */
-	       goto terminate;
-	    }
-
-            /* Read the next data sectors of this layer. */
-
-   	    for(si=0; si<actual_layer_sectors; si++)
-	    {  RS01ReadSector(image, ec->data+offset, block_idx[layer]);
-	       block_idx[layer]++;
-	       offset += 2048;
-	    }
-
-	    /* Now process the data bytes of the current layer. */
-
-	    for(si=0; si<actual_layer_bytes; si++)
-	    {  register int feedback;
-
-	       feedback = gf_index_of[ec->data[si] ^ par_idx[sp]];
-
-	       if(feedback != GF_ALPHA0) /* non-zero feedback term */
-	       {  register int spk = sp+1;
-		  register int *gpoly = rs_gpoly + nroots;
-
-		  switch(nroots-spk)
-		  {  
-		    case 110: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		    case 109: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		    case 108: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		    case 107: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		    case 106: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		    case 105: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		    case 104: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		    case 103: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		    case 102: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		    case 101: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		    case 100: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 99: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 98: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 97: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 96: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 95: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 94: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 93: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 92: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 91: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 90: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 89: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 88: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 87: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 86: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 85: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 84: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 83: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 82: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 81: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 80: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 79: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 78: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 77: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 76: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 75: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 74: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 73: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 72: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 71: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 70: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 69: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 68: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 67: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 66: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 65: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 64: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 63: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 62: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 61: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 60: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 59: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 58: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 57: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 56: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 55: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 54: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 53: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 52: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 51: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 50: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 49: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 48: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 47: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 46: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 45: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 44: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 43: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 42: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 41: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 40: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 39: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 38: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 37: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 36: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 35: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 34: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 33: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 32: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 31: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 30: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 29: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 28: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 27: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 26: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 25: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 24: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 23: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 22: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 21: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 20: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 19: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 18: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 17: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 16: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 15: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 14: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 13: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 12: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 11: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 10: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case  9: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case  8: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case  7: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case  6: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case  5: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case  4: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case  3: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case  2: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case  1: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  }
-
-		  spk = 0;
-		  
-		  switch(sp)
-		  {
-                    case 110: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		    case 109: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		    case 108: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		    case 107: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		    case 106: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		    case 105: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		    case 104: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		    case 103: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		    case 102: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		    case 101: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		    case 100: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 99: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 98: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 97: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 96: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 95: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 94: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 93: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 92: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 91: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 90: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 89: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 88: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 87: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 86: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 85: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 84: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 83: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 82: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 81: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 80: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 79: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 78: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 77: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 76: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 75: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 74: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 73: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 72: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 71: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 70: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 69: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 68: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 67: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 66: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 65: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 64: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 63: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 62: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 61: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 60: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 59: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 58: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 57: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 56: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 55: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 54: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 53: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 52: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 51: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 50: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 49: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 48: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 47: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 46: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 45: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 44: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 43: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 42: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 41: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 40: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 39: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 38: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 37: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 36: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 35: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 34: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 33: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 32: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 31: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 30: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 29: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 28: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 27: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 26: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 25: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 24: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 23: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 22: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 21: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 20: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 19: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 18: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 17: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 16: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 15: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 14: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 13: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 12: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 11: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case 10: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case  9: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case  8: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case  7: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case  6: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case  5: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case  4: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case  3: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case  2: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		     case  1: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  }
-
-		  par_idx[sp] = enc_alpha_to[feedback + rs_gpoly[0]];
-	       }
-	       else                   /* zero feedback term */
-		 par_idx[sp] = 0;
-
-	       par_idx += nroots;
-	    }
-
-	    if(++sp>=nroots) sp=0;   /* shift */
-
-	    /* Report progress */
-
-	    progress++;
-	    percent = (1000*progress)/max_percent;
-	    if(last_percent != percent) 
-	    {  GuiSetProgress(wl->encPBar2, percent, 1000);
-	       PrintProgress(_("Ecc generation: %3d.%1d%%"), percent/10, percent%10);
-	       last_percent = percent;
-	    }
-	 }
-	}
-	break;
-      }
-
-      /* Write the nroots bytes of parity information */
-
-      n = LargeWrite(image->eccFile, ec->parity, nroots*actual_layer_bytes);
-
-      if(n != nroots*actual_layer_bytes)
-        Stop(_("could not write to ecc file \"%s\":\n%s"),Closure->eccName,strerror(errno));
-
-      MD5Update(&md5Ctxt, ec->parity, nroots*actual_layer_bytes);
-   }
+   if(ec->fusedScan)
+        write_parity(ec);
+   else create_reed_solomon(ec);
 
    /*** Complete the ecc header and write it out */
 
-   MD5Final(eh->eccSum, &md5Ctxt);
+   MD5Final(eh->eccSum, &ec->md5Ctxt);
 
    LargeSeek(image->eccFile, 0);
 #ifdef HAVE_BIG_ENDIAN
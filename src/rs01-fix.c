@@ -28,7 +28,6 @@
 #include "dvdisaster.h"
 
 #include "rs01-includes.h"
-#include "galois-inlines.h"
 
 /*
  * Read crc values from the .ecc file.
@@ -59,11 +58,14 @@ typedef struct
 {  RS01Widgets *wl;
    GaloisTables *gt;
    ReedSolomonTables *rt;
+   RSDecoder *decoder;
    Image *image;
    int earlyTermination;
    char *msg;
    unsigned char *imgBlock[256];
    guint32 *crcBuf[256];
+   unsigned char *eccBuf;   /* parity bytes of one ecc block as stored in the .ecc file */
+   unsigned char *parity;   /* same, sorted into nroots layers of 2048 bytes */
 } fix_closure;
 
 static void fix_cleanup(gpointer data)
@@ -96,6 +98,9 @@ static void fix_cleanup(gpointer data)
 
    if(fc->gt) FreeGaloisTables(fc->gt);
    if(fc->rt) FreeReedSolomonTables(fc->rt);
+   if(fc->decoder) FreeRSDecoder(fc->decoder);
+   if(fc->eccBuf) g_free(fc->eccBuf);
+   if(fc->parity) g_free(fc->parity);
  
    g_free(fc);
 
@@ -113,11 +118,10 @@ void RS01Fix(Image *image)
    ReedSolomonTables *rt;
    fix_closure *fc = g_malloc0(sizeof(fix_closure)); 
    EccHeader *eh = NULL;
-   unsigned char parity[256];
    int erasure_count,erasure_list[256],erasure_map[256];
    gint64 block_idx[256];
    gint64 s,si;
-   int i,j,k,n;
+   int i,j,n;
    gint64 corrected, uncorrected;
    gint64 parity_block = 0;
    guint64 expected_image_size;
@@ -127,8 +131,6 @@ void RS01Fix(Image *image)
    char *t = NULL;
    gint32 nroots;         /* These are copied to increase performance. */
    gint32 ndata;
-   gint32 *gf_index_of;
-   gint32 *gf_alpha_to;
 
    /*** Register the cleanup procedure for GUI mode */
 
@@ -337,9 +339,6 @@ void RS01Fix(Image *image)
    gt = fc->gt = CreateGaloisTables(RS_GENERATOR_POLY);
    rt = fc->rt = CreateReedSolomonTables(gt, RS_FIRST_ROOT, RS_PRIM_ELEM, eh->eccBytes);
 
-   gf_index_of = gt->indexOf;
-   gf_alpha_to = gt->alphaTo;
-
    nroots      = rt->nroots;
    ndata       = rt->ndata;
 
@@ -354,6 +353,10 @@ void RS01Fix(Image *image)
       fc->crcBuf[i]   = g_malloc(sizeof(int) * cache_size);
    }
 
+   fc->eccBuf  = g_malloc(2048*nroots);
+   fc->parity  = g_malloc(2048*nroots);
+   fc->decoder = CreateRSDecoder(rt);
+
    /*** Setup the block counters for mapping medium sectors to
 	ecc blocks */
 
@@ -478,162 +481,53 @@ void RS01Fix(Image *image)
 	}
      }
      else  /* try to correct them */
-     {  int bi;
-
-        for(bi=0; bi<2048; bi++)
-        {  int offset = cache_offset+bi;
-	   int r, deg_lambda, el, deg_omega;
-	   int u,q,tmp,num1,num2,den,discr_r;
-	   int lambda[nroots+1], s[nroots]; /* Err+Eras Locator poly * and syndrome poly */
-	   int b[nroots+1], t[nroots+1], omega[nroots+1];
-	   int root[nroots], reg[nroots+1], loc[nroots];
-	   int syn_error, count;
+     {  unsigned char *layer[255];
+	int bi;
 
-	   /* Read the parity bytes */
+	/* Read the parity bytes for all 2048 byte positions at once
+	   and sort them into layers alongside the data sectors */
 
-	   if(!LargeSeek(image->eccFile, (gint64)(sizeof(EccHeader) + image->expectedSectors*sizeof(guint32) + nroots*parity_block)))
-	     Stop(_("Failed seeking in ecc area: %s"), strerror(errno));
+	if(!LargeSeek(image->eccFile, (gint64)(sizeof(EccHeader) + image->expectedSectors*sizeof(guint32) + nroots*parity_block)))
+	  Stop(_("Failed seeking in ecc area: %s"), strerror(errno));
 
-	   n = LargeRead(image->eccFile, parity, nroots);
-	   if(n != nroots)
-	     Stop(_("Can't read ecc file:\n%s"),strerror(errno));
-	   parity_block++;
+	n = LargeRead(image->eccFile, fc->eccBuf, 2048*nroots);
+	if(n != 2048*nroots)
+	  Stop(_("Can't read ecc file:\n%s"),strerror(errno));
+	parity_block+=2048;
 
-	   /* Form the syndromes; i.e., evaluate data(x) at roots of g(x) */
+	for(i=0; i<ndata; i++)
+	  layer[i] = fc->imgBlock[i]+cache_offset;
 
-	   for(i=0; i<nroots; i++)
-	     s[i] = fc->imgBlock[0][offset];
+	for(i=0; i<nroots; i++)
+	{  layer[ndata+i] = fc->parity+2048*i;
+	   for(bi=0; bi<2048; bi++)
+	     layer[ndata+i][bi] = fc->eccBuf[bi*nroots+i];
+	}
 
-	   for(j=1; j<GF_FIELDMAX; j++)
-	   {  int data = j>=ndata ? parity[j-ndata] : fc->imgBlock[j][offset];
+	SetRSDecoderErasures(fc->decoder, erasure_list, erasure_count);
 
-	      for(i=0;i<nroots;i++)
-              {  if(s[i] == 0) s[i] = data;
-	         else s[i] = data ^ gf_alpha_to[mod_fieldmax(gf_index_of[s[i]] + (RS_FIRST_ROOT+i)*RS_PRIM_ELEM)];
-	      }
-	   }
+	/* Form the syndromes for all 2048 byte positions at once and
+	   solve the erasure columns with the cached erasure matrix */
 
-	   /* Convert syndromes to index form, check for nonzero condition */
+	RSDecodeBlock(fc->decoder, layer, 0);
 
-	   syn_error = 0;
-	   for(i=0; i<nroots; i++)
-           {  syn_error |= s[i];
-	      s[i] = gf_index_of[s[i]];
-	   }
+        for(bi=0; bi<2048; bi++)
+        {  int offset = cache_offset+bi;
+	   int location[nroots], error[nroots];
+	   int count;
 
 	   /* If it is already correct by coincidence,
 	      we have nothing to do any further */
 
-	   if(!syn_error) continue;
-
-	   /* NOTE: Since we already know all our erasure positions, 
-	      we could do away simpler than by using the Berlekamp and Chien
-	      algorithms.I've left them in this release to have a reference
-	      implementation Phil's library code which can be compared
-	      against later optimized versions. */
-
-	   /* Init lambda to be the erasure locator polynomial */
-
-	   memset(lambda+1, 0, nroots*sizeof(lambda[0]));
-	   lambda[0] = 1;
-
-	   lambda[1] = gf_alpha_to[mod_fieldmax(RS_PRIM_ELEM*(GF_FIELDMAX-1-erasure_list[0]))];
-	   for(i=1; i<erasure_count; i++) 
-	   {  u = mod_fieldmax(RS_PRIM_ELEM*(GF_FIELDMAX-1-erasure_list[i]));
-	      for(j=i+1; j>0; j--) 
-	      {  tmp = gf_index_of[lambda[j-1]];
-	         if(tmp != GF_ALPHA0)
-		   lambda[j] ^= gf_alpha_to[mod_fieldmax(u + tmp)];
-	      }
-	   }
-	
-	   for(i=0; i<nroots+1; i++)
-	     b[i] = gf_index_of[lambda[i]];
-  
-	   /* Begin Berlekamp-Massey algorithm to determine error+erasure locator polynomial */
-
-	   r = erasure_count;   /* r is the step number */
-	   el = erasure_count;
-	   while(++r <= nroots) /* Compute discrepancy at the r-th step in poly-form */
-	   {  
-	     discr_r = 0;
-	     for(i=0; i<r; i++)
-	       if((lambda[i] != 0) && (s[r-i-1] != GF_ALPHA0))
-		 discr_r ^= gf_alpha_to[mod_fieldmax(gf_index_of[lambda[i]] + s[r-i-1])];
-
-	     discr_r = gf_index_of[discr_r];	/* Index form */
-
-	     if(discr_r == GF_ALPHA0) 
-	     {
-	        /* B(x) = x*B(x) */
-	        memmove(b+1, b, nroots*sizeof(b[0]));
-	        b[0] = GF_ALPHA0;
-	     } 
-	     else 
-	     {  /* T(x) = lambda(x) - discr_r*x*b(x) */
-	        t[0] = lambda[0];
-	        for(i=0; i<nroots; i++) 
-		{  if(b[i] != GF_ALPHA0)
-		        t[i+1] = lambda[i+1] ^ gf_alpha_to[mod_fieldmax(discr_r + b[i])];
-		   else t[i+1] = lambda[i+1];
-		}
-
-		if(2*el <= r+erasure_count-1) 
-		{  el = r + erasure_count - el;
-
-		   /* B(x) <-- inv(discr_r) * lambda(x) */
-		   for(i=0; i<=nroots; i++)
-		     b[i] = (lambda[i] == 0) ? GF_ALPHA0 : mod_fieldmax(gf_index_of[lambda[i]] - discr_r + GF_FIELDMAX);
-		} 
-		else 
-		{  /* 2 lines below: B(x) <-- x*B(x) */
-		   memmove(b+1, b, nroots*sizeof(b[0]));
-		   b[0] = GF_ALPHA0;
-		}
-
-		memcpy(lambda,t,(nroots+1)*sizeof(t[0]));
-	     }
-	   }
-
-	   /* Convert lambda to index form and compute deg(lambda(x)) */
-	   deg_lambda = 0;
-	   for(i=0; i<nroots+1; i++)
-	   {  lambda[i] = gf_index_of[lambda[i]];
-	      if(lambda[i] != GF_ALPHA0)
-		deg_lambda = i;
-	   }
-
-	   /* Find roots of the error+erasure locator polynomial by Chien search */
-	   memcpy(reg+1, lambda+1, nroots*sizeof(reg[0]));
-	   count = 0;		/* Number of roots of lambda(x) */
+	   if(!(fc->decoder->nonzero[bi/SYNDROME_COLUMNS] & (1U<<(bi%SYNDROME_COLUMNS)))) continue;
 
-	   for(i=1, k=RS_PRIMTH_ROOT-1; i<=GF_FIELDMAX; i++, k=mod_fieldmax(k+RS_PRIMTH_ROOT))
-	   {  q=1; /* lambda[0] is always 0 */
-
-	      for(j=deg_lambda; j>0; j--)
-	      {  if(reg[j] != GF_ALPHA0) 
-		 {  reg[j] = mod_fieldmax(reg[j] + j);
-		    q ^= gf_alpha_to[reg[j]];
-		 }
-	      }
-
-	      if(q != 0) continue; /* Not a root */
-
-	      /* store root (index-form) and error location number */
-
-	      root[count] = i;
-	      loc[count] = k;
-
-	      /* If we've already found max possible roots, abort the search to save time */
-
-	      if(++count == deg_lambda) break;
-	      //if(++count >= deg_lambda) break;
-	   }
+	   count = RSDecodeBlockColumn(fc->decoder, bi, location, error);
 
 	   /* deg(lambda) unequal to number of roots => uncorrectable error detected */
 
-	   if(deg_lambda != count)
-	   {  PrintLog("Decoder problem (%d != %d) for %d sectors: ", deg_lambda, count, erasure_count);
+	   if(count < 0)
+	   {  PrintLog("Decoder problem (%d != %d) for %d sectors: ", 
+		       fc->decoder->degLambda, fc->decoder->rootCount, erasure_count);
 
 	      for(i=0; i<erasure_count; i++)
 	      {  gint64 idx = block_idx[erasure_list[i]];
@@ -644,69 +538,30 @@ void RS01Fix(Image *image)
 	      break;
 	   }
 
-	   /* Compute err+eras evaluator poly omega(x) = s(x)*lambda(x) 
-	      (modulo x**nroots). in index form. Also find deg(omega). */
-
-	   deg_omega = deg_lambda-1;
-
-	   for(i=0; i<=deg_omega; i++)
-	   {  tmp = 0;
-	      for(j=i; j>=0; j--)
-	      {  if((s[i - j] != GF_ALPHA0) && (lambda[j] != GF_ALPHA0))
-		   tmp ^= gf_alpha_to[mod_fieldmax(s[i - j] + lambda[j])];
-	      }
-
-	      omega[i] = gf_index_of[tmp];
-	   }
-
-	   /* Compute error values in poly-form. 
-	      num1 = omega(inv(X(l))), 
-              num2 = inv(X(l))**(FIRST_ROOT-1) and 
-	      den  = lambda_pr(inv(X(l))) all in poly-form. */
-
-	   for(j=count-1; j>=0; j--)
-	   {  num1 = 0;
-
-	      for(i=deg_omega; i>=0; i--) 
-	      {  if(omega[i] != GF_ALPHA0)
-		    num1 ^= gf_alpha_to[mod_fieldmax(omega[i] + i * root[j])];
-	      }
-
-	      num2 = gf_alpha_to[mod_fieldmax(root[j] * (RS_FIRST_ROOT - 1) + GF_FIELDMAX)];
-	      den = 0;
-    
-	      /* lambda[i+1] for i even is the formal derivative lambda_pr of lambda[i] */
-
-	      for(i=MIN(deg_lambda, nroots-1) & ~1; i>=0; i-=2) 
-	      {  if(lambda[i+1] != GF_ALPHA0)
-		   den ^= gf_alpha_to[mod_fieldmax(lambda[i+1] + i * root[j])];
-	      }
-
-	      /* Apply error to data */
+	   /* Apply error to data */
 
-	      if(num1 != 0)
-	      {  int location = loc[j];
+	   for(j=0; j<count; j++)
+	   {  int loc = location[j];
 		
-		 if(location >= 0 && location < ndata)
-		 {  if(erasure_map[location] == 3)
-		    {  int old = fc->imgBlock[location][offset];
-		       int new = old ^ gf_alpha_to[mod_fieldmax(gf_index_of[num1] + gf_index_of[num2] + GF_FIELDMAX - gf_index_of[den])];
-
-		       PrintCLI(_("-> Error located in sector %" PRId64 " at byte %4d (value %02x '%c', expected %02x '%c')\n"),
-				block_idx[location], bi, 
-				old, canprint(old) ? old : '.',
-				new, canprint(new) ? new : '.');
-		    }
-
-		    if(!erasure_map[location])
-		      PrintLog(_("Unexpected byte error in sector %" PRId64 ", byte %d\n"),
-			       block_idx[location], bi);
-
-		    fc->imgBlock[location][offset] ^= gf_alpha_to[mod_fieldmax(gf_index_of[num1] + gf_index_of[num2] + GF_FIELDMAX - gf_index_of[den])];
+	      if(loc >= 0 && loc < ndata)
+	      {  if(erasure_map[loc] == 3)
+		 {  int old = fc->imgBlock[loc][offset];
+		    int new = old ^ error[j];
+
+		    PrintCLI(_("-> Error located in sector %" PRId64 " at byte %4d (value %02x '%c', expected %02x '%c')\n"),
+			     block_idx[loc], bi, 
+			     old, canprint(old) ? old : '.',
+			     new, canprint(new) ? new : '.');
 		 }
-		 else
-		   PrintLog(_("Bad error location %d; corrupted .ecc file?\n"), location);
+
+		 if(!erasure_map[loc])
+		   PrintLog(_("Unexpected byte error in sector %" PRId64 ", byte %d\n"),
+			    block_idx[loc], bi);
+
+		 fc->imgBlock[loc][offset] ^= error[j];
 	      }
+	      else
+		PrintLog(_("Bad error location %d; corrupted .ecc file?\n"), loc);
 	   }
 	}
      }
@@ -523,6 +523,7 @@ void RS01Verify(Image *image)
 	 else
 	 {  PrintLog(_("* suspicious image : all sectors present, but %" PRId64 " CRC errors\n"
 		       "- image md5sum     : %s\n"),image->crcErrors,idigest);
+	    exitCode = EXIT_CODE_CHECKSUM_ERROR;
 
 	    GuiSetLabelText(wl->cmpImageResult, _("<span %s>Image complete, but contains checksum errors!</span>"), Closure->redMarkup);
 	    GuiSetLabelText(wl->cmpImageMd5Sum, "%s", idigest);
@@ -533,6 +534,7 @@ void RS01Verify(Image *image)
 	      PrintLog(_("* BAD image        : %" PRId64 " sectors missing\n"), image->sectorsMissing);
 	 else PrintLog(_("* BAD image        : %" PRId64 " sectors missing, %" PRId64 " CRC errors\n"), 
 		         image->sectorsMissing, image->crcErrors);
+	 exitCode = EXIT_CODE_MISSING_SECTOR;
 
 	 GuiSetLabelText(wl->cmpImageResult,
 			 _("<span %s>Bad image.</span>"), Closure->redMarkup);
@@ -654,6 +656,7 @@ process_ecc:
 		 "*                  : Please upgrade dvdisaster.\n"),
 	       eh->neededVersion/10000,
 	       (eh->neededVersion%10000)/100);
+       exitCode = EXIT_CODE_VERSION_MISMATCH;
 
        GuiSetLabelText(wl->cmpEccRequires, 
 		       "<span %s>dvdisaster-%d.%d</span>",
@@ -717,6 +720,7 @@ process_ecc:
 	else  /* more than 2 Sectors difference */ 
 	{  if(!ecc_in_last)
 	   {  PrintLog(_("* medium sectors   : %" PRId64 " (BAD)\n"), image->expectedSectors);
+	      exitCode = EXIT_CODE_SIZE_MISMATCH;
 	      GuiSetLabelText(wl->cmpEccMediumSectors, "<span %s>%" PRId64 "</span>", 
 			      Closure->redMarkup, image->expectedSectors);
 	      if(!ecc_advice)
@@ -725,6 +729,7 @@ process_ecc:
 	   else /* byte size difference */
 	   {  PrintLog(_("* medium sectors   : %" PRId64 " sectors + %d bytes (BAD)\n"),
 		       image->expectedSectors-1, ecc_in_last);
+	      exitCode = EXIT_CODE_SIZE_MISMATCH;
 	      GuiSetLabelText(wl->cmpEccMediumSectors, 
 			      _("<span %s>%" PRId64 " sectors + %d bytes</span>"), 
 			      Closure->redMarkup, image->expectedSectors-1, ecc_in_last);
@@ -747,6 +752,7 @@ process_ecc:
 	 }
 	 else
 	 {  PrintLog(_("* image md5sum     : %s (BAD)\n"),edigest);
+	    exitCode = EXIT_CODE_CHECKSUM_ERROR;
 	    GuiSetLabelText(wl->cmpEccImgMd5Sum, "<span %s>%s</span>",
 			    Closure->redMarkup, edigest);
 	    GuiSetLabelText(wl->cmpImageMd5Sum, "<span %s>%s</span>",
@@ -843,6 +849,7 @@ process_ecc:
 
    if(memcmp(eh->eccSum, digest, 16))
    {  PrintLog(_("* ecc md5sum       : BAD, ecc file may be damaged!\n"));
+      exitCode = EXIT_CODE_SYNDROME_ERROR;
       GuiSetLabelText(wl->cmpEccMd5Sum, _("<span %s>bad</span>"), Closure->redMarkup);
       if(!ecc_advice)
 	ecc_advice = g_strdup_printf(_("<span %s>Error correction file may be damaged!</span>"), Closure->redMarkup);
@@ -125,20 +125,28 @@ void RS02ResetCksums(Image *image)
 
 void RS02UpdateCksums(Image *image, gint64 sector, unsigned char *buf)
 {  RS02CksumClosure *csc = (RS02CksumClosure*)image->eccMethod->ckSumClosure;
+   struct MD5Context *ctxt[2];
+   unsigned char const *bufs[2] = { buf, buf };
+   int layer_end = FALSE;
 
-   MD5Update(&csc->md5ctxt, buf, 2048);
+   /* Every sector goes into the image md5sum and into at most 
+      one of the portion md5sums. Sectors seen by two md5sums
+      are hashed side by side. */
+
+   ctxt[0] = &csc->md5ctxt;
+   ctxt[1] = NULL;
 
    /* md5sum the data portion */
 
    if(sector < csc->lay->dataSectors)
    {  if(sector < csc->lay->dataSectors - 1)
-	   MD5Update(&csc->dataCtxt, buf, 2048);
+	   ctxt[1] = &csc->dataCtxt;
       else MD5Update(&csc->dataCtxt, buf, image->eccHeader->inLast);
    }
 
    /* md5sum the crc portion */
    if(sector >= csc->lay->dataSectors+2 && sector < csc->lay->protectedSectors)
-      MD5Update(&csc->crcCtxt, buf, 2048);
+      ctxt[1] = &csc->crcCtxt;
 
    /* md5sum the ecc layers */
    if(sector >= csc->lay->protectedSectors)
@@ -146,18 +154,25 @@ void RS02UpdateCksums(Image *image, gint64 sector, unsigned char *buf)
 
       RS02SliceIndex(csc->lay, sector, &layer, &n);
       if(layer != -1)  /* not an ecc header? */
-      {  if(n < csc->lay->sectorsPerLayer-1)  /* not at layer end? */
-	    MD5Update(&csc->eccCtxt, buf, 2048);
-	 else  /* layer end; update meta md5 and skip to next layer */
-	 {  guint8 sum[16];
-	    MD5Update(&csc->eccCtxt, buf, 2048);
-	    MD5Final(sum, &csc->eccCtxt);
-	    MD5Update(&csc->metaCtxt, sum, 16);
-	    MD5Init(&csc->eccCtxt);
-	 }
+      {  ctxt[1] = &csc->eccCtxt;
+	 if(n >= csc->lay->sectorsPerLayer-1)  /* at layer end? */
+	    layer_end = TRUE;
       }
       /* maybe add ...else { check ecc header } */ 
    }
+
+   if(ctxt[1])
+        MD5UpdateMulti(ctxt, bufs, 2048, 2);
+   else MD5Update(&csc->md5ctxt, buf, 2048);
+
+   /* layer end; update meta md5 and skip to next layer */
+
+   if(layer_end)
+   {  guint8 sum[16];
+      MD5Final(sum, &csc->eccCtxt);
+      MD5Update(&csc->metaCtxt, sum, 16);
+      MD5Init(&csc->eccCtxt);
+   }
 }
 
 int RS02FinalizeCksums(Image *image)
@@ -246,6 +261,63 @@ void RS02ReadSector(Image *image, RS02Layout *lay, unsigned char *buf, gint64 s)
     Stop(_("Failed reading sector %" PRId64 " in image: %s"),s,strerror(errno));
 }
 
+/***
+ *** Queue up sector reads for submitting them in one go.
+ ***
+ * RS02QueueSector() does the same as RS02ReadSector(), but instead of
+ * reading real sectors it adds them to the request vector vec containing
+ * n requests. Sectors which are adjacent in the image and in memory
+ * are merged into one request. Returns the new number of requests.
+ * RS02QueueRawSector() queues sector s regardless of the layout,
+ * e.g. for reading the ecc portion.
+ * RS02ReadQueuedSectors() submits all requests and waits for them.
+ */
+
+int RS02QueueRawSector(LargeIOVec *vec, int n, unsigned char *buf, gint64 s)
+{  
+   if(n > 0)
+   {  LargeIOVec *prev = &vec[n-1];
+
+      if(   prev->offset + prev->count == 2048*s
+	 && (unsigned char*)prev->buf + prev->count == buf)
+      {  prev->count += 2048;
+	 return n;
+      }
+   }
+
+   vec[n].offset = 2048*s;
+   vec[n].buf    = buf;
+   vec[n].count  = 2048;
+
+   return n+1;
+}
+
+int RS02QueueSector(Image *image, RS02Layout *lay, LargeIOVec *vec, int n,
+		    unsigned char *buf, gint64 s)
+{  
+   if(   s >= lay->protectedSectors
+      || s == lay->firstEccHeader
+      || s == lay->firstEccHeader + 1
+      || s >= image->sectorSize)
+   {  RS02ReadSector(image, lay, buf, s);
+      return n;
+   }
+
+   return RS02QueueRawSector(vec, n, buf, s);
+}
+
+void RS02ReadQueuedSectors(Image *image, LargeIOVec *vec, int n)
+{  int i;
+
+   if(LargeReadV(image->file, vec, n))
+     return;
+
+   for(i=0; i<n; i++)
+     if(vec[i].result != vec[i].count)
+       Stop(_("Failed reading sector %" PRId64 " in image: %s"),
+	    (gint64)vec[i].offset/2048, strerror(errno));
+}
+
 /***
  *** Calculate position of n-th Ecc sector of the given slice in the image.
  ***
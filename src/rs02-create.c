@@ -26,6 +26,30 @@
 
 #include "rs02-includes.h"
 
+#ifdef SYS_MINGW
+#include <windows.h>
+#endif
+
+#ifdef HAVE_MMAP
+  #include <sys/mman.h>
+
+#if defined(SYS_LINUX)
+
+  #define MMAP_FLAGS (MAP_SHARED | MAP_POPULATE | MAP_NORESERVE)
+
+#elif defined(SYS_FREEBSD)
+
+  #define MMAP_FLAGS (MAP_SHARED | MAP_PREFAULT_READ)
+
+#else
+
+  /* SYS_NETBSD and others. */
+  #define MMAP_FLAGS (MAP_SHARED)
+
+#endif
+
+#endif
+
 /***
  *** Local data package used during encoding
  ***/
@@ -38,24 +62,92 @@ typedef struct
    GaloisTables *gt;
    ReedSolomonTables *rt;
    EccHeader *eh;
-   unsigned char *data;
+
+   guint32 pageSize;           /* needed for memory mapping */
+   unsigned char **ioData;     /* shared buffers between IO and RS threads */
+   unsigned char **encoderData;/* point into the buffers below or into a mmap()ed area */
+   unsigned char **ioBuf;      /* aligned buffers of the respective data sets */
+   unsigned char **encoderBuf;
+   unsigned char **ioMmapBase; /* mmap() works on multiples of page sizes */
+   guint64 *ioMmapSize;        /* so the mmap area might differ from sector range */
+   unsigned char **encoderMmapBase;
+   guint64 *encoderMmapSize;
+   AlignedBuffer *dataAligned[512]; /* backing store of both data sets */
+   LargeIOVec *ioVec;          /* request vector of the IO thread */
+   unsigned char *paritybase;
    unsigned char *parity;
    unsigned char *slice[256];
+   AlignedBuffer *sliceAligned[256];
+   guint64 chunkSize;          /* we can process this much layer sectors at a time */
+   guint64 readSectors;        /* sectors per read in the fused pass */
    struct MD5Context md5Ctxt[256];
    guint8 md5Sum[16*256];
    guint8 eccSum[16];
+
+   /* The IO and encoder threads are working interleaved.
+      Each one keeps track of its state in a separate data set. */
+
+   guint64 ioChunk;            /* chunk we are currently working on */
+   guint64 encoderChunk;
+   guint64 flushChunk;
+   guint64 ioLayerSectors;     /* last layer maybe smaller than chunkSize */
+   guint64 encoderLayerSectors;
+   guint64 flushLayerSectors;
+   int ioLayer;                /* first layer and number of layers in the chunk */
+   int ioLayers;
+   int encoderLayer;
+   int encoderLayers;
+   unsigned char *encoderParity;
+
+   GMutex *lock;               /* lock on this struct */
+   GCond *ioCond;              /* sync between encoder and IO threads */
+   guint64 sectorsToEncode;    /* total number of sector to encode */
+   guint64 buffersToEncode;    /* number of unprocessed sector columns */
+   guint64 nextBufferIndex;    /* next sector column which needs to be encoded */
+   int slicesFree;             /* flag for sharing them between IO and encoder */
+   GThread *thread[MAX_CODEC_THREADS];
+   int nThreads;
+   int abortImmediately;
+   guint64 progress;
+   int lastPercent;
+
    char *msg;
    int earlyTermination;
    GTimer *timer;
    int checksumsReused;
+   int fusedScan;              /* checksums are calculated in the encoding pass */
+   int crcWritten;
 } ecc_closure;
 
+#ifdef HAVE_MMAP
+static void unmap_layer(unsigned char **base, guint64 *size, int layer)
+{
+   if(base[layer])
+   {  if(munmap(base[layer], size[layer]) == -1)
+	 Stop("munmap() failed: %s\n", strerror(errno));
+      base[layer] = NULL;
+   }
+}
+#endif
+
 static void ecc_cleanup(gpointer data)
 {  ecc_closure *ec = (ecc_closure*)data;
    int i;
 
    UnregisterCleanup();
 
+   /* Wait for the encoder threads if we aborted prematurely */
+
+   if(ec->nThreads)
+   {  g_mutex_lock(ec->lock);
+      ec->abortImmediately = TRUE;
+      g_cond_broadcast(ec->ioCond);
+      g_mutex_unlock(ec->lock);
+
+      for(i=0; i<ec->nThreads; i++)
+	g_thread_join(ec->thread[i]);
+   }
+
    if(ec->earlyTermination && ec->wl)
    {  GuiSetLabelText(ec->wl->encFootline,
 		      _("<span %s>Aborted by unrecoverable error.</span>"),
@@ -77,15 +169,45 @@ static void ecc_cleanup(gpointer data)
    if(ec->gt) FreeGaloisTables(ec->gt);
    if(ec->rt) FreeReedSolomonTables(ec->rt);
    if(ec->eh) g_free(ec->eh);
-   if(ec->lay) g_free(ec->lay);
-   if(ec->data) g_free(ec->data);
-   if(ec->parity) g_free(ec->parity);
+   if(ec->paritybase) g_free(ec->paritybase);
+   if(ec->ioVec) g_free(ec->ioVec);
    if(ec->msg) g_free(ec->msg);
    if(ec->timer) g_timer_destroy(ec->timer);
+   if(ec->lock)
+   {  g_mutex_clear(ec->lock);
+      g_free(ec->lock);
+   }
+   if(ec->ioCond)
+   {  g_cond_clear(ec->ioCond);
+      g_free(ec->ioCond);
+   }
+
+#ifdef HAVE_MMAP
+   if(ec->lay && ec->ioMmapBase)
+   {  for(i=0; i<ec->lay->ndata; i++)
+      {  unmap_layer(ec->ioMmapBase, ec->ioMmapSize, i);
+	 unmap_layer(ec->encoderMmapBase, ec->encoderMmapSize, i);
+      }
+   }
+#endif
+   if(ec->lay) g_free(ec->lay);
+
+   for(i=0; i<512; i++)
+     if(ec->dataAligned[i])
+       FreeAlignedBuffer(ec->dataAligned[i]);
 
    for(i=0; i<256; i++)
-     if(ec->slice[i])
-       g_free(ec->slice[i]);
+     if(ec->sliceAligned[i])
+       FreeAlignedBuffer(ec->sliceAligned[i]);
+
+   g_free(ec->ioData);
+   g_free(ec->encoderData);
+   g_free(ec->ioBuf);
+   g_free(ec->encoderBuf);
+   g_free(ec->ioMmapBase);
+   g_free(ec->encoderMmapBase);
+   g_free(ec->ioMmapSize);
+   g_free(ec->encoderMmapSize);
 
    g_free(ec);
 
@@ -162,6 +284,45 @@ static void remove_old_ecc(ecc_closure *ec)
    }
 }
 
+/*
+ * Check a data sector for completeness and add it to the CRC sums
+ */
+
+static void scan_sector(ecc_closure *ec, unsigned char *buf, gint64 sector)
+{  RS02Layout *lay = ec->lay;
+   Image *image = ec->image;
+   int n = sector < lay->dataSectors-1 ? 2048 : image->inLast;
+   int err;
+
+   /* Look for the dead sector marker */
+
+   err = CheckForMissingSector(buf, sector, image->fpState == FP_PRESENT ? image->imageFP : NULL, FINGERPRINT_SECTOR);
+   if(err != SECTOR_PRESENT)
+   {  /* The image has already been expanded in the fused pass */
+
+      if(ec->fusedScan)
+	LargeTruncate(image->file, (gint64)(2048*(lay->dataSectors-1)+image->inLast));
+
+      if(err == SECTOR_MISSING)
+	 Stop(_("Image contains unread(able) sectors.\n"
+		"Error correction information can only be\n"
+		"appended to complete (undamaged) images.\n"));
+      else
+	 Stop(_("Sector %" PRId64 " in the image is marked unreadable\n"
+		"and seems to come from a different medium.\n\n"
+		"The image was probably mastered from defective content.\n"
+		"For example it might contain one or more files which came\n"
+		"from a damaged medium which was NOT fully recovered.\n" 
+		"This means that some files may have been silently corrupted.\n\n"
+		"Error correction information can only be\n"
+		"appended to complete (undamaged) images.\n"), sector);
+   }
+      
+   /* Update and cache the CRC sums */
+
+   AddSectorToCrcBuffer(Closure->crcBuf, CRCBUF_UPDATE_ALL, sector, buf, n);
+}
+
 /*
  * Check the image for completeness and calculate the CRC sums
  * if the respective data has not already been supplied by ReadLinear() 
@@ -171,13 +332,18 @@ static void check_image(ecc_closure *ec)
 {  RS02Layout *lay = ec->lay;
    Image *image = ec->image;
    gint64 sectors;
+   guint64 parity_bytes;
    int last_percent, percent;
+   int nroots_aligned = (lay->nroots+15)&~15;
    
    /* In the (unlikely) event that the image has just been read,
       we can reuse the checksums generated in the reading pass.
       Otherwise create a new buffer.
     */
 
+   if(!Closure->crcBuf && Closure->crcCacheFile)
+      Closure->crcBuf = LoadCrcBuf(image, Closure->crcCacheFile);
+
    if(CrcBufValid(Closure->crcBuf, image, DATA_SECTORS_ONLY))   
    {  ec->checksumsReused=TRUE;
       memcpy(image->mediumSum, Closure->crcBuf->dataMD5sum, 16);
@@ -188,6 +354,24 @@ static void check_image(ecc_closure *ec)
       Closure->crcBuf = CreateCrcBuf(image);
    }
 
+   /* If the parity of the whole image fits into memory,
+      the checksums are calculated from the same buffers
+      which are fed into the encoder. The image is then
+      read only once. Besides the cache, up to half of
+      the available memory may be used for the parity. */
+
+   parity_bytes = 2048*(guint64)nroots_aligned*lay->sectorsPerLayer;
+   if(   parity_bytes <= (guint64)Closure->cacheMiB<<20
+      || (parity_bytes <= ProbeAvailableMemory()/2 && parity_bytes <= (guint64)SIZE_MAX/4))
+   {  Verbose("Single pass over the image; keeping %" PRIu64 " MiB of parity in memory.\n",
+	      parity_bytes>>20);
+      ec->fusedScan = TRUE;
+      return;
+   }
+
+   Verbose("Two passes over the image; %" PRIu64 " MiB of parity do not fit into memory.\n",
+	   parity_bytes>>20);
+
    last_percent = 0;
  
    if(!LargeSeek(image->file, 0))
@@ -195,7 +379,7 @@ static void check_image(ecc_closure *ec)
 
    for(sectors = 0; sectors < lay->dataSectors; sectors++)
    {  unsigned char buf[2048];
-      int expected,n,err;
+      int expected,n;
 
       if(Closure->stopActions) /* User hit the Stop button */
 	abort_encoding(ec, FALSE);
@@ -210,28 +394,7 @@ static void check_image(ecc_closure *ec)
       if(n != expected)
 	Stop(_("Failed reading sector %" PRId64 " in image: %s"),sectors,strerror(errno));
 
-      /* Look for the dead sector marker */
-
-      err = CheckForMissingSector(buf, sectors, image->fpState == FP_PRESENT ? image->imageFP : NULL, FINGERPRINT_SECTOR);
-      if(err != SECTOR_PRESENT)
-      {    if(err == SECTOR_MISSING)
-	    Stop(_("Image contains unread(able) sectors.\n"
-		   "Error correction information can only be\n"
-		   "appended to complete (undamaged) images.\n"));
-	 else
-	    Stop(_("Sector %" PRId64 " in the image is marked unreadable\n"
-		   "and seems to come from a different medium.\n\n"
-		   "The image was probably mastered from defective content.\n"
-		   "For example it might contain one or more files which came\n"
-		   "from a damaged medium which was NOT fully recovered.\n" 
-		   "This means that some files may have been silently corrupted.\n\n"
-		   "Error correction information can only be\n"
-		   "appended to complete (undamaged) images.\n"), sectors);
-      }
-      
-      /* Update and cache the CRC sums */
-
-      AddSectorToCrcBuffer(Closure->crcBuf, CRCBUF_UPDATE_ALL, sectors, buf, n);
+      scan_sector(ec, buf, sectors);
 
       percent = (100*sectors)/(lay->eccSectors + lay->dataSectors);
 
@@ -297,10 +460,14 @@ static void expand_image(ecc_closure *ec)
       if(n != 2048)
 	Stop(_("Failed expanding the image: %s\n"), strerror(errno));
 
-      percent = (100*(sectors+lay->dataSectors)) / (lay->eccSectors + lay->dataSectors);
+      if(ec->fusedScan)
+	   percent = (100*sectors) / lay->eccSectors;
+      else percent = (100*(sectors+lay->dataSectors)) / (lay->eccSectors + lay->dataSectors);
       if(last_percent != percent)
       {  if(ec->checksumsReused)
 	      PrintProgress(_("Preparing image (checksums taken from cache, adding space): %3d%%") ,percent);
+	 else if(ec->fusedScan)
+	      PrintProgress(_("Preparing image (adding space): %3d%%"), percent);
 	 else PrintProgress(_("Preparing image (checksums, adding space): %3d%%"), percent);
 
 	 GuiSetProgress(ec->wl->encPBar1, percent, 100);
@@ -311,6 +478,8 @@ static void expand_image(ecc_closure *ec)
 
    if(ec->checksumsReused)
         PrintProgress(_("Preparing image (checksums taken from cache, adding space): %3d%%"), 100);
+   else if(ec->fusedScan)
+        PrintProgress(_("Preparing image (adding space): %3d%%"), 100);
    else PrintProgress(_("Preparing image (checksums, adding space): %3d%%"), 100);
    PrintProgress("\n");
    GuiSetProgress(ec->wl->encPBar1, 100, 100);
@@ -446,557 +615,573 @@ static void prepare_header(ecc_closure *ec)
  * Calculate the Reed-Solomon error correction code
  */
 
-static void create_reed_solomon(ecc_closure *ec)
+/* The IO thread reads the data layers of the next chunk while the
+   encoder threads work on the current one. Each encoder takes one
+   sector column (the same sector of all ndata layers) at a time,
+   so the work can be divided among any number of threads without
+   sharing parity bytes. The parity of the previous chunk is written
+   out by the IO thread while the encoders are busy.
+
+   If the parity of the whole image fits into memory, the fused pass
+   is used instead: The layers are read one after another, which is
+   the order of the sectors in the image. So the IO thread can check
+   the sectors and calculate their CRC and md5 sums while the encoders
+   work the previously read part of the layer into the parity. */
+
+static void flip_buffers(ecc_closure *ec)
+{  unsigned char **dtmp;
+   guint64 *stmp;
+
+   dtmp = ec->ioData;     ec->ioData     = ec->encoderData;     ec->encoderData     = dtmp;
+   dtmp = ec->ioBuf;      ec->ioBuf      = ec->encoderBuf;      ec->encoderBuf      = dtmp;
+   dtmp = ec->ioMmapBase; ec->ioMmapBase = ec->encoderMmapBase; ec->encoderMmapBase = dtmp;
+   stmp = ec->ioMmapSize; ec->ioMmapSize = ec->encoderMmapSize; ec->encoderMmapSize = stmp;
+}
+
+#ifdef HAVE_MMAP
+
+/* Memory mapping is only possible if the layer section consists
+   of plain data sectors. The ecc header and the padding sectors
+   behind the protected area are synthesized by RS02ReadSector(). */
+
+static int layer_is_mappable(ecc_closure *ec, gint64 first, gint64 last)
 {  RS02Layout *lay = ec->lay;
-   Image *image = ec->image;
-   int nroots = lay->nroots;
-   int ndata  = lay->ndata;
-   gint64 b_idx, block_idx[256]; 
-   guint64 n_parity_blocks,n_layer_sectors;
-   guint64 n_parity_bytes,n_layer_bytes;
-   guint64 si,chunk;
-   int last_percent, percent, max_percent, progress;
-   int layer,i,j,k;
-   unsigned char *par_ptr;
-   int out_of_memory = 0;
-static gint32 *gf_index_of;    /* These need to be static globals */
-static gint32 *rs_gpoly;       /* for optimization reasons. */
-static gint32 *enc_alpha_to;
 
-   /*** Show the second progress bar */
+   if(last >= lay->protectedSectors || last >= ec->image->sectorSize)
+      return FALSE;
 
-   GuiShowWidget(ec->wl->encPBar2);
-   GuiShowWidget(ec->wl->encLabel2);
-   
-   /*** Adjust image bounds to include the CRC sectors */
+   if(first <= lay->firstEccHeader+1 && last >= lay->firstEccHeader)
+      return FALSE;
 
-   image->sectorSize = lay->protectedSectors;
+   return TRUE;
+}
+#endif /* HAVE_MMAP */
 
-   /*** Create table for Galois field math */
+static void read_layers(ecc_closure *ec, int first_layer, int n_layers, guint64 chunk, guint64 n_sectors)
+{  RS02Layout *lay = ec->lay;
+   int n_vec = 0;
+   int i;
+   guint64 si;
 
-   ec->gt = CreateGaloisTables(RS_GENERATOR_POLY);
-   ec->rt = CreateReedSolomonTables(ec->gt, RS_FIRST_ROOT, RS_PRIM_ELEM, nroots);
+   ec->ioLayer = first_layer;
+   ec->ioLayers = n_layers;
+   ec->ioChunk = chunk;
+   ec->ioLayerSectors = n_sectors;
+
+   /* Queue the sectors of all layers and read them in one go */
+
+   for(i=0; i<n_layers; i++)
+   {  int layer = first_layer+i;
+      gint64 first_sec = layer*lay->sectorsPerLayer + chunk;
+
+      if(Closure->stopActions) /* User hit the Stop button */
+	abort_encoding(ec, TRUE);
+
+#ifdef HAVE_MMAP
+      if(Closure->encodingIOStrategy == IO_STRATEGY_MMAP)
+      {  unmap_layer(ec->ioMmapBase, ec->ioMmapSize, i);
+
+	 if(layer_is_mappable(ec, first_sec, first_sec+ec->ioLayerSectors-1))
+	 {  guint64 page_offset = 2048*first_sec;
+	    int shift = page_offset % ec->pageSize;
+
+	    page_offset -= shift;
+	    ec->ioMmapSize[i] = 2048*ec->ioLayerSectors + shift;
+	    ec->ioMmapBase[i] = mmap(NULL, ec->ioMmapSize[i],
+					 PROT_READ, MMAP_FLAGS,
+					 ec->image->file->fileHandle,
+					 page_offset);
+	    if(ec->ioMmapBase[i] == MAP_FAILED)
+	    {  ec->ioMmapBase[i] = NULL;
+	       Stop(_("Failed mmap()ing layer %d: %s\n"), layer, strerror(errno));
+	    }
+	    ec->ioData[i] = ec->ioMmapBase[i]+shift;
+	    continue;
+	 }
+      }
+#endif /* HAVE_MMAP */
 
-   gf_index_of  = ec->gt->indexOf;
-   enc_alpha_to = ec->gt->encAlphaTo;
-   rs_gpoly     = ec->rt->gpoly;
+      ec->ioData[i] = ec->ioBuf[i];
+      for(si=0; si<ec->ioLayerSectors; si++)
+	n_vec = RS02QueueSector(ec->image, lay, ec->ioVec, n_vec,
+				ec->ioData[i]+2048*si, first_sec+si);
+   }
 
-   /*** Allocate buffers for the parity calculation and image data caching. 
+   RS02ReadQueuedSectors(ec->image, ec->ioVec, n_vec);
+}
 
-        The algorithm builds the parity file consecutively in chunks of n_parity_blocks.
-        We use all the amount of memory allowed by cacheMiB for caching the parity blocks. */
+/* The last chunk may contain fewer sectors. */
 
-   n_parity_blocks = ((guint64)Closure->cacheMiB<<20) / (guint64)nroots;  /* 1 MiB = 2^20 */
-   n_parity_blocks >>= 1;                              /* two buffer sets for scrambling */
-   n_parity_blocks &= ~0x7ff;                          /* round down to multiple of 2048 */
-   n_parity_bytes  = (guint64)nroots * n_parity_blocks;
+static void read_next_chunk(ecc_closure *ec, guint64 chunk)
+{  RS02Layout *lay = ec->lay;
 
-   /* Each chunk of parity blocks is built iteratively by processing the data in layers
-      (first all bytes at pos 0, then pos 1, until ndata layers have been processed).
-      So we need to buffer n_layer_bytes = n_parity_blocks of input data.
-      For practical reasons we require that the layer size is a multiple of the
-      medium sector size of 2048 bytes. */
+   if(chunk+ec->chunkSize < lay->sectorsPerLayer)
+        read_layers(ec, 0, lay->ndata, chunk, ec->chunkSize);
+   else read_layers(ec, 0, lay->ndata, chunk, lay->sectorsPerLayer-chunk);
+}
 
-   n_layer_bytes   = n_parity_blocks;
-   n_layer_sectors = n_parity_blocks/2048;
+/* In the fused pass, a chunk consists of as many complete layers
+   as fit into the read buffer, or of a part of a single layer.
+   Subsequent layers are adjacent in the image, so the sectors are
+   still read and summed up in image order. A chunk ends at lay->dataSectors
+   so that all data sectors have been summed up before the CRC sectors
+   are written and read back. */
 
-   if(n_layer_sectors*2048 != n_parity_blocks)
-     Stop("Internal error: parity blocks are not a multiple of sector size.\n");
+static void read_fused_chunk(ecc_closure *ec, int layer, guint64 chunk)
+{  RS02Layout *lay = ec->lay;
+   gint64 first_sec = layer*lay->sectorsPerLayer + chunk;
+   guint64 n_sectors = lay->sectorsPerLayer-chunk;
+   int n_layers = 1;
+   int i;
+   guint64 si;
 
-   ec->parity = g_try_malloc(n_parity_bytes);
-   ec->data   = g_try_malloc(n_layer_bytes);
+   if(first_sec >= lay->dataSectors && !ec->crcWritten)
+   {  memcpy(ec->image->mediumSum, Closure->crcBuf->imageMD5sum, 16);
+      write_crc(ec);
+      ec->crcWritten = TRUE;
+   }
 
-   /*** Create buffers for dividing the ecc information into nroots slices */
+   if(!chunk && lay->sectorsPerLayer <= ec->readSectors)
+   {  n_layers = ec->readSectors / lay->sectorsPerLayer;
+      if(n_layers > lay->ndata-layer)
+	n_layers = lay->ndata-layer;
+      if(first_sec < lay->dataSectors)
+      {  gint64 data_layers = (lay->dataSectors-first_sec) / lay->sectorsPerLayer;
 
-   for(i=0; i<nroots; i++)
-   {  ec->slice[i] = g_try_malloc(n_layer_bytes);
-      if(!ec->slice[i])
-	 out_of_memory = 1;
+	 if(n_layers > data_layers)
+	   n_layers = data_layers ? data_layers : 1;
+      }
    }
 
-   if(out_of_memory || !ec->parity || !ec->data)
-   {  LargeTruncate(image->file, (gint64)(2048*ec->lay->dataSectors));
-      Stop(_("Failed allocating memory for I/O cache.\n"
-	     "Cache size is currently %d MiB.\n"
-	     "Try reducing it.\n"),
-	   Closure->cacheMiB);
+   if(n_sectors > ec->readSectors)
+     n_sectors = ec->readSectors;
+   if(n_layers == 1 && first_sec < lay->dataSectors && first_sec+n_sectors > lay->dataSectors)
+     n_sectors = lay->dataSectors-first_sec;
+
+   read_layers(ec, layer, n_layers, chunk, n_sectors);
+
+   for(i=0; i<n_layers; i++)
+   {  first_sec = (layer+i)*lay->sectorsPerLayer + chunk;
+
+      for(si=0; si<n_sectors && first_sec+si<lay->dataSectors; si++)
+	scan_sector(ec, ec->ioData[i]+2048*si, first_sec+si);
    }
+}
 
-   /*** Setup the block counters for mapping medium sectors to ecc blocks 
-        The image is divided into ndata layers;
-        with each layer spanning s lay->sectorsPerLayer sectors. */
+/* Split the parity of a sector column into the nroots slices */
 
-   for(b_idx=0, i=0; i<ndata; b_idx+=lay->sectorsPerLayer, i++)
-     block_idx[i] = b_idx;
+static void split_parity(ecc_closure *ec, unsigned char *parity, guint64 si)
+{  int nroots = ec->lay->nroots;
+   int nroots_aligned = (nroots+15)&~15;
+   int i,j,k;
 
-   /*** Initialize md5 contexts for checksumming the nroots slices */
+   for(j=0, i=2048*si; j<2048; j++, i++)
+   {  for(k=0; k<nroots; k++)
+	ec->slice[k][i] = parity[k];
+      parity += nroots_aligned;
+   }
+}
 
-   for(i=0; i<nroots; i++)
-      MD5Init(&ec->md5Ctxt[i]);
+/* Write out the slices of the previous chunk and advance their md5sums.
+   The slices are equally long, so their md5sums can be advanced side by side. */
 
-   /*** Create ecc information for the protected sectors portion of the image. */ 
+static void flush_parity(ecc_closure *ec)
+{  RS02Layout *lay = ec->lay;
+   struct MD5Context *md5_ctxt[256];
+   unsigned char const *md5_buf[256];
+   guint64 si;
+   int n_vec = 0;
+   int i,k;
 
-   max_percent = ndata * ((lay->sectorsPerLayer / n_layer_sectors) + 1);
-   progress = percent = 0;
-   last_percent = -1;
-   g_timer_start(ec->timer);
+   for(k=0; k<lay->nroots; k++)
+   {  for(si=0; si<ec->flushLayerSectors; si++)
+      {  gint64 s = RS02EccSectorIndex(lay, k, ec->flushChunk + si);
+
+	 n_vec = RS02QueueRawSector(ec->ioVec, n_vec, ec->slice[k]+2048*si, s);
+      }
+      md5_ctxt[k] = &ec->md5Ctxt[k];
+      md5_buf[k]  = ec->slice[k];
+   }
+
+   if(!LargeWriteV(ec->image->file, ec->ioVec, n_vec))
+   {  for(i=0; i<n_vec; i++)
+	if(ec->ioVec[i].result != (ssize_t)ec->ioVec[i].count)
+	  Stop(_("Failed writing to sector %" PRId64 " in image: %s"),
+	       (gint64)ec->ioVec[i].offset/2048, strerror(errno));
+   }
+
+   MD5UpdateMulti(md5_ctxt, md5_buf, 2048*ec->flushLayerSectors, lay->nroots);
+}
+
+/* Hand the chunk which has just been read over to the encoders */
+
+static void dispatch_chunk(ecc_closure *ec)
+{  int nroots_aligned = (ec->lay->nroots+15)&~15;
+
+   flip_buffers(ec);
+
+   g_mutex_lock(ec->lock);
+   ec->buffersToEncode     = ec->ioLayerSectors;
+   ec->encoderLayerSectors = ec->ioLayerSectors;
+   ec->nextBufferIndex     = 0;
+   ec->encoderChunk        = ec->ioChunk;
+   ec->encoderLayer        = ec->ioLayer;
+   ec->encoderLayers       = ec->ioLayers;
+   if(ec->fusedScan)
+        ec->encoderParity  = ec->parity + 2048*nroots_aligned*ec->ioChunk;
+   else ec->encoderParity  = ec->parity;
+   ec->slicesFree          = FALSE;
+   g_cond_broadcast(ec->ioCond);
+   g_mutex_unlock(ec->lock);
+}
+
+static void wait_for_encoders(ecc_closure *ec)
+{
+   g_mutex_lock(ec->lock);
+   while(ec->buffersToEncode)
+     g_cond_wait(ec->ioCond, ec->lock);
+   g_mutex_unlock(ec->lock);
+
+   ec->flushLayerSectors = ec->encoderLayerSectors;
+   ec->flushChunk        = ec->encoderChunk;
+}
+
+static void io_thread(ecc_closure *ec)
+{  RS02Layout *lay = ec->lay;
+   guint64 chunk;
+
+   /* Preload the first chunk */
+
+   read_next_chunk(ec, 0);
 
    /* Process the image.
-      From each layer a chunk of n_layer_sectors is read in at once.
-      So after (lay->sectorsPerLayer/n_layer_sectors)+1 iterations 
+      From each layer a chunk of ec->chunkSize sectors is read in at once.
+      So after (lay->sectorsPerLayer/ec->chunkSize)+1 iterations
       the whole image has been processed. */
 
-   for(chunk=0; chunk<lay->sectorsPerLayer; chunk+=n_layer_sectors) 
-   {  guint64 actual_layer_bytes,actual_layer_sectors;
-      int sp;
+   for(chunk=ec->ioLayerSectors; chunk<lay->sectorsPerLayer; chunk+=ec->ioLayerSectors)
+   {
+      dispatch_chunk(ec);
 
-      /* Prepare the parity data for the next chunk. */
+      /* Write out parity from last run */
 
-      memset(ec->parity, 0, n_parity_bytes);
+      if(ec->flushLayerSectors)
+	flush_parity(ec);
 
-      /* The last chunk may contain fewer sectors. */
+      g_mutex_lock(ec->lock);
+      ec->slicesFree = TRUE;  /* we have saved the slices; go ahead */
+      g_cond_broadcast(ec->ioCond);
+      g_mutex_unlock(ec->lock);
 
-      if(chunk+n_layer_sectors < lay->sectorsPerLayer)
-           actual_layer_sectors = n_layer_sectors;
-      else actual_layer_sectors = lay->sectorsPerLayer-chunk;
+      /* Read the next chunk while encoders are working */
 
-      actual_layer_bytes   = 2048*actual_layer_sectors;
+      read_next_chunk(ec, chunk);
+      wait_for_encoders(ec);
+   }
 
-      /* Work each of the ndata data layers 
-	 into the parity data of the current chunk. */
+   /* Encode the last chunk */
 
-      sp = nroots - ndata % nroots;  /* => (ndata + sp) mod nroots = 0 so that parity */
-	                             /* is aligned at sp=0 after ndata iterations */
-      if(sp==nroots) sp=0;
+   dispatch_chunk(ec);
+   if(ec->flushLayerSectors)
+     flush_parity(ec);
 
-      for(layer=0; layer<ndata; layer++)
-      {  int offset = 0;
-         unsigned char *par_idx = ec->parity;
+   g_mutex_lock(ec->lock);
+   ec->slicesFree = TRUE;
+   g_cond_broadcast(ec->ioCond);
+   g_mutex_unlock(ec->lock);
 
-	 if(Closure->stopActions) /* User hit the Stop button */
-	   abort_encoding(ec, TRUE);
+   wait_for_encoders(ec);
+   flush_parity(ec);
+}
 
-         /* Read the next data sectors of this layer. */
+static void fused_io_thread(ecc_closure *ec)
+{  RS02Layout *lay = ec->lay;
+   int nroots_aligned = (lay->nroots+15)&~15;
+   int layer = 0;
+   guint64 chunk = 0;
 
-   	 for(si=0; si<actual_layer_sectors; si++)
-	 {  RS02ReadSector(image, lay, ec->data+offset, block_idx[layer]);
-	    block_idx[layer]++;
-	    offset += 2048;
-	 }
+   /* Preload the first chunk */
 
-	 /* Now process the data bytes of the current layer. */
-
-	 for(si=0; si<actual_layer_bytes; si++)
-	 {  register int feedback;
-
-	    feedback = gf_index_of[ec->data[si] ^ par_idx[sp]];
-
-	    if(feedback != GF_ALPHA0) /* non-zero feedback term */
-	    {  register int spk = sp+1;
-	       register int *gpoly = rs_gpoly + nroots;
-
-	       switch(nroots-spk)  /* unrolled loop part1 */
-	       {  
-	          case 170: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-	          case 169: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-	          case 168: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 167: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 166: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 165: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 164: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 163: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 162: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 161: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-	          case 160: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-	          case 159: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-	          case 158: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 157: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 156: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 155: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 154: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 153: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 152: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 151: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-	          case 150: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-	          case 149: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-	          case 148: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 147: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 146: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 145: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 144: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 143: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 142: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 141: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-	          case 140: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-	          case 139: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-	          case 138: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 137: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 136: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 135: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 134: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 133: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 132: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 131: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-	          case 130: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-	          case 129: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-	          case 128: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 127: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 126: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 125: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 124: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 123: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 122: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 121: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-	          case 120: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-	          case 119: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-	          case 118: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 117: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 116: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 115: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 114: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 113: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 112: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 111: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-	          case 110: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-	          case 109: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-	          case 108: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 107: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 106: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 105: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 104: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 103: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 102: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 101: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 100: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 99: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 98: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 97: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 96: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 95: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 94: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 93: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 92: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 91: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 90: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 89: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 88: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 87: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 86: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 85: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 84: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 83: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 82: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 81: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 80: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 79: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 78: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 77: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 76: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 75: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 74: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 73: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 72: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 71: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 70: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 69: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 68: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 67: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 66: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 65: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 64: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 63: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 62: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 61: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 60: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 59: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 58: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 57: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 56: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 55: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 54: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 53: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 52: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 51: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 50: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 49: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 48: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 47: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 46: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 45: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 44: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 43: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 42: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 41: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 40: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 39: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 38: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 37: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 36: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 35: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 34: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 33: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 32: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 31: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 30: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 29: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 28: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 27: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 26: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 25: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 24: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 23: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 22: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 21: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 20: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 19: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 18: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 17: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 16: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 15: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 14: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 13: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 12: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 11: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 10: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case  9: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case  8: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case  7: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case  6: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case  5: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case  4: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case  3: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case  2: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case  1: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-	       }
-
-	       spk = 0;
-		  
-	       switch(sp)  /* unrolled loop part2 */
-	       {
-	          case 170: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-	          case 169: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-	          case 168: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 167: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 166: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 165: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 164: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 163: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 162: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 161: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-	          case 160: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-	          case 159: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-	          case 158: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 157: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 156: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 155: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 154: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 153: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 152: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 151: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-	          case 150: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-	          case 149: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-	          case 148: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 147: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 146: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 145: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 144: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 143: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 142: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 141: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-	          case 140: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-	          case 139: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-	          case 138: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 137: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 136: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 135: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 134: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 133: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 132: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 131: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-	          case 130: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-	          case 129: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-	          case 128: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 127: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 126: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 125: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 124: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 123: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 122: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 121: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-	          case 120: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-	          case 119: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-	          case 118: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 117: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 116: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 115: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 114: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 113: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 112: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 111: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-                  case 110: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 109: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 108: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 107: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 106: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 105: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 104: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 103: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 102: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 101: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		  case 100: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 99: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 98: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 97: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 96: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 95: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 94: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 93: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 92: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 91: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 90: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 89: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 88: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 87: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 86: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 85: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 84: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 83: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 82: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 81: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 80: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 79: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 78: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 77: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 76: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 75: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 74: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 73: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 72: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 71: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 70: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 69: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 68: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 67: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 66: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 65: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 64: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 63: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 62: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 61: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 60: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 59: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 58: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 57: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 56: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 55: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 54: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 53: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 52: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 51: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 50: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 49: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 48: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 47: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 46: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 45: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 44: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 43: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 42: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 41: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 40: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 39: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 38: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 37: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 36: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 35: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 34: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 33: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 32: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 31: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 30: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 29: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 28: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 27: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 26: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 25: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 24: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 23: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 22: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 21: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 20: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 19: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 18: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 17: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 16: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 15: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 14: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 13: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 12: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 11: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case 10: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case  9: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case  8: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case  7: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case  6: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case  5: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case  4: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case  3: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case  2: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-		   case  1: par_idx[spk++] ^= enc_alpha_to[feedback + *--gpoly];
-	       }
-
-	       par_idx[sp] = enc_alpha_to[feedback + rs_gpoly[0]];
-	    }
-	    else                   /* zero feedback term */
-	      par_idx[sp] = 0;
+   read_fused_chunk(ec, 0, 0);
 
-	    par_idx += nroots;
-	 }
+   /* Process the layers in image order. A chunk must not be encoded
+      before the same sectors of the previous layer have been worked
+      into the parity, so the encoders are waited for after each chunk. */
 
-	 if(++sp>=nroots) sp=0;   /* shift */
+   for(;;)
+   {  chunk += ec->ioLayerSectors;
+      if(chunk >= lay->sectorsPerLayer)
+      {  chunk = 0;
+	 layer += ec->ioLayers;
+      }
 
-	 /* Report progress */
+      dispatch_chunk(ec);
+      if(layer >= lay->ndata)
+	break;
 
-	 progress++;
-	 percent = (1000*progress)/max_percent;
-	 if(last_percent != percent) 
-	 {  GuiSetProgress(ec->wl->encPBar2, percent, 1000);
-	    PrintProgress(_("Ecc generation: %3d.%1d%%"), percent/10, percent%10);
-	    last_percent = percent;
-	 }
+      read_fused_chunk(ec, layer, chunk);
+      wait_for_encoders(ec);
+   }
+
+   wait_for_encoders(ec);
+
+   /* Now split up the parity and write it out */
+
+   for(chunk=0; chunk<lay->sectorsPerLayer; chunk+=ec->flushLayerSectors)
+   {  guint64 si;
+
+      ec->flushChunk = chunk;
+      if(chunk+ec->chunkSize < lay->sectorsPerLayer)
+           ec->flushLayerSectors = ec->chunkSize;
+      else ec->flushLayerSectors = lay->sectorsPerLayer-chunk;
+
+      for(si=0; si<ec->flushLayerSectors; si++)
+	split_parity(ec, ec->parity + 2048*nroots_aligned*(chunk+si), si);
+
+      flush_parity(ec);
+   }
+}
+
+static gpointer encoder_thread(ecc_closure *ec)
+{  ReedSolomonTables *rt = ec->rt;
+   int nroots = ec->lay->nroots;
+   int ndata  = ec->lay->ndata;
+   int nroots_aligned = (nroots+15)&~15;
+   int percent;
+   int i;
+
+   for(;;)
+   {  unsigned char *parity;
+      int layer_offset;
+      int layer;
+
+      g_mutex_lock(ec->lock);
+      while(   ec->sectorsToEncode
+	    && !ec->abortImmediately
+	    && ec->nextBufferIndex >= ec->encoderLayerSectors)
+ 	 g_cond_wait(ec->ioCond, ec->lock);
+
+      /* Termination criterion */
+
+      if(!ec->sectorsToEncode || ec->abortImmediately)
+      {  g_mutex_unlock(ec->lock);
+	 return NULL;
       }
+      layer_offset = ec->nextBufferIndex++;
+      g_mutex_unlock(ec->lock);
 
-      /* The parity bytes have been prepared as sequences of nroots bytes for each 
-	 ecc block. Now we split them up into nroots slices and write them out. */
+      /* Work the data layers of the chunk into the parity data
+	 of the current sector column. The shift register state
+	 at the start of layer i is (shiftInit+i) mod nroots. */
 
-      par_ptr = ec->parity;
+      parity = ec->encoderParity + 2048*nroots_aligned*layer_offset;
+      if(!ec->encoderLayer)
+	memset(parity, 0, 2048*nroots_aligned);
 
-      for(si=0; si<actual_layer_sectors; si++)
-      {  guint64 idx = 2048*si;
+      for(i=0; i<ec->encoderLayers; i++)
+      {  layer = ec->encoderLayer+i;
+	 EncodeNextLayer(rt, ec->encoderData[i] + 2048*layer_offset,
+			 parity, 2048, (rt->shiftInit+layer) % nroots);
+      }
 
-	 for(j=0; j<2048; j++, idx++)
-	 {  for(k=0; k<nroots; k++)
-	      ec->slice[k][idx] = *par_ptr++;
-	 }
+      /* The parity bytes have been prepared as sequences of nroots bytes
+	 for each ecc block. Now we split them up into nroots slices
+	 as soon as the IO thread has written out the previous ones.
+	 In the fused pass, this is done by the IO thread at the end. */
+
+      if(!ec->fusedScan)
+      {  g_mutex_lock(ec->lock);
+	 while(!ec->slicesFree && !ec->abortImmediately)
+	   g_cond_wait(ec->ioCond, ec->lock);
+	 g_mutex_unlock(ec->lock);
+
+	 if(ec->abortImmediately)
+	   return NULL;
+
+	 split_parity(ec, parity, layer_offset);
       }
 
-      for(k=0; k<nroots; k++)
-      {  int idx=0;
+      /* Report progress and finish processing of this column */
 
-	for(si=0; si<actual_layer_sectors; si++, idx+=2048)
-	 {  gint64 s = RS02EccSectorIndex(lay, k, chunk + si);
+      g_mutex_lock(ec->lock);
+      ec->progress += ec->encoderLayers;
+      percent = (1000*ec->progress)/(ndata*ec->lay->sectorsPerLayer);
+      if(ec->lastPercent != percent)
+      {  ec->lastPercent = percent;
+	 GuiSetProgress(ec->wl->encPBar2, percent, 1000);
+	 PrintProgress(_("Ecc generation: %3d.%1d%%"), percent/10, percent%10);
+      }
 
-	    if(!LargeSeek(image->file, 2048*s))
-	      Stop(_("Failed seeking to sector %" PRId64 " in image: %s"), s, strerror(errno));
+      ec->sectorsToEncode -= ec->encoderLayers;
+      if(!--ec->buffersToEncode)
+	g_cond_broadcast(ec->ioCond);
+      g_mutex_unlock(ec->lock);
+   }
+}
 
-	    if(LargeWrite(image->file, ec->slice[k]+idx, 2048) != 2048)
-	      Stop(_("Failed writing to sector %" PRId64 " in image: %s"), s, strerror(errno));
+static void create_reed_solomon(ecc_closure *ec)
+{  RS02Layout *lay = ec->lay;
+   Image *image = ec->image;
+   int nroots = lay->nroots;
+   int ndata  = lay->ndata;
+   int nroots_aligned = (nroots+15)&~15; /* 128bit alignment */
+   guint64 n_parity_bytes;
+   int out_of_memory = 0;
+   int i;
 
-	    MD5Update(&ec->md5Ctxt[k], ec->slice[k]+idx, 2048);
-	}
+   /*** Show the second progress bar */
+
+   GuiShowWidget(ec->wl->encPBar2);
+   GuiShowWidget(ec->wl->encLabel2);
+
+   /*** Adjust image bounds to include the CRC sectors */
+
+   image->sectorSize = lay->protectedSectors;
+
+   /*** Create table for Galois field math */
+
+   ec->gt = CreateGaloisTables(RS_GENERATOR_POLY);
+   ec->rt = CreateReedSolomonTables(ec->gt, RS_FIRST_ROOT, RS_PRIM_ELEM, nroots);
+
+   /*** Allocate buffers for the parity calculation and image data caching.
+
+        The algorithm builds the parity consecutively in chunks of ec->chunkSize
+	ecc blocks. Each chunk is built iteratively by processing the data in layers
+	(first all bytes at pos 0, then pos 1, until ndata layers have been processed).
+	All ndata layers of a chunk are buffered twice (one set is read in while
+	the other one is encoded), plus the parity and its nroots slices.
+        We use all the amount of memory allowed by cacheMiB for these buffers.
+
+	In the fused pass the parity of the whole image is kept in memory,
+	and the remaining cache is used for the two sets of read buffers.
+	A parity larger than the cache leaves the whole cache to them. */
+
+   ec->chunkSize = ((guint64)Closure->cacheMiB<<20) / (2048*(guint64)(2*ndata+nroots_aligned+nroots));
+   if(ec->chunkSize < 1)
+     ec->chunkSize = 1;
+   if(ec->chunkSize > lay->sectorsPerLayer)
+     ec->chunkSize = lay->sectorsPerLayer;
+
+   if(ec->fusedScan)
+   {  n_parity_bytes = 2048*(guint64)nroots_aligned*lay->sectorsPerLayer;
+      if(n_parity_bytes < (guint64)Closure->cacheMiB<<20)
+	   ec->readSectors = (((guint64)Closure->cacheMiB<<20) - n_parity_bytes) / (2*2048);
+      else ec->readSectors = ((guint64)Closure->cacheMiB<<20) / (2*2048);
+      if(ec->readSectors < 64)
+	ec->readSectors = 64;
+      if(ec->readSectors > ndata*lay->sectorsPerLayer)
+	ec->readSectors = ndata*lay->sectorsPerLayer;
+   }
+   else n_parity_bytes = 2048*(guint64)nroots_aligned*ec->chunkSize;
+
+   ec->paritybase = g_try_malloc(n_parity_bytes+16);
+   if(ec->paritybase)
+     ec->parity = ec->paritybase + (16 - ((intptr_t)ec->paritybase & 15));
+
+   /* Data and slices are aligned so that they can be used with O_DIRECT */
+
+   ec->ioData          = g_malloc0(256*sizeof(unsigned char*));
+   ec->encoderData     = g_malloc0(256*sizeof(unsigned char*));
+   ec->ioBuf           = g_malloc0(256*sizeof(unsigned char*));
+   ec->encoderBuf      = g_malloc0(256*sizeof(unsigned char*));
+   ec->ioMmapBase      = g_malloc0(256*sizeof(unsigned char*));
+   ec->encoderMmapBase = g_malloc0(256*sizeof(unsigned char*));
+   ec->ioMmapSize      = g_malloc0(256*sizeof(guint64));
+   ec->encoderMmapSize = g_malloc0(256*sizeof(guint64));
+
+   for(i=0; i<(ec->fusedScan ? 1 : ndata); i++)
+   {  guint64 size = 2048*(ec->fusedScan ? ec->readSectors : ec->chunkSize);
+
+      ec->dataAligned[i]   = TryCreateAlignedBuffer(size);
+      ec->dataAligned[i+256] = TryCreateAlignedBuffer(size);
+      if(!ec->dataAligned[i] || !ec->dataAligned[i+256])
+      {  out_of_memory = 1;
+	 break;
       }
+      ec->ioBuf[i]      = ec->dataAligned[i]->buf;
+      ec->encoderBuf[i] = ec->dataAligned[i+256]->buf;
    }
 
+   /* The read buffers of the fused pass may hold several complete layers */
+
+   if(ec->fusedScan && !out_of_memory)
+   {  for(i=1; i<ndata && (i+1)*lay->sectorsPerLayer <= ec->readSectors; i++)
+      {  ec->ioBuf[i]      = ec->ioBuf[0]      + 2048*i*lay->sectorsPerLayer;
+	 ec->encoderBuf[i] = ec->encoderBuf[0] + 2048*i*lay->sectorsPerLayer;
+      }
+   }
+
+   /*** Create buffers for dividing the ecc information into nroots slices */
+
+   for(i=0; i<nroots && !out_of_memory; i++)
+   {  ec->sliceAligned[i] = TryCreateAlignedBuffer(2048*ec->chunkSize);
+      if(!ec->sliceAligned[i])
+	 out_of_memory = 1;
+      else ec->slice[i] = ec->sliceAligned[i]->buf;
+   }
+
+   ec->ioVec = g_try_malloc(MAX(GF_FIELDMAX*ec->chunkSize, ec->readSectors)*sizeof(LargeIOVec));
+
+   if(out_of_memory || !ec->paritybase || !ec->ioVec)
+   {  LargeTruncate(image->file, (gint64)(2048*ec->lay->dataSectors));
+      Stop(_("Failed allocating memory for I/O cache.\n"
+	     "Cache size is currently %d MiB.\n"
+	     "Try reducing it.\n"),
+	   Closure->cacheMiB);
+   }
+
+#ifdef SYS_MINGW
+   {
+      SYSTEM_INFO si;
+      GetSystemInfo(&si);
+      ec->pageSize = si.dwPageSize;
+   }
+#else
+   ec->pageSize = sysconf(_SC_PAGE_SIZE);
+#endif
+
+   if(Closure->encodingIOStrategy == IO_STRATEGY_DIRECT)
+     LargeEnableDirectIO(image->file);
+
+   /*** Initialize md5 contexts for checksumming the nroots slices */
+
+   for(i=0; i<nroots; i++)
+     MD5Init(&ec->md5Ctxt[i]);
+
+   /*** Spawn the RS encoder threads */
+
+   ec->lock   = g_malloc(sizeof(GMutex)); g_mutex_init(ec->lock);
+   ec->ioCond = g_malloc(sizeof(GCond));  g_cond_init(ec->ioCond);
+   ec->sectorsToEncode = ndata*lay->sectorsPerLayer;
+   ec->lastPercent = -1;
+
+   g_timer_start(ec->timer);
+
+   g_mutex_lock(ec->lock);  /* ec->thread[i] = ... may produce race condition */
+   for(i=0; i<Closure->codecThreads; i++)
+   {  GError *err = NULL;
+
+      ec->thread[i] = g_thread_try_new("encoder", (GThreadFunc)encoder_thread, (gpointer)ec, &err);
+      if(!ec->thread[i])
+      {  g_mutex_unlock(ec->lock);
+         Stop("Could not create encoder thread: %s", err->message);
+      }
+      ec->nThreads++;
+   }
+   g_mutex_unlock(ec->lock);
+
+   /*** Now we actually become being the IO thread */
+
+   if(ec->fusedScan)
+        fused_io_thread(ec);
+   else io_thread(ec);
+
+   /*** Wait for workers to finish */
+
+   for(i=0; i<ec->nThreads; i++)
+     g_thread_join(ec->thread[i]);
+   ec->nThreads = 0;
+
    /*** We can store only one md5sum in the header,
 	so lets produce a meta-checksum from all nroots md5sums */
 
@@ -1108,9 +1293,11 @@ void RS02Create(void)
 
    expand_image(ec);
 
-   /*** Distribute and write the CRC sums */
+   /*** Distribute and write the CRC sums.
+	In the fused pass this happens while encoding. */
 
-   write_crc(ec);
+   if(!ec->fusedScan)
+     write_crc(ec);
 
    /*** Create the Reed-Solomon parts of the ecc section */
 
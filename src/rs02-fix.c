@@ -25,7 +25,6 @@
 #include "dvdisaster.h"
 
 #include "rs02-includes.h"
-#include "galois-inlines.h"
 
 /***
  *** Internal housekeeping
@@ -38,9 +37,12 @@ typedef struct
    RS02Layout *lay;
    GaloisTables *gt;
    ReedSolomonTables *rt;
+   RSDecoder *decoder;
    int earlyTermination;
    char *msg;
    unsigned char *imgBlock[255];
+   LargeIOVec *ioVec;    /* read requests for one cache fill */
+   Bitmap *needed;       /* ecc blocks to process (--damage-map only) */
 } fix_closure;
 
 static void fix_cleanup(gpointer data)
@@ -67,10 +69,13 @@ static void fix_cleanup(gpointer data)
 	 g_free(fc->imgBlock[i]); 
    }
 
+   if(fc->ioVec) g_free(fc->ioVec);
+   if(fc->needed) FreeBitmap(fc->needed);
    if(fc->lay) g_free(fc->lay);
 
    if(fc->gt) FreeGaloisTables(fc->gt);
    if(fc->rt) FreeReedSolomonTables(fc->rt);
+   if(fc->decoder) FreeRSDecoder(fc->decoder);
 
    g_free(fc);
 
@@ -119,6 +124,51 @@ static void expand_image(fix_closure *fc, gint64 new_size)
    image->file->size = new_size;
 }
 
+/*
+ * Find the ecc blocks containing the sectors from the damage map.
+ * Returns NULL if the map can not be used for this image.
+ */
+
+static Bitmap *damaged_blocks(fix_closure *fc, gint64 expected_sectors)
+{  RS02Layout *lay = fc->lay;
+   DamageMap *dm;
+   Bitmap *needed;
+   gint64 s,damaged = 0;
+   int blocks = 0;
+
+   dm = LoadDamageMap(fc->image, Closure->damageMapFile);
+   if(!dm)
+   {  PrintLog(_("Processing all ecc blocks.\n"));
+      return NULL;
+   }
+
+   needed = CreateBitmap0(lay->sectorsPerLayer);
+
+   for(s=0; s<expected_sectors; s++)
+   {  gint64 slice,n;
+
+      if(!SectorIsDamaged(dm, s))
+	continue;
+
+      damaged++;
+      RS02SliceIndex(lay, s, &slice, &n);
+      if(slice < 0)        /* ecc headers are not part of an ecc block */
+	continue;
+
+      if(!GetBit(needed, n))
+      {  SetBit(needed, n);
+	 blocks++;
+      }
+   }
+
+   FreeDamageMap(dm);
+
+   PrintLog(_("Damage map: %" PRId64 " damaged sectors in %d of %" PRId64 " ecc blocks.\n"),
+	    damaged, blocks, lay->sectorsPerLayer);
+
+   return needed;
+}
+
 /***
  *** Test and fix the current image.
  ***/
@@ -132,8 +182,6 @@ void RS02Fix(Image *image)
 #ifdef HAVE_BIG_ENDIAN
    EccHeader *eh_swapped;
 #endif
-   gint32 *gf_index_of;
-   gint32 *gf_alpha_to;
    gint64 block_idx[255];
    gint64 s;
    guint32 crc_buf[512];
@@ -141,7 +189,9 @@ void RS02Fix(Image *image)
    int nroots,ndata;
    int crc_idx, ecc_idx;
    int crc_valid = TRUE;
+   int crc_verified;
    int cache_size, cache_sector, cache_offset;
+   int n_vec;
    int erasure_count,erasure_list[255],erasure_map[255];
    int error_count;
    int percent, last_percent;
@@ -157,6 +207,7 @@ void RS02Fix(Image *image)
    gint64 uncorrected=0;
    gint64 damaged_sectors=0;
    gint64 damaged_eccblocks=0;
+   gint64 skipped_eccblocks=0;
    gint64 damaged_eccsecs=0;
    gint64 expected_sectors;
    char *t=NULL;
@@ -184,8 +235,7 @@ void RS02Fix(Image *image)
 
    fc->gt      = CreateGaloisTables(RS_GENERATOR_POLY);
    fc->rt      = CreateReedSolomonTables(fc->gt, RS_FIRST_ROOT, RS_PRIM_ELEM, nroots);
-   gf_index_of = fc->gt->indexOf;
-   gf_alpha_to = fc->gt->alphaTo;
+   fc->decoder = CreateRSDecoder(fc->rt);
 
    /*** Expand a truncated image with "dead sector" markers */
 
@@ -302,6 +352,7 @@ void RS02Fix(Image *image)
 
    for(i=0; i<255; i++)
       fc->imgBlock[i] = g_malloc(cache_size*2048);
+   fc->ioVec = g_malloc(255*cache_size*sizeof(LargeIOVec));
 
    /*** Setup the block counters for mapping medium sectors to ecc blocks.
         Error correction begins at lay->CrcLayerIndex so that we have a chance
@@ -322,6 +373,12 @@ void RS02Fix(Image *image)
    crc_idx = 0;
    memcpy(crc_buf, (char*)eh + 2048, sizeof(guint32) * lay->ndata);
 
+   /*** With a damage map, only the ecc blocks containing 
+	damaged sectors need to be processed. */
+
+   if(Closure->damageMapFile)
+     fc->needed = damaged_blocks(fc, expected_sectors);
+
    /*** Test ecc blocks and attempt error correction */
 
    last_percent = -1;
@@ -357,6 +414,19 @@ void RS02Fix(Image *image)
      if(s == 1) /* force CRC reload */
        crc_idx = 512;
 
+     /* Skip ecc blocks without damaged sectors. The cache pointers
+	are advanced at the end of the loop; the CRC pointer must
+	also move past the data sectors of this ecc block. */
+
+     if(fc->needed && !GetBit(fc->needed, si))
+     {  for(i=0; i<lay->ndata; i++)
+	  if(block_idx[i] < lay->dataSectors)
+	    crc_idx++;
+
+	erasure_count = 0;
+	goto skip;
+     }
+
      /* Fill cache with the next batch of cache_size ecc blocks. */
 
      if(cache_sector >= cache_size)
@@ -364,10 +434,14 @@ void RS02Fix(Image *image)
         if(lay->sectorsPerLayer-si < cache_size)
            cache_size = lay->sectorsPerLayer-si;
 
-        for(i=0; i<ndata; i++)       /* Read data portion */
+        /* Queue up the data and ecc portions and read them in one go */
+
+        n_vec = 0;
+        for(i=0; i<ndata; i++)       /* data portion */
         {  int offset = 0;
 	   for(j=0; j<cache_size; j++) 
-	   {  RS02ReadSector(image, lay, fc->imgBlock[i]+offset, block_idx[i]+j);
+	   {  n_vec = RS02QueueSector(image, lay, fc->ioVec, n_vec,
+				      fc->imgBlock[i]+offset, block_idx[i]+j);
 	      offset += 2048;
 	   }
 	}
@@ -377,22 +451,21 @@ void RS02Fix(Image *image)
 	   for(j=0; j<cache_size; j++) 
 	   {  gint64 esi = RS02EccSectorIndex(lay, i, ecc_idx+j);
 
-	      if(!LargeSeek(image->file, 2048*esi))
-		Stop(_("Failed seeking to sector %" PRId64 " in image: %s"), esi, strerror(errno));
-
-	      if(LargeRead(image->file, fc->imgBlock[i+ndata]+offset, 2048) != 2048)
-		Stop(_("Failed reading sector %" PRId64 " in image: %s"), esi, strerror(errno));
-
+	      n_vec = RS02QueueRawSector(fc->ioVec, n_vec,
+					 fc->imgBlock[i+ndata]+offset, esi);
 	      offset += 2048;
 	   }
 	}
 
+	RS02ReadQueuedSectors(image, fc->ioVec, n_vec);
+
         cache_sector = cache_offset = 0;
      }
 
      /* Look for erasures based on the "dead sector" marker and CRC sums */
 
      erasure_count = error_count = 0;
+     crc_verified = TRUE;
 
      for(i=0; i<lay->ndata; i++)  /* Check the data sectors */
      {  
@@ -411,7 +484,10 @@ void RS02Fix(Image *image)
 	     int err;
 
 	     if(crc_idx >= 512)
-	     {  if(!LargeSeek(image->file, crc_sector_byte))
+	     {  crc_sector_byte += 2048*(crc_idx/512 - 1);  /* CRCs of skipped ecc blocks */
+		crc_idx %= 512;
+
+		if(!LargeSeek(image->file, crc_sector_byte))
 		  Stop(_("Failed seeking in crc area: %s"), strerror(errno));
 	
 		if(LargeRead(image->file, crc_buf, 2048) != 2048)
@@ -421,7 +497,6 @@ void RS02Fix(Image *image)
 					    eh->mediumFP, eh->fpSector);
 
 		crc_sector_byte += 2048;
-		crc_idx = 0;
 		crc_valid = (err == SECTOR_PRESENT);
 	     }
 
@@ -433,10 +508,14 @@ void RS02Fix(Image *image)
 		crc_errors++;
 	     }
 
+	     if(!crc_valid) crc_verified = FALSE;
 	     data_count++;
 	     crc_idx++;
           }
-	  else if(block_idx[i] >= lay->dataSectors + 2) crc_count++;
+	  else
+	  {  crc_verified = FALSE;  /* ecc header and CRC sectors */
+	     if(block_idx[i] >= lay->dataSectors + 2) crc_count++;
+	  }
 	}
      }
 
@@ -476,150 +555,43 @@ void RS02Fix(Image *image)
 	goto skip;
      }
 
-     /* Build ecc block and attempt to correct it */
+     /* Unless being paranoid, skip the ecc block if all of its data
+	sectors are present and match their CRC. Only byte errors in
+	the ecc sectors could go unnoticed that way. Blocks containing
+	ecc header or CRC sectors are always decoded so that the CRC
+	information is repaired before we need it. */
 
-     for(bi=0; bi<2048; bi++)  /* Run through each ecc block byte */
-     {  int offset = cache_offset+bi;
-        int r, deg_lambda, el, deg_omega;
-	int u,q,tmp,num1,num2,den,discr_r;
-	int lambda[nroots+1], syn[nroots]; /* Err+Eras Locator poly * and syndrome poly */
-	int b[nroots+1], t[nroots+1], omega[nroots+1];
-	int root[nroots], reg[nroots+1], loc[nroots];
-	int syn_error, count;
-	int k;
-
-	/* Form the syndromes; i.e., evaluate data(x) at roots of g(x) */
+     if(!erasure_count && crc_verified && !Closure->paranoidFix)
+     {  skipped_eccblocks++;
+	goto skip;
+     }
 
-	for(i=0; i<nroots; i++)
-	  syn[i] = fc->imgBlock[0][offset];
+     /* Build ecc block and attempt to correct it */
 
-	for(j=1; j<GF_FIELDMAX; j++)
-	{  int data = fc->imgBlock[j][offset];
+     SetRSDecoderErasures(fc->decoder, erasure_list, erasure_count);
 
-	   for(i=0;i<nroots;i++)
-	   {  if(syn[i] == 0) syn[i] = data;
-	      else syn[i] = data ^ gf_alpha_to[mod_fieldmax(gf_index_of[syn[i]] + (RS_FIRST_ROOT+i)*RS_PRIM_ELEM)];
-	   }
-	}
+     /* Form the syndromes for all 2048 ecc block bytes at once and
+	solve the erasure columns with the cached erasure matrix */
 
-	/* Convert syndromes to index form, check for nonzero condition */
+     RSDecodeBlock(fc->decoder, fc->imgBlock, cache_offset);
 
-	syn_error = 0;
-	for(i=0; i<nroots; i++)
-	{  syn_error |= syn[i];
-	   syn[i] = gf_index_of[syn[i]];
-	}
+     for(bi=0; bi<2048; bi++)  /* Run through each ecc block byte */
+     {  int offset = cache_offset+bi;
+	int location[nroots], error[nroots];
+	int count;
 
 	/* If it is already correct by coincidence, we have nothing to do any further */
 
-	if(syn_error) damaged_eccblocks++; 
+	if(fc->decoder->nonzero[bi/SYNDROME_COLUMNS] & (1U<<(bi%SYNDROME_COLUMNS))) damaged_eccblocks++; 
 	else continue;
 
-//printf("Syndrome error for ecc block %" PRId64 ", byte %d\n",s,bi);
-
-	/* If we have found any erasures, 
-	   initialize lambda to be the erasure locator polynomial */
-
-	memset(lambda+1, 0, nroots*sizeof(lambda[0]));
-	lambda[0] = 1;
-
-	if(erasure_count > 0)
-	{  lambda[1] = gf_alpha_to[mod_fieldmax(RS_PRIM_ELEM*(GF_FIELDMAX-1-erasure_list[0]))];
-	   for(i=1; i<erasure_count; i++) 
-	   {  u = mod_fieldmax(RS_PRIM_ELEM*(GF_FIELDMAX-1-erasure_list[i]));
-	      for(j=i+1; j>0; j--) 
-	      {  tmp = gf_index_of[lambda[j-1]];
-	         if(tmp != GF_ALPHA0)
-		   lambda[j] ^= gf_alpha_to[mod_fieldmax(u + tmp)];
-	      }
-	   }
-	}	
-
-	for(i=0; i<nroots+1; i++)
-	  b[i] = gf_index_of[lambda[i]];
-  
-	/* Begin Berlekamp-Massey algorithm to determine error+erasure locator polynomial */
-
-	r = erasure_count;   /* r is the step number */
-	el = erasure_count;
-	while(++r <= nroots) /* Compute discrepancy at the r-th step in poly-form */
-	{  
-	  discr_r = 0;
-	  for(i=0; i<r; i++)
-	    if((lambda[i] != 0) && (syn[r-i-1] != GF_ALPHA0))
-	      discr_r ^= gf_alpha_to[mod_fieldmax(gf_index_of[lambda[i]] + syn[r-i-1])];
-
-	  discr_r = gf_index_of[discr_r];	/* Index form */
-
-	  if(discr_r == GF_ALPHA0) 
-	  {  /* B(x) = x*B(x) */
-	    memmove(b+1, b, nroots*sizeof(b[0]));
-	    b[0] = GF_ALPHA0;
-	  } 
-	  else 
-	  {  /* T(x) = lambda(x) - discr_r*x*b(x) */
-	     t[0] = lambda[0];
-	     for(i=0; i<nroots; i++) 
-	     {  if(b[i] != GF_ALPHA0)
-		     t[i+1] = lambda[i+1] ^ gf_alpha_to[mod_fieldmax(discr_r + b[i])];
-	        else t[i+1] = lambda[i+1];
-	     }
-
-	     if(2*el <= r+erasure_count-1) 
-	     {  el = r + erasure_count - el;
-
-	        /* B(x) <-- inv(discr_r) * lambda(x) */
-	        for(i=0; i<=nroots; i++)
-		  b[i] = (lambda[i] == 0) ? GF_ALPHA0 : mod_fieldmax(gf_index_of[lambda[i]] - discr_r + GF_FIELDMAX);
-	     } 
-	     else 
-	     {  /* 2 lines below: B(x) <-- x*B(x) */
-	        memmove(b+1, b, nroots*sizeof(b[0]));
-		b[0] = GF_ALPHA0;
-	     }
-
-	     memcpy(lambda,t,(nroots+1)*sizeof(t[0]));
-	  }
-	}
-
-	/* Convert lambda to index form and compute deg(lambda(x)) */
-	deg_lambda = 0;
-	for(i=0; i<nroots+1; i++)
-	{  lambda[i] = gf_index_of[lambda[i]];
-	   if(lambda[i] != GF_ALPHA0)
-	     deg_lambda = i;
-	}
-
-	/* Find roots of the error+erasure locator polynomial by Chien search */
-	memcpy(reg+1, lambda+1, nroots*sizeof(reg[0]));
-	count = 0;		/* Number of roots of lambda(x) */
-
-	for(i=1, k=RS_PRIMTH_ROOT-1; i<=GF_FIELDMAX; i++, k=mod_fieldmax(k+RS_PRIMTH_ROOT))
-	{  q=1; /* lambda[0] is always 0 */
-
-	   for(j=deg_lambda; j>0; j--)
-	   {  if(reg[j] != GF_ALPHA0) 
-	      {  reg[j] = mod_fieldmax(reg[j] + j);
-		 q ^= gf_alpha_to[reg[j]];
-	      }
-	   }
-
-	   if(q != 0) continue; /* Not a root */
-
-	   /* store root (index-form) and error location number */
-
-	   root[count] = i;
-	   loc[count] = k;
-
-	   /* If we've already found max possible roots, abort the search to save time */
-
-	   if(++count == deg_lambda) break;
-	}
+	count = RSDecodeBlockColumn(fc->decoder, bi, location, error);
 
 	/* deg(lambda) unequal to number of roots => uncorrectable error detected */
 
-	if(deg_lambda != count)
-	{  PrintLog("Decoder problem (%d != %d) for %d sectors: ", deg_lambda, count, erasure_count);
+	if(count < 0)
+	{  PrintLog("Decoder problem (%d != %d) for %d sectors: ", 
+		    fc->decoder->degLambda, fc->decoder->rootCount, erasure_count);
 
 	   for(i=0; i<erasure_count; i++)
 	   {  gint64 loc = erasure_list[i];
@@ -632,78 +604,39 @@ void RS02Fix(Image *image)
 	   goto skip;
 	}
 
-	/* Compute err+eras evaluator poly omega(x) = syn(x)*lambda(x) 
-	   (modulo x**nroots). in index form. Also find deg(omega). */
-
-	deg_omega = deg_lambda-1;
-
-	for(i=0; i<=deg_omega; i++)
-	{  tmp = 0;
-	   for(j=i; j>=0; j--)
-	   {  if((syn[i - j] != GF_ALPHA0) && (lambda[j] != GF_ALPHA0))
-	        tmp ^= gf_alpha_to[mod_fieldmax(syn[i - j] + lambda[j])];
-	   }
-
-	   omega[i] = gf_index_of[tmp];
-	}
-
-	/* Compute error values in poly-form. 
-	   num1 = omega(inv(X(l))), 
-	   num2 = inv(X(l))**(FIRST_ROOT-1) and 
-	   den  = lambda_pr(inv(X(l))) all in poly-form. */
-
-	for(j=count-1; j>=0; j--)
-	{  num1 = 0;
-
-	   for(i=deg_omega; i>=0; i--) 
-	   {  if(omega[i] != GF_ALPHA0)
-	         num1 ^= gf_alpha_to[mod_fieldmax(omega[i] + i * root[j])];
-	   }
-
-	   num2 = gf_alpha_to[mod_fieldmax(root[j] * (RS_FIRST_ROOT - 1) + GF_FIELDMAX)];
-	   den = 0;
-    
-	   /* lambda[i+1] for i even is the formal derivative lambda_pr of lambda[i] */
-
-	   for(i=MIN(deg_lambda, nroots-1) & ~1; i>=0; i-=2) 
-	   {  if(lambda[i+1] != GF_ALPHA0)
-	        den ^= gf_alpha_to[mod_fieldmax(lambda[i+1] + i * root[j])];
-	   }
-
-	   /* Apply error to data */
+	/* Apply error to data */
 
-	   if(num1 != 0)
-	   {  int location = loc[j];
+	for(j=0; j<count; j++)
+	{  int loc = location[j];
 		
-	      if(erasure_map[location] != 1)  /* erasure came from CRC error */
-	      {  int old = fc->imgBlock[location][offset];
-		 int new = old ^ gf_alpha_to[mod_fieldmax(gf_index_of[num1] + gf_index_of[num2] + GF_FIELDMAX - gf_index_of[den])];
-		 char *msg;
-		 gint64 sector;
-
-		 if(erasure_map[location] == 3)  /* erasure came from CRC error */
-		 {  msg = _("-> CRC-predicted error in sector %lld at byte %4d (value %02x '%c', expected %02x '%c')\n");
-		 }
-		 else
-		 {  msg = _("-> Non-predicted error in sector %lld at byte %4d (value %02x '%c', expected %02x '%c')\n");
-		    if(erasure_map[location] == 0) /* remember error location */
-		    {  erasure_map[location] = 7;
-		       error_count++;  
-		    }
+	   if(erasure_map[loc] != 1)  /* erasure came from CRC error */
+	   {  int old = fc->imgBlock[loc][offset];
+	      int new = old ^ error[j];
+	      char *msg;
+	      gint64 sector;
+
+	      if(erasure_map[loc] == 3)  /* erasure came from CRC error */
+	      {  msg = _("-> CRC-predicted error in sector %lld at byte %4d (value %02x '%c', expected %02x '%c')\n");
+	      }
+	      else
+	      {  msg = _("-> Non-predicted error in sector %lld at byte %4d (value %02x '%c', expected %02x '%c')\n");
+		 if(erasure_map[loc] == 0) /* remember error location */
+		 {  erasure_map[loc] = 7;
+		    error_count++;  
 		 }
-
-		 if(location < ndata)
-		      sector = block_idx[location];
-		 else sector = RS02EccSectorIndex(lay, location-ndata, ecc_idx);
-
-		 PrintCLI(msg,
-			  sector, bi, 
-			  old, canprint(old) ? old : '.',
-			  new, canprint(new) ? new : '.');
 	      }
 
-	      fc->imgBlock[location][offset] ^= gf_alpha_to[mod_fieldmax(gf_index_of[num1] + gf_index_of[num2] + GF_FIELDMAX - gf_index_of[den])];
+	      if(loc < ndata)
+		   sector = block_idx[loc];
+	      else sector = RS02EccSectorIndex(lay, loc-ndata, ecc_idx);
+
+	      PrintCLI(msg,
+		       sector, bi, 
+		       old, canprint(old) ? old : '.',
+		       new, canprint(new) ? new : '.');
 	   }
+
+	   fc->imgBlock[loc][offset] ^= error[j];
 	}
      }
 
@@ -824,6 +757,12 @@ skip:
       {    t=_("Good! All sectors are already present.");
            PrintLog("%s\n", t);
       }
+      else if(skipped_eccblocks)
+      {    t=_("Good! All detected errors are repaired.");
+	   PrintLog("%s\n", t);
+	   PrintLog(_("%" PRId64 " ecc blocks with intact data sectors were not decoded; "
+		      "use --paranoid to check their ecc sectors, too.\n"), skipped_eccblocks);
+      }
       else 
       {    t=_("Good! All sectors are repaired.");
 	   PrintLog("%s\n", t);
@@ -844,20 +783,26 @@ skip:
    Verbose("%" PRId64 " of %" PRId64 " ecc blocks damaged (%" PRId64 " / %" PRId64 " sectors)\n",
 	   damaged_eccblocks, 2048*lay->sectorsPerLayer,
 	   damaged_eccsecs, lay->sectorsPerLayer);
-   if(data_count != lay->dataSectors)
-        g_printf("ONLY %lld of %lld data sectors processed\n", 
-		 (long long int)data_count, (long long int)lay->dataSectors);
-   else Verbose("all data sectors processed\n");
-
-   if(crc_count != lay->crcSectors)
-        g_printf("%lld of %lld crc sectors processed\n", 
-		 (long long int)crc_count, (long long int)lay->crcSectors);
-   else Verbose("all  crc sectors processed\n");
-
-   if(ecc_count != lay->rsSectors)
-        g_printf("%lld of %lld ecc sectors processed\n", 
-		 (long long int)ecc_count, (long long int)lay->rsSectors);
-   else Verbose("all  ecc sectors processed\n");
+   if(fc->needed)
+   {  Verbose("%" PRId64 " data, %" PRId64 " crc and %" PRId64 " ecc sectors processed (damage map)\n",
+	      data_count, crc_count, ecc_count);
+   }
+   else
+   {  if(data_count != lay->dataSectors)
+	   g_printf("ONLY %lld of %lld data sectors processed\n", 
+		    (long long int)data_count, (long long int)lay->dataSectors);
+      else Verbose("all data sectors processed\n");
+
+      if(crc_count != lay->crcSectors)
+	   g_printf("%lld of %lld crc sectors processed\n", 
+		    (long long int)crc_count, (long long int)lay->crcSectors);
+      else Verbose("all  crc sectors processed\n");
+
+      if(ecc_count != lay->rsSectors)
+	   g_printf("%lld of %lld ecc sectors processed\n", 
+		    (long long int)ecc_count, (long long int)lay->rsSectors);
+      else Verbose("all  ecc sectors processed\n");
+   }
 
    /*** Clean up */
 
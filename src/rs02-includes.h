@@ -164,6 +164,9 @@ void RS02UpdateCksums(Image*, gint64, unsigned char*);
 int RS02FinalizeCksums(Image*);
 
 void RS02ReadSector(Image*, RS02Layout*, unsigned char*, gint64);
+int RS02QueueRawSector(LargeIOVec*, int, unsigned char*, gint64);
+int RS02QueueSector(Image*, RS02Layout*, LargeIOVec*, int, unsigned char*, gint64);
+void RS02ReadQueuedSectors(Image*, LargeIOVec*, int);
 gint64 RS02EccSectorIndex(RS02Layout*, gint64, gint64);
 gint64 RS02SectorIndex(RS02Layout*, gint64, gint64);
 void RS02SliceIndex(RS02Layout*, gint64, gint64*, gint64*);
@@ -375,6 +375,7 @@ typedef struct
    guint32 *crcBuf;
    gint8   *crcValid;
    unsigned char crcSum[16];
+   MD5Pipe *imageMD5;         /* md5sum of the data portion */
 } verify_closure;
 
 static void cleanup(gpointer data)
@@ -389,6 +390,7 @@ static void cleanup(gpointer data)
    if(cc->map) FreeBitmap(cc->map);
    if(cc->crcBuf) g_free(cc->crcBuf);
    if(cc->crcValid) g_free(cc->crcValid);
+   if(cc->imageMD5) FreeMD5Pipe(cc->imageMD5);
    
    g_free(cc);
 
@@ -568,7 +570,6 @@ void RS02Verify(Image *image)
    RS02Widgets *wl = self->widgetList;
    EccHeader *eh;
    RS02Layout *lay;
-   struct MD5Context image_md5;
    struct MD5Context ecc_md5;
    struct MD5Context meta_md5;
    unsigned char ecc_sum[16];
@@ -721,7 +722,7 @@ void RS02Verify(Image *image)
    if(!LargeSeek(image->file, 0))
      Stop(_("Failed seeking to start of image: %s\n"), strerror(errno));
 
-   MD5Init(&image_md5);
+   cc->imageMD5 = CreateMD5Pipe();
    MD5Init(&ecc_md5);
    MD5Init(&meta_md5);
 
@@ -757,8 +758,8 @@ void RS02Verify(Image *image)
 
       if(s < lay->dataSectors)
       {  if(s < lay->dataSectors - 1)
-	      MD5Update(&image_md5, buf, 2048);
-	 else MD5Update(&image_md5, buf, eh->inLast);
+	      MD5PipeUpdate(cc->imageMD5, buf, 2048);
+	 else MD5PipeUpdate(cc->imageMD5, buf, eh->inLast);
       }
 
       /* Look for the dead sector marker */
@@ -873,9 +874,23 @@ void RS02Verify(Image *image)
       }
    }
 
+   /* Remember the damaged sectors for a subsequent fix */
+
+   if(Closure->damageMapFile)
+   {  DamageMap *dm;
+
+      GetImageFingerprint(image, NULL, eh->fpSector);
+      dm = CreateDamageMap(image, expected_sectors);
+      for(s=0; s<expected_sectors; s++)
+	 if(!GetBit(cc->map, s))
+	    SetBit(dm->damaged, s);
+      SaveDamageMap(dm, Closure->damageMapFile);
+      FreeDamageMap(dm);
+   }
+
    /* The image md5sum is only useful if all blocks have been successfully read. */
 
-   MD5Final(medium_sum, &image_md5);
+   MD5PipeFinal(medium_sum, cc->imageMD5);
    AsciiDigest(data_digest, medium_sum);
 
    MD5Final(ecc_sum, &meta_md5); 
@@ -891,7 +906,8 @@ void RS02Verify(Image *image)
       if(!total_missing && !total_crc_errors)
          PrintLog(_("* suspicious image : contains damaged ecc headers\n"));
       else
-      {  if(!total_crc_errors)
+      {  exitCode = total_missing ? EXIT_CODE_MISSING_SECTOR : EXIT_CODE_CHECKSUM_ERROR;
+	 if(!total_crc_errors)
 	   PrintLog(_("* BAD image        : %" PRId64 " sectors missing\n"), total_missing);
 	 if(!total_missing)
 	   PrintLog(_("* suspicious image : all sectors present, but %" PRId64 " CRC errors\n"), total_crc_errors);
@@ -1001,6 +1017,7 @@ continue_with_ecc:
 		 "*                  : Please upgrade dvdisaster.\n"),
 	       eh->neededVersion/10000,
 	       (eh->neededVersion%10000)/100);
+      exitCode = EXIT_CODE_VERSION_MISMATCH;
 
 
      if(Closure->guiMode)
@@ -1033,6 +1050,7 @@ continue_with_ecc:
            PrintLog(_("* medium sectors   : %" PRId64 " (BAD, perhaps TAO/DAO mismatch)\n"),
 		    expected_sectors);
       else PrintLog(_("* medium sectors   : %" PRId64 " (BAD)\n"),expected_sectors);
+      exitCode = EXIT_CODE_SIZE_MISMATCH;
 
       if(Closure->guiMode)
       {  GuiSetLabelText(wl->cmpEccMediumSectors, 
@@ -1054,6 +1072,7 @@ continue_with_ecc:
 
       if(n) PrintLog(_("- data md5sum      : %s (good)\n"),hdr_digest);
       else  PrintLog(_("* data md5sum      : %s (BAD)\n"),hdr_digest);
+      if(!n) exitCode = EXIT_CODE_CHECKSUM_ERROR;
 
       if(n)
       {  GuiSetLabelText(wl->cmpEcc1Msg, "%s", hdr_digest);
@@ -1080,6 +1099,7 @@ continue_with_ecc:
       }
       else 
       {  PrintLog(_("* crc md5sum       : %s (BAD)\n"),digest);
+	 exitCode = EXIT_CODE_SYNDROME_ERROR;
 	 GuiSetLabelText(wl->cmpEcc2Msg, "<span %s>%s</span>", Closure->redMarkup, digest);
 	 ecc_md5_failure = TRUE;
       }
@@ -1101,6 +1121,7 @@ continue_with_ecc:
       }
       else 
       {    PrintLog(_("* ecc md5sum       : %s (BAD)\n"),digest);
+	   exitCode = EXIT_CODE_SYNDROME_ERROR;
 	   GuiSetLabelText(wl->cmpEcc3Msg, "<span %s>%s</span>", Closure->redMarkup, digest);
 	   ecc_md5_failure = TRUE;
       }
@@ -183,8 +183,15 @@ CrcBuf *RS03GetCrcBuf(Image *image)
  *** Read one or more image sectors from the .iso file.
  ***/
 
-void RS03ReadSectors(Image *image, RS03Layout *lay, unsigned char *buf, 
-		     gint64 layer, gint64 layer_sector, gint64 how_many, int flags)
+/*
+ * Find out where the requested sectors are located.
+ * Sectors beyond the end of the image are created in memory;
+ * returns FALSE if nothing remains to be read from the file.
+ */
+
+static int locate_sectors(Image *image, RS03Layout *lay, unsigned char *buf,
+			  gint64 layer, gint64 layer_sector, gint64 how_many, int flags,
+			  LargeFile **file_out, gint64 *start_out, gint64 *size_out)
 {  LargeFile *target_file = NULL;
    gint64 start_sector=0;
    gint64 stop_sector=0;
@@ -321,7 +328,7 @@ void RS03ReadSectors(Image *image, RS03Layout *lay, unsigned char *buf,
    }
 
    if(byte_size<=0)
-      return;
+      return FALSE;
 
    /* Image with ecc files may have an incomplete last sector.
       Deal with it appropriately. */
@@ -335,6 +342,38 @@ void RS03ReadSectors(Image *image, RS03Layout *lay, unsigned char *buf,
       }
    }
 
+   *file_out  = target_file;
+   *start_out = start_sector;
+   *size_out  = byte_size;
+
+   return TRUE;
+}
+
+void RS03ReadSectors(Image *image, RS03Layout *lay, unsigned char *buf, 
+		     gint64 layer, gint64 layer_sector, gint64 how_many, int flags)
+{  LargeFile *target_file;
+   gint64 start_sector;
+   gint64 byte_size;
+   gint64 n;
+
+   if(!locate_sectors(image, lay, buf, layer, layer_sector, how_many, flags,
+		      &target_file, &start_sector, &byte_size))
+      return;
+
+   /* Direct I/O only happens through the vectored functions */
+
+   if(target_file->directIO)
+   {  LargeIOVec v;
+
+      v.offset = 2048*start_sector;
+      v.buf    = buf;
+      v.count  = byte_size;
+      if(!LargeReadV(target_file, &v, 1))
+	 Stop(_("Failed reading sector %" PRId64 " in image: %s"),
+	      start_sector, strerror(errno));
+      return;
+   }
+
    /* All sectors are consecutively readable in image case */
    
    if(!LargeSeek(target_file, (gint64)(2048*start_sector)))
@@ -347,6 +386,50 @@ void RS03ReadSectors(Image *image, RS03Layout *lay, unsigned char *buf,
 	   start_sector, strerror(errno));
 }
 
+/*
+ * Read the same range of sectors from the first n_layers layers,
+ * e.g. a number of complete ecc blocks. Layer i goes into buf[i].
+ * All reads are submitted at once to keep the disk busy.
+ */
+
+void RS03ReadLayers(Image *image, RS03Layout *lay, unsigned char **buf, int n_layers,
+		    gint64 layer_sector, gint64 how_many, int flags)
+{  LargeIOVec img_vec[GF_FIELDMAX], ecc_vec[GF_FIELDMAX];
+   int n_img = 0, n_ecc = 0;
+   int layer,i;
+
+   for(layer=0; layer<n_layers; layer++)
+   {  LargeFile *target_file;
+      gint64 start_sector;
+      gint64 byte_size;
+      LargeIOVec *v;
+
+      if(!locate_sectors(image, lay, buf[layer], layer, layer_sector, how_many, flags,
+			 &target_file, &start_sector, &byte_size))
+	 continue;
+
+      if(target_file == image->file)
+	   v = &img_vec[n_img++];
+      else v = &ecc_vec[n_ecc++];
+
+      v->offset = 2048*start_sector;
+      v->buf    = buf[layer];
+      v->count  = byte_size;
+   }
+
+   if(!LargeReadV(image->file, img_vec, n_img))
+     for(i=0; i<n_img; i++)
+       if(img_vec[i].result != img_vec[i].count)
+	  Stop(_("Failed reading sector %" PRId64 " in image: %s"),
+	       (gint64)img_vec[i].offset/2048, strerror(errno));
+
+   if(n_ecc && !LargeReadV(image->eccFile, ecc_vec, n_ecc))
+     for(i=0; i<n_ecc; i++)
+       if(ecc_vec[i].result != ecc_vec[i].count)
+	  Stop(_("Failed reading sector %" PRId64 " in image: %s"),
+	       (gint64)ecc_vec[i].offset/2048, strerror(errno));
+}
+
 /***
  *** Calculate position of n-th sector of the given layer in the image.
  ***/
@@ -85,9 +85,12 @@ typedef struct
    guint32 *encoderCrc;        /* only an alias pointer into data! */
    unsigned char **encoderMmapBase;
    guint64 *encoderMmapSize;
+   AlignedBuffer **ioAligned;  /* backing store of ioData for the */
+   AlignedBuffer **encoderAligned; /* readwrite and direct strategies */
    unsigned char *paritybase;
    unsigned char *parity;
    unsigned char **slice;
+   AlignedBuffer **sliceAligned;
    int slicesFree;          /* flag for sharing it between IO and encoder */
    guint32 *firstCrc;       /* storage for first CRC block */
    guint64 chunkSize;       /* we can process this much layer sectors at a time */
@@ -111,6 +114,10 @@ typedef struct
    int buffersToEncode;     /* number of unprocessed buffers */
    int nextBufferIndex;     /* next buffer which needs to be encoded */
    GThread *thread[MAX_CODEC_THREADS];
+   int nThreads;            /* number of spawned encoder threads */
+   int activeThreads;       /* encoders allowed to take work */
+   AutoTune *tune;          /* only with --auto-tune */
+   int tunedEncoder;        /* encoding algorithm chosen by the tuner */
    char *msg;
    int earlyTermination;
    int abortImmediately;
@@ -141,12 +148,15 @@ static void ecc_cleanup(gpointer data)
 
       /* Wait for all worker to exit */
 
-      for(i=0; i<Closure->codecThreads; i++)
+      for(i=0; i<ec->nThreads; i++)
       {  g_thread_join(ec->thread[i]);
 	 fflush(stdout);
       }
    }
 
+   if(ec->tunedEncoder)
+      Closure->encodingAlgorithm = ENCODING_ALG_DEFAULT;
+
    if(ec->earlyTermination)
    {  GuiSetLabelText(ec->wl->encFootline,
 		      _("<span %s>Aborted by unrecoverable error.</span>"),
@@ -183,6 +193,7 @@ static void ecc_cleanup(gpointer data)
    if(ec->avgTimer) g_timer_destroy(ec->avgTimer);
    if(ec->contTimer) g_timer_destroy(ec->contTimer);
    if(ec->firstCrc) g_free(ec->firstCrc);
+   if(ec->tune) FreeAutoTune(ec->tune);
 
 #ifdef HAVE_MMAP
    if(Closure->encodingIOStrategy == IO_STRATEGY_MMAP)
@@ -213,15 +224,24 @@ static void ecc_cleanup(gpointer data)
    if(ec->lay) g_free(ec->lay);
 
    for(i=0; i<256; i++)
-   {  if(ec->slice && ec->slice[i])
-         g_free(ec->slice[i]);
-      if(ec->ioData && ec->ioData[i])
+   {  if(ec->sliceAligned && ec->sliceAligned[i])
+         FreeAlignedBuffer(ec->sliceAligned[i]);
+
+      if(ec->ioAligned && ec->ioAligned[i])
+         FreeAlignedBuffer(ec->ioAligned[i]);
+      else if(ec->ioData && ec->ioData[i])
          g_free(ec->ioData[i]);
-      if(ec->encoderData && ec->encoderData[i])
+
+      if(ec->encoderAligned && ec->encoderAligned[i])
+         FreeAlignedBuffer(ec->encoderAligned[i]);
+      else if(ec->encoderData && ec->encoderData[i])
          g_free(ec->encoderData[i]);
    }
 
    if(ec->slice)  g_free(ec->slice);
+   if(ec->sliceAligned) g_free(ec->sliceAligned);
+   if(ec->ioAligned) g_free(ec->ioAligned);
+   if(ec->encoderAligned) g_free(ec->encoderAligned);
    if(ec->ioData) g_free(ec->ioData);
    if(ec->encoderData) g_free(ec->encoderData);
    g_free(ec);
@@ -568,6 +588,7 @@ static void prepare_crc_block(ecc_closure *ec, CrcBlock *cb)
 
 static void flip_buffers(ecc_closure *ec)
 {  unsigned char **dtmp;
+   AlignedBuffer **atmp;
    guint32 *ctmp;
    guint64 *etmp;
 
@@ -575,6 +596,7 @@ static void flip_buffers(ecc_closure *ec)
    dtmp = ec->ioData; ec->ioData = ec->encoderData; ec->encoderData = dtmp;
    dtmp = ec->ioMmapBase; ec->ioMmapBase = ec->encoderMmapBase; ec->encoderMmapBase = dtmp;
    etmp = ec->ioMmapSize; ec->ioMmapSize = ec->encoderMmapSize; ec->encoderMmapSize = etmp;
+   atmp = ec->ioAligned; ec->ioAligned = ec->encoderAligned; ec->encoderAligned = atmp;
 }
 
 static void read_next_chunk(ecc_closure *ec, guint64 chunk)
@@ -593,7 +615,24 @@ static void read_next_chunk(ecc_closure *ec, guint64 chunk)
 
    memset(ec->ioCrc, 0, ec->chunkBytes);
 
-   /* Read the next layers of the current chunk. */
+   /* With normal or direct IO, read all data layers of the current chunk at once.
+      One sector more is read to chain back the CRC sums
+      (unless we are already in the last chunk).
+      Additional space is provided in the ec->ioData buffer. */
+
+#ifdef HAVE_MMAP
+   if(Closure->encodingIOStrategy != IO_STRATEGY_MMAP)
+#endif
+   {  guint64 n_sectors = ec->ioLayerSectors;
+
+      if(ec->ioChunk+ec->ioLayerSectors < lay->sectorsPerLayer)
+	 n_sectors++;
+
+      RS03ReadLayers(ec->image, lay, ec->ioData, lay->ndata-1,
+		     ec->ioChunk, n_sectors, RS03_READ_DATA);
+   }
+
+   /* Check the next layers of the current chunk. */
 
    for(layer=0; layer<lay->ndata-1; layer++) /* exclude CRC layer */
    {  guint64 first_sec = layer*lay->sectorsPerLayer+ec->ioChunk;
@@ -649,7 +688,7 @@ static void read_next_chunk(ecc_closure *ec, guint64 chunk)
 	    shift = page_offset % ec->pageSize;
 	    page_offset -= shift;
 	    
-	    if(ec->ioLayerSectors == ec->chunkSize)
+	    if(ec->ioChunk+ec->ioLayerSectors < lay->sectorsPerLayer)
 	         ec->ioMmapSize[layer] = 2048*ec->ioLayerSectors + 2048 + shift;
 	    else ec->ioMmapSize[layer] = 2048*ec->ioLayerSectors + shift;
 
@@ -663,12 +702,7 @@ static void read_next_chunk(ecc_closure *ec, guint64 chunk)
 	    ec->ioData[layer] = ec->ioMmapBase[layer]+shift;
 	 }
       }
-      else
 #endif /* HAVE_MMAP */
-      {
-	 RS03ReadSectors(ec->image, lay, ec->ioData[layer], 
-			 layer, ec->ioChunk, ec->ioLayerSectors, RS03_READ_DATA);
-      }
 
       err = CheckForMissingSectors(ec->ioData[layer], first_sec, 
 				   lay->eh->mediumFP, lay->eh->fpSector, 
@@ -699,73 +733,72 @@ static void read_next_chunk(ecc_closure *ec, guint64 chunk)
 		 "Perform a \"Verify\" action for more information.\n\n"));
       }
 
-      /* One sector more to chain back the CRC sums
-         (unless we are already in the last chunk).
-         Additional space is provided in the ec->ioData buffer. */
-
-#ifdef HAVE_MMAP
-      if(Closure->encodingIOStrategy == IO_STRATEGY_READWRITE)
-      {
-#endif
-	 if(ec->ioChunk+ec->ioLayerSectors < lay->sectorsPerLayer)
-	 {  
-	    RS03ReadSectors(ec->image, lay, ec->ioData[layer]+ec->chunkBytes, 
-			    layer, ec->ioChunk+ec->ioLayerSectors, 1, RS03_READ_DATA);
-	 }
-#ifdef HAVE_MMAP
-      }
-#endif
    } /* all layers from chunk finished */
 }
 
 static void flush_crc(ecc_closure *ec, LargeFile *file_out)
 {  RS03Layout *lay = ec->lay;
+   LargeIOVec vec;
    gint64 crc_sect;
-   gint64 i;
 
    /* Write out the CRC layer */
       
    verbose("%s", "IO: writing CRC layer\n");
-   crc_sect = 2048*(ec->encoderChunk+lay->firstCrcPos);
-   if(!LargeSeek(file_out, crc_sect))
-   {  ec->abortImmediately = TRUE;
+   crc_sect = ec->encoderChunk+lay->firstCrcPos;
+   vec.offset = 2048*crc_sect;
+   vec.buf    = ec->encoderCrc;
+   vec.count  = 2048*ec->encoderLayerSectors;
 
-      Stop(_("Failed seeking to sector %" PRId64 " in image: %s"), crc_sect, strerror(errno));
+   if(!LargeWriteV(file_out, &vec, 1))
+   {  ec->abortImmediately = TRUE;
+      Stop(_("Failed writing to sector %" PRId64 " in image: %s"), crc_sect, strerror(errno));
    }
-   for(i=0; i<ec->encoderLayerSectors; i++)
-      if(LargeWrite(file_out, ec->encoderCrc+512*i, 2048) != 2048)
-      {  ec->abortImmediately = TRUE;
-	 Stop(_("Failed writing to sector %" PRId64 " in image: %s"), crc_sect, strerror(errno));
-      }
 }
 
 static void flush_parity(ecc_closure *ec, LargeFile *file_out)
 {  RS03Layout *lay = ec->lay;
-   gint64 i;
+   LargeIOVec vec[GF_FIELDMAX];
    int k;
 
-   /* Write out the created parity. */
+   /* Write out the created parity.
+      The sectors of each slice are consecutive in the image,
+      so there is one write request per ecc layer. */
 
    verbose("%s", "IO: writing parity...\n");
    for(k=0; k<lay->nroots; k++)
-   {  gint64 idx=0;
-
-      for(i=0; i<ec->flushLayerSectors; i++, idx+=2048)
-      {  gint64 s = RS03SectorIndex(lay, k+lay->ndata, ec->flushChunk+i);
-	
-	 if(!LargeSeek(file_out, 2048*s))
-	 {  ec->abortImmediately = TRUE;
-	    Stop(_("Failed seeking to sector %" PRId64 " in image: %s"), s, strerror(errno));
-	 }
-	 if(LargeWrite(file_out, ec->slice[k]+idx, 2048) != 2048)
-	 {  ec->abortImmediately = TRUE;
-	    Stop(_("Failed writing to sector %" PRId64 " in image: %s"), s, strerror(errno));
-	 }
-      }
+   {  vec[k].offset = 2048*RS03SectorIndex(lay, k+lay->ndata, ec->flushChunk);
+      vec[k].buf    = ec->slice[k];
+      vec[k].count  = 2048*ec->flushLayerSectors;
+   }
+
+   if(!LargeWriteV(file_out, vec, lay->nroots))
+   {  for(k=0; k<lay->nroots; k++)
+	if(vec[k].result != vec[k].count)
+	{  ec->abortImmediately = TRUE;
+	   Stop(_("Failed writing to sector %" PRId64 " in image: %s"),
+		(gint64)vec[k].offset/2048, strerror(errno));
+	}
    }
    verbose("%s", "IO: parity written.\n");
 }
 
+/* Show the number of active encoders in the GUI */
+
+static void show_threads(ecc_closure *ec)
+{
+#ifdef WITH_GUI_YES
+   if(Closure->guiMode)
+   {  char *alg="none";
+      char *iostrat="none";
+
+      DescribeRSEncoder(&alg, &iostrat);
+      GuiSetLabelText(ec->wl->encThreads, 
+		      _("%d threads with %s encoding and %s I/O"),
+		      ec->activeThreads, alg, iostrat);
+   }
+#endif /* WITH_GUI_YES */
+}
+
 static gpointer io_thread(ecc_closure *ec)
 {  RS03Layout *lay = ec->lay;
    LargeFile *file_out = ec->writeHandle;
@@ -803,9 +836,15 @@ static gpointer io_thread(ecc_closure *ec)
    }
    else
 #endif /* HAVE_MMAP*/
-   {  for(i=0; i<ndata; i++)
-      {  ec->ioData[i] = g_malloc(ec->chunkBytes+2048);
-	 ec->encoderData[i] = g_malloc(ec->chunkBytes+2048);
+   {  /* Aligned so that they can be used with O_DIRECT */
+
+      ec->ioAligned      = g_malloc0(256*sizeof(AlignedBuffer*));
+      ec->encoderAligned = g_malloc0(256*sizeof(AlignedBuffer*));
+      for(i=0; i<ndata; i++)
+      {  ec->ioAligned[i]      = CreateAlignedBuffer(ec->chunkBytes+2048);
+	 ec->encoderAligned[i] = CreateAlignedBuffer(ec->chunkBytes+2048);
+	 ec->ioData[i]      = ec->ioAligned[i]->buf;
+	 ec->encoderData[i] = ec->encoderAligned[i]->buf;
       }
    }
 
@@ -815,9 +854,12 @@ static gpointer io_thread(ecc_closure *ec)
 
    /*** Create buffers for dividing the ecc information into nroots slices */
 
-   ec->slice      = g_malloc0(256*sizeof(unsigned char*));
+   ec->slice        = g_malloc0(256*sizeof(unsigned char*));
+   ec->sliceAligned = g_malloc0(256*sizeof(AlignedBuffer*));
    for(i=0; i<nroots; i++)
-     ec->slice[i] = g_malloc(ec->chunkBytes);
+   {  ec->sliceAligned[i] = CreateAlignedBuffer(ec->chunkBytes);
+      ec->slice[i] = ec->sliceAligned[i]->buf;
+   }
 
    Verbose("Cache allocation: %lldK+%lldK+%lldK=%lldM (data+parity+descrambling)\n",
 	   (long long)((2*ec->chunkBytes*ndata)/1024),
@@ -830,12 +872,13 @@ static gpointer io_thread(ecc_closure *ec)
    /* Process the image.
       From each layer a chunk of ec->chunkSize sectors is read in at once.
       So after (lay->sectorsPerLayer/ec->chunkSize)+1 iterations 
-      the whole image has been processed. */
+      the whole image has been processed.
+      The auto-tuner may change ec->chunkSize between two chunks. */
 
    verbose("NOTE: ndata = %d, chunk size = %d\n", ndata, ec->chunkSize);
    verbose("NOTE: sectors per layer = %lld\n", (long long)lay->sectorsPerLayer);
 
-   for(chunk=0; chunk<lay->sectorsPerLayer; chunk+=ec->chunkSize) 
+   for(chunk=0; chunk<lay->sectorsPerLayer; chunk+=ec->ioLayerSectors) 
    {  int cpu_bound = 0;
 
       verbose("Starting IO processing for chunk %d\n", chunk);
@@ -910,6 +953,17 @@ static gpointer io_thread(ecc_closure *ec)
       {  GuiSetLabelText(ec->wl->encBottleneck, _("I/O bound"));
 	 ec->ioBound++;
       }
+
+      /* Adapt the number of encoders and the chunk size */
+
+      if(ec->tune
+	 && AutoTuneChunk(ec->tune, cpu_bound, 2048.0*ndata*ec->flushLayerSectors))
+      {  g_mutex_lock(ec->lock);
+	 ec->activeThreads = ec->tune->activeThreads;
+	 g_mutex_unlock(ec->lock);
+	 ec->chunkSize = ec->tune->chunk;
+	 show_threads(ec);
+      }
    } /* chunk finished */
 
    /* Broadcast read to the worker threads */
@@ -971,7 +1025,7 @@ static gpointer encoder_thread(ecc_closure *ec)
 
    i=my_number; /* prevents stupid compiler warning */
    g_mutex_lock(ec->lock);
-   for(i=0; i<Closure->codecThreads; i++)
+   for(i=0; i<ec->nThreads; i++)
      if(ec->thread[i] == self)
        my_number = i;
    g_mutex_unlock(ec->lock);
@@ -999,7 +1053,8 @@ static gpointer encoder_thread(ecc_closure *ec)
       g_mutex_lock(ec->lock);
       while(   ec->sectorsToEncode 
 	    && !ec->abortImmediately
-	    && ec->nextBufferIndex >= ec->encoderLayerSectors)
+	    && (   ec->nextBufferIndex >= ec->encoderLayerSectors
+		|| my_number >= ec->activeThreads))
       {  verbose("ENC: encoder %d waiting for work\n", my_number);
  	 g_cond_wait(ec->ioCond, ec->lock);
       }
@@ -1145,11 +1200,18 @@ static gpointer encoder_thread(ecc_closure *ec)
 static void create_reed_solomon(ecc_closure *ec)
 {  int nroots = ec->lay->nroots;
    int ndata = ec->lay->ndata;
+   int n_threads;
    int i;
-#ifdef WITH_GUI_YES
-   char *alg="none";
-   char *iostrat="none";
-#endif
+
+   /*** With --auto-tune, all threads which might become useful are
+	spawned right away, but only the first ec->activeThreads
+	of them take work. */
+
+   if(ec->tune)
+        n_threads = ec->tune->maxThreads;
+   else n_threads = Closure->codecThreads;
+   ec->activeThreads = ec->tune ? ec->tune->activeThreads : n_threads;
+
    /*** Show the second progress bar */
 #ifdef WITH_GUI_YES
    if(Closure->guiMode)
@@ -1162,11 +1224,7 @@ static void create_reed_solomon(ecc_closure *ec)
       GuiShowWidget(ec->wl->encPerformance);
       GuiShowWidget(ec->wl->encBottleneck);
 
-      DescribeRSEncoder(&alg, &iostrat);
-
-      GuiSetLabelText(ec->wl->encThreads, 
-		      _("%d threads with %s encoding and %s I/O"),
-		      Closure->codecThreads, alg, iostrat);
+      show_threads(ec);
       GuiSetLabelText(ec->wl->encPerformance, "");
       GuiSetLabelText(ec->wl->encBottleneck, "");
    }
@@ -1185,10 +1243,18 @@ static void create_reed_solomon(ecc_closure *ec)
 
 	So we need to buffer 2048*Closure->prefetchSectors of input data.
 	For practical reasons we require that the layer size is a multiple of the
-	medium sector size of 2048 bytes. */
+	medium sector size of 2048 bytes.
+	The auto-tuner may use chunks up to its maxChunk setting,
+	so the buffers must be allocated for that size. */
 
-   ec->chunkBytes  = 2048*Closure->prefetchSectors;
-   ec->chunkSize   = Closure->prefetchSectors;
+   if(ec->tune)
+   {  ec->chunkBytes  = 2048*ec->tune->maxChunk;
+      ec->chunkSize   = ec->tune->chunk;
+   }
+   else
+   {  ec->chunkBytes  = 2048*Closure->prefetchSectors;
+      ec->chunkSize   = Closure->prefetchSectors;
+   }
 
 #ifdef SYS_MINGW
    {
@@ -1210,6 +1276,12 @@ static void create_reed_solomon(ecc_closure *ec)
    else
       ec->writeHandle   = ec->image->file;
    ec->lastPercent   = -1;
+
+   if(Closure->encodingIOStrategy == IO_STRATEGY_DIRECT)
+   {  LargeEnableDirectIO(ec->image->file);
+      if(ec->image->eccFile)
+	LargeEnableDirectIO(ec->image->eccFile);
+   }
    ec->cpuBound = ec->ioBound = 0;
 
    /*** Initialize the encoder tables*/
@@ -1220,7 +1292,7 @@ static void create_reed_solomon(ecc_closure *ec)
    /*** Spawn the RS encoder threads */
 
    g_mutex_lock(ec->lock);  /* ec->thread[i] = ... may produce race condition */
-   for(i=0; i<Closure->codecThreads; i++) 
+   for(i=0; i<n_threads; i++) 
    {  GError *err = NULL;
 
       verbose("SCHED: creating encoder %d\n", i);
@@ -1230,6 +1302,7 @@ static void create_reed_solomon(ecc_closure *ec)
 	 ec->abortImmediately = TRUE;
          Stop("Could not create encoder thread: %s", err->message);
       }
+      ec->nThreads++;
    }
    g_mutex_unlock(ec->lock);
    g_thread_yield(); /* FIXME */
@@ -1240,7 +1313,7 @@ static void create_reed_solomon(ecc_closure *ec)
 
    /*** Wait for workers to finish */
 
-   for(i=0; i<Closure->codecThreads; i++)
+   for(i=0; i<ec->nThreads; i++)
    {  g_thread_join(ec->thread[i]);
       verbose("SCHED: joined with worker %d\n", i);
       fflush(stdout);
@@ -1316,6 +1389,21 @@ void RS03Create(void)
 
    lay = ec->lay = CalcRS03Layout(image, Closure->eccTarget);
 
+   /*** Start from the tuned profile of this host.
+	Chunks may grow up to twice the prefetch setting. */
+
+   if(Closure->autoTune)
+   {  int prefetch = MAX(Closure->prefetchSectors, Closure->tunedPrefetch);
+
+      ec->tune = CreateAutoTune(Closure->tunedPrefetch ? Closure->tunedPrefetch : Closure->prefetchSectors,
+				32, MIN(2*prefetch, MAX_PREFETCH_CACHE_SIZE));
+
+      if(Closure->encodingAlgorithm == ENCODING_ALG_DEFAULT)
+      {  Closure->encodingAlgorithm = AutoTuneEncoder(lay->nroots);
+	 ec->tunedEncoder = TRUE;
+      }
+   }
+
    /*** Announce what we are going to do */
 
    ecc_sectors = lay->nroots*lay->sectorsPerLayer;
@@ -1344,12 +1432,12 @@ void RS03Create(void)
      if(Closure->eccTarget == ECC_IMAGE)
 	 ec->msg = g_strdup_printf(_("Augmenting image with Method RS03 [%d threads, %s, %s I/O]:\n"
 				     "%" PRId64 " MiB data, %" PRId64 " MiB ecc (%d roots; %4.1f%% redundancy)."),
-				   Closure->codecThreads, alg, iostrat, 
+				   ec->tune ? ec->tune->activeThreads : Closure->codecThreads, alg, iostrat, 
 				   lay->dataSectors/512, ecc_sectors/512, lay->nroots, lay->redundancy);
       else
 	 ec->msg = g_strdup_printf(_("Creating the error correction file with Method RS03 [%d threads, %s, %s I/O]:\n"
 				     "%" PRId64 " MiB data, %" PRId64 " MiB ecc (%d roots; %4.1f%% redundancy)."),
-				   Closure->codecThreads, alg, iostrat, 
+				   ec->tune ? ec->tune->activeThreads : Closure->codecThreads, alg, iostrat, 
 				   lay->dataSectors/512, ecc_sectors/512, lay->nroots, lay->redundancy);
 
       PrintLog("%s\n",ec->msg);
@@ -1391,6 +1479,12 @@ void RS03Create(void)
 	abort_encoding(ec, FALSE);
    }
 
+   /*** Pick up the md5 sums from an earlier read.
+	This must happen before the image is modified. */
+
+   if(!Closure->crcBuf && Closure->crcCacheFile)
+      Closure->crcBuf = LoadCrcBuf(image, Closure->crcCacheFile);
+
    /*** Expand the image by ecc_sectors. */
 
    expand_image(ec);
@@ -1421,6 +1515,12 @@ void RS03Create(void)
    PrintLog(_("Avg performance: %5.2fs (%5.2fMiB/s) total\n"), 
 	    elapsed, mbs);
 
+   if(ec->tune)
+   {  AutoTuneRemember(ec->tune, &Closure->tunedPrefetch, 1);
+      PrintLog(_("Auto-tuned to %d threads and %d sectors prefetch.\n"),
+	       ec->tune->activeThreads, ec->tune->chunk);
+   }
+
    GuiSetLabelText(wl->encPerformance, _("%5.2fMiB/s average"), mbs);
    GuiSetLabelText(ec->wl->encBottleneck, 
 		   _("%d times CPU bound; %d times I/O bound"),
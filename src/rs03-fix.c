@@ -25,29 +25,116 @@
 #include "dvdisaster.h"
 
 #include "rs03-includes.h"
-#include "galois-inlines.h"
 
 /***
  *** Internal housekeeping
  ***/
 
+/* Outcome of decoding a single ecc block */
+
+#define FIX_BLOCK_DECODED    0
+#define FIX_BLOCK_TOO_MANY   1   /* more erasures than roots */
+#define FIX_BLOCK_DEC_FAILED 2   /* deg(lambda) != number of roots */
+#define FIX_BLOCK_SKIPPED    3   /* data sectors verified by CRC, not decoded */
+
+typedef struct
+{  int done;                /* set by the decoder thread when finished */
+   int status;              /* FIX_BLOCK_* from above */
+   int erasureCount;        /* erasures known before decoding */
+   int errorCount;          /* additional errors found by the decoder */
+   int erasureList[255];
+   int erasureMap[255];     /* 1 = dead sector, 3 = crc error, 7 = new error */
+   int damagedSectors;
+   int crcErrors;
+   int damagedBytes;        /* byte positions with nonzero syndrome */
+   int degLambda, rootCount;/* diagnostics for FIX_BLOCK_DEC_FAILED */
+   unsigned char *patch[255]; /* corrections to be XORed into the sectors */
+   GString *log;            /* CLI output produced while decoding */
+} fix_result;
+
+/* A batch of consecutive ecc blocks as read from the image.
+   While the decoders are busy with one batch, the IO thread
+   fills the other one. */
+
+typedef struct
+{  unsigned char *imgBlock[255];
+   AlignedBuffer *imgAligned[255];  /* backing store for imgBlock */
+   guint32 firstCrc[512];   /* CRC sector for the first ecc block in this batch */
+   gint64 firstBlock;
+   int nBlocks;
+   int maxBlocks;
+   fix_result *result;
+} fix_batch;
+
 typedef struct
 {  RS03Widgets *wl;
    RS03Layout *lay;
+   EccHeader *eh;
    GaloisTables *gt;
    ReedSolomonTables *rt;
+   RSDecoder *decoder;      /* for decoding in the IO thread */
    Image *image;
    int earlyTermination;
    char *msg;
-   unsigned char *imgBlock[255];
+   fix_batch *batch[2];
+   guint32 lastCrc[512];    /* last CRC sector of the previously read batch */
+   gint64 lastCrcBlock;     /* ecc block whose CRCs are in lastCrc */
+   Bitmap *needed;          /* ecc blocks to process (--damage-map only) */
+
+   GMutex *lock;            /* lock on the shared variables below */
+   GCond *cond;             /* sync between decoders and IO thread */
+   GThread *thread[MAX_CODEC_THREADS];
+   int nThreads;
+   int activeThreads;       /* decoders allowed to take work */
+   int abortImmediately;
+   int batchBlocks;         /* ecc blocks per batch */
+   gint64 nextRead;         /* first ecc block of the next batch */
+   int batchesRead;         /* batches handed over to the decoders */
+   int batchesTotal;        /* known after the last batch has been read */
+   AutoTune *tune;          /* only with --auto-tune */
+   int decodeBatch;         /* batch currently distributed to the decoders */
+   int nextBlock;           /* next unclaimed ecc block in that batch */
 } fix_closure;
 
+static void free_result(fix_result *fr)
+{  int i;
+
+   for(i=0; i<255; i++)
+   {  if(fr->patch[i])
+      {  g_free(fr->patch[i]);
+	 fr->patch[i] = NULL;
+      }
+   }
+
+   if(fr->log)
+   {  g_string_free(fr->log, TRUE);
+      fr->log = NULL;
+   }
+}
+
 static void fix_cleanup(gpointer data)
 {  fix_closure *fc = (fix_closure*)data;
-   int i;
+   int i,j;
 
    UnregisterCleanup();
 
+   /* Wake up the decoder threads and wait for them to exit */
+
+   if(fc->lock)
+   {  g_mutex_lock(fc->lock);
+      fc->abortImmediately = TRUE;
+      g_cond_broadcast(fc->cond);
+      g_mutex_unlock(fc->lock);
+
+      for(i=0; i<fc->nThreads; i++)
+	g_thread_join(fc->thread[i]);
+
+      g_mutex_clear(fc->lock);
+      g_free(fc->lock);
+      g_cond_clear(fc->cond);
+      g_free(fc->cond);
+   }
+
    if(fc->earlyTermination)
    {  GuiSwitchAndSetFootline(fc->wl->fixNotebook, 1,
 			      fc->wl->fixFootline,
@@ -61,14 +148,30 @@ static void fix_cleanup(gpointer data)
    if(fc->msg) g_free(fc->msg);
    if(fc->image) CloseImage(fc->image);
 
-   for(i=0; i<255; i++)
-   {  if(fc->imgBlock[i])
-	 g_free(fc->imgBlock[i]); 
+   for(i=0; i<2; i++)
+   {  fix_batch *fb = fc->batch[i];
+
+      if(!fb) continue;
+
+      for(j=0; j<255; j++)
+      {  if(fb->imgAligned[j])
+	    FreeAlignedBuffer(fb->imgAligned[j]);
+      }
+
+      if(fb->result)
+      {  for(j=0; j<fb->maxBlocks; j++)
+	    free_result(&fb->result[j]);
+	 g_free(fb->result);
+      }
+      g_free(fb);
    }
 
    if(fc->lay) g_free(fc->lay);
    if(fc->gt) FreeGaloisTables(fc->gt);
    if(fc->rt) FreeReedSolomonTables(fc->rt);
+   if(fc->decoder) FreeRSDecoder(fc->decoder);
+   if(fc->tune) FreeAutoTune(fc->tune);
+   if(fc->needed) FreeBitmap(fc->needed);
 
    g_free(fc);
 
@@ -118,6 +221,447 @@ static void expand_image(Image *image, EccHeader *eh, gint64 new_size)
    }
 }
 
+/***
+ *** Decoding of a single ecc block.
+ ***
+ * Runs in the decoder threads. The image data is not modified here;
+ * corrections are recorded in the result and applied by the IO thread
+ * when it processes the ecc blocks in their natural order.
+ */
+
+static void log_result(fix_result *fr, char *format, ...)
+{  va_list argp;
+
+   if(!fr->log)
+     fr->log = g_string_sized_new(256);
+
+   va_start(argp, format);
+   g_string_append_vprintf(fr->log, format, argp);
+   va_end(argp);
+}
+
+/*
+ * The CRC sector of an ecc block carries the checksums for the next
+ * ecc block; it can only be verified by its own selfCRC and by
+ * comparing its layout information with the one we are working with.
+ */
+
+static int crc_block_valid(RS03Layout *lay, EccHeader *eh, unsigned char *sector)
+{  guint64 buf[256];   /* 2048 bytes, aligned for the CrcBlock */
+   CrcBlock *cb = (CrcBlock*)buf;
+   guint32 recorded_crc;
+
+   memcpy(buf, sector, 2048);
+
+   if(  memcmp(cb->cookie, "*dvdisaster*", 12)
+      ||memcmp(cb->method, "RS03", 4))
+     return FALSE;
+
+   recorded_crc = cb->selfCRC;
+#ifdef HAVE_BIG_ENDIAN
+   cb->selfCRC = 0x47504c00;
+#else
+   cb->selfCRC = 0x4c5047;
+#endif
+
+   if(Crc32((unsigned char*)buf, 2048) != recorded_crc)
+     return FALSE;
+
+#ifdef HAVE_BIG_ENDIAN
+   SwapCrcBlockBytes(cb);
+#endif
+
+   return    cb->dataSectors == lay->dataSectors
+	  && cb->dataBytes == lay->ndata
+	  && cb->eccBytes == lay->nroots
+	  && cb->sectorsPerLayer == lay->sectorsPerLayer
+	  && !(cb->methodFlags[0] & MFLAG_ECC_FILE) == (lay->target != ECC_FILE)
+	  && cb->fpSector == eh->fpSector
+	  && !memcmp(cb->mediumFP, eh->mediumFP, 16);
+}
+
+static void decode_block(fix_closure *fc, RSDecoder *dec, fix_batch *fb, int k)
+{  RS03Layout *lay = fc->lay;
+   EccHeader *eh = fc->eh;
+   fix_result *fr = &fb->result[k];
+   gint64 s = fb->firstBlock + k;
+   guint32 *crc_buf;
+   int nroots = lay->nroots;
+   int ndata  = lay->ndata;
+   int cache_offset = 2048*k;
+   int erasure_count;
+   int crc_valid, crc_idx;
+   int bi,i,j,err;
+
+   free_result(fr);
+   fr->status = FIX_BLOCK_DECODED;
+   fr->errorCount = 0;
+   fr->damagedSectors = fr->crcErrors = fr->damagedBytes = 0;
+
+   /* Set crc ptr to beginning of CRC sector. The first ECC block has no
+      CRC sector; the checksums are taken from the Ecc header instead. */
+
+   if(k==0) 
+   {  crc_buf = fb->firstCrc;
+      err = CheckForMissingSector((unsigned char*)crc_buf, 
+				  lay->firstCrcPos,
+				  eh->mediumFP, eh->fpSector);
+   }
+   else
+   {  crc_buf = (guint32*)(fb->imgBlock[ndata-1]+cache_offset-2048);
+      err = CheckForMissingSector((unsigned char*)crc_buf, 
+				  (ndata-1)*lay->sectorsPerLayer+s,
+				  eh->mediumFP, eh->fpSector);
+   }
+   crc_valid = (err == SECTOR_PRESENT);
+   crc_idx = 0;
+
+   /*** Look for erasures based on the "dead sector" marker and CRC sums */
+
+   erasure_count = 0;
+
+   /* Check the data sectors */
+
+   for(i=0; i<ndata; i++)  
+   {  err = CheckForMissingSector(fb->imgBlock[i]+cache_offset, i*lay->sectorsPerLayer+s,
+				  eh->mediumFP, eh->fpSector);
+      /* FIXME: sector number is wrong for CRC layer in ecc files */
+      /* FIXME: Auto-replace the padding sectors */
+
+      if(err == SECTOR_PRESENT)
+      {  fr->erasureMap[i] = 0;
+      }
+      else
+      {  fr->erasureMap[i] = 1;
+	 fr->erasureList[erasure_count++] = i;
+	 fr->damagedSectors++;
+      }
+
+      if(i < ndata-1)     /* only data sectors have CRCs */
+      {  guint32 crc = Crc32(fb->imgBlock[i]+cache_offset, 2048);
+
+	 if(crc_valid && !fr->erasureMap[i] && crc != crc_buf[crc_idx])
+	 {  fr->erasureMap[i] = 3;
+	    fr->erasureList[erasure_count++] = i;
+	    log_result(fr, _("CRC error in sector %" PRId64 "\n"), i*lay->sectorsPerLayer+s);
+	    fr->damagedSectors++;
+	    fr->crcErrors++;
+	 }
+
+	 crc_idx++;
+      }
+   }
+
+   /* Check the ecc sectors */
+
+   for(i=ndata; i<GF_FIELDMAX; i++)
+   {  err = CheckForMissingSector(fb->imgBlock[i]+cache_offset,
+				  RS03SectorIndex(lay, i, s),
+				  eh->mediumFP, eh->fpSector);
+
+      if(err)
+      {  fr->erasureMap[i] = 1;
+	 fr->erasureList[erasure_count++] = i;
+	 fr->damagedSectors++;
+      }
+      else fr->erasureMap[i] = 0;
+   }
+
+   fr->erasureCount = erasure_count;
+
+   /* Trivially reject uncorrectable ecc block */
+
+   if(erasure_count>nroots)   /* uncorrectable */
+   {  fr->status = FIX_BLOCK_TOO_MANY;
+      return;
+   }
+
+   /* Unless being paranoid, skip the ecc block if all data sectors
+      are present and match their CRC, and the CRC sector is intact.
+      Only byte errors in the ecc sectors could go unnoticed that way. */
+
+   if(   !erasure_count && crc_valid && !Closure->paranoidFix
+      && crc_block_valid(lay, eh, fb->imgBlock[ndata-1]+cache_offset))
+   {  fr->status = FIX_BLOCK_SKIPPED;
+      return;
+   }
+
+   /* Build ecc block and attempt to correct it */
+
+   SetRSDecoderErasures(dec, fr->erasureList, erasure_count);
+
+   /* Form the syndromes for all 2048 ecc block bytes at once and
+      solve the erasure columns with the cached erasure matrix */
+
+   RSDecodeBlock(dec, fb->imgBlock, cache_offset);
+
+   for(bi=0; bi<2048; bi++)  /* Run through each ecc block byte */
+   {  int offset = cache_offset+bi;
+      int location[nroots], error[nroots];
+      int count;
+
+      /* If it is already correct by coincidence, we have nothing to do any further */
+
+      if(dec->nonzero[bi/SYNDROME_COLUMNS] & (1U<<(bi%SYNDROME_COLUMNS))) fr->damagedBytes++; 
+      else continue;
+
+      count = RSDecodeBlockColumn(dec, bi, location, error);
+
+      /* deg(lambda) unequal to number of roots => uncorrectable error detected */
+
+      if(count < 0)
+      {  fr->status = FIX_BLOCK_DEC_FAILED;
+	 fr->degLambda = dec->degLambda;
+	 fr->rootCount = dec->rootCount;
+	 return;
+      }
+
+      /* Record the error values for the data */
+
+      for(j=0; j<count; j++)
+      {  int loc = location[j];
+
+	 if((Closure->debugMode && Closure->verbose) || Closure->regtestMode)
+	 {  if (fr->erasureMap[loc] != 1)  /* erasure came from CRC error */
+	    {  int old = fb->imgBlock[loc][offset];
+	       int new = old ^ error[j];
+	       char *msg, *type;
+	       gint64 sector;
+
+	       if(fr->erasureMap[loc] == 3)  /* erasure came from CRC error */
+	       {  msg = _("-> CRC-predicted error in sector %lld%s at byte %4d (value %02x '%c', expected %02x '%c')\n");
+	       }
+	       else
+	       {  msg = _("-> Non-predicted error in sector %lld%s at byte %4d (value %02x '%c', expected %02x '%c')\n");
+		  if(fr->erasureMap[loc] == 0) /* remember error location */
+		  {  fr->erasureMap[loc] = 7;
+		     fr->errorCount++;  
+		  }
+	       }
+
+	       sector = RS03SectorIndex(lay, loc, s);
+	       if(eh->methodFlags[0] & MFLAG_ECC_FILE && loc >= ndata-1)
+		 type="(ecc)";
+	       else
+		 type="";
+		 
+	       log_result(fr, msg,
+			  sector, type, bi, 
+			  old, canprint(old) ? old : '.',
+			  new, canprint(new) ? new : '.');
+	    }
+	 }
+	 else  /* in non-debug mode, apply the only non-printf-preparing code of the above block */
+	 {
+	    if (fr->erasureMap[loc] == 0)
+	    {  fr->erasureMap[loc] = 7;
+	       fr->errorCount++;
+	    }
+	 }
+
+	 if(!fr->patch[loc])
+	   fr->patch[loc] = g_malloc0(2048);
+	 fr->patch[loc][bi] ^= error[j];
+      }
+   }
+}
+
+/***
+ *** The decoder threads.
+ ***
+ * Each decoder claims the next unprocessed ecc block from the
+ * oldest batch which has been handed over by the IO thread.
+ */
+
+static gpointer decoder_thread(fix_closure *fc)
+{  GThread *self = g_thread_self();
+   RSDecoder *dec = CreateRSDecoder(fc->rt);
+   int my_number = 0;
+   int i;
+
+   g_mutex_lock(fc->lock);
+
+   for(i=0; i<fc->nThreads; i++)
+     if(fc->thread[i] == self)
+       my_number = i;
+
+   for(;;)
+   {  fix_batch *fb;
+      int k;
+
+      while(   !fc->abortImmediately
+	    && fc->decodeBatch < fc->batchesTotal
+	    && (   fc->decodeBatch == fc->batchesRead
+		|| my_number >= fc->activeThreads))
+	g_cond_wait(fc->cond, fc->lock);
+
+      if(fc->abortImmediately || fc->decodeBatch >= fc->batchesTotal)
+	break;
+
+      fb = fc->batch[fc->decodeBatch & 1];
+      k  = fc->nextBlock++;
+      if(fc->nextBlock >= fb->nBlocks)
+      {  fc->decodeBatch++;
+	 fc->nextBlock = 0;
+      }
+      g_mutex_unlock(fc->lock);
+
+      decode_block(fc, dec, fb, k);
+
+      g_mutex_lock(fc->lock);
+      fb->result[k].done = TRUE;
+      g_cond_broadcast(fc->cond);
+   }
+
+   g_mutex_unlock(fc->lock);
+   FreeRSDecoder(dec);
+   return NULL;
+}
+
+/***
+ *** Reading and writing ecc blocks (only done in the IO thread)
+ ***/
+
+/* Advance fc->nextRead to the next ecc block containing damaged sectors */
+
+static void skip_undamaged(fix_closure *fc)
+{  gint64 spl = fc->lay->sectorsPerLayer;
+
+   if(!fc->needed)
+      return;
+
+   while(fc->nextRead < spl && !GetBit(fc->needed, fc->nextRead))
+      fc->nextRead++;
+}
+
+/* Fill the batch with the next fc->batchBlocks ecc blocks and
+   hand it over to the decoders. With a damage map, the batch
+   ends at the next ecc block without damaged sectors. */
+
+static void read_batch(fix_closure *fc, int n)
+{  Image *image = fc->image;
+   RS03Layout *lay = fc->lay;
+   fix_batch *fb = fc->batch[n & 1];
+   gint64 s = fc->nextRead;
+   int ndata = lay->ndata;
+   int i;
+
+   fb->firstBlock = s;
+   fb->nBlocks = fc->batchBlocks;
+   if(lay->sectorsPerLayer-s < fc->batchBlocks)
+      fb->nBlocks = lay->sectorsPerLayer-s;
+   if(fc->needed)
+   {  for(i=1; i<fb->nBlocks; i++)
+	 if(!GetBit(fc->needed, s+i))
+	    break;
+      fb->nBlocks = i;
+   }
+   fc->nextRead += fb->nBlocks;
+   skip_undamaged(fc);
+
+   /* Read the data, CRC and ecc layers in one go */
+
+   RS03ReadLayers(image, lay, fb->imgBlock, ndata+lay->nroots, s,
+		  fb->nBlocks, RS03_READ_ALL);
+
+   /* The CRCs for the first ecc block are in the CRC sector
+      of the preceeding ecc block, which has not been read
+      if it was skipped. */
+
+   if(fc->lastCrcBlock != s)
+      RS03ReadSectors(image, lay, (unsigned char*)fc->lastCrc,
+		      ndata-1, s-1, 1, RS03_READ_CRC);
+
+   /* Keep a copy of the last CRC sector for the next pass */
+
+   memcpy(fb->firstCrc, fc->lastCrc, 2048);
+   memcpy(fc->lastCrc, fb->imgBlock[ndata-1]+2048*(fb->nBlocks-1), 2048);
+   fc->lastCrcBlock = s + fb->nBlocks;
+
+   for(i=0; i<fb->nBlocks; i++)
+     fb->result[i].done = FALSE;
+
+   /* Wake up the decoders */
+
+   g_mutex_lock(fc->lock);
+   fc->batchesRead++;
+   if(fc->nextRead >= lay->sectorsPerLayer)
+     fc->batchesTotal = fc->batchesRead;
+   g_cond_broadcast(fc->cond);
+   g_mutex_unlock(fc->lock);
+}
+
+/* Wait until the given ecc block has been decoded */
+
+static fix_result* wait_for_block(fix_closure *fc, fix_batch *fb, int k)
+{  fix_result *fr = &fb->result[k];
+
+   g_mutex_lock(fc->lock);
+   while(!fr->done)
+     g_cond_wait(fc->cond, fc->lock);
+   g_mutex_unlock(fc->lock);
+
+   return fr;
+}
+
+/* Apply the corrections found by the decoder to the cached sectors */
+
+static void apply_patches(fix_batch *fb, int k)
+{  fix_result *fr = &fb->result[k];
+   int i,j;
+
+   for(i=0; i<255; i++)
+   {  unsigned char *dst = fb->imgBlock[i]+2048*k;
+      unsigned char *patch = fr->patch[i];
+
+      if(!patch) continue;
+
+      for(j=0; j<2048; j++)
+	dst[j] ^= patch[j];
+   }
+}
+
+/*
+ * Find the ecc blocks containing the sectors from the damage map.
+ * Returns NULL if the map can not be used for this image.
+ */
+
+static Bitmap *damaged_blocks(fix_closure *fc, gint64 expected_sectors)
+{  RS03Layout *lay = fc->lay;
+   DamageMap *dm;
+   Bitmap *needed;
+   gint64 s,damaged = 0;
+   int blocks = 0;
+
+   dm = LoadDamageMap(fc->image, Closure->damageMapFile);
+   if(!dm)
+   {  PrintLog(_("Processing all ecc blocks.\n"));
+      return NULL;
+   }
+
+   needed = CreateBitmap0(lay->sectorsPerLayer);
+
+   for(s=0; s<expected_sectors; s++)
+   {  gint64 block = s % lay->sectorsPerLayer;
+
+      if(!SectorIsDamaged(dm, s))
+	continue;
+
+      damaged++;
+      if(!GetBit(needed, block))
+      {  SetBit(needed, block);
+	 blocks++;
+      }
+   }
+
+   FreeDamageMap(dm);
+
+   PrintLog(_("Damage map: %" PRId64 " damaged sectors in %d of %" PRId64 " ecc blocks.\n"),
+	    damaged, blocks, lay->sectorsPerLayer);
+
+   return needed;
+}
+
 /***
  *** Test and fix the current image.
  ***/
@@ -128,18 +672,12 @@ void RS03Fix(Image *image)
    RS03Layout *lay;
    fix_closure *fc = g_malloc0(sizeof(fix_closure)); 
    EccHeader *eh;
-   gint32 *gf_index_of;
-   gint32 *gf_alpha_to;
-   gint64 block_idx[255];
    gint64 s;
-   guint32 *crc_buf, last_crc_sector1[512], last_crc_sector2[512];
    int nroots,ndata;
-   int crc_idx;
-   int crc_valid = TRUE;
-   int cache_size, cache_sector, cache_offset;
-   int erasure_count,erasure_list[255],erasure_map[255];
-   int error_count;
+   int cache_size, read_ahead;
+   int n_threads;
    int percent, last_percent;
+   int n;
    int worst_ecc = 0, local_plot_max = 0;
    int i,j;
    gint64 crc_errors=0;
@@ -152,6 +690,7 @@ void RS03Fix(Image *image)
    gint64 uncorrected=0;
    gint64 damaged_sectors=0;
    gint64 damaged_eccblocks=0;
+   gint64 skipped_eccblocks=0;
    gint64 damaged_eccsecs=0;
    gint64 expected_sectors;
    char *t=NULL;
@@ -168,6 +707,7 @@ void RS03Fix(Image *image)
    if(image->eccFileHeader)
         eh = image->eccFileHeader;
    else eh = image->eccHeader;
+   fc->eh = eh;
 
    /*** Open the image file */
 
@@ -191,8 +731,7 @@ void RS03Fix(Image *image)
 
    fc->gt      = CreateGaloisTables(RS_GENERATOR_POLY);
    fc->rt      = CreateReedSolomonTables(fc->gt, RS_FIRST_ROOT, RS_PRIM_ELEM, nroots);
-   gf_index_of = fc->gt->indexOf;
-   gf_alpha_to = fc->gt->alphaTo;
+   fc->decoder = CreateRSDecoder(fc->rt);
 
    /*** Expand a truncated image with "dead sector" markers.
         If the images have the same number of sectors but a 
@@ -352,554 +891,344 @@ void RS03Fix(Image *image)
 	on which the error correction is carried out. 
 	There is a total of lay->sectorsPerLayer ecc blocks.
 	A portion of cache_size sectors is read ahead from each layer,
-	giving a total cache size of 255*cache_size. */
+	giving a total cache size of 255*cache_size. 
+	Two such caches are used so that the next portion can be read
+	while the decoder threads are working on the current one.
+	With --auto-tune, the portions may grow up to twice that size. */
 
    cache_size = 2*Closure->cacheMiB;  /* ndata+nroots=255 medium sectors are approx. 0.5MiB */
+   fc->batchBlocks = cache_size;
 
-   for(i=0; i<255; i++)
-      fc->imgBlock[i] = g_malloc(cache_size*2048);
-
-   /*** Setup the block counters for mapping medium sectors to ecc blocks.
-	We begin at the first ecc block (0) */
-
-   for(s=0, i=0; i<lay->ndata; s+=lay->sectorsPerLayer, i++)
-     block_idx[i] = s;
-
-   cache_sector = cache_size;  /* forces instant reload of imgBlock cache */
-   cache_offset = 2048*cache_sector;
-
-   /*** CRC sums for the first ecc block are stored in the last CRC sector.
-	Error handling is done later when this sector is actually used. */
-
-   RS03ReadSectors(image, lay, 
-		   (unsigned char*)last_crc_sector2, 
-		   lay->ndata-1, lay->sectorsPerLayer-1, 1, RS03_READ_CRC);
-
-   /*** Test ecc blocks and attempt error correction */
-
-   last_percent = -1;
-
-   for(s=0; s<lay->sectorsPerLayer; s++)
-   { int bi;
+   if(Closure->autoTune)  /* tuned in units of MiB */
+   {  int start = Closure->tunedCacheMiB ? Closure->tunedCacheMiB : Closure->cacheMiB;
 
-     /* See if user hit the Stop button */
+      fc->tune = CreateAutoTune(start, 8, 2*MAX(Closure->cacheMiB, Closure->tunedCacheMiB));
+      cache_size = 2*fc->tune->maxChunk;
+      fc->batchBlocks = 2*fc->tune->chunk;
+   }
 
-     if(Closure->stopActions) 
-     {   if(Closure->stopActions == STOP_CURRENT_ACTION) /* suppress memleak warning when closing window */
-	 {  GuiSwitchAndSetFootline(fc->wl->fixNotebook, 1,
-				    fc->wl->fixFootline,
-				    _("<span %s>Aborted by user request!</span>"),
-				    Closure->redMarkup);
-	 }
-         fc->earlyTermination = FALSE;  /* suppress respective error message */
-	 goto terminate;
-     }
+   for(j=0; j<2; j++)
+   {  fix_batch *fb = fc->batch[j] = g_malloc0(sizeof(fix_batch));
 
-     /* Fill cache with the next batch of cache_size ecc blocks. */
+      for(i=0; i<255; i++)
+      {  fb->imgAligned[i] = CreateAlignedBuffer(cache_size*2048);
+	 fb->imgBlock[i] = fb->imgAligned[i]->buf;
+      }
+      fb->result = g_malloc0(cache_size*sizeof(fix_result));
+      fb->maxBlocks = cache_size;
+   }
 
-     if(cache_sector >= cache_size)
-     {  
-        if(lay->sectorsPerLayer-s < cache_size)
-           cache_size = lay->sectorsPerLayer-s;
+   /*** Reading the next portion ahead of writing out the current one
+	is only safe if the files are complete; otherwise the write
+	operations might change what is read from behind the file end. */
 
-	/* Read the data portion */
+   read_ahead = (lay->target == ECC_IMAGE
+		 || image->eccFile->size >= 2048*(lay->firstEccPos+nroots*lay->sectorsPerLayer));
 
-        for(i=0; i<ndata-1; i++)
-        {  
-	   RS03ReadSectors(image, lay, fc->imgBlock[i], i, s, 
-			   cache_size, RS03_READ_DATA);
-	}
+   /*** The batches are large enough to make up for the missing
+	kernel read-ahead when bypassing the page cache. */
 
-	/* Read from the CRC layer */
+   if(Closure->encodingIOStrategy == IO_STRATEGY_DIRECT)
+   {  LargeEnableDirectIO(image->file);
+      if(image->eccFile)
+	LargeEnableDirectIO(image->eccFile);
+   }
 
-	RS03ReadSectors(image, lay, fc->imgBlock[ndata-1], ndata-1, s,
-			cache_size, RS03_READ_CRC);
+   /*** CRC sums for the first ecc block are stored in the last CRC sector.
+	Error handling is done later when this sector is actually used. */
 
-	/* Keep a copy of the last CRC sector for the next pass */
-	memcpy(last_crc_sector1, last_crc_sector2, 2048);
-	memcpy(last_crc_sector2, fc->imgBlock[ndata-1]+2048*(cache_size-1), 2048);
+   RS03ReadSectors(image, lay, 
+		   (unsigned char*)fc->lastCrc, 
+		   lay->ndata-1, lay->sectorsPerLayer-1, 1, RS03_READ_CRC);
+   fc->lastCrcBlock = 0;
 
-	/* and finally the ecc portion */
+   /*** With a damage map, only the ecc blocks containing 
+	damaged image sectors need to be processed. */
 
-        for(i=0; i<nroots; i++)
-        {  
-	   RS03ReadSectors(image, lay, fc->imgBlock[i+ndata], i+ndata, s,
-			   cache_size, RS03_READ_ECC);
-	}
+   if(Closure->damageMapFile)
+      fc->needed = damaged_blocks(fc, expected_sectors);
 
-        cache_sector = cache_offset = 0;
-     }
+   /*** Spawn the decoder threads */
 
-     /* Set crc ptr to beginning of CRC sector. The first ECC block has no
-	CRC sector; the checksums are taken from the Ecc header instead. */
+   fc->lock = g_malloc(sizeof(GMutex)); g_mutex_init(fc->lock);
+   fc->cond = g_malloc(sizeof(GCond));  g_cond_init(fc->cond);
+   fc->batchesTotal = G_MAXINT;
+   n_threads = fc->tune ? fc->tune->maxThreads : Closure->codecThreads;
+   fc->activeThreads = fc->tune ? fc->tune->activeThreads : n_threads;
 
-     if(cache_sector==0) 
-     {  int err;
+   g_mutex_lock(fc->lock);  /* fc->thread[i] = ... may produce race condition */
+   for(i=0; i<n_threads; i++) 
+   {  GError *err = NULL;
 
-        crc_buf = last_crc_sector1;
-	err = CheckForMissingSector((unsigned char*)crc_buf, 
-				    lay->firstCrcPos,
-				    eh->mediumFP, eh->fpSector);
-	crc_valid = (err == SECTOR_PRESENT);
-     }
-     else
-     {  int err;
+      fc->thread[i] = g_thread_try_new("decoder", (GThreadFunc)decoder_thread, (gpointer)fc, &err);
+      if(!fc->thread[i])
+      {  g_mutex_unlock(fc->lock);
+         Stop("Could not create decoder thread: %s", err->message);
+      }
+      fc->nThreads++;
+   }
+   g_mutex_unlock(fc->lock);
 
-	crc_buf   = (guint32*)(fc->imgBlock[ndata-1]+cache_offset-2048);
+   /*** Test ecc blocks and attempt error correction.
+	The decoders work on the ecc blocks in arbitrary order,
+	but the results are collected and written out here
+	in the natural order of the ecc blocks. */
 
-	err = CheckForMissingSector((unsigned char*)crc_buf, 
-				    block_idx[ndata-1],
-				    eh->mediumFP, eh->fpSector);
-	crc_valid = (err == SECTOR_PRESENT);
-     }
-     crc_idx = 0;
+   last_percent = -1;
 
-     /*** Look for erasures based on the "dead sector" marker and CRC sums */
+   skip_undamaged(fc);
+   if(fc->nextRead < lay->sectorsPerLayer)
+      read_batch(fc, 0);
+   else  /* damage map lists no damaged sectors */
+   {  g_mutex_lock(fc->lock);
+      fc->batchesTotal = 0;
+      g_cond_broadcast(fc->cond);
+      g_mutex_unlock(fc->lock);
+   }
 
-     erasure_count = error_count = 0;
+   for(n=0; n<fc->batchesTotal; n++)
+   { fix_batch *fb = fc->batch[n & 1];
+     int k;
 
-     /* Check the data sectors */
+     if(read_ahead && n+1 < fc->batchesTotal)
+     {  read_batch(fc, n+1);
 
-     for(i=0; i<lay->ndata; i++)  
-     {  int err = CheckForMissingSector(fc->imgBlock[i]+cache_offset, block_idx[i],
-					eh->mediumFP, eh->fpSector);
-       /* FIXME: sector number is wrong for CRC layer in ecc files */
-       /* FIXME: Auto-replace the padding sectors */
+        /* The decoders are CPU bound if they are still working
+	   on the previous batch. Without reading ahead there is
+	   no overlap to measure, so nothing is adapted then. */
 
-        if(err == SECTOR_PRESENT)
-	{  erasure_map[i] = 0;
-	}
-	else
-	{  erasure_map[i] = 1;
-	   erasure_list[erasure_count++] = i;
-	   damaged_sectors++;
-	}
+        if(fc->tune)
+	{  int cpu_bound;
 
-	if(i < ndata-1)     /* only data sectors have CRCs */
-	{  guint32 crc = Crc32(fc->imgBlock[i]+cache_offset, 2048);
+	   g_mutex_lock(fc->lock);
+	   cpu_bound = fc->decodeBatch <= n;
+	   g_mutex_unlock(fc->lock);
 
-	   if(crc_valid && !erasure_map[i] && crc != crc_buf[crc_idx])
-	   {  erasure_map[i] = 3;
-	      erasure_list[erasure_count++] = i;
-	      PrintCLI(_("CRC error in sector %" PRId64 "\n"),block_idx[i]);
-	      damaged_sectors++;
-	      crc_errors++;
+	   if(AutoTuneChunk(fc->tune, cpu_bound, 2048.0*GF_FIELDMAX*fb->nBlocks))
+	   {  g_mutex_lock(fc->lock);
+	      fc->activeThreads = fc->tune->activeThreads;
+	      g_cond_broadcast(fc->cond);
+	      g_mutex_unlock(fc->lock);
+	      fc->batchBlocks = 2*fc->tune->chunk;
 	   }
-
-	   data_count++;
-	   crc_idx++;
-	}
-	else crc_count++;
-     }
-
-     /* Check the ecc sectors */
-
-     for(i=lay->ndata; i<GF_FIELDMAX; i++)
-     {  int err = CheckForMissingSector(fc->imgBlock[i]+cache_offset,
-					RS03SectorIndex(lay, i, s),
-					eh->mediumFP, eh->fpSector);
-
-	if(err)
-	{  erasure_map[i] = 1;
-	   erasure_list[erasure_count++] = i;
-	   damaged_sectors++;
 	}
-        else erasure_map[i] = 0;
-
-	ecc_count++;
-     }
-
-     /* Trivially reject uncorrectable ecc block */
-
-     if(erasure_count>lay->nroots)   /* uncorrectable */
-     {  if(!Closure->guiMode)
-	{  int sep_printed = 0;
-
-           PrintCLI(_("* Ecc block %" PRId64 ": %3d unrepairable sectors: "), s, erasure_count);
-
-	   for(i=0; i<erasure_count; i++)
-	   {  /* sector counting wraps to 0 for ecc files after the data layer */
-              if(eh->methodFlags[0] & MFLAG_ECC_FILE && erasure_list[i] >= ndata-1 && ! sep_printed)
-	      {  PrintCLI("; ecc file: ");
-                 sep_printed = 1;
-              }
-              PrintCLI("%" PRId64 " ", RS03SectorIndex(lay, erasure_list[i], s));
-	   }
-	   PrintCLI("\n");
-     }
-
-	uncorrected += erasure_count;
-	goto skip;
      }
 
-     /* Build ecc block and attempt to correct it */
-
-     for(bi=0; bi<2048; bi++)  /* Run through each ecc block byte */
-     {  int offset = cache_offset+bi;
-        int r, deg_lambda, el, deg_omega;
-	int u,q,tmp,num1,num2,den,discr_r;
-	int lambda[nroots+1], syn[nroots]; /* Err+Eras Locator poly * and syndrome poly */
-	int b[nroots+1], t[nroots+1], omega[nroots+1];
-	int root[nroots], reg[nroots+1], loc[nroots];
-	int syn_error, count;
-	int k;
-
-	/* Form the syndromes; i.e., evaluate data(x) at roots of g(x) */
+     for(k=0; k<fb->nBlocks; k++)
+     { fix_result *fr;
+       int cache_offset = 2048*k;
+       int erasure_count;
 
-	for(i=0; i<nroots; i++)
-	  syn[i] = fc->imgBlock[0][offset];
+       s = fb->firstBlock + k;
 
-	for(j=1; j<GF_FIELDMAX; j++)
-	{  int data = fc->imgBlock[j][offset];
+       /* See if user hit the Stop button */
 
-	   for(i=0;i<nroots;i++)
-	   {  if(syn[i] == 0) syn[i] = data;
-	      else syn[i] = data ^ gf_alpha_to[mod_fieldmax(gf_index_of[syn[i]] + (RS_FIRST_ROOT+i)*RS_PRIM_ELEM)];
+       if(Closure->stopActions) 
+       {   if(Closure->stopActions == STOP_CURRENT_ACTION) /* suppress memleak warning when closing window */
+	   {  GuiSwitchAndSetFootline(fc->wl->fixNotebook, 1,
+				      fc->wl->fixFootline,
+				      _("<span %s>Aborted by user request!</span>"),
+				      Closure->redMarkup);
 	   }
-	}
+	   fc->earlyTermination = FALSE;  /* suppress respective error message */
+	   goto terminate;
+       }
 
-	/* Convert syndromes to index form, check for nonzero condition */
+       fr = wait_for_block(fc, fb, k);
 
-	syn_error = 0;
-	for(i=0; i<nroots; i++)
-	{  syn_error |= syn[i];
-	   syn[i] = gf_index_of[syn[i]];
-	}
+       if(fr->log)
+	 PrintCLI("%s", fr->log->str);
 
-	/* If it is already correct by coincidence, we have nothing to do any further */
+       damaged_sectors += fr->damagedSectors;
+       crc_errors      += fr->crcErrors;
+       damaged_eccblocks += fr->damagedBytes;
+       data_count += ndata-1;
+       crc_count++;
+       ecc_count += nroots;
 
-	if(syn_error) damaged_eccblocks++; 
-	else continue;
+       erasure_count = fr->erasureCount;
 
-	//printf("Syndrome error for ecc block %lld, byte %d\n",s,bi);
+       if(fr->status == FIX_BLOCK_SKIPPED)
+	 skipped_eccblocks++;
 
-	/* If we have found any erasures, 
-	   initialize lambda to be the erasure locator polynomial */
+       /* Trivially reject uncorrectable ecc block */
 
-	memset(lambda+1, 0, nroots*sizeof(lambda[0]));
-	lambda[0] = 1;
+       if(fr->status == FIX_BLOCK_TOO_MANY)   /* uncorrectable */
+       {  if(!Closure->guiMode)
+	  {  int sep_printed = 0;
 
-	if(erasure_count > 0)
-	{  lambda[1] = gf_alpha_to[mod_fieldmax(RS_PRIM_ELEM*(GF_FIELDMAX-1-erasure_list[0]))];
-	   for(i=1; i<erasure_count; i++) 
-	   {  u = mod_fieldmax(RS_PRIM_ELEM*(GF_FIELDMAX-1-erasure_list[i]));
-	      for(j=i+1; j>0; j--) 
-	      {  tmp = gf_index_of[lambda[j-1]];
-	         if(tmp != GF_ALPHA0)
-		   lambda[j] ^= gf_alpha_to[mod_fieldmax(u + tmp)];
-	      }
-	   }
-	}	
-
-	for(i=0; i<nroots+1; i++)
-	  b[i] = gf_index_of[lambda[i]];
-  
-	/* Begin Berlekamp-Massey algorithm to determine error+erasure locator polynomial */
-
-	r = erasure_count;   /* r is the step number */
-	el = erasure_count;
-	while(++r <= nroots) /* Compute discrepancy at the r-th step in poly-form */
-	{  
-	  discr_r = 0;
-	  for(i=0; i<r; i++)
-	    if((lambda[i] != 0) && (syn[r-i-1] != GF_ALPHA0))
-	      discr_r ^= gf_alpha_to[mod_fieldmax(gf_index_of[lambda[i]] + syn[r-i-1])];
-
-	  discr_r = gf_index_of[discr_r];	/* Index form */
-
-	  if(discr_r == GF_ALPHA0) 
-	  {  /* B(x) = x*B(x) */
-	    memmove(b+1, b, nroots*sizeof(b[0]));
-	    b[0] = GF_ALPHA0;
-	  } 
-	  else 
-	  {  /* T(x) = lambda(x) - discr_r*x*b(x) */
-	     t[0] = lambda[0];
-	     for(i=0; i<nroots; i++) 
-	     {  if(b[i] != GF_ALPHA0)
-		     t[i+1] = lambda[i+1] ^ gf_alpha_to[mod_fieldmax(discr_r + b[i])];
-	        else t[i+1] = lambda[i+1];
-	     }
+	     PrintCLI(_("* Ecc block %" PRId64 ": %3d unrepairable sectors: "), s, erasure_count);
 
-	     if(2*el <= r+erasure_count-1) 
-	     {  el = r + erasure_count - el;
-
-	        /* B(x) <-- inv(discr_r) * lambda(x) */
-	        for(i=0; i<=nroots; i++)
-		  b[i] = (lambda[i] == 0) ? GF_ALPHA0 : mod_fieldmax(gf_index_of[lambda[i]] - discr_r + GF_FIELDMAX);
-	     } 
-	     else 
-	     {  /* 2 lines below: B(x) <-- x*B(x) */
-	        memmove(b+1, b, nroots*sizeof(b[0]));
-		b[0] = GF_ALPHA0;
+	     for(i=0; i<erasure_count; i++)
+	     {  /* sector counting wraps to 0 for ecc files after the data layer */
+		if(eh->methodFlags[0] & MFLAG_ECC_FILE && fr->erasureList[i] >= ndata-1 && ! sep_printed)
+		{  PrintCLI("; ecc file: ");
+		   sep_printed = 1;
+		}
+		PrintCLI("%" PRId64 " ", RS03SectorIndex(lay, fr->erasureList[i], s));
 	     }
-
-	     memcpy(lambda,t,(nroots+1)*sizeof(t[0]));
+	     PrintCLI("\n");
 	  }
-	}
-
-	/* Convert lambda to index form and compute deg(lambda(x)) */
-	deg_lambda = 0;
-	for(i=0; i<nroots+1; i++)
-	{  lambda[i] = gf_index_of[lambda[i]];
-	   if(lambda[i] != GF_ALPHA0)
-	     deg_lambda = i;
-	}
-
-	/* Find roots of the error+erasure locator polynomial by Chien search */
-	memcpy(reg+1, lambda+1, nroots*sizeof(reg[0]));
-	count = 0;		/* Number of roots of lambda(x) */
-
-	for(i=1, k=RS_PRIMTH_ROOT-1; i<=GF_FIELDMAX; i++, k=mod_fieldmax(k+RS_PRIMTH_ROOT))
-	{  q=1; /* lambda[0] is always 0 */
-
-	   for(j=deg_lambda; j>0; j--)
-	   {  if(reg[j] != GF_ALPHA0) 
-	      {  reg[j] = mod_fieldmax(reg[j] + j);
-		 q ^= gf_alpha_to[reg[j]];
-	      }
-	   }
-
-	   if(q != 0) continue; /* Not a root */
-
-	   /* store root (index-form) and error location number */
-
-	   root[count] = i;
-	   loc[count] = k;
-
-	   /* If we've already found max possible roots, abort the search to save time */
-
-	   if(++count == deg_lambda) break;
-	}
-
-	/* deg(lambda) unequal to number of roots => uncorrectable error detected */
-
-	if(deg_lambda != count)
-	{  int sep_printed = 0;
-           PrintLog("Decoder problem (%d != %d) for %d sectors: ", deg_lambda, count, erasure_count);
-
-	   for(i=0; i<erasure_count; i++)
-	   {  /* sector counting wraps to 0 for ecc files after the data layer */
-              if(eh->methodFlags[0] & MFLAG_ECC_FILE && erasure_list[i] >= ndata-1 && ! sep_printed)
-	      {  PrintCLI(_("; ecc file: "));
-                 sep_printed = 1;
-              }
-              PrintCLI("%" PRId64 " ", RS03SectorIndex(lay, erasure_list[i], s));
-	   }
-	   PrintCLI("\n");
-	   uncorrected += erasure_count;
-	   goto skip;
-	}
-
-	/* Compute err+eras evaluator poly omega(x) = syn(x)*lambda(x) 
-	   (modulo x**nroots). in index form. Also find deg(omega). */
-
-	deg_omega = deg_lambda-1;
-
-	for(i=0; i<=deg_omega; i++)
-	{  tmp = 0;
-	   for(j=i; j>=0; j--)
-	   {  if((syn[i - j] != GF_ALPHA0) && (lambda[j] != GF_ALPHA0))
-	        tmp ^= gf_alpha_to[mod_fieldmax(syn[i - j] + lambda[j])];
-	   }
-
-	   omega[i] = gf_index_of[tmp];
-	}
 
-	/* Compute error values in poly-form. 
-	   num1 = omega(inv(X(l))), 
-	   num2 = inv(X(l))**(FIRST_ROOT-1) and 
-	   den  = lambda_pr(inv(X(l))) all in poly-form. */
+	  uncorrected += erasure_count;
+	  goto skip;
+       }
 
-	for(j=count-1; j>=0; j--)
-	{  num1 = 0;
+       /* Apply the corrections to the cached sectors.
+	  If the CRC sector was changed, the next ecc block
+	  has seen the wrong checksums and must be decoded again. */
 
-	   for(i=deg_omega; i>=0; i--) 
-	   {  if(omega[i] != GF_ALPHA0)
-	         num1 ^= gf_alpha_to[mod_fieldmax(omega[i] + i * root[j])];
-	   }
+       if(fr->patch[ndata-1] && k+1 < fb->nBlocks)
+       {  wait_for_block(fc, fb, k+1);
+	  apply_patches(fb, k);
+	  decode_block(fc, fc->decoder, fb, k+1);
+       }
+       else apply_patches(fb, k);
 
-	   num2 = gf_alpha_to[mod_fieldmax(root[j] * (RS_FIRST_ROOT - 1) + GF_FIELDMAX)];
-	   den = 0;
-    
-	   /* lambda[i+1] for i even is the formal derivative lambda_pr of lambda[i] */
+       /* deg(lambda) unequal to number of roots => uncorrectable error detected */
 
-	   for(i=MIN(deg_lambda, nroots-1) & ~1; i>=0; i-=2) 
-	   {  if(lambda[i+1] != GF_ALPHA0)
-	        den ^= gf_alpha_to[mod_fieldmax(lambda[i+1] + i * root[j])];
-	   }
+       if(fr->status == FIX_BLOCK_DEC_FAILED)
+       {  int sep_printed = 0;
+	  PrintLog("Decoder problem (%d != %d) for %d sectors: ", fr->degLambda, fr->rootCount, erasure_count);
 
-	   /* Apply error to data */
-
-	   if(num1 != 0)
-	   {  int location = loc[j];
-
-	      if((Closure->debugMode && Closure->verbose) || Closure->regtestMode)
-	      {  if (erasure_map[location] != 1)  /* erasure came from CRC error */
-	         {  int old = fc->imgBlock[location][offset];
-		    int new = old ^ gf_alpha_to[mod_fieldmax(gf_index_of[num1] + gf_index_of[num2] + GF_FIELDMAX - gf_index_of[den])];
-		    char *msg, *type;
-		    gint64 sector;
-
-		    if(erasure_map[location] == 3)  /* erasure came from CRC error */
-		    {  msg = _("-> CRC-predicted error in sector %lld%s at byte %4d (value %02x '%c', expected %02x '%c')\n");
-		    }
-		    else
-		    {  msg = _("-> Non-predicted error in sector %lld%s at byte %4d (value %02x '%c', expected %02x '%c')\n");
-		       if(erasure_map[location] == 0) /* remember error location */
-		       {  erasure_map[location] = 7;
-		          error_count++;  
-		       }
-		    }
-
-		    sector = RS03SectorIndex(lay, location, s);
-		    if(eh->methodFlags[0] & MFLAG_ECC_FILE && location >= ndata-1)
-		      type="(ecc)";
-		    else
-		      type="";
-		 
-		    PrintCLI(msg,
-	                     sector, type, bi, 
-			     old, canprint(old) ? old : '.',
-			     new, canprint(new) ? new : '.');
-	         }
-	      }
-	      else  /* in non-debug mode, apply the only non-printf-preparing code of the above block */
-	      {
-	         if (erasure_map[location] == 0)
-	         {  erasure_map[location] = 7;
-	            error_count++;
-	         }
-	      }
-
-	      fc->imgBlock[location][offset] ^= gf_alpha_to[mod_fieldmax(gf_index_of[num1] + gf_index_of[num2] + GF_FIELDMAX - gf_index_of[den])];
-	   }
-	}
-     }
+	  for(i=0; i<erasure_count; i++)
+	  {  /* sector counting wraps to 0 for ecc files after the data layer */
+	     if(eh->methodFlags[0] & MFLAG_ECC_FILE && fr->erasureList[i] >= ndata-1 && ! sep_printed)
+	     {  PrintCLI(_("; ecc file: "));
+		sep_printed = 1;
+	     }
+	     PrintCLI("%" PRId64 " ", RS03SectorIndex(lay, fr->erasureList[i], s));
+	  }
+	  PrintCLI("\n");
+	  uncorrected += erasure_count;
+	  goto skip;
+       }
 
-     /* Write corrected sectors back to disc
-        and report them */
+       /* Write corrected sectors back to disc
+	  and report them */
 
-     erasure_count += error_count;  /* total errors encountered */
+       erasure_count += fr->errorCount;  /* total errors encountered */
 
-     if(erasure_count)
-     {  int sep_printed = 0;
-        PrintCLI(_("  %3d repaired sectors: "), erasure_count);
+       if(erasure_count)
+       {  int sep_printed = 0;
+	  PrintCLI(_("  %3d repaired sectors: "), erasure_count);
 
-        for(i=0; i<255; i++)
-        {  gint64 sec;
-           char type='?';
-	   int length,n;
+	  for(i=0; i<255; i++)
+	  {  gint64 sec;
+	     char type='?';
+	     int length,m;
 	   
-	   if(!erasure_map[i]) continue;
+	     if(!fr->erasureMap[i]) continue;
 
-	   switch(erasure_map[i])
-	   {  case 1:  /* dead sector */
-	        type = 'd';
-	        break;
+	     switch(fr->erasureMap[i])
+	     {  case 1:  /* dead sector */
+		  type = 'd';
+		  break;
 
-	      case 3:  /* crc error */
-	        type = 'c';
-	        break;
+		case 3:  /* crc error */
+		  type = 'c';
+		  break;
 
-	      case 7:  /* other (new) error */
-		type = 'n';
-		damaged_sectors++;
-	        break;
-	   }
+		case 7:  /* other (new) error */
+		  type = 'n';
+		  damaged_sectors++;
+		  break;
+	     }
 
-	   sec = RS03SectorIndex(lay, i, s);
-	   if(i < ndata) {  data_corr++;  }
-	   else          {  ecc_corr++;   }
-	   corrected++;
+	     sec = RS03SectorIndex(lay, i, s);
+	     if(i < ndata) {  data_corr++;  }
+	     else          {  ecc_corr++;   }
+	     corrected++;
 
-	   if(eh->methodFlags[0] & MFLAG_ECC_FILE && i >= ndata-1 && ! sep_printed)
-	   {  PrintCLI(_("; ecc file: "));
-              sep_printed = 1;
-           }
-	   PrintCLI("%" PRId64 "%c ", sec, type);
+	     if(eh->methodFlags[0] & MFLAG_ECC_FILE && i >= ndata-1 && ! sep_printed)
+	     {  PrintCLI(_("; ecc file: "));
+		sep_printed = 1;
+	     }
+	     PrintCLI("%" PRId64 "%c ", sec, type);
 
-	   /* Write the recovered sector */
+	     /* Write the recovered sector */
 
-	   if(sec != lay->dataSectors-1) length = 2048;
-	   else length = eh->inLast;  /* non-image file may be clipped */
+	     if(sec != lay->dataSectors-1) length = 2048;
+	     else length = eh->inLast;  /* non-image file may be clipped */
 
-	   /* Write back into the image */
+	     /* Write back into the image */
 
-	   if(   lay->target == ECC_IMAGE 
-	      || i < ndata-1)
-	   {
-	      if(!LargeSeek(image->file, (gint64)(2048*sec)))
-		 Stop(_("Failed seeking to sector %" PRId64 " in image [%s]: %s"),
-		      sec, "FW", strerror(errno));
+	     if(   lay->target == ECC_IMAGE 
+		|| i < ndata-1)
+	     {
+		if(!LargeSeek(image->file, (gint64)(2048*sec)))
+		   Stop(_("Failed seeking to sector %" PRId64 " in image [%s]: %s"),
+			sec, "FW", strerror(errno));
 
-	      n = LargeWrite(image->file, cache_offset+fc->imgBlock[i], length);
-	      if(n != length)
-		 Stop(_("could not write medium sector %" PRId64 ":\n%s"), sec, strerror(errno));
-	   }
+		m = LargeWrite(image->file, cache_offset+fb->imgBlock[i], length);
+		if(m != length)
+		   Stop(_("could not write medium sector %" PRId64 ":\n%s"), sec, strerror(errno));
+	     }
 
-	   /* Write back into the error correction file
-	      (for the CRC and ECC portion of the ecc block).
-	      Note that "sec" contains the virtual adresses as
-	      if we were processing an augmented image. */
-
-	   if(lay->target == ECC_FILE && i >= ndata-1)
-	   {  
-              if(!LargeSeek(image->eccFile, (gint64)(2048*sec)))
-		 Stop(_("Failed seeking to sector %" PRId64 " in ecc file [%s]: %s"),
-		      sec, "FW", strerror(errno));
-
-	      n = LargeWrite(image->eccFile, cache_offset+fc->imgBlock[i], 2048);
-	      if(n != 2048)
-		Stop(_("could not write ecc file sector %" PRId64 ":\n%s"),
-		     sec, strerror(errno));
-	   }
-	}
-	PrintCLI("\n");
-     }
+	     /* Write back into the error correction file
+		(for the CRC and ECC portion of the ecc block).
+		Note that "sec" contains the virtual adresses as
+		if we were processing an augmented image. */
+
+	     if(lay->target == ECC_FILE && i >= ndata-1)
+	     {  
+		if(!LargeSeek(image->eccFile, (gint64)(2048*sec)))
+		   Stop(_("Failed seeking to sector %" PRId64 " in ecc file [%s]: %s"),
+			sec, "FW", strerror(errno));
+
+		m = LargeWrite(image->eccFile, cache_offset+fb->imgBlock[i], 2048);
+		if(m != 2048)
+		  Stop(_("could not write ecc file sector %" PRId64 ":\n%s"),
+		       sec, strerror(errno));
+	     }
+	  }
+	  PrintCLI("\n");
+       }
 
 skip:
-     /* Collect some damage statistics */
-     
-     if(erasure_count)
-       damaged_eccsecs++;
-
-     if(erasure_count>worst_ecc)
-       worst_ecc = erasure_count;
+       free_result(fr);
 
-     if(erasure_count>local_plot_max)
-       local_plot_max = erasure_count;
+       /* Collect some damage statistics */
+     
+       if(erasure_count)
+	 damaged_eccsecs++;
 
-     /* Advance the cache pointers */
+       if(erasure_count>worst_ecc)
+	 worst_ecc = erasure_count;
 
-     cache_sector++;
-     cache_offset += 2048;
+       if(erasure_count>local_plot_max)
+	 local_plot_max = erasure_count;
 
-     /* Report progress */
+       /* Report progress */
 
-     percent = (1000*s)/lay->sectorsPerLayer;
+       percent = (1000*s)/lay->sectorsPerLayer;
 
-     if(last_percent != percent) 
-     {
+       if(last_percent != percent) 
+       {
 #ifdef WITH_GUI_YES
-        if(Closure->guiMode)
-	{  
-	   RS03AddFixValues(wl, percent, local_plot_max);
-	   local_plot_max = 0;
+	  if(Closure->guiMode)
+	  {  
+	     RS03AddFixValues(wl, percent, local_plot_max);
+	     local_plot_max = 0;
 
-	   //if(last_corrected != corrected || last_uncorrected != uncorrected) 
-	   RS03UpdateFixResults(wl, corrected, uncorrected);
-	}
-        else
+	     //if(last_corrected != corrected || last_uncorrected != uncorrected) 
+	     RS03UpdateFixResults(wl, corrected, uncorrected);
+	  }
+	  else
 #endif
-	  PrintProgress(_("Ecc progress: %3d.%1d%%"),percent/10,percent%10);
-        last_percent = percent;
+	    PrintProgress(_("Ecc progress: %3d.%1d%%"),percent/10,percent%10);
+	  last_percent = percent;
+       }
      }
 
-     /* Increment the block indices */
+     if(!read_ahead && n+1 < fc->batchesTotal)
+       read_batch(fc, n+1);
+   }
 
-     for(i=0; i<lay->ndata; i++)
-	block_idx[i]++;
+   if(fc->tune)
+   {  AutoTuneRemember(fc->tune, &Closure->tunedCacheMiB, 1);
+      Verbose("Auto-tuned to %d threads and %dMiB cache.\n",
+	      fc->tune->activeThreads, fc->tune->chunk);
    }
 
    /*** Print results */
@@ -924,6 +1253,13 @@ skip:
            PrintLog("%s\n", t);
 	   exitCode = 0;
       }
+      else if(skipped_eccblocks)
+      {    t=_("Good! All detected errors are repaired.");
+	   PrintLog("%s\n", t);
+	   PrintLog(_("%" PRId64 " ecc blocks with intact data sectors were not decoded; "
+		      "use --paranoid to check their ecc sectors, too.\n"), skipped_eccblocks);
+	   exitCode = 1;
+      }
       else 
       {    t=_("Good! All sectors are repaired.");
 	   PrintLog("%s\n", t);
@@ -945,20 +1281,26 @@ skip:
    Verbose("%" PRId64 " of %" PRId64 " ecc blocks damaged (%" PRId64 " / %" PRId64 " sectors)\n",
 	   damaged_eccblocks, 2048*lay->sectorsPerLayer,
 	   damaged_eccsecs, lay->sectorsPerLayer);
-   if(data_count != (ndata-1)*lay->sectorsPerLayer)
-        g_printf("ONLY %lld of %lld data sectors processed\n", 
-		 (long long int)data_count, (long long int)(ndata-1)*lay->sectorsPerLayer);
-   else Verbose("all data sectors processed\n");
-
-   if(crc_count != lay->sectorsPerLayer)
-        g_printf("%lld of %lld crc sectors processed\n", 
-		 (long long int)crc_count, (long long int)lay->sectorsPerLayer);
-   else Verbose("all  crc sectors processed\n");
-
-   if(ecc_count != nroots*lay->sectorsPerLayer)
-        g_printf("%lld of %lld ecc sectors processed\n", 
-		 (long long int)ecc_count, (long long int)nroots*lay->sectorsPerLayer);
-   else Verbose("all  ecc sectors processed\n");
+   if(fc->needed)
+   {  Verbose("%" PRId64 " of %" PRId64 " ecc blocks processed (damage map)\n",
+	      crc_count, lay->sectorsPerLayer);
+   }
+   else
+   {  if(data_count != (ndata-1)*lay->sectorsPerLayer)
+	   g_printf("ONLY %lld of %lld data sectors processed\n", 
+		    (long long int)data_count, (long long int)(ndata-1)*lay->sectorsPerLayer);
+      else Verbose("all data sectors processed\n");
+
+      if(crc_count != lay->sectorsPerLayer)
+	   g_printf("%lld of %lld crc sectors processed\n", 
+		    (long long int)crc_count, (long long int)lay->sectorsPerLayer);
+      else Verbose("all  crc sectors processed\n");
+
+      if(ecc_count != nroots*lay->sectorsPerLayer)
+	   g_printf("%lld of %lld ecc sectors processed\n", 
+		    (long long int)ecc_count, (long long int)nroots*lay->sectorsPerLayer);
+      else Verbose("all  ecc sectors processed\n");
+   }
 
    /*** Clean up */
 
@@ -101,10 +101,10 @@ typedef struct
    GtkWidget *redundancySpinA, *redundancySpinB;
    GtkWidget *prefetchScaleA, *prefetchScaleB;
    GtkWidget *threadsScaleA, *threadsScaleB;
-   GtkWidget *eaRadio1A,*eaRadio2A,*eaRadio3A,*eaRadio4A;
-   GtkWidget *eaRadio1B,*eaRadio2B,*eaRadio3B,*eaRadio4B;
-   GtkWidget *ioRadio1A,*ioRadio2A;
-   GtkWidget *ioRadio1B,*ioRadio2B;
+   GtkWidget *eaRadio1A,*eaRadio2A,*eaRadio3A,*eaRadio4A,*eaRadio5A,*eaRadio6A;
+   GtkWidget *eaRadio1B,*eaRadio2B,*eaRadio3B,*eaRadio4B,*eaRadio5B,*eaRadio6B;
+   GtkWidget *ioRadio1A,*ioRadio2A,*ioRadio3A;
+   GtkWidget *ioRadio1B,*ioRadio2B,*ioRadio3B;
    LabelWithOnlineHelp *prefetchLwoh;
    LabelWithOnlineHelp *threadsLwoh;
 
@@ -176,6 +176,7 @@ typedef struct _RS03Layout
 
 CrcBuf *RS03GetCrcBuf(Image *image);
 void RS03ReadSectors(Image*, RS03Layout*, unsigned char*, gint64, gint64, gint64, int);
+void RS03ReadLayers(Image*, RS03Layout*, unsigned char**, int, gint64, gint64, int);
 
 gint64 RS03SectorIndex(RS03Layout*, gint64, gint64);
 RS03Layout *CalcRS03Layout(Image*, int);
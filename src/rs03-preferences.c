@@ -137,6 +137,20 @@ static void encoding_alg_cb(GtkWidget *widget, gpointer data)
       activate_toggle_button(GTK_TOGGLE_BUTTON(wl->eaRadio4A), TRUE); 
       activate_toggle_button(GTK_TOGGLE_BUTTON(wl->eaRadio4B), TRUE); 
    }
+
+   if(widget == wl->eaRadio5A || widget == wl->eaRadio5B)
+   {  Closure->encodingAlgorithm = ENCODING_ALG_AVX2;
+
+      activate_toggle_button(GTK_TOGGLE_BUTTON(wl->eaRadio5A), TRUE); 
+      activate_toggle_button(GTK_TOGGLE_BUTTON(wl->eaRadio5B), TRUE); 
+   }
+
+   if(widget == wl->eaRadio6A || widget == wl->eaRadio6B)
+   {  Closure->encodingAlgorithm = ENCODING_ALG_AVX512;
+
+      activate_toggle_button(GTK_TOGGLE_BUTTON(wl->eaRadio6A), TRUE); 
+      activate_toggle_button(GTK_TOGGLE_BUTTON(wl->eaRadio6B), TRUE); 
+   }
 }
 
 /*
@@ -163,6 +177,13 @@ static void io_strategy_cb(GtkWidget *widget, gpointer data)
       activate_toggle_button(GTK_TOGGLE_BUTTON(wl->ioRadio2A), TRUE); 
       activate_toggle_button(GTK_TOGGLE_BUTTON(wl->ioRadio2B), TRUE); 
    }
+
+   if(widget == wl->ioRadio3A || widget == wl->ioRadio3B)
+   {  Closure->encodingIOStrategy = IO_STRATEGY_DIRECT;
+
+      activate_toggle_button(GTK_TOGGLE_BUTTON(wl->ioRadio3A), TRUE);
+      activate_toggle_button(GTK_TOGGLE_BUTTON(wl->ioRadio3B), TRUE);
+   }
 }
 
 /*
@@ -499,7 +520,7 @@ void CreateRS03PrefsPage(Method *method, GtkWidget *parent)
 
    for(i=0; i<2; i++)
    {  GtkWidget *hbox = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 4);
-      GtkWidget *radio1, *radio2;
+      GtkWidget *radio1, *radio2, *radio3=NULL;
 
       gtk_box_pack_start(GTK_BOX(hbox), i ? lwoh->normalLabel : lwoh->linkBox, FALSE, FALSE, 0);
       if (!i) gtk_box_pack_start(GTK_BOX(hbox), lwoh->tooltip, FALSE, FALSE, 0);
@@ -863,19 +884,32 @@ void CreateRS03PrefsPage(Method *method, GtkWidget *parent)
       lab = gtk_label_new(_utf("memory mapped"));
       gtk_container_add(GTK_CONTAINER(radio2), lab);
 
+#if defined(HAVE_O_DIRECT) && !defined(SYS_MINGW)
+      radio3 = gtk_radio_button_new_from_widget(GTK_RADIO_BUTTON(radio1));
+      g_signal_connect(G_OBJECT(radio3), "toggled", G_CALLBACK(io_strategy_cb), (gpointer)wl);
+      gtk_box_pack_start(GTK_BOX(hbox), radio3, FALSE, FALSE, 0);
+      lab = gtk_label_new(_utf("direct"));
+      gtk_container_add(GTK_CONTAINER(radio3), lab);
+#endif
+
       switch(Closure->encodingIOStrategy)
       {  case IO_STRATEGY_READWRITE: activate_toggle_button(GTK_TOGGLE_BUTTON(radio1), TRUE); break;
          case IO_STRATEGY_MMAP:      activate_toggle_button(GTK_TOGGLE_BUTTON(radio2), TRUE); break;
+         case IO_STRATEGY_DIRECT:
+	    if(radio3) activate_toggle_button(GTK_TOGGLE_BUTTON(radio3), TRUE);
+	    break;
       }
 
       if(!i)
       {  wl->ioRadio1A = radio1;
 	 wl->ioRadio2A = radio2;
+	 wl->ioRadio3A = radio3;
 	 gtk_box_pack_start(GTK_BOX(vbox), hbox, FALSE, FALSE, 0);
       }
       else  
       {  wl->ioRadio1B = radio1;
 	 wl->ioRadio2B = radio2;
+	 wl->ioRadio3B = radio3;
 	 GuiAddHelpWidget(lwoh, hbox);
       }
    }
@@ -895,7 +929,11 @@ void CreateRS03PrefsPage(Method *method, GtkWidget *parent)
      "affected by poor caching and preloading decisions made by the kernel (since the kernel does not "
      "know what dvdisaster is going to do with the data). This scheme "
      "performs well when encoding in a RAM-based file system (such as /dev/shm on GNU/Linux) "
-     "and on very fast media with low latency such as SSDs."
+     "and on very fast media with low latency such as SSDs.\n\n"
+     "The <b>direct</b> option works like read/write, but bypasses the kernel's file cache. "
+     "Since the image is read only once, caching it has no benefit; direct I/O keeps "
+     "encoding large images from evicting the cached data of other programs. "
+     "It is also used when verifying and fixing images."
  			    ));
 
    /*** Number of threads */
@@ -973,7 +1011,7 @@ void CreateRS03PrefsPage(Method *method, GtkWidget *parent)
 
    for(i=0; i<2; i++)
    {  GtkWidget *hbox = gtk_box_new(GTK_ORIENTATION_HORIZONTAL, 4);
-      GtkWidget *radio1, *radio2, *radio3=NULL, *radio4;
+      GtkWidget *radio1, *radio2, *radio3=NULL, *radio4, *radio5=NULL, *radio6=NULL;
 
       gtk_box_pack_start(GTK_BOX(hbox), i ? lwoh->normalLabel : lwoh->linkBox, FALSE, FALSE, 0);
       if(!i) gtk_box_pack_start(GTK_BOX(hbox), lwoh->tooltip, FALSE, FALSE, 0);
@@ -997,6 +1035,20 @@ void CreateRS03PrefsPage(Method *method, GtkWidget *parent)
 	 lab = gtk_label_new(_utf("SSE2"));
 	 gtk_container_add(GTK_CONTAINER(radio3), lab);
       }
+      if(Closure->useAVX2)
+      {  radio5 = gtk_radio_button_new_from_widget(GTK_RADIO_BUTTON(radio2));
+	 g_signal_connect(G_OBJECT(radio5), "toggled", G_CALLBACK(encoding_alg_cb), (gpointer)wl);
+	 gtk_box_pack_start(GTK_BOX(hbox), radio5, FALSE, FALSE, 0);
+	 lab = gtk_label_new(_utf("AVX2"));
+	 gtk_container_add(GTK_CONTAINER(radio5), lab);
+      }
+      if(Closure->useAVX512)
+      {  radio6 = gtk_radio_button_new_from_widget(GTK_RADIO_BUTTON(radio2));
+	 g_signal_connect(G_OBJECT(radio6), "toggled", G_CALLBACK(encoding_alg_cb), (gpointer)wl);
+	 gtk_box_pack_start(GTK_BOX(hbox), radio6, FALSE, FALSE, 0);
+	 lab = gtk_label_new(_utf("AVX512"));
+	 gtk_container_add(GTK_CONTAINER(radio6), lab);
+      }
       if(Closure->useAltiVec)
       {  radio3 = gtk_radio_button_new_from_widget(GTK_RADIO_BUTTON(radio2));
 	 g_signal_connect(G_OBJECT(radio3), "toggled", G_CALLBACK(encoding_alg_cb), (gpointer)wl);
@@ -1017,6 +1069,12 @@ void CreateRS03PrefsPage(Method *method, GtkWidget *parent)
          case ENCODING_ALG_64BIT:   activate_toggle_button(GTK_TOGGLE_BUTTON(radio2), TRUE); break;
          case ENCODING_ALG_SSE2:    
          case ENCODING_ALG_ALTIVEC: activate_toggle_button(GTK_TOGGLE_BUTTON(radio3), TRUE); break;
+         case ENCODING_ALG_AVX2:    
+	    if(radio5) activate_toggle_button(GTK_TOGGLE_BUTTON(radio5), TRUE); 
+	    break;
+         case ENCODING_ALG_AVX512:  
+	    if(radio6) activate_toggle_button(GTK_TOGGLE_BUTTON(radio6), TRUE); 
+	    break;
       }
 
       if(!i)
@@ -1024,6 +1082,8 @@ void CreateRS03PrefsPage(Method *method, GtkWidget *parent)
 	 wl->eaRadio2A = radio2;
 	 wl->eaRadio3A = radio3;
 	 wl->eaRadio4A = radio4;
+	 wl->eaRadio5A = radio5;
+	 wl->eaRadio6A = radio6;
 	 gtk_box_pack_start(GTK_BOX(vbox), hbox, FALSE, FALSE, 0);
       }
       else  
@@ -1031,6 +1091,8 @@ void CreateRS03PrefsPage(Method *method, GtkWidget *parent)
 	 wl->eaRadio2B = radio2;
 	 wl->eaRadio3B = radio3;
 	 wl->eaRadio4B = radio4;
+	 wl->eaRadio5B = radio5;
+	 wl->eaRadio6B = radio6;
 	 GuiAddHelpWidget(lwoh, hbox);
       }
    }
@@ -1042,9 +1104,10 @@ void CreateRS03PrefsPage(Method *method, GtkWidget *parent)
      "processor specific extensions.\n\n"
      "Available extensions are SSE2 for x86 based processors and AltiVec "
      "on PowerPC processors. These extensions encode with 128bit wide operations "
-     "and will usually provide the fastest encoding variant. If \"auto\" is selected, the "
-     "SSE2/AltiVec algorithms will be selected if the processor supports them; "
-     "otherwise the 64bit algorithm will be used."
+     "and will usually provide the fastest encoding variant. Newer x86 processors "
+     "may also offer AVX2 and AVX512 which use 256bit and 512bit wide operations. "
+     "If \"auto\" is selected, the widest of these algorithms supported "
+     "by the processor will be used; otherwise the 64bit algorithm will be used."
 			    ));
 }
 #endif /* WITH_GUI_YES */
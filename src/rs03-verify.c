@@ -26,14 +26,6 @@
 
 #include "rs03-includes.h"
 
-#define EXIT_CODE_SIZE_MISMATCH 1
-#define EXIT_CODE_VERSION_MISMATCH 2
-
-#define EXIT_CODE_UNEXPECTED_EOF 10
-#define EXIT_CODE_MISSING_SECTOR 11
-#define EXIT_CODE_CHECKSUM_ERROR 12
-#define EXIT_CODE_SYNDROME_ERROR 13
-
 #ifdef WITH_GUI_YES
 
 /***
@@ -409,17 +401,66 @@ typedef struct
    CrcBuf *crcBuf;
    Bitmap *map;
    unsigned char crcSum[16];
-   unsigned char *eccBlock[256];
+   MD5Pipe *imageMD5;               /* md5sum of the data portion */
+   AlignedBuffer *readAhead;        /* sectors read ahead while scanning */
+   AlignedBuffer *eccAligned[2][256];
+   unsigned char *eccBlock[2][256];  /* double buffered for the syndrome check */
    GaloisTables *gt;
    ReedSolomonTables *rt;
+
+   /* Shared between the reader and the syndrome checking threads */
+
+   GMutex *lock;
+   GCond *cond;
+   GThread *thread[MAX_CODEC_THREADS];
+   int nThreads;
+   int activeThreads;       /* threads allowed to take work */
+   int abortImmediately;
+   gint64 chunkFirst[2];    /* first ecc block in each buffer */
+   int chunkSize[2];        /* number of ecc blocks in each buffer */
+   int *badSub[2];          /* bad sub blocks per ecc block; -1 while unchecked */
+   int chunkBlocks;         /* ecc blocks per chunk */
+   gint64 nextRead;         /* first ecc block of the next chunk */
+   int chunksRead;          /* chunks handed over to the checking threads */
+   int chunksTotal;         /* known after the last chunk has been read */
+   AutoTune *tune;          /* only with --auto-tune */
+   int checkChunk;          /* chunk currently being distributed */
+   int nextBlock;           /* next unclaimed ecc block in that chunk */
+   VerifyState *vs;         /* only with --verify-state */
+   gint64 skippedBlocks;    /* unchanged ecc blocks not read in */
+   int syndromesChecked;    /* syndrome check has run to completion */
 } verify_closure;
 
+static void stop_syndrome_threads(verify_closure *vc)
+{  int i;
+
+   if(!vc->lock)
+     return;
+
+   g_mutex_lock(vc->lock);
+   vc->abortImmediately = TRUE;
+   g_cond_broadcast(vc->cond);
+   g_mutex_unlock(vc->lock);
+
+   for(i=0; i<vc->nThreads; i++)
+     g_thread_join(vc->thread[i]);
+   vc->nThreads = 0;
+
+   g_mutex_clear(vc->lock);
+   g_free(vc->lock);
+   vc->lock = NULL;
+   g_cond_clear(vc->cond);
+   g_free(vc->cond);
+}
+
 static void cleanup(gpointer data)
 {  verify_closure *vc = (verify_closure*)data;
    int i;
 
    UnregisterCleanup();
 
+   stop_syndrome_threads(vc);
+
    GuiAllowActions(TRUE);
 
    if(vc->image) CloseImage(vc->image);
@@ -428,13 +469,22 @@ static void cleanup(gpointer data)
    }
    if(vc->map) FreeBitmap(vc->map);
    if(vc->crcBuf) FreeCrcBuf(vc->crcBuf);
+   if(vc->imageMD5) FreeMD5Pipe(vc->imageMD5);
+   if(vc->readAhead) FreeAlignedBuffer(vc->readAhead);
 
    for(i=0; i<255; i++)
-      if(vc->eccBlock[i])
-	 g_free(vc->eccBlock[i]);
+   {  if(vc->eccAligned[0][i])
+	 FreeAlignedBuffer(vc->eccAligned[0][i]);
+      if(vc->eccAligned[1][i])
+	 FreeAlignedBuffer(vc->eccAligned[1][i]);
+   }
+   if(vc->badSub[0]) g_free(vc->badSub[0]);
+   if(vc->badSub[1]) g_free(vc->badSub[1]);
 
    if(vc->gt) FreeGaloisTables(vc->gt);
    if(vc->rt) FreeReedSolomonTables(vc->rt);
+   if(vc->tune) FreeAutoTune(vc->tune);
+   if(vc->vs) FreeVerifyState(vc->vs);
 
    g_free(vc);
 
@@ -509,37 +559,161 @@ static int prognosis(verify_closure *vc, gint64 missing, gint64 expected)
  *** Error syndrome check
  ***/
 
+/*
+ * The checking threads. Each one claims the next unchecked ecc block
+ * from the oldest chunk which has been read in, and counts the
+ * byte positions with nonzero error syndromes.
+ */
+
+static gpointer syndrome_thread(verify_closure *vc)
+{  GThread *self = g_thread_self();
+   int my_number = 0;
+   int i;
+
+   g_mutex_lock(vc->lock);
+
+   for(i=0; i<vc->nThreads; i++)
+     if(vc->thread[i] == self)
+       my_number = i;
+
+   for(;;)
+   {  unsigned char **buf;
+      int chunk,k,bad;
+
+      while(   !vc->abortImmediately
+	    && vc->checkChunk < vc->chunksTotal
+	    && (   vc->checkChunk == vc->chunksRead
+		|| my_number >= vc->activeThreads))
+	g_cond_wait(vc->cond, vc->lock);
+
+      if(vc->abortImmediately || vc->checkChunk >= vc->chunksTotal)
+	break;
+
+      chunk = vc->checkChunk & 1;
+      k = vc->nextBlock++;
+      if(vc->nextBlock >= vc->chunkSize[chunk])
+      {  vc->checkChunk++;
+	 vc->nextBlock = 0;
+      }
+      g_mutex_unlock(vc->lock);
+
+      /* Calculate the error syndromes.
+	 Note that we are only called when the image does not contain
+	 dead sector markers; therefore we can skip this test. */
+
+      buf = vc->eccBlock[chunk];
+      bad = CountErrorSyndromes(vc->rt, buf, 2048*k, 2048);
+
+      g_mutex_lock(vc->lock);
+      vc->badSub[chunk][k] = bad;
+      g_cond_broadcast(vc->cond);
+   }
+
+   g_mutex_unlock(vc->lock);
+   return NULL;
+}
+
+/*
+ * Read the next chunk of ecc blocks and hand it over
+ * to the checking threads.
+ */
+
+static void read_syndrome_chunk(verify_closure *vc, int n)
+{  RS03Layout *lay = vc->lay;
+   int chunk = n & 1;
+   gint64 ecc_block;
+   gint64 num_sectors = vc->chunkBlocks;
+   int k;
+
+   /* Skip the ecc blocks which have not changed since the last verify */
+
+   if(vc->vs)
+   {  VerifyState *vs = vc->vs;
+      gint64 group = vc->nextRead / vs->groupBlocks;
+      gint64 run_end;
+
+      while(group < vs->groups && !VerifyGroup(vs, group))
+	group++;
+
+      ecc_block = MIN(group*vs->groupBlocks, lay->sectorsPerLayer);
+      vc->skippedBlocks += ecc_block - vc->nextRead;
+      vc->nextRead = ecc_block;
+
+      if(ecc_block >= lay->sectorsPerLayer)  /* nothing left to check */
+      {  g_mutex_lock(vc->lock);
+	 vc->chunksTotal = vc->chunksRead;
+	 g_cond_broadcast(vc->cond);
+	 g_mutex_unlock(vc->lock);
+	 return;
+      }
+
+      while(group < vs->groups && VerifyGroup(vs, group))
+	group++;
+      run_end = MIN(group*vs->groupBlocks, lay->sectorsPerLayer);
+      num_sectors = MIN(num_sectors, run_end - ecc_block);
+   }
+
+   ecc_block = vc->nextRead;
+   if(ecc_block+num_sectors >= lay->sectorsPerLayer)
+      num_sectors = lay->sectorsPerLayer - ecc_block;
+
+   RS03ReadLayers(vc->image, lay, vc->eccBlock[chunk], GF_FIELDMAX,
+		  ecc_block, num_sectors, RS03_READ_ALL);
+
+   vc->chunkFirst[chunk] = ecc_block;
+   vc->chunkSize[chunk]  = num_sectors;
+   for(k=0; k<num_sectors; k++)
+     vc->badSub[chunk][k] = -1;
+   vc->nextRead += num_sectors;
+
+   g_mutex_lock(vc->lock);
+   vc->chunksRead++;
+   if(vc->nextRead >= lay->sectorsPerLayer)
+     vc->chunksTotal = vc->chunksRead;
+   g_cond_broadcast(vc->cond);
+   g_mutex_unlock(vc->lock);
+}
+
 static int check_syndromes(verify_closure *vc)
 {  RS03Layout *lay = vc->lay;
-   Image *image = vc->image;
-   gint64 li,ecc_block;
-   gint64 cache_idx = Closure->prefetchSectors;
+   gint64 ecc_block;
    gint64 ecc_good, ecc_bad, ecc_bad_sub;
    int percent,last_percent = -1;
-   int bad_counted;
-   int layer,i,j;
+   int max_blocks, n_threads;
+   int n,i,j;
 
    GuiSetLabelText(vc->wl->cmpHeadline, "<big>%s</big>\n<i>%s</i>",
 		   _("Checking the image and error correction files."),
 		   _("- Checking ecc blocks (deep verify) -"));
 
-   /* Allocate buffers and initialize layer sector addresses */
+   /* Allocate buffers. The prefetch is split into two halves so that
+      the next chunk can be read while the current one is being checked.
+      With --auto-tune, chunks may grow up to twice that size. */
 
-   for(i=0, li=0; i<GF_FIELDMAX; i++,li+=lay->sectorsPerLayer)
-   {  
-      vc->eccBlock[i] = g_try_malloc(2048*Closure->prefetchSectors);
-      if(!vc->eccBlock[i])  /* out of memory */
-      {  int j;
+   if(Closure->autoTune)
+   {  int prefetch = MAX(Closure->prefetchSectors, Closure->tunedPrefetch);
+      int start = Closure->tunedPrefetch ? Closure->tunedPrefetch : Closure->prefetchSectors;
 
-	 for(j=0; j<i; j++)
-	    g_free(vc->eccBlock[j]);
+      vc->tune = CreateAutoTune(MAX(1, start/2), 16, MIN(prefetch, MAX_PREFETCH_CACHE_SIZE/2));
+      max_blocks = vc->tune->maxChunk;
+      vc->chunkBlocks = vc->tune->chunk;
+   }
+   else max_blocks = vc->chunkBlocks = MAX(1, Closure->prefetchSectors/2);
 
-	 GuiSetLabelText(vc->wl->cmpEccSyndromes,
-			 _("<span %s>Out of memory; try reducing sector prefetch!</span>"),
-			 Closure->redMarkup);
-	 PrintLog(_("* Ecc block test   : out of memory; try reducing sector prefetch!\n"));
-	 return 0;
+   for(j=0; j<2; j++)
+   {  for(i=0; i<GF_FIELDMAX; i++)
+      {  
+	 vc->eccAligned[j][i] = TryCreateAlignedBuffer(2048*max_blocks);
+	 if(!vc->eccAligned[j][i])  /* out of memory */
+	 {  GuiSetLabelText(vc->wl->cmpEccSyndromes,
+			    _("<span %s>Out of memory; try reducing sector prefetch!</span>"),
+			    Closure->redMarkup);
+	    PrintLog(_("* Ecc block test   : out of memory; try reducing sector prefetch!\n"));
+	    return 0;
+	 }
+	 vc->eccBlock[j][i] = vc->eccAligned[j][i]->buf;
       }
+      vc->badSub[j] = g_malloc(sizeof(int)*max_blocks);
    }
 
    /* Init Reed-Solomon tables */
@@ -547,92 +721,128 @@ static int check_syndromes(verify_closure *vc)
    vc->gt = CreateGaloisTables(RS_GENERATOR_POLY);
    vc->rt = CreateReedSolomonTables(vc->gt, RS_FIRST_ROOT, RS_PRIM_ELEM, lay->nroots);
 
-   /* Check the error syndromes */
-
-   ecc_good = ecc_bad = ecc_bad_sub = 0;
+   /* Spawn the checking threads */
 
-   for(ecc_block=0; ecc_block<lay->sectorsPerLayer; ecc_block++)
-   {  gint64 num_sectors = 0; 
-      unsigned char data[GF_FIELDMAX];
+   vc->lock = g_malloc(sizeof(GMutex)); g_mutex_init(vc->lock);
+   vc->cond = g_malloc(sizeof(GCond));  g_cond_init(vc->cond);
+   vc->chunksTotal = G_MAXINT;
+   n_threads = vc->tune ? vc->tune->maxThreads : Closure->codecThreads;
+   vc->activeThreads = vc->tune ? vc->tune->activeThreads : n_threads;
 
-      /* Check for user interruption */
+   g_mutex_lock(vc->lock);  /* vc->thread[i] = ... may produce race condition */
+   for(i=0; i<n_threads; i++) 
+   {  GError *err = NULL;
 
-      if(Closure->stopActions)   
-      {  if(Closure->stopActions == STOP_CURRENT_ACTION) /* suppress memleak warning when closing window */
-	 {  GuiSetLabelText(vc->wl->cmpEccSyndromes, 
-			    _("<span %s>Aborted by user request!</span>"),
-			    Closure->redMarkup);
-	 }
-         return 0;
+      vc->thread[i] = g_thread_try_new("syndromes", (GThreadFunc)syndrome_thread, (gpointer)vc, &err);
+      if(!vc->thread[i])
+      {  g_mutex_unlock(vc->lock);
+         Stop("Could not create syndrome checking thread: %s", err->message);
       }
+      vc->nThreads++;
+   }
+   g_mutex_unlock(vc->lock);
 
-      /* Reload cache? */
-      
-      if(cache_idx == Closure->prefetchSectors)
-      {  
-	 cache_idx = 0;
-	 num_sectors = Closure->prefetchSectors;
-	 if(ecc_block+num_sectors >= lay->sectorsPerLayer)
-	    num_sectors = lay->sectorsPerLayer - ecc_block;
-
-	 for(layer=0; layer<GF_FIELDMAX; layer++)
-	   if(layer < lay->ndata-1)
-	     RS03ReadSectors(image, vc->lay, vc->eccBlock[layer], 
-			    layer, ecc_block, num_sectors, RS03_READ_DATA);
-	   else
-	     RS03ReadSectors(image, vc->lay, vc->eccBlock[layer], 
-			    layer, ecc_block, num_sectors, RS03_READ_CRC | RS03_READ_ECC);
-      }
+   /* Check the error syndromes. We are the reader thread and
+      collect the results in ecc block order. */
 
-      /* Calculate the error syndromes.
-	 Note that we are only called when the image does not contain
-	 dead sector markers; therefore we can skip this test. */
+   ecc_good = ecc_bad = ecc_bad_sub = 0;
 
-      bad_counted = FALSE;
+   read_syndrome_chunk(vc, 0);
 
-      for(i=0; i<2048; i++) 
-      {  int result;
+   for(n=0; n<vc->chunksTotal; n++)
+   {  int chunk = n & 1;
+      int k;
 
-	 for(j=0; j<GF_FIELDMAX; j++)
-	   data[j] = vc->eccBlock[j][2048*cache_idx+i];
+      if(n+1 < vc->chunksTotal)
+      {  read_syndrome_chunk(vc, n+1);
 
-	 result = TestErrorSyndromes(vc->rt, data);
+	 /* The checking threads are CPU bound if they are still
+	    working on the previous chunk. Adapt their number and
+	    the size of the chunks read from now on. */
 
-	 if(result)
-	 {  ecc_bad_sub++;
-	    if(!bad_counted)
-	    {  bad_counted++;
-	       ecc_bad++;
+	 if(vc->tune)
+	 {  int cpu_bound;
+
+	    g_mutex_lock(vc->lock);
+	    cpu_bound = vc->checkChunk <= n;
+	    g_mutex_unlock(vc->lock);
+
+	    if(AutoTuneChunk(vc->tune, cpu_bound, 2048.0*GF_FIELDMAX*vc->chunkSize[chunk]))
+	    {  g_mutex_lock(vc->lock);
+	       vc->activeThreads = vc->tune->activeThreads;
+	       g_cond_broadcast(vc->cond);
+	       g_mutex_unlock(vc->lock);
+	       vc->chunkBlocks = vc->tune->chunk;
 	    }
 	 }
       }
-      cache_idx++;
 
-      if(!bad_counted) ecc_good++;
+      for(k=0; k<vc->chunkSize[chunk]; k++)
+      {  int bad;
 
-      /* Advance percentage gauge */
+	 ecc_block = vc->chunkFirst[chunk] + k;
 
-      percent = (100*(ecc_block+1))/lay->sectorsPerLayer;
-      if(percent != last_percent)
-      {  last_percent = percent;
+	 /* Check for user interruption */
 
-	 if(!ecc_bad)
-	 {  GuiSetLabelText(vc->wl->cmpEccSyndromes,
-			    _("%d%% tested"),
-			    percent);
-	    PrintProgress(_("- Ecc block test   : %d%% tested"), percent);
+	 if(Closure->stopActions)   
+	 {  if(Closure->stopActions == STOP_CURRENT_ACTION) /* suppress memleak warning when closing window */
+	    {  GuiSetLabelText(vc->wl->cmpEccSyndromes, 
+			       _("<span %s>Aborted by user request!</span>"),
+			       Closure->redMarkup);
+	    }
+	    stop_syndrome_threads(vc);
+	    return 0;
+	 }
+
+	 /* Wait for the result of this ecc block */
 
+	 g_mutex_lock(vc->lock);
+	 while((bad = vc->badSub[chunk][k]) < 0)
+	   g_cond_wait(vc->cond, vc->lock);
+	 g_mutex_unlock(vc->lock);
+
+	 if(bad)
+	 {  ecc_bad_sub += bad;
+	    ecc_bad++;
+	    if(vc->vs)
+	      MarkGroupDefective(vc->vs, ecc_block/vc->vs->groupBlocks);
 	 }
-	 else
-	 {  GuiSetLabelText(vc->wl->cmpEccSyndromes,
-			    _("<span %s>%" PRId64 " good, %" PRId64 " bad; %d%% tested</span>"),
-			    Closure->redMarkup, ecc_good, ecc_bad, percent);
-	    PrintProgress(_("* Ecc block test   : %" PRId64 " good, %" PRId64 " bad; %d%% tested")
-			  , ecc_good, ecc_bad, percent);
+	 else ecc_good++;
+
+	 /* Advance percentage gauge */
+
+	 percent = (100*(ecc_block+1))/lay->sectorsPerLayer;
+	 if(percent != last_percent)
+	 {  last_percent = percent;
+
+	    if(!ecc_bad)
+	    {  GuiSetLabelText(vc->wl->cmpEccSyndromes,
+			       _("%d%% tested"),
+			       percent);
+	       PrintProgress(_("- Ecc block test   : %d%% tested"), percent);
+
+	    }
+	    else
+	    {  GuiSetLabelText(vc->wl->cmpEccSyndromes,
+			       _("<span %s>%" PRId64 " good, %" PRId64 " bad; %d%% tested</span>"),
+			       Closure->redMarkup, ecc_good, ecc_bad, percent);
+	       PrintProgress(_("* Ecc block test   : %" PRId64 " good, %" PRId64 " bad; %d%% tested")
+			     , ecc_good, ecc_bad, percent);
+	    }
 	 }
       }
    }
 
+   stop_syndrome_threads(vc);
+   ecc_good += vc->skippedBlocks;
+   vc->syndromesChecked = TRUE;
+
+   if(vc->tune)
+   {  AutoTuneRemember(vc->tune, &Closure->tunedPrefetch, 2);
+      Verbose("Auto-tuned to %d threads and %d ecc blocks per chunk.\n",
+	      vc->tune->activeThreads, vc->tune->chunk);
+   }
+
    /* Tell user about our findings */
 
    if(!ecc_bad)
@@ -652,6 +862,63 @@ static int check_syndromes(verify_closure *vc)
    return ecc_bad;
 }
 
+/***
+ *** Incremental verify
+ ***/
+
+/*
+ * A group of ecc blocks covers a stripe of sectors in each of the
+ * 255 layers. Layers are consecutive in augmented images; in the
+ * ecc file case the crc and ecc layers follow the file header
+ * in the ecc file.
+ */
+
+/* Keep the state small by grouping ecc blocks */
+
+static gint64 group_blocks(RS03Layout *lay)
+{  return MAX(16, (lay->sectorsPerLayer+1023)/1024);
+}
+
+static void verify_stripe(gpointer data, gint64 group, int layer,
+			  int *file, guint64 *offset, guint64 *length)
+{  verify_closure *vc = (verify_closure*)data;
+   RS03Layout *lay = vc->lay;
+   gint64 first = group*group_blocks(lay);
+   gint64 count = MIN(group_blocks(lay), lay->sectorsPerLayer - first);
+
+   if(lay->target == ECC_FILE && layer >= lay->ndata-1)
+   {  *file   = 1;
+      *offset = 2048*(2 + (layer-(lay->ndata-1))*lay->sectorsPerLayer + first);
+   }
+   else
+   {  *file   = 0;
+      *offset = 2048*(layer*lay->sectorsPerLayer + first);
+   }
+   *length = 2048*count;
+}
+
+static void create_verify_state(verify_closure *vc)
+{  RS03Layout *lay = vc->lay;
+   struct MD5Context md5ctxt;
+   guint8 layout_id[16];
+   gint64 groups;
+
+   groups = (lay->sectorsPerLayer+group_blocks(lay)-1)/group_blocks(lay);
+
+   MD5Init(&md5ctxt);
+   MD5Update(&md5ctxt, (unsigned char*)vc->eh, sizeof(EccHeader));
+   MD5Update(&md5ctxt, (unsigned char*)&lay->target, sizeof(lay->target));
+   MD5Final(layout_id, &md5ctxt);
+
+   vc->vs = CreateVerifyState(vc->image, Closure->verifyStateFile, groups, group_blocks(lay),
+			      GF_FIELDMAX, verify_stripe, vc, layout_id);
+
+   if(vc->vs->fullVerify)
+        PrintLog(_("- incremental mode : full verify; %s\n"), vc->vs->reason);
+   else PrintLog(_("- incremental mode : %" PRId64 " of %" PRId64 " ecc block groups unchanged since last verify\n"),
+		 vc->vs->unchanged, groups);
+}
+
 /***
  *** The verify action
  ***/
@@ -663,12 +930,14 @@ void RS03Verify(Image *image)
    EccHeader *eh = NULL;
    RS03Layout *lay;
    RS03CksumClosure *csc;
-   struct MD5Context image_md5;
    unsigned char medium_sum[16];
    char data_digest[33], hdr_digest[33];
+   char *data_md5 = data_digest;
+   int partial_verify;
    gint64 s, crc_idx;
+   gint64 ahead_first = 0, ahead_count = 0;
    int last_percent = 0;
-   unsigned char buf[2048];
+   unsigned char *buf;
    gint64 first_missing, last_missing;
    gint64 total_missing,data_missing,crc_missing,ecc_missing;
    gint64 new_missing = 0, new_crc_errors = 0;
@@ -1008,6 +1277,12 @@ void RS03Verify(Image *image)
    vc->crcBuf = self->getCrcBuf(vc->image);
    csc = (RS03CksumClosure*)self->ckSumClosure;
 
+   /*** Find out which ecc blocks need to be verified */
+
+   if(Closure->verifyStateFile)
+     create_verify_state(vc);
+   partial_verify = vc->vs && vc->vs->unchanged;
+
    /*** Check the data portion of the image file for the
 	"dead sector marker" and CRC errors */
    
@@ -1018,7 +1293,14 @@ void RS03Verify(Image *image)
      if(!LargeSeek(image->eccFile, 4096))  /* skip the header */
        Stop(_("Failed seeking to start of ecc file: %s\n"), strerror(errno));
 
-   MD5Init(&image_md5);
+   if(Closure->encodingIOStrategy == IO_STRATEGY_DIRECT)
+   {  LargeEnableDirectIO(image->file);
+      if(image->eccFile)
+	LargeEnableDirectIO(image->eccFile);
+   }
+
+   vc->imageMD5 = CreateMD5Pipe();
+   vc->readAhead = CreateAlignedBuffer(2048*Closure->prefetchSectors);
 
    first_missing = last_missing = -1;
    total_missing = data_missing = crc_missing = ecc_missing = 0;
@@ -1028,6 +1310,7 @@ void RS03Verify(Image *image)
    for(s=0; s<virtual_expected; s++)
    {  int percent,current_missing;
       int defective = 0;
+      gint64 layer_sector = s%lay->sectorsPerLayer;
 
       /* Check for user interruption */
 
@@ -1040,20 +1323,44 @@ void RS03Verify(Image *image)
          goto terminate;
       }
 
-      /* Read the next sector */
+      /* Read the next sector. Sectors are read ahead in batches
+	 (which must not cross a layer boundary), since there is
+	 no read-ahead by the kernel when using direct I/O. */
+
+      /* Sectors of unchanged ecc blocks are taken as good
+	 from the last verify. */
+
+      if(partial_verify && !VerifyGroup(vc->vs, layer_sector/vc->vs->groupBlocks))
+      {  buf = NULL;
+	 current_missing = SECTOR_PRESENT;
+	 goto sector_checked;
+      }
+
+      if(s >= ahead_first + ahead_count)
+      {  ahead_first = s;
+	 ahead_count = MIN(Closure->prefetchSectors, lay->sectorsPerLayer - layer_sector);
+	 ahead_count = MIN(ahead_count, virtual_expected - s);
 
-      RS03ReadSectors(image, vc->lay, buf,
-		      s/vc->lay->sectorsPerLayer,
-		      s%vc->lay->sectorsPerLayer,
-		      1,
-		      RS03_READ_DATA|RS03_READ_CRC|RS03_READ_ECC);
+	 if(partial_verify)  /* do not read ahead into unchanged ecc blocks */
+	 {  gint64 group = layer_sector/vc->vs->groupBlocks;
 
-      /* update the MD5 sum */
+	    while(group < vc->vs->groups && VerifyGroup(vc->vs, group))
+	      group++;
+	    ahead_count = MIN(ahead_count, group*vc->vs->groupBlocks - layer_sector);
+	 }
 
-      if(s < lay->dataSectors)
+	 RS03ReadSectors(image, vc->lay, vc->readAhead->buf,
+			 s/lay->sectorsPerLayer, layer_sector, ahead_count,
+			 RS03_READ_DATA|RS03_READ_CRC|RS03_READ_ECC);
+      }
+      buf = vc->readAhead->buf + 2048*(s - ahead_first);
+
+      /* update the MD5 sum; pointless if sectors are skipped */
+
+      if(s < lay->dataSectors && !partial_verify)
       {  if(s < lay->dataSectors - 1)
-	      MD5Update(&image_md5, buf, 2048);
-	 else MD5Update(&image_md5, buf, eh->inLast);
+	      MD5PipeUpdate(vc->imageMD5, buf, 2048);
+	 else MD5PipeUpdate(vc->imageMD5, buf, eh->inLast);
       }
 
       /* Look for the dead sector marker */
@@ -1105,6 +1412,8 @@ void RS03Verify(Image *image)
 	 exitCode = EXIT_CODE_MISSING_SECTOR;
       }
 
+sector_checked:
+
       /* Report dead sectors. Combine subsequent missing sectors into one report. */
 
       if(!current_missing || s==virtual_expected-1)
@@ -1133,7 +1442,7 @@ void RS03Verify(Image *image)
       /* If the image sector is from the data portion and it was readable, 
 	 test its CRC sum */
 
-      if(   !current_missing
+      if(   !current_missing && buf
 	 && (   (lay->target == ECC_IMAGE && s < lay->firstCrcPos)
 	     || (lay->target == ECC_FILE && s < lay->dataSectors)))
       {  guint32 crc = Crc32(buf, 2048);
@@ -1150,7 +1459,9 @@ void RS03Verify(Image *image)
       crc_idx++;
 
       if(!defective)
-	SetBit(vc->map, s);
+	   SetBit(vc->map, s);
+      else if(vc->vs)
+	   MarkGroupDefective(vc->vs, layer_sector/vc->vs->groupBlocks);
 
 #ifdef WITH_GUI_YES      
       if(Closure->guiMode) 
@@ -1245,16 +1556,33 @@ void RS03Verify(Image *image)
       }
    }
    
+   /* Remember the damaged image sectors for a subsequent fix.
+      The ecc file part is not covered by the map. */
+
+   if(Closure->damageMapFile)
+   {  DamageMap *dm;
+
+      GetImageFingerprint(image, NULL, eh->fpSector);
+      dm = CreateDamageMap(image, expected_image_sectors);
+      for(s=0; s<expected_image_sectors; s++)
+	 if(!GetBit(vc->map, s))
+	    SetBit(dm->damaged, s);
+      SaveDamageMap(dm, Closure->damageMapFile);
+      FreeDamageMap(dm);
+   }
+
    /* The image md5sum is only useful if all blocks have been successfully read. */
 
-   MD5Final(medium_sum, &image_md5);
+   MD5PipeFinal(medium_sum, vc->imageMD5);
    AsciiDigest(data_digest, medium_sum);
+   if(partial_verify)
+     data_md5 = _("not calculated (incremental verify)");
 
    /* Do a resume of our findings */ 
 
    if(!total_missing && !data_crc_errors && !csc->signatureErrors)
       PrintLog(_("- good image/file  : all sectors present\n"
-		 "- data md5sum      : %s\n"),data_digest);
+		 "- data md5sum      : %s\n"),data_md5);
    else
    {  if(!data_crc_errors && !csc->signatureErrors)
          PrintLog(_("* BAD image/file   : %" PRId64 " sectors missing\n"), total_missing);
@@ -1268,7 +1596,7 @@ void RS03Verify(Image *image)
       PrintLog(_("  ... data section   : %" PRId64 " sectors missing; %" PRId64 " CRC errors\n"), 
 	       data_missing, data_crc_errors);
       if(!total_missing && !data_crc_errors && !csc->signatureErrors)
-	PrintLog(_("  ... data md5sum    : %s\n"), data_digest); 
+	PrintLog(_("  ... data md5sum    : %s\n"), data_md5); 
 
       if(csc->signatureErrors)
 	 PrintLog(_("  ... crc section    : %" PRId64 " sectors missing; %" PRId64 " signature errors\n"), 
@@ -1289,7 +1617,7 @@ void RS03Verify(Image *image)
       if(!ecc_missing)
       {  GuiSetLabelText(wl->cmpEccSection, _("complete"));
       }
-      GuiSetLabelText(wl->cmpImageMd5Sum, "%s", data_missing ? "-" : data_digest);
+      GuiSetLabelText(wl->cmpImageMd5Sum, "%s", data_missing ? "-" : data_md5);
    }
    
    /*** Test error syndromes */
@@ -1339,6 +1667,11 @@ void RS03Verify(Image *image)
 #else
    prognosis(vc, total_missing+data_crc_errors, lay->totalSectors);
 #endif
+
+   /*** Remember the result for the next incremental verify */
+
+   if(vc->vs && vc->syndromesChecked)
+     SaveVerifyState(vc->vs);
    
 #ifdef WITH_GUI_YES
    if(Closure->guiMode)
@@ -205,13 +205,15 @@ DeviceHandle* OpenDevice(char *device)
   dh = g_malloc0(sizeof(DeviceHandle));
   dh->senseSize = sizeof(SCSI_Sense_Data);
 
-  if(!strcmp(device, "sim-cd"))
-  {  if(!Closure->simulateCD) /* can happen via resource file / last-device */
+  if(!strncmp(device, "sim-cd", 6))
+  {  char *sim_image = SimulatedCDImage(device);
+
+      if(!sim_image) /* can happen via resource file / last-device */
       {  g_free(dh);
          return NULL;
       }
 
-      dh->simImage = LargeOpen(Closure->simulateCD, O_RDONLY, IMG_PERMS);
+      dh->simImage = LargeOpen(sim_image, O_RDONLY, IMG_PERMS);
       if(!dh->simImage)
       {  g_free(dh);
 
@@ -120,13 +120,15 @@ DeviceHandle* OpenDevice(char *device)
    if(dh->senseSize > sizeof(struct scsi_sense_data))
       dh->senseSize = sizeof(struct scsi_sense_data);
 
-   if(!strcmp(device, "sim-cd"))
-   {  if(!Closure->simulateCD) /* can happen via resource file / last-device */
+   if(!strncmp(device, "sim-cd", 6))
+   {  char *sim_image = SimulatedCDImage(device);
+
+      if(!sim_image) /* can happen via resource file / last-device */
       {  g_free(dh);
          return NULL;
       }
      
-      dh->simImage = LargeOpen(Closure->simulateCD, O_RDONLY, IMG_PERMS);
+      dh->simImage = LargeOpen(sim_image, O_RDONLY, IMG_PERMS);
       if(!dh->simImage)
       {  g_free(dh);
 
@@ -55,6 +55,23 @@ AlignedBuffer* CreateAlignedBuffer(int size)
    return ab;
 }
 
+/* Same as above, but returns NULL if memory is exhausted.
+   Used for the large streaming buffers of the RS03 codec,
+   which must be aligned for O_DIRECT. */
+
+AlignedBuffer* TryCreateAlignedBuffer(size_t size)
+{  AlignedBuffer *ab = g_malloc0(sizeof(AlignedBuffer));
+
+   ab->base = g_try_malloc(size+4096);
+   if(!ab->base)
+   {  g_free(ab);
+      return NULL;
+   }
+   ab->buf  = ab->base + (4096 - ((intptr_t)ab->base & 4095));
+
+   return ab;
+}
+
 void FreeAlignedBuffer(AlignedBuffer *ab)
 {  g_free(ab->base);
    g_free(ab);
@@ -2301,11 +2318,8 @@ int TestUnitReady(DeviceHandle *dh)
  * Sector reading using the packet interface.
  */
 
-static int read_dvd_sector(DeviceHandle *dh, unsigned char *buf, int lba, int nsectors)
-{  Sense *sense = &dh->sense;
-   unsigned char cmd[MAX_CDB_SIZE];
-   int ret;
-
+static void build_dvd_read_cdb(unsigned char *cmd, int lba, int nsectors)
+{
    memset(cmd, 0, MAX_CDB_SIZE);
    cmd[0] = 0x28;  /* READ(10) */
    cmd[1] = 0;  /* no special flags */
@@ -2316,6 +2330,14 @@ static int read_dvd_sector(DeviceHandle *dh, unsigned char *buf, int lba, int ns
    cmd[6] = 0;         /* reserved */
    cmd[7] = 0;         /* number of sectors */
    cmd[8] = nsectors;  /* read 1 sector */
+}
+
+static int read_dvd_sector(DeviceHandle *dh, unsigned char *buf, int lba, int nsectors)
+{  Sense *sense = &dh->sense;
+   unsigned char cmd[MAX_CDB_SIZE];
+   int ret;
+
+   build_dvd_read_cdb(cmd, lba, nsectors);
 
    ret = SendPacket(dh, cmd, 10, buf, 2048*nsectors, sense, DATA_READ);
 
@@ -2324,11 +2346,8 @@ static int read_dvd_sector(DeviceHandle *dh, unsigned char *buf, int lba, int ns
    return ret;
 }
 
-static int read_cd_sector(DeviceHandle *dh, unsigned char *buf, int lba, int nsectors)
-{  Sense *sense = &dh->sense;
-   unsigned char cmd[MAX_CDB_SIZE];
-   int ret;
-
+static void build_cd_read_cdb(DeviceHandle *dh, unsigned char *cmd, int lba, int nsectors)
+{
    memset(cmd, 0, MAX_CDB_SIZE);
    cmd[0]  = 0xbe;         /* READ CD */
    switch(dh->subType)
@@ -2346,6 +2365,14 @@ static int read_cd_sector(DeviceHandle *dh, unsigned char *buf, int lba, int nse
    cmd[9]  = 0x10;  /* we want the user data only */
    cmd[10] = 0;    /* reserved stuff */
    cmd[11] = 0;    /* no special wishes for the control byte */
+}
+
+static int read_cd_sector(DeviceHandle *dh, unsigned char *buf, int lba, int nsectors)
+{  Sense *sense = &dh->sense;
+   unsigned char cmd[MAX_CDB_SIZE];
+   int ret;
+
+   build_cd_read_cdb(dh, cmd, lba, nsectors);
 
    ret = SendPacket(dh, cmd, 12, buf, 2048*nsectors, sense, DATA_READ);
 
@@ -2478,6 +2505,331 @@ static int read_raw_cd_sector(DeviceHandle *dh, unsigned char *outbuf, int lba,
    return ret;
 }
 
+/***
+ *** Read-ahead for the linear reader
+ ***
+ * Keeps up to Closure->readAhead READ commands queued at the drive
+ * so that it does not idle while the reader checksums and writes the
+ * previous sectors. With the sg driver the commands are passed to the
+ * kernel through the asynchronous sg interface; otherwise (simulated
+ * drive, cdrom driver, other OSes) a helper thread issues them in order.
+ * The queue predicts that the next request continues where the previous
+ * one ended. It is dropped when the reader jumps elsewhere, and given up
+ * for good on the first failed command so that the error handling
+ * remains with the normal synchronous reading routines.
+ */
+
+enum
+{  SLOT_QUEUED,               /* waiting for the helper thread */
+   SLOT_BUSY,                 /* command issued to the drive */
+   SLOT_DONE                  /* status and data available */
+};
+
+typedef struct
+{  gint64 lba;                /* first sector of the command */
+   int nsectors;              /* number of sectors */
+   unsigned char cmd[MAX_CDB_SIZE];
+   int cdbSize;
+   AlignedBuffer *ab;         /* receives the sector data */
+   Sense sense;               /* sense data of this command */
+   int status;                /* SendPacket() result */
+   int state;
+} ReadAheadSlot;
+
+typedef struct _ReadAhead
+{  DeviceHandle *dh;
+   ReadAheadSlot slot[MAX_READ_AHEAD];
+   int depth;                 /* number of commands kept in flight */
+   int head;                  /* oldest queued slot */
+   int count;                 /* number of queued slots */
+   int nsectors;              /* sectors per command */
+   gint64 nextSector;         /* first sector of the next command to queue */
+   gint64 lastSector;         /* do not read beyond this sector */
+   int failed;                /* TRUE after the first error */
+   int async;                 /* TRUE if using the asynchronous sg interface */
+
+   GThread *thread;           /* helper thread otherwise */
+   GMutex *lock;
+   GCond *cond;
+   int exit;
+} ReadAhead;
+
+static gpointer read_ahead_thread(gpointer data)
+{  ReadAhead *ra = (ReadAhead*)data;
+
+   g_mutex_lock(ra->lock);
+   while(!ra->exit)
+   {  ReadAheadSlot *slot = NULL;
+      int i,status;
+
+      for(i=0; i<ra->count; i++)
+      {  ReadAheadSlot *candidate = &ra->slot[(ra->head+i) % ra->depth];
+
+	 if(candidate->state == SLOT_QUEUED)
+	 {  slot = candidate;
+	    break;
+	 }
+      }
+
+      if(!slot)
+      {  g_cond_wait(ra->cond, ra->lock);
+	 continue;
+      }
+
+      slot->state = SLOT_BUSY;
+      g_mutex_unlock(ra->lock);
+
+      status = SendPacket(ra->dh, slot->cmd, slot->cdbSize, slot->ab->buf,
+			  2048*slot->nsectors, &slot->sense, DATA_READ);
+
+      g_mutex_lock(ra->lock);
+      slot->status = status;
+      slot->state  = SLOT_DONE;
+      g_cond_broadcast(ra->cond);
+   }
+   g_mutex_unlock(ra->lock);
+
+   return NULL;
+}
+
+/*
+ * Fill up the queue with the commands following ra->nextSector.
+ */
+
+static void queue_read_ahead(ReadAhead *ra)
+{  DeviceHandle *dh = ra->dh;
+
+   g_mutex_lock(ra->lock);
+   while(ra->count < ra->depth && ra->nextSector <= ra->lastSector)
+   {  int idx = (ra->head+ra->count) % ra->depth;
+      ReadAheadSlot *slot = &ra->slot[idx];
+      int n = ra->nsectors;
+
+      if(ra->nextSector+n-1 > ra->lastSector)
+	 n = ra->lastSector-ra->nextSector+1;
+
+      slot->lba      = ra->nextSector;
+      slot->nsectors = n;
+      if(dh->read == read_cd_sector)
+      {  build_cd_read_cdb(dh, slot->cmd, slot->lba, n);
+	 slot->cdbSize = 12;
+      }
+      else
+      {  build_dvd_read_cdb(slot->cmd, slot->lba, n);
+	 slot->cdbSize = 10;
+      }
+      memset(&slot->sense, 0, sizeof(Sense));
+      slot->status = 0;
+      slot->state  = SLOT_QUEUED;
+
+#ifdef SYS_LINUX
+      if(ra->async)
+      {  if(SubmitAsyncPacket(dh, idx, slot->cmd, slot->cdbSize, slot->ab->buf,
+			      2048*n, &slot->sense) < 0)
+	 {  slot->status = -1;
+	    slot->state  = SLOT_DONE;
+	 }
+	 else slot->state = SLOT_BUSY;
+      }
+#endif
+
+      ra->nextSector += n;
+      ra->count++;
+   }
+   g_cond_broadcast(ra->cond);
+   g_mutex_unlock(ra->lock);
+}
+
+/*
+ * Wait until the oldest queued command has completed.
+ */
+
+static ReadAheadSlot* wait_for_read_ahead(ReadAhead *ra)
+{  ReadAheadSlot *slot = &ra->slot[ra->head];
+
+#ifdef SYS_LINUX
+   if(ra->async)
+   {  if(slot->state == SLOT_BUSY)
+      {  slot->status = ReapAsyncPacket(ra->dh, ra->head);
+	 slot->state  = SLOT_DONE;
+      }
+      return slot;
+   }
+#endif
+
+   g_mutex_lock(ra->lock);
+   while(slot->state != SLOT_DONE)
+      g_cond_wait(ra->cond, ra->lock);
+   g_mutex_unlock(ra->lock);
+
+   return slot;
+}
+
+static void pop_read_ahead(ReadAhead *ra)
+{
+   g_mutex_lock(ra->lock);
+   ra->head = (ra->head+1) % ra->depth;
+   ra->count--;
+   g_mutex_unlock(ra->lock);
+}
+
+/*
+ * Drop all queued commands. Commands which have not yet been
+ * picked up by the helper thread are simply discarded;
+ * those already at the drive must be waited for.
+ */
+
+static void drain_read_ahead(ReadAhead *ra)
+{
+   g_mutex_lock(ra->lock);
+   while(ra->count > 0
+	 && ra->slot[(ra->head+ra->count-1) % ra->depth].state == SLOT_QUEUED)
+      ra->count--;
+   g_mutex_unlock(ra->lock);
+
+   while(ra->count > 0)
+   {  wait_for_read_ahead(ra);
+      pop_read_ahead(ra);
+   }
+}
+
+/*
+ * Try to deliver the requested sectors from the queue.
+ * Returns FALSE if the caller must read them synchronously.
+ */
+
+static int read_ahead(DeviceHandle *dh, unsigned char *buf, gint64 s, int nsectors)
+{  ReadAhead *ra = dh->readAhead;
+   ReadAheadSlot *slot;
+
+   if(ra->failed || nsectors > MAX_CLUSTER_SECTORS)
+      return FALSE;
+
+   /* Restart the queue if the caller left the predicted sequence */
+
+   if(   !ra->count
+      || ra->slot[ra->head].lba != s
+      || ra->slot[ra->head].nsectors != nsectors)
+   {  drain_read_ahead(ra);
+      ra->nextSector = s;
+      ra->nsectors   = nsectors;
+      queue_read_ahead(ra);
+
+      if(!ra->count)
+	 return FALSE;
+   }
+
+   slot = wait_for_read_ahead(ra);
+
+   /* Fall back to synchronous reading on the first error */
+
+   if(slot->status)
+   {  ra->failed = TRUE;
+      drain_read_ahead(ra);
+      PrintCLIorLabel(Closure->status,
+		      _("Sectors %" PRId64 " - %" PRId64 ": read-ahead failed; reading synchronously from now on.\n"),
+		      s, s+nsectors-1);
+      return FALSE;
+   }
+
+   memcpy(buf, slot->ab->buf, 2048*nsectors);
+   pop_read_ahead(ra);
+   queue_read_ahead(ra);
+
+   return TRUE;
+}
+
+/*
+ * Set up the read-ahead queue for reading up to last_sector.
+ * Raw reading and the defect simulation keep using
+ * the synchronous routines.
+ */
+
+void StartReadAhead(DeviceHandle *dh, int depth, gint64 last_sector)
+{  ReadAhead *ra;
+   GError *err = NULL;
+   int i;
+
+   if(dh->readAhead || depth < 1)
+      return;
+
+   if(Closure->readRaw || dh->defects || dh->stripe)
+      return;
+
+   if(dh->read != read_dvd_sector && dh->read != read_cd_sector)
+      return;
+
+   if(depth > MAX_READ_AHEAD)
+      depth = MAX_READ_AHEAD;
+
+   ra = g_malloc0(sizeof(ReadAhead));
+   ra->dh         = dh;
+   ra->depth      = depth;
+   ra->lastSector = last_sector;
+
+   for(i=0; i<depth; i++)
+      ra->slot[i].ab = CreateAlignedBuffer(MAX_CLUSTER_SIZE);
+
+   ra->lock = g_malloc(sizeof(GMutex));
+   g_mutex_init(ra->lock);
+   ra->cond = g_malloc(sizeof(GCond));
+   g_cond_init(ra->cond);
+
+#ifdef SYS_LINUX
+   ra->async = OpenAsyncPackets(dh);
+#endif
+
+   if(!ra->async)
+   {  ra->thread = g_thread_try_new("read_ahead", read_ahead_thread, (gpointer)ra, &err);
+      if(!ra->thread)
+      {  Verbose("# Read-ahead disabled: %s\n", err->message);
+	 g_error_free(err);
+	 dh->readAhead = ra;
+	 StopReadAhead(dh);
+	 return;
+      }
+   }
+
+   Verbose("# Read-ahead: %d commands queued %s\n", depth,
+	   ra->async ? "through the sg driver" : "by a helper thread");
+
+   dh->readAhead = ra;
+}
+
+void StopReadAhead(DeviceHandle *dh)
+{  ReadAhead *ra = dh->readAhead;
+   int i;
+
+   if(!ra)
+      return;
+
+   drain_read_ahead(ra);
+
+   if(ra->thread)
+   {  g_mutex_lock(ra->lock);
+      ra->exit = TRUE;
+      g_cond_broadcast(ra->cond);
+      g_mutex_unlock(ra->lock);
+      g_thread_join(ra->thread);
+   }
+
+#ifdef SYS_LINUX
+   if(ra->async)
+      CloseAsyncPackets(dh);
+#endif
+
+   g_mutex_clear(ra->lock);
+   g_free(ra->lock);
+   g_cond_clear(ra->cond);
+   g_free(ra->cond);
+
+   for(i=0; i<ra->depth; i++)
+      FreeAlignedBuffer(ra->slot[i].ab);
+
+   g_free(ra);
+   dh->readAhead = NULL;
+}
+
 /*
  * Sector reading through the device handle.
  * dh->read dispatches to one the routines above.
@@ -2502,6 +2854,16 @@ int ReadSectors(DeviceHandle *dh, unsigned char *buf, gint64 s, int nsectors)
        }
    }
 
+   /* Let the other drives help if several are reading the medium */
+
+   if(dh->stripe && ReadStripedSectors(dh, buf, s, nsectors))
+      return 0;
+
+   /* Take the sectors from the read-ahead queue if possible */
+
+   if(dh->readAhead && read_ahead(dh, buf, s, nsectors))
+      return 0;
+
 #if 0
    if(   (s == 331600 && nsectors > 16)
 	 || s >331605)
@@ -134,6 +134,9 @@ typedef struct _DeviceHandle
    SCSITaskInterface **taskInterface;
    IOVirtualRange *range;
 #endif
+#ifdef SYS_LINUX
+   int asyncFd;               /* sg node for queued commands; -1 if not open */
+#endif
 
   /*
    * Simulated images
@@ -170,6 +173,8 @@ typedef struct _DeviceHandle
    RawBuffer *rawBuffer;      /* for performing raw read analysis */
    int (*read)(struct _DeviceHandle*, unsigned char*, int, int);
    int (*readRaw)(struct _DeviceHandle*, unsigned char*, int, int);
+   struct _ReadAhead *readAhead; /* queued commands for the linear reader */
+   struct _Stripe *stripe;    /* further drives reading the same medium */
 
    /* 
     * Information about currently inserted medium 
@@ -264,6 +269,13 @@ DeviceHandle* open_spti_device(char*);
 int SendPacket(DeviceHandle*, unsigned char*, int, unsigned char*, int, Sense*, int);
 int SimulateSendPacket(DeviceHandle*, unsigned char*, int, unsigned char*, int, Sense*, int);
 
+#ifdef SYS_LINUX
+int OpenAsyncPackets(DeviceHandle*);
+int SubmitAsyncPacket(DeviceHandle*, int, unsigned char*, int, unsigned char*, int, Sense*);
+int ReapAsyncPacket(DeviceHandle*, int);
+void CloseAsyncPackets(DeviceHandle*);
+#endif
+
 /*** 
  *** scsi-layer.c
  ***
@@ -290,4 +302,16 @@ int  TestUnitReady(DeviceHandle*);
 int ReadSectors(DeviceHandle*, unsigned char*, gint64, int);
 int ReadSectorsFast(DeviceHandle*, unsigned char*, gint64, int);
 
+void StartReadAhead(DeviceHandle*, int, gint64);
+void StopReadAhead(DeviceHandle*);
+
+/***
+ *** read-striped.c
+ ***/
+
+void OpenStripedDevices(Image*);
+void SetStripedReading(DeviceHandle*, CrcBuf*, gint64);
+int  ReadStripedSectors(DeviceHandle*, unsigned char*, gint64, int);
+void CloseStripedDevices(DeviceHandle*);
+
 #endif /* SCSI_LAYER_H */
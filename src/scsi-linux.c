@@ -103,14 +103,17 @@ DeviceHandle* OpenDevice(char *device)
    dh = g_malloc0(sizeof(DeviceHandle));
 
    dh->senseSize = sizeof(Sense);
+   dh->asyncFd = -1;
 
-   if(!strcmp(device, "sim-cd"))
-   {  if(!Closure->simulateCD) /* can happen via resource file / last-device */
+   if(!strncmp(device, "sim-cd", 6))
+   {  char *sim_image = SimulatedCDImage(device);
+
+       if(!sim_image) /* can happen via resource file / last-device */
        {  g_free(dh);
           return NULL;
        }
 
-       dh->simImage = LargeOpen(Closure->simulateCD, O_RDONLY, IMG_PERMS);
+       dh->simImage = LargeOpen(sim_image, O_RDONLY, IMG_PERMS);
        if(!dh->simImage)
        {  g_free(dh);
 
@@ -348,4 +351,132 @@ int SendPacket(DeviceHandle *dh, unsigned char *cmd, int cdb_size, unsigned char
    return -1;
 }
 
+/***
+ *** Queued commands through the asynchronous sg interface.
+ ***
+ * Used by the read-ahead in scsi-layer.c. Commands are written to the
+ * sg node belonging to the drive and their completion is picked up
+ * later with read(). Each command is tagged with the number of its
+ * read-ahead slot so that the completions can be collected in order.
+ */
+
+/*
+ * Find the sg node for the device. /dev/srN and friends are
+ * looked up in sysfs; sg nodes are taken as they are.
+ */
+
+static char* find_sg_node(char *device)
+{  struct stat mystat;
+   char *real_path,*sysfs_dir,*sg_node = NULL;
+   const char *entry;
+   GDir *dir;
+
+   if(stat(device, &mystat))
+      return NULL;
+
+   if(S_ISCHR(mystat.st_mode))
+      return g_strdup(device);
+
+   if(!S_ISBLK(mystat.st_mode))
+      return NULL;
+
+   real_path = realpath(device, NULL);
+   if(!real_path)
+      return NULL;
+
+   sysfs_dir = g_strdup_printf("/sys/class/block/%s/device/scsi_generic", strrchr(real_path, '/')+1);
+   free(real_path);
+
+   dir = g_dir_open(sysfs_dir, 0, NULL);
+   g_free(sysfs_dir);
+   if(!dir)
+      return NULL;
+
+   entry = g_dir_read_name(dir);
+   if(entry)
+      sg_node = g_strdup_printf("/dev/%s", entry);
+   g_dir_close(dir);
+
+   return sg_node;
+}
+
+int OpenAsyncPackets(DeviceHandle *dh)
+{  char *sg_node;
+   int version,force_pack_id = 1;
+
+   if(dh->simImage || Closure->useSCSIDriver != DRIVER_SG)
+      return FALSE;
+
+   sg_node = find_sg_node(dh->device);
+   if(!sg_node)
+   {  Verbose("# No sg node found for %s\n", dh->device);
+      return FALSE;
+   }
+
+   dh->asyncFd = open(sg_node, O_RDWR);
+   if(dh->asyncFd < 0)
+   {  Verbose("# Could not open %s: %s\n", sg_node, strerror(errno));
+      g_free(sg_node);
+      return FALSE;
+   }
+
+   if(   ioctl(dh->asyncFd, SG_GET_VERSION_NUM, &version) < 0
+      || version < 30000
+      || ioctl(dh->asyncFd, SG_SET_FORCE_PACK_ID, &force_pack_id) < 0)
+   {  Verbose("# %s does not support queued commands\n", sg_node);
+      g_free(sg_node);
+      CloseAsyncPackets(dh);
+      return FALSE;
+   }
+
+   Verbose("# Queueing commands through %s\n", sg_node);
+   g_free(sg_node);
+   return TRUE;
+}
+
+int SubmitAsyncPacket(DeviceHandle *dh, int id, unsigned char *cmd, int cdb_size, unsigned char *buf, int size, Sense *sense)
+{  struct sg_io_hdr sg_io;
+
+   memset(&sg_io, 0, sizeof(sg_io));
+   sg_io.interface_id    = 'S';
+   sg_io.dxfer_direction = SG_DXFER_FROM_DEV;
+   sg_io.cmd_len         = cdb_size;
+   sg_io.mx_sb_len       = sizeof(Sense);
+   sg_io.dxfer_len       = size;
+   sg_io.dxferp          = buf;
+   sg_io.cmdp            = cmd;
+   sg_io.sbp             = (unsigned char*)sense;
+   sg_io.timeout         = 10*60*1000;
+   sg_io.flags           = SG_FLAG_LUN_INHIBIT|SG_FLAG_DIRECT_IO;
+   sg_io.pack_id         = id;
+
+   if(write(dh->asyncFd, &sg_io, sizeof(sg_io)) != sizeof(sg_io))
+      return -1;
+
+   return 0;
+}
+
+int ReapAsyncPacket(DeviceHandle *dh, int id)
+{  struct sg_io_hdr sg_io;
+
+   memset(&sg_io, 0, sizeof(sg_io));
+   sg_io.interface_id = 'S';
+   sg_io.pack_id      = id;
+
+   if(read(dh->asyncFd, &sg_io, sizeof(sg_io)) != sizeof(sg_io))
+      return -1;
+
+   if(sg_io.status || sg_io.host_status || sg_io.driver_status)
+      return -1;
+
+   return 0;
+}
+
+void CloseAsyncPackets(DeviceHandle *dh)
+{
+   if(dh->asyncFd >= 0)
+      close(dh->asyncFd);
+   dh->asyncFd = -1;
+}
+
 #endif /* SYS_LINUX */
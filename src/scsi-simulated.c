@@ -31,12 +31,42 @@
  ***/
 
 void InitSimulatedCD()
-{  
+{  unsigned int i;
+
    if(!Closure->simulateCD)
       return;
 
    g_ptr_array_add(Closure->deviceNodes, g_strdup("sim-cd"));
    g_ptr_array_add(Closure->deviceNames, g_strdup_printf(_("Simulated CD (%s)"), Closure->simulateCD));
+
+   if(Closure->simulateCDs)
+      for(i=0; i<Closure->simulateCDs->len; i++)
+      {  char *image = g_ptr_array_index(Closure->simulateCDs, i);
+
+	 g_ptr_array_add(Closure->deviceNodes, g_strdup_printf("sim-cd%d", i+2));
+	 g_ptr_array_add(Closure->deviceNames, g_strdup_printf(_("Simulated CD %d (%s)"), i+2, image));
+      }
+}
+
+/*
+ * Map the simulated drives to their images:
+ * sim-cd uses the first --sim-cd image, sim-cd2 the second one and so on.
+ */
+
+char* SimulatedCDImage(char *device)
+{  int n;
+
+   if(strncmp(device, "sim-cd", 6) || !Closure->simulateCD)
+      return NULL;
+
+   if(!device[6])
+      return Closure->simulateCD;
+
+   n = atoi(device+6);
+   if(n < 2 || !Closure->simulateCDs || n-2 >= Closure->simulateCDs->len)
+      return NULL;
+
+   return g_ptr_array_index(Closure->simulateCDs, n-2);
 }
 
 /***
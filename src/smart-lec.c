@@ -1605,6 +1605,89 @@ static void pick_best_frame(sh_context *shc, char *message)
 		  rb->bestFrame, rb->bestP2, rb->bestP1, rb->bestQ2, rb->bestQ1);
 }
 
+/*
+ * The heuristics only read rb and write into their sh_context.
+ * Each one gets its own copy of the context so that they can
+ * run in parallel. The copies share the visited list (which
+ * is only appended to between iterations), but have their own
+ * cycle penalties.
+ */
+
+typedef void (*sh_heuristic)(sh_context*);
+
+static sh_heuristic heuristics[] =
+{  many_p_correct_one_q,
+   many_q_correct_one_p,
+#ifndef LOCAL_ONLY
+   try_alternative_vectors,
+   try_alternative_crossing_bytes,
+#endif
+   find_p_with_two_erasures,
+   swap_p_for_new_improvement,
+   try_indirect_improvement
+};
+
+#define N_HEURISTICS ((int)(sizeof(heuristics)/sizeof(sh_heuristic)))
+
+typedef struct
+{  sh_context *shc;
+   sh_heuristic heuristic;
+} sh_task;
+
+static void run_heuristic(gpointer data, gpointer unused)
+{  sh_task *task = (sh_task*)data;
+
+   task->heuristic(task->shc);
+}
+
+static sh_context* clone_sh_context(sh_context *shc)
+{  sh_context *clone = g_malloc(sizeof(sh_context));
+
+   memcpy(clone, shc, sizeof(sh_context));
+   clone->penalty = g_malloc(sizeof(int)*shc->visitedMax);
+   memcpy(clone->penalty, shc->penalty, sizeof(int)*shc->visitedCnt);
+
+   return clone;
+}
+
+static void run_heuristics(sh_context *shc)
+{  sh_task tasks[N_HEURISTICS];
+   gpointer task_ptrs[N_HEURISTICS];
+   int *base_penalty;
+   int i,j;
+
+   for(i=0; i<N_HEURISTICS; i++)
+   {  tasks[i].shc = clone_sh_context(shc);
+      tasks[i].heuristic = heuristics[i];
+      task_ptrs[i] = &tasks[i];
+   }
+
+   RunLECSearchTasks(run_heuristic, task_ptrs, N_HEURISTICS);
+
+   /* Merge in the fixed order of the heuristics, so that the
+      result does not depend on the number of threads. */
+
+   base_penalty = g_malloc(sizeof(int)*shc->visitedMax);
+   memcpy(base_penalty, shc->penalty, sizeof(int)*shc->visitedCnt);
+
+   for(i=0; i<N_HEURISTICS; i++)
+   {  sh_context *clone = tasks[i].shc;
+
+      if(found_better_solution(shc, clone->bestBonus, clone->bestMalus))
+      {  memcpy(shc->bestFrame, clone->bestFrame, shc->rb->sampleSize);
+	 memcpy(shc->msg, clone->msg, SMART_LEC_MESSAGE_SIZE);
+      }
+
+      for(j=0; j<shc->visitedCnt; j++)
+	shc->penalty[j] += clone->penalty[j] - base_penalty[j];
+
+      g_free(clone->penalty);
+      g_free(clone);
+   }
+
+   g_free(base_penalty);
+}
+
 static int smart_lec_iteration(sh_context *shc, char *message)
 {  RawBuffer *rb = shc->rb;
   
@@ -1616,19 +1699,7 @@ static int smart_lec_iteration(sh_context *shc, char *message)
    update_pq_state(shc);
    print_pq_state(shc);
 
-   many_p_correct_one_q(shc);
-   many_q_correct_one_p(shc);
-#ifndef LOCAL_ONLY
-   try_alternative_vectors(shc);
-
-   try_alternative_crossing_bytes(shc);
-#endif
-
-   find_p_with_two_erasures(shc);
-
-   swap_p_for_new_improvement(shc);
-
-   try_indirect_improvement(shc);
+   run_heuristics(shc);
 
    if(frame_visited(shc, shc->bestFrame))
       printf("pruning!\n");
@@ -1662,7 +1733,8 @@ int SmartLEC(RawBuffer *rb)
 	 return TRUE;
       }
 
-      if(!memcmp(prev_state, rb->recovered, rb->sampleSize))
+      if(!memcmp(prev_state, rb->recovered, rb->sampleSize)
+	 || LECTimeExceeded(rb))
       {  free_sh_context(shc);
 	 return FALSE;
       }
@@ -0,0 +1,440 @@
+/*  dvdisaster: Additional error correction for optical media.
+ *  Copyright (C) 2004-2017 Carsten Gnoerlich.
+ *  Copyright (C) 2019-2021 The dvdisaster development team.
+ *
+ *  Email: support@dvdisaster.org
+ *
+ *  This file is part of dvdisaster.
+ *
+ *  dvdisaster is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  dvdisaster is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with dvdisaster. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*** src type: no GUI code ***/
+
+#include "dvdisaster.h"
+
+/*
+ * The verify state remembers which parts of an image and its ecc file
+ * were found to be free of defects by the last verify, so that the next
+ * verify only needs to look at the parts which may have changed since.
+ *
+ * The ecc blocks are divided into groups of consecutive blocks.
+ * A group covers one stripe of sectors in each layer; the codec
+ * tells us where these stripes are located in the image and ecc files.
+ * A group is considered unchanged if neither file has been modified
+ * since the last verify. If a file has been modified, the physical
+ * extents of each group are compared against the previous run
+ * (this needs FIEMAP, e.g. on Linux). This only locates the changes
+ * on copy-on-write file systems (e.g. btrfs), which never write
+ * modified data in place. On other file systems an in-place write
+ * keeps the extents, so all groups are verified then.
+ *
+ * A full verify is also done if the state does not belong to the
+ * image and ecc data, and after --full-verify-days have passed
+ * since the last full verify.
+ */
+
+#define VERIFY_STATE_COOKIE "*dvdisaster-vfy*"
+#define VERIFY_STATE_VERSION 2
+#define VERIFY_STATE_BYTE_ORDER 0x01020304
+
+typedef struct
+{  char cookie[16];
+   guint32 version;
+   guint32 byteOrder;           /* detects states from other architectures */
+   guint64 imageBytes;          /* size of image file in bytes */
+   guint64 eccBytes;            /* size of ecc file in bytes, or 0 */
+   gint64 imageMTime;           /* modification time of image file in nsec */
+   gint64 eccMTime;             /* modification time of ecc file in nsec */
+   gint64 stateTime;            /* time at which above values were taken, in sec */
+   gint64 lastFullVerify;       /* time of the last full verify */
+   guint64 groups;
+   guint64 groupBlocks;
+   gint32 extentsKnown;         /* extent digests follow the bitmap */
+   gint32 padding;
+   guint8 layoutId[16];         /* provided by the codec */
+   guint8 mediumFP[16];
+   guint8 payloadMD5sum[16];    /* md5sum of bitmap and extent digests */
+   guint32 selfCRC;             /* CRC32 of the preceding header bytes */
+   guint32 padding2;
+} VerifyStateHeader;
+
+/***
+ *** Extent digests
+ ***/
+
+/*
+ * Find the first extent which ends behind the given file position.
+ */
+
+static int first_extent(LargeExtent *ext, int n, guint64 pos)
+{  int lo = 0, hi = n;
+
+   while(lo < hi)
+   {  int mid = (lo+hi)/2;
+
+      if(ext[mid].logical + ext[mid].length <= pos)
+	   lo = mid+1;
+      else hi = mid;
+   }
+
+   return lo;
+}
+
+/*
+ * Digest the physical location of all stripes of each group.
+ * Returns FALSE if the extents of a file can not be determined.
+ */
+
+static int digest_extents(VerifyState *vs, LargeFile **file, VerifyStripeFunc stripe, gpointer data)
+{  LargeExtent *ext[2] = { NULL, NULL };
+   int n_ext[2] = { -1, -1 };
+   gint64 g;
+   int i;
+
+   for(i=0; i<2; i++)
+     if(file[i])
+     {  n_ext[i] = LargeExtents(file[i], &ext[i]);
+	if(n_ext[i] < 0)
+	{  g_free(ext[0]);
+	   return FALSE;
+	}
+     }
+
+   for(g=0; g<vs->groups; g++)
+   {  struct MD5Context md5ctxt;
+      int s;
+
+      MD5Init(&md5ctxt);
+
+      for(s=0; s<vs->stripes; s++)
+      {  guint64 offset, length, end;
+	 int f,e;
+
+	 stripe(data, g, s, &f, &offset, &length);
+	 if(!length || !file[f])
+	   continue;
+
+	 end = offset + length;
+	 for(e=first_extent(ext[f], n_ext[f], offset);
+	     e<n_ext[f] && ext[f][e].logical < end; e++)
+	 {  guint64 first = MAX(offset, ext[f][e].logical);
+	    guint64 last  = MIN(end, ext[f][e].logical + ext[f][e].length);
+	    guint64 entry[4];
+
+	    entry[0] = (guint64)f<<32 | ext[f][e].flags;
+	    entry[1] = first;
+	    entry[2] = ext[f][e].physical + (first - ext[f][e].logical);
+	    entry[3] = last - first;
+	    MD5Update(&md5ctxt, (unsigned char*)entry, sizeof(entry));
+	 }
+      }
+
+      MD5Final(vs->extentDigest + 16*g, &md5ctxt);
+   }
+
+   g_free(ext[0]);
+   g_free(ext[1]);
+   return TRUE;
+}
+
+/***
+ *** Load the previous state and decide what to verify
+ ***/
+
+static void payload_md5(VerifyState *vs, int extents, guint8 *digest)
+{  struct MD5Context md5ctxt;
+
+   MD5Init(&md5ctxt);
+   MD5Update(&md5ctxt, (unsigned char*)vs->clean->bitmap, vs->clean->words*sizeof(guint32));
+   if(extents)
+     MD5Update(&md5ctxt, vs->extentDigest, 16*vs->groups);
+   MD5Final(digest, &md5ctxt);
+}
+
+/*
+ * Read the previous state from the file.
+ * Returns the reason why it can not be used, or NULL.
+ */
+
+static char *load_state(VerifyState *vs, VerifyStateHeader *vsh, VerifyState *old)
+{  FILE *file;
+   char *reason = NULL;
+
+   file = portable_fopen(vs->path, "rb");
+   if(!file)
+     return _("no previous verify state");
+
+   if(   fread(vsh, sizeof(VerifyStateHeader), 1, file) != 1
+      || memcmp(vsh->cookie, VERIFY_STATE_COOKIE, 16))
+   {  reason = _("not a verify state file");
+      goto finished;
+   }
+
+   if(   vsh->version != VERIFY_STATE_VERSION
+      || vsh->byteOrder != VERIFY_STATE_BYTE_ORDER
+      || vsh->selfCRC != Crc32((unsigned char*)vsh, offsetof(VerifyStateHeader, selfCRC)))
+   {  reason = _("unsupported or damaged verify state");
+      goto finished;
+   }
+
+   if(   memcmp(vsh->layoutId, vs->layoutId, 16)
+      || memcmp(vsh->mediumFP, vs->mediumFP, 16)
+      || vsh->groups != vs->groups
+      || vsh->groupBlocks != vs->groupBlocks)
+   {  reason = _("verify state belongs to other ecc data");
+      goto finished;
+   }
+
+   if(   fread(old->clean->bitmap, sizeof(guint32), old->clean->words, file) != old->clean->words
+      || (vsh->extentsKnown
+	  && fread(old->extentDigest, 16, vs->groups, file) != vs->groups))
+   {  reason = _("verify state is truncated");
+      goto finished;
+   }
+
+   {  guint8 digest[16];
+
+      payload_md5(old, vsh->extentsKnown, digest);
+      if(memcmp(digest, vsh->payloadMD5sum, 16))
+	reason = _("unsupported or damaged verify state");
+   }
+
+finished:
+   fclose(file);
+   return reason;
+}
+
+/*
+ * A file is modified if its size or modification time differs.
+ * Modifications in the same second in which the state was
+ * recorded may go unnoticed in the modification time,
+ * so these are treated as modified, too.
+ */
+
+static int file_modified(guint64 bytes, gint64 mtime,
+			 guint64 old_bytes, gint64 old_mtime, gint64 state_time)
+{  return    bytes != old_bytes || mtime != old_mtime
+	  || mtime >= state_time * G_GINT64_CONSTANT(1000000000);
+}
+
+VerifyState *CreateVerifyState(Image *image, char *path, gint64 groups, gint64 group_blocks,
+			       int stripes, VerifyStripeFunc stripe, gpointer data, guint8 *layout_id)
+{  VerifyState *vs = g_malloc0(sizeof(VerifyState));
+   VerifyState *old = g_malloc0(sizeof(VerifyState));
+   VerifyStateHeader vsh;
+   LargeFile *file[2];
+   char *reason, *all_reason;
+   gint64 g,changed;
+   int s;
+
+   vs->path = g_strdup(path);
+   vs->groups = groups;
+   vs->groupBlocks = group_blocks;
+   vs->stripes = stripes;
+   vs->clean = CreateBitmap0(groups);
+   vs->check = CreateBitmap0(groups);
+   vs->extentDigest = g_malloc0(16*groups);
+   vs->now = g_get_real_time() / G_USEC_PER_SEC;
+   memcpy(vs->layoutId, layout_id, 16);
+   if(image->fpState == FP_PRESENT)
+     memcpy(vs->mediumFP, image->imageFP, 16);
+
+   /*** Only look at the ecc file if the codec keeps stripes there */
+
+   file[0] = image->file;
+   file[1] = NULL;
+   for(s=0; s<stripes; s++)
+   {  guint64 offset, length;
+      int f;
+
+      stripe(data, 0, s, &f, &offset, &length);
+      if(f == 1) file[1] = image->eccFile;
+   }
+
+   /*** Take the current properties of the files before verifying them */
+
+   if(!LargeStatMTime(file[0]->path, &vs->imageBytes, &vs->imageMTime))
+     vs->imageBytes = vs->imageMTime = 0;
+   if(file[1] && !LargeStatMTime(file[1]->path, &vs->eccBytes, &vs->eccMTime))
+     vs->eccBytes = vs->eccMTime = 0;
+   vs->extentsKnown = digest_extents(vs, file, stripe, data);
+
+   /*** Compare them with the previous state */
+
+   old->groups = groups;
+   old->clean = CreateBitmap0(groups);
+   old->extentDigest = g_malloc0(16*groups);
+
+   reason = load_state(vs, &vsh, old);
+   if(reason)
+   {  vs->reason = g_strdup(reason);
+      goto full_verify;
+   }
+
+   vs->lastFullVerify = vsh.lastFullVerify;
+   if(vs->now - vsh.lastFullVerify >= (gint64)Closure->fullVerifyDays*86400)
+   {  vs->reason = g_strdup_printf(_("last full verify is %d or more days ago"), Closure->fullVerifyDays);
+      goto full_verify;
+   }
+
+   if(   vs->imageBytes != vsh.imageBytes
+      || vs->eccBytes != vsh.eccBytes)
+   {  vs->reason = g_strdup(_("image or ecc file size has changed"));
+      goto full_verify;
+   }
+
+   /*** Groups which had defects are always verified again */
+
+   for(g=0; g<groups; g++)
+     if(GetBit(old->clean, g))
+          SetBit(vs->clean, g);
+     else SetBit(vs->check, g);
+
+   /*** Files have not been modified: skip all clean groups */
+
+   if(   !file_modified(vs->imageBytes, vs->imageMTime,
+		        vsh.imageBytes, vsh.imageMTime, vsh.stateTime)
+      && !file_modified(vs->eccBytes, vs->eccMTime,
+			vsh.eccBytes, vsh.eccMTime, vsh.stateTime))
+   {  all_reason = _("all ecc blocks had defects in the last verify");
+      goto partial_verify;
+   }
+
+   /*** Otherwise, find the modified groups from their extents */
+
+   all_reason = _("image or ecc file has been modified");
+   if(!vs->extentsKnown || !vsh.extentsKnown)
+   {  vs->reason = g_strdup(_("image or ecc file has been modified"));
+      goto full_verify;
+   }
+
+   if(   !LargeCopyOnWrite(file[0])
+      || (file[1] && !LargeCopyOnWrite(file[1])))
+   {  vs->reason = g_strdup(_("image or ecc file has been modified"));
+      goto full_verify;
+   }
+
+   changed = 0;
+   for(g=0; g<groups; g++)
+     if(memcmp(vs->extentDigest+16*g, old->extentDigest+16*g, 16))
+     {  SetBit(vs->check, g);
+	changed++;
+     }
+
+   if(!changed)
+   {  vs->reason = g_strdup(_("image or ecc file has been modified"));
+      goto full_verify;
+   }
+
+partial_verify:
+   for(g=0; g<groups; g++)
+     if(!GetBit(vs->check, g))
+       vs->unchanged++;
+
+   if(vs->unchanged)
+     goto finished;
+
+   /* All groups must be verified anyways; count that as a full verify */
+
+   vs->reason = g_strdup(all_reason);
+
+full_verify:
+   vs->fullVerify = TRUE;
+   vs->unchanged = 0;
+   for(g=0; g<groups; g++)
+   {  SetBit(vs->check, g);
+      SetBit(vs->clean, g);
+   }
+
+finished:
+
+   /* Groups which are verified in this run start out clean;
+      defects found during the verify will clear them. */
+
+   for(g=0; g<groups; g++)
+     if(GetBit(vs->check, g))
+       SetBit(vs->clean, g);
+
+   FreeBitmap(old->clean);
+   g_free(old->extentDigest);
+   g_free(old);
+
+   return vs;
+}
+
+/*
+ * Record a defect found during the verify.
+ */
+
+void MarkGroupDefective(VerifyState *vs, gint64 group)
+{
+   if(group >= 0 && group < vs->groups)
+     ClearBit(vs->clean, group);
+}
+
+/***
+ *** Save the state for the next verify
+ ***/
+
+void SaveVerifyState(VerifyState *vs)
+{  VerifyStateHeader vsh;
+   FILE *file;
+   int ok;
+
+   memset(&vsh, 0, sizeof(VerifyStateHeader));
+   memcpy(vsh.cookie, VERIFY_STATE_COOKIE, 16);
+   vsh.version        = VERIFY_STATE_VERSION;
+   vsh.byteOrder      = VERIFY_STATE_BYTE_ORDER;
+   vsh.imageBytes     = vs->imageBytes;
+   vsh.eccBytes       = vs->eccBytes;
+   vsh.imageMTime     = vs->imageMTime;
+   vsh.eccMTime       = vs->eccMTime;
+   vsh.stateTime      = vs->now;
+   vsh.lastFullVerify = vs->fullVerify ? vs->now : vs->lastFullVerify;
+   vsh.groups         = vs->groups;
+   vsh.groupBlocks    = vs->groupBlocks;
+   vsh.extentsKnown   = vs->extentsKnown;
+   memcpy(vsh.layoutId, vs->layoutId, 16);
+   memcpy(vsh.mediumFP, vs->mediumFP, 16);
+   payload_md5(vs, vs->extentsKnown, vsh.payloadMD5sum);
+   vsh.selfCRC = Crc32((unsigned char*)&vsh, offsetof(VerifyStateHeader, selfCRC));
+
+   file = portable_fopen(vs->path, "wb");
+   if(!file)
+   {  PrintLog(_("Could not save the verify state to %s: %s\n"), vs->path, strerror(errno));
+      return;
+   }
+
+   ok =    fwrite(&vsh, sizeof(VerifyStateHeader), 1, file) == 1
+        && fwrite(vs->clean->bitmap, sizeof(guint32), vs->clean->words, file) == vs->clean->words
+        && (!vs->extentsKnown
+	    || fwrite(vs->extentDigest, 16, vs->groups, file) == vs->groups);
+
+   if(fclose(file) || !ok)
+     PrintLog(_("Could not save the verify state to %s: %s\n"), vs->path, strerror(errno));
+}
+
+/***
+ *** Clean up
+ ***/
+
+void FreeVerifyState(VerifyState *vs)
+{  g_free(vs->path);
+   g_free(vs->reason);
+   FreeBitmap(vs->clean);
+   FreeBitmap(vs->check);
+   g_free(vs->extentDigest);
+   g_free(vs);
+}